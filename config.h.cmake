@@ -10,6 +10,8 @@
 #cmakedefine USE_MAXMIND_GEOIP
 #cmakedefine01 HAVE_CLOCK_GETTIME_MONOTONIC
 #cmakedefine HAVE_SOCK_CLOEXEC
+#cmakedefine HAVE_RECVMMSG
+#cmakedefine HAVE_SENDMMSG
 #define DEFAULT_BRIDGE_MAX_IN_OUTPUTS @DEFAULT_BRIDGE_MAX_IN_OUTPUTS@
 #cmakedefine SIPX_NO_RECORD
 
@@ -14,6 +14,8 @@ using namespace std;
 
 namespace reTurn {
 
+static_assert(RECEIVE_BUFFER_SIZE <= DataBuffer::PoolBlockSize, "receive buffers must fit in a pool block");
+
 AsyncSocketBase::AsyncSocketBase(asio::io_context& ioService) : 
   mIOService(ioService),
   mReceiving(false),
@@ -122,7 +124,7 @@ AsyncSocketBase::doReceive()
    if(!mReceiving)
    {
       mReceiving=true;
-      mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      mReceiveBuffer = DataBuffer::allocatePooled(RECEIVE_BUFFER_SIZE);
       transportReceive();
    }
 }
@@ -139,7 +141,7 @@ AsyncSocketBase::doFramedReceive()
    if(!mReceiving)
    {
       mReceiving=true;
-      mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      mReceiveBuffer = DataBuffer::allocatePooled(RECEIVE_BUFFER_SIZE);
       transportFramedReceive();
    }
 }
@@ -23,6 +23,12 @@ namespace reTurn {
 class AsyncSocketBaseHandler;
 class AsyncSocketBaseDestroyedHandler;
 
+#if defined(SO_REUSEPORT)
+/// SO_REUSEPORT: lets several sockets bind the same address and port, the
+/// kernel then spreads incoming datagrams/connections across them by flow
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> ReusePortOption;
+#endif
+
 class AsyncSocketBase :
    public std::enable_shared_from_this<AsyncSocketBase>
 {
@@ -47,6 +53,8 @@ public:
    virtual void framedReceive();  
    virtual void close();
 
+   asio::io_context& getIOService() noexcept { return mIOService; }
+
    bool isConnected() const noexcept { return mConnected; }
    asio::ip::address& getConnectedAddress() noexcept { return mConnectedAddress; }
    unsigned short getConnectedPort() const noexcept { return mConnectedPort; }
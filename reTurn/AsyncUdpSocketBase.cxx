@@ -26,6 +26,12 @@ AsyncUdpSocketBase::getSocketDescriptor()
 
 asio::error_code 
 AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port)
+{
+   return bind(address, port, false);
+}
+
+asio::error_code 
+AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port, bool reusePort)
 {
    asio::error_code errorCode;
    mSocket.open(address.is_v6() ? asio::ip::udp::v6() : asio::ip::udp::v4(), errorCode);
@@ -41,6 +47,12 @@ AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port)
 #endif
 #endif
       mSocket.set_option(asio::ip::udp::socket::reuse_address(true), errorCode);
+#if defined(SO_REUSEPORT)
+      if(reusePort)
+      {
+         mSocket.set_option(ReusePortOption(true), errorCode);
+      }
+#endif
       mSocket.set_option(asio::socket_base::receive_buffer_size(66560));
       //mSocket.set_option(asio::socket_base::send_buffer_size(66560));
       mSocket.bind(asio::ip::udp::endpoint(address, port), errorCode);
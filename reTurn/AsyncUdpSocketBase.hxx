@@ -18,6 +18,8 @@ public:
    unsigned int getSocketDescriptor() override;
 
    asio::error_code bind(const asio::ip::address& address, unsigned short port) override;
+   /// reusePort sets SO_REUSEPORT (where available) before binding
+   asio::error_code bind(const asio::ip::address& address, unsigned short port, bool reusePort);
    void connect(const std::string& address, unsigned short port) override;
 
    void transportReceive() override;
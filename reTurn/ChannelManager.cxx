@@ -17,7 +17,8 @@ ChannelManager::ChannelManager()
    // make starting channel number random; use the CSPRNG so the channel
    // number is not predictable (CWE-338) - predictable channels aid TURN
    // data injection.
-   int randInt = resip::Random::getCryptoRandom();
+   // (unsigned, so that a negative random number cannot take us below MIN_CHANNEL_NUM)
+   unsigned int randInt = (unsigned int)resip::Random::getCryptoRandom();
    mNextChannelNumber = MIN_CHANNEL_NUM + (unsigned short)(randInt % (MAX_CHANNEL_NUM-MIN_CHANNEL_NUM+1));
 }
 
@@ -34,9 +35,43 @@ void ChannelManager::clear()
    {
       delete it->second;
    }
-   // Now clear both maps
+   // Now clear the map and the channel table
    mTupleRemotePeerMap.clear();
-   mChannelRemotePeerMap.clear();
+   for (unsigned int i = 0; i < ChannelPageCount; i++)
+   {
+      mChannelPages[i].reset();
+   }
+}
+
+RemotePeer**
+ChannelManager::findChannelSlot(unsigned short channel, bool create)
+{
+   if(channel < MIN_CHANNEL_NUM || channel > MAX_CHANNEL_NUM)
+   {
+      return 0;
+   }
+   unsigned int index = channel - MIN_CHANNEL_NUM;
+   std::unique_ptr<RemotePeer*[]>& page = mChannelPages[index / ChannelPageSize];
+   if(!page)
+   {
+      if(!create)
+      {
+         return 0;
+      }
+      page.reset(new RemotePeer*[ChannelPageSize]());
+   }
+   return &page[index % ChannelPageSize];
+}
+
+void
+ChannelManager::clearChannelSlot(const RemotePeer* remotePeer)
+{
+   RemotePeer** slot = findChannelSlot(remotePeer->getChannel(), false);
+   // the channel may have been rebound to another peer since
+   if(slot && *slot == remotePeer)
+   {
+      *slot = 0;
+   }
 }
 
 unsigned short 
@@ -63,32 +98,35 @@ RemotePeer*
 ChannelManager::createChannelBinding(const StunTuple& peerTuple, unsigned short channel)
 {
    resip_assert(findRemotePeerByPeerAddress(peerTuple) == 0);
+   RemotePeer** slot = findChannelSlot(channel, true);
+   resip_assert(slot);
 
    // Create New RemotePeer
    RemotePeer* remotePeer = new RemotePeer(peerTuple, channel, TURN_CHANNEL_BINDING_LIFETIME_SECONDS);
 
-   // Add RemoteAddress to the appropriate maps
+   // Add RemoteAddress to the map and the channel table
    mTupleRemotePeerMap[peerTuple] = remotePeer;
-   mChannelRemotePeerMap[channel] = remotePeer;
+   *slot = remotePeer;
    return remotePeer;
 }
 
 RemotePeer* 
 ChannelManager::findRemotePeerByChannel(unsigned short channelNumber)
 {
-   ChannelRemotePeerMap::iterator it = mChannelRemotePeerMap.find(channelNumber);
-   if(it != mChannelRemotePeerMap.end())
+   RemotePeer** slot = findChannelSlot(channelNumber, false);
+   if(slot && *slot)
    {
-      if(!it->second->isExpired())
+      RemotePeer* remotePeer = *slot;
+      if(!remotePeer->isExpired())
       {
-         return it->second;
+         return remotePeer;
       }
       else
       {
          // cleanup expired channel binding
-         mTupleRemotePeerMap.erase(it->second->getPeerTuple());
-         delete it->second;
-         mChannelRemotePeerMap.erase(it);
+         mTupleRemotePeerMap.erase(remotePeer->getPeerTuple());
+         *slot = 0;
+         delete remotePeer;
       }
    }
    return 0;
@@ -108,8 +146,8 @@ ChannelManager::findRemotePeerByPeerAddress(const StunTuple& peerAddress)
       else
       {
          // cleanup expired channel binding
-         mChannelRemotePeerMap.erase(it->second->getChannel());
-		 delete it->second;
+         clearChannelSlot(it->second);
+         delete it->second;
          mTupleRemotePeerMap.erase(it);
       }
    }
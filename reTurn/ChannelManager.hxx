@@ -1,7 +1,8 @@
 #ifndef CHANNELMANAGER_HXX
 #define CHANNELMANAGER_HXX
 
-#include <map>
+#include <memory>
+#include <rutil/HashMap.hxx>
 #include "RemotePeer.hxx"
 
 namespace reTurn {
@@ -23,9 +24,16 @@ public:
    RemotePeer* findRemotePeerByPeerAddress(const StunTuple& peerAddress);
 
 private:
-   typedef std::map<unsigned short,RemotePeer*> ChannelRemotePeerMap;
-   typedef std::map<StunTuple,RemotePeer*> TupleRemotePeerMap;
-   ChannelRemotePeerMap mChannelRemotePeerMap;
+   // Channel numbers index directly into pages of ChannelPageSize entries; a
+   // page is only allocated once a channel in its range is bound, since most
+   // allocations use a handful of channels
+   static const unsigned int ChannelPageSize = 256;
+   static const unsigned int ChannelPageCount = (MAX_CHANNEL_NUM - MIN_CHANNEL_NUM + 1) / ChannelPageSize;
+   std::unique_ptr<RemotePeer*[]> mChannelPages[ChannelPageCount];
+   RemotePeer** findChannelSlot(unsigned short channel, bool create);
+   void clearChannelSlot(const RemotePeer* remotePeer);
+
+   typedef HashMap<StunTuple,RemotePeer*> TupleRemotePeerMap;
    TupleRemotePeerMap mTupleRemotePeerMap;
 
    unsigned short getNextChannelNumber();
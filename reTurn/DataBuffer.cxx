@@ -1,5 +1,6 @@
 #include "DataBuffer.hxx"
 #include <memory.h>
+#include <new>
 #include "rutil/ResipAssert.h"
 #include <rutil/WinLeakCheck.hxx>
 
@@ -10,8 +11,148 @@ void ArrayDeallocator(char* data)
    delete [] data;
 }
 
+namespace
+{
+
+// Blocks kept per thread and per list before further frees go back to the heap
+constexpr unsigned int MaxFreeBlocks = 1024;
+// Large enough for the shared_ptr control block that allocate_shared puts around a DataBuffer
+constexpr size_t NodeSize = 128;
+constexpr size_t BlockSize = DataBuffer::PoolHeadroom + DataBuffer::PoolBlockSize + DataBuffer::PoolTailroom;
+
+// Singly linked list of equally sized free blocks, linked through their first bytes
+class FreeList
+{
+public:
+   explicit FreeList(size_t blockSize) : mBlockSize(blockSize), mHead(nullptr), mCount(0) {}
+   ~FreeList()
+   {
+      while (mHead)
+      {
+         void* next = *static_cast<void**>(mHead);
+         ::operator delete(mHead);
+         mHead = next;
+      }
+   }
+
+   void* get()
+   {
+      if (!mHead)
+      {
+         return ::operator new(mBlockSize);
+      }
+      void* block = mHead;
+      mHead = *static_cast<void**>(block);
+      --mCount;
+      return block;
+   }
+
+   void put(void* block)
+   {
+      if (mCount >= MaxFreeBlocks)
+      {
+         ::operator delete(block);
+         return;
+      }
+      *static_cast<void**>(block) = mHead;
+      mHead = block;
+      ++mCount;
+   }
+
+private:
+   const size_t mBlockSize;
+   void* mHead;
+   unsigned int mCount;
+};
+
+struct ThreadPools
+{
+   ThreadPools() : mBlocks(BlockSize), mNodes(NodeSize) {}
+   ~ThreadPools();
+   FreeList mBlocks;
+   FreeList mNodes;
+};
+
+// Buffers can outlive the pools of the thread releasing them (eg. when held
+// by a static); from then on that thread uses the heap directly
+thread_local bool tPoolsDestroyed = false;
+thread_local ThreadPools tPools;
+
+ThreadPools::~ThreadPools()
+{
+   tPoolsDestroyed = true;
+}
+
+void* poolGet(FreeList ThreadPools::* list, size_t size)
+{
+   return tPoolsDestroyed ? ::operator new(size) : (tPools.*list).get();
+}
+
+void poolPut(FreeList ThreadPools::* list, void* block)
+{
+   if (tPoolsDestroyed)
+   {
+      ::operator delete(block);
+   }
+   else
+   {
+      (tPools.*list).put(block);
+   }
+}
+
+void PoolDeallocator(char* data)
+{
+   poolPut(&ThreadPools::mBlocks, data);
+}
+
+// Serves allocate_shared's single control block + DataBuffer allocation from the node pool
+template <class T>
+class PoolAllocator
+{
+public:
+   typedef T value_type;
+
+   PoolAllocator() noexcept {}
+   template <class U> PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+   T* allocate(size_t n)
+   {
+      if (fitsNode(n))
+      {
+         return static_cast<T*>(poolGet(&ThreadPools::mNodes, NodeSize));
+      }
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+   }
+
+   void deallocate(T* p, size_t n) noexcept
+   {
+      if (fitsNode(n))
+      {
+         poolPut(&ThreadPools::mNodes, p);
+      }
+      else
+      {
+         ::operator delete(p);
+      }
+   }
+
+private:
+   static bool fitsNode(size_t n)
+   {
+      return n == 1 && sizeof(T) <= NodeSize && alignof(T) <= alignof(std::max_align_t);
+   }
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+}
+
 DataBuffer::DataBuffer(const char* const data, const size_t size, deallocator dealloc)
    : mBuffer(nullptr)
+   , mCapacity(size)
    , mSize(size)
    , mDealloc(dealloc)
 {
@@ -25,6 +166,7 @@ DataBuffer::DataBuffer(const char* const data, const size_t size, deallocator de
 
 DataBuffer::DataBuffer(const size_t size, deallocator dealloc)
    : mBuffer(nullptr)
+   , mCapacity(size)
    , mSize(size)
    , mDealloc(dealloc)
 {
@@ -46,11 +188,24 @@ DataBuffer* DataBuffer::own(char* const data, const size_t size, deallocator dea
 {
    DataBuffer* buff = new reTurn::DataBuffer(0, dealloc);
    buff->mBuffer = data;
+   buff->mCapacity = size;
    buff->mSize = size;
    buff->mStart = buff->mBuffer;
    return buff;
 }
 
+std::shared_ptr<DataBuffer>
+DataBuffer::allocatePooled(const size_t size)
+{
+   resip_assert(size <= PoolBlockSize);
+   const auto buff = std::allocate_shared<DataBuffer>(PoolAllocator<DataBuffer>(), size_t(0), PoolDeallocator);
+   buff->mBuffer = static_cast<char*>(poolGet(&ThreadPools::mBlocks, BlockSize));
+   buff->mCapacity = BlockSize;
+   buff->mSize = size;
+   buff->mStart = buff->mBuffer + PoolHeadroom;
+   return buff;
+}
+
 const char* 
 DataBuffer::data() const noexcept
 { 
@@ -79,14 +234,14 @@ char&
 DataBuffer::operator[](const size_t p)
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 char 
 DataBuffer::operator[](const size_t p) const
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 size_t
@@ -106,6 +261,35 @@ DataBuffer::offset(const size_t bytes)
    return mSize;
 }
 
+size_t
+DataBuffer::headroom() const noexcept
+{
+   return mStart - mBuffer;
+}
+
+size_t
+DataBuffer::tailroom() const noexcept
+{
+   return mCapacity - headroom() - mSize;
+}
+
+size_t
+DataBuffer::prepend(const size_t bytes)
+{
+   resip_assert(bytes <= headroom());
+   mStart = mStart-bytes;
+   mSize = mSize+bytes;
+   return mSize;
+}
+
+size_t
+DataBuffer::append(const size_t bytes)
+{
+   resip_assert(bytes <= tailroom());
+   mSize = mSize+bytes;
+   return mSize;
+}
+
 } // namespace
 
 
@@ -2,6 +2,7 @@
 #define DATA_BUFFER_HXX
 
 #include <cstddef>
+#include <memory>
 
 namespace reTurn {
 
@@ -18,6 +19,20 @@ public:
 
    static DataBuffer* own(char* data, size_t size, deallocator dealloc = ArrayDeallocator);
 
+   /// Fixed size blocks handed out by allocatePooled
+   static constexpr size_t PoolBlockSize = 4096;
+   /// Room kept in front of a pooled buffer: enough for a STUN header, an
+   /// IPv6 XOR-PEER-ADDRESS and a DATA attribute header (or a ChannelData header)
+   static constexpr size_t PoolHeadroom = 48;
+   /// Room kept behind a pooled buffer for padding to a multiple of 4 bytes
+   static constexpr size_t PoolTailroom = 4;
+
+   /// Returns a buffer of size bytes (at most PoolBlockSize) taken from a
+   /// per-thread free list, so that a steady stream of packets does not touch
+   /// the heap.  The contents are not cleared.  The buffer has PoolHeadroom
+   /// and PoolTailroom bytes around it for prepend() and append().
+   static std::shared_ptr<DataBuffer> allocatePooled(size_t size);
+
    const char* data() const noexcept;
    size_t size() const noexcept;
    char& operator[](size_t p);
@@ -26,11 +41,17 @@ public:
    size_t truncate(size_t newSize);
    size_t offset(size_t bytes);
 
+   size_t headroom() const noexcept;  // bytes that prepend() can add in front of data()
+   size_t tailroom() const noexcept;  // bytes that append() can add after the end of the data
+   size_t prepend(size_t bytes);      // moves the start back over the headroom, returns the new size
+   size_t append(size_t bytes);       // grows the size into the tailroom, returns the new size
+
    char* mutableData() noexcept;
    size_t& mutableSize() noexcept;
 
 private:
    char* mBuffer;
+   size_t mCapacity;
    size_t mSize;
    char* mStart;
    deallocator mDealloc;
@@ -0,0 +1,236 @@
+#include "MetricsServer.hxx"
+#include "TurnStatistics.hxx"
+
+#include <functional>
+#include <istream>
+#include <rutil/DataStream.hxx>
+#include <rutil/OpenMetrics.hxx>
+#include <rutil/WinLeakCheck.hxx>
+#include <rutil/Logger.hxx>
+#include "ReTurnSubsystem.hxx"
+
+#define RESIPROCATE_SUBSYSTEM ReTurnSubsystem::RETURN
+
+using namespace resip;
+
+namespace reTurn {
+
+// Requests are a request line and a few headers; anything longer is dropped
+static const size_t MaxRequestSize = 8192;
+static const unsigned int RequestTimeoutSecs = 10;
+
+class MetricsConnection : public std::enable_shared_from_this<MetricsConnection>
+{
+public:
+   MetricsConnection(asio::io_context& ioService, const MetricsServer& server) :
+      mSocket(ioService),
+      mTimer(ioService),
+      mRequest(MaxRequestSize),
+      mServer(server)
+   {
+   }
+
+   asio::ip::tcp::socket& socket() { return mSocket; }
+
+   void start()
+   {
+      // Don't let a client that never completes its request hold the socket
+      mTimer.expires_after(std::chrono::seconds(RequestTimeoutSecs));
+      mTimer.async_wait(std::bind(&MetricsConnection::handleTimeout, shared_from_this(), std::placeholders::_1));
+      asio::async_read_until(mSocket, mRequest, "\r\n\r\n",
+         std::bind(&MetricsConnection::handleRead, shared_from_this(), std::placeholders::_1));
+   }
+
+private:
+   void handleRead(const asio::error_code& e)
+   {
+      if(e)
+      {
+         DebugLog(<< "MetricsConnection read failed: " << e.value() << "-" << e.message());
+         close();
+         return;
+      }
+
+      std::istream requestStream(&mRequest);
+      std::string requestLine;
+      std::getline(requestStream, requestLine);
+      // Accept a query string, which Prometheus does not send by default
+      bool isMetrics = requestLine.compare(0, 13, "GET /metrics ") == 0 ||
+                       requestLine.compare(0, 13, "GET /metrics?") == 0;
+
+      Data body;
+      Data response;
+      {
+         DataStream ds(response);
+         if(isMetrics)
+         {
+            mServer.buildMetrics(body);
+            ds << "HTTP/1.0 200 OK\r\n"
+               << "Content-Type: " << OpenMetricsWriter::ContentType << "\r\n";
+         }
+         else
+         {
+            body = "Not Found\n";
+            ds << "HTTP/1.0 404 Not Found\r\n"
+               << "Content-Type: text/plain\r\n";
+         }
+         ds << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n"
+            << "\r\n"
+            << body;
+      }
+      mResponse = response;
+      asio::async_write(mSocket, asio::buffer(mResponse.data(), mResponse.size()),
+         std::bind(&MetricsConnection::handleWrite, shared_from_this(), std::placeholders::_1));
+   }
+
+   void handleWrite(const asio::error_code& e)
+   {
+      if(e)
+      {
+         DebugLog(<< "MetricsConnection write failed: " << e.value() << "-" << e.message());
+      }
+      close();
+   }
+
+   void handleTimeout(const asio::error_code& e)
+   {
+      if(e != asio::error::operation_aborted)
+      {
+         close();
+      }
+   }
+
+   void close()
+   {
+      mTimer.cancel();
+      asio::error_code ec;
+      mSocket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+      mSocket.close(ec);
+   }
+
+   asio::ip::tcp::socket mSocket;
+   asio::steady_timer mTimer;
+   asio::streambuf mRequest;
+   Data mResponse;
+   const MetricsServer& mServer;
+};
+
+MetricsServer::MetricsServer(asio::io_context& ioService, const asio::ip::address& address, unsigned short port) :
+   mIOService(ioService),
+   mAcceptor(ioService),
+   mStartTime(time(0))
+{
+   asio::ip::tcp::endpoint endpoint(address, port);
+
+   mAcceptor.open(endpoint.protocol());
+   mAcceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+   mAcceptor.bind(endpoint);
+   mAcceptor.listen();
+
+   InfoLog(<< "MetricsServer started.  Listening on " << address.to_string() << ":" << port);
+}
+
+void
+MetricsServer::start()
+{
+   std::shared_ptr<MetricsConnection> connection = std::make_shared<MetricsConnection>(mIOService, *this);
+   mAcceptor.async_accept(connection->socket(), std::bind(&MetricsServer::handleAccept, this, connection, std::placeholders::_1));
+}
+
+void
+MetricsServer::handleAccept(const std::shared_ptr<MetricsConnection>& connection, const asio::error_code& e)
+{
+   if(!e)
+   {
+      connection->start();
+   }
+   else
+   {
+      ErrLog(<< "Error in MetricsServer::handleAccept: " << e.value() << "-" << e.message());
+      if(e == asio::error::operation_aborted)
+      {
+         return;
+      }
+   }
+   start();
+}
+
+void
+MetricsServer::buildMetrics(Data& body) const
+{
+   uint64_t counters[TurnStatistics::NumCounters];
+   TurnStatistics::snapshot(counters);
+
+   const uint64_t created = (uint64_t)mStartTime;
+   DataStream ds(body);
+   OpenMetricsWriter writer(ds);
+
+   writer.family("reTurn_active_allocations", OpenMetricsWriter::Gauge, "TURN allocations currently active");
+   writer.gauge((double)(counters[TurnStatistics::AllocationsCreated] - counters[TurnStatistics::AllocationsDestroyed]));
+   writer.family("reTurn_allocations", OpenMetricsWriter::Counter, "TURN allocations created");
+   writer.counter(counters[TurnStatistics::AllocationsCreated], OpenMetricsWriter::Labels(), created);
+
+   writer.family("reTurn_requests", OpenMetricsWriter::Counter, "STUN/TURN requests answered, by method and outcome");
+   static const char* const outcomes[TurnStatistics::NumRequestOutcomes] = { "success", "challenged", "error" };
+   for(unsigned int method = 0; method < TurnStatistics::NumRequestMethods; method++)
+   {
+      for(unsigned int outcome = 0; outcome < TurnStatistics::NumRequestOutcomes; outcome++)
+      {
+         writer.counter(counters[TurnStatistics::requestCounter((TurnStatistics::RequestMethod)method, (TurnStatistics::RequestOutcome)outcome)],
+                        OpenMetricsWriter::Labels("method", TurnStatistics::requestMethodName((TurnStatistics::RequestMethod)method)).add("outcome", outcomes[outcome]),
+                        created);
+      }
+   }
+
+   writer.family("reTurn_send_indications", OpenMetricsWriter::Counter, "Send indications received");
+   writer.counter(counters[TurnStatistics::SendIndications], OpenMetricsWriter::Labels(), created);
+
+   writer.family("reTurn_relayed_packets", OpenMetricsWriter::Counter, "Packets relayed, by direction");
+   writer.counter(counters[TurnStatistics::PacketsToPeers], OpenMetricsWriter::Labels("direction", "to_peer"), created);
+   writer.counter(counters[TurnStatistics::PacketsToClients], OpenMetricsWriter::Labels("direction", "to_client"), created);
+   writer.family("reTurn_relayed_bytes", OpenMetricsWriter::Counter, "Application data bytes relayed, by direction", "bytes");
+   writer.counter(counters[TurnStatistics::BytesToPeers], OpenMetricsWriter::Labels("direction", "to_peer"), created);
+   writer.counter(counters[TurnStatistics::BytesToClients], OpenMetricsWriter::Labels("direction", "to_client"), created);
+   writer.family("reTurn_dropped_packets", OpenMetricsWriter::Counter, "Packets not relayed for lack of a permission or channel binding");
+   writer.counter(counters[TurnStatistics::PacketsDropped], OpenMetricsWriter::Labels(), created);
+
+   writer.finish();
+}
+
+} // namespace
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of Plantronics nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
@@ -0,0 +1,72 @@
+#ifndef METRICSSERVER_HXX
+#define METRICSSERVER_HXX
+
+#include <memory>
+#include <time.h>
+#include <asio.hpp>
+#include <rutil/Data.hxx>
+
+namespace reTurn {
+
+class MetricsConnection;
+
+/// A minimal HTTP listener that answers GET /metrics with the TurnStatistics
+/// counters in the OpenMetrics text format, for Prometheus to scrape.  Each
+/// request is answered from a snapshot of the counters and the connection is
+/// then closed.
+class MetricsServer
+{
+public:
+   MetricsServer(asio::io_context& ioService, const asio::ip::address& address, unsigned short port);
+
+   void start();
+
+   /// Renders the current metrics, as served on /metrics
+   void buildMetrics(resip::Data& body) const;
+
+private:
+   void handleAccept(const std::shared_ptr<MetricsConnection>& connection, const asio::error_code& e);
+
+   asio::io_context& mIOService;
+   asio::ip::tcp::acceptor mAcceptor;
+   const time_t mStartTime;
+};
+
+} // namespace
+
+#endif
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of Plantronics nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
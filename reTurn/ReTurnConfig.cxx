@@ -46,6 +46,9 @@ ReTurnConfig::ReTurnConfig() :
    mTurnAddress(asio::ip::make_address("0.0.0.0")),
    mTurnV6Address(asio::ip::make_address("::0")),
    mAltStunAddress(asio::ip::make_address("0.0.0.0")),
+   mNumIOThreads(1),
+   mMetricsPort(0),
+   mMetricsAddress(asio::ip::make_address("127.0.0.1")),
    mAuthenticationRealm("reTurn"),
    mUserDatabaseCheckInterval(60),
    mNonceLifetime(3600),            // 1 hour - at least 1 hours is recommended by the RFC
@@ -79,6 +82,13 @@ void ReTurnConfig::parseConfig(int argc, char** argv, const resip::Data& default
    mTurnAddress = asio::ip::make_address(getConfigData("TurnAddress", "0.0.0.0").c_str());
    mTurnV6Address = asio::ip::make_address(getConfigData("TurnV6Address", "::0").c_str());
    mAltStunAddress = asio::ip::make_address(getConfigData("AltStunAddress", "0.0.0.0").c_str());
+   mNumIOThreads = getConfigUnsignedLong("NumIOThreads", mNumIOThreads);
+   if(mNumIOThreads == 0)
+   {
+      mNumIOThreads = 1;
+   }
+   mMetricsPort = getConfigUnsignedShort("MetricsPort", mMetricsPort);
+   mMetricsAddress = asio::ip::make_address(getConfigData("MetricsAddress", "127.0.0.1").c_str());
    mAuthenticationRealm = getConfigData("AuthenticationRealm", mAuthenticationRealm);
    mUserDatabaseCheckInterval = getConfigUnsignedShort("UserDatabaseCheckInterval", 60);
    mNonceLifetime = getConfigUnsignedLong("NonceLifetime", mNonceLifetime);
@@ -58,6 +58,9 @@ public:
    asio::ip::address mTurnAddress;
    asio::ip::address mTurnV6Address;
    asio::ip::address mAltStunAddress;
+   unsigned int mNumIOThreads;
+   unsigned short mMetricsPort;  // 0 disables the metrics listener
+   asio::ip::address mMetricsAddress;
 
    resip::Data mAuthenticationRealm;
    int mUserDatabaseCheckInterval;
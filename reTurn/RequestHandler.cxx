@@ -7,6 +7,7 @@
 #include "TurnAllocation.hxx"
 #include "AsyncSocketBase.hxx"
 #include "StunAuth.hxx"
+#include "TurnStatistics.hxx"
 #include <rutil/Random.hxx>
 #include <rutil/Timer.hxx>
 #include <rutil/ParseBuffer.hxx>
@@ -134,6 +135,12 @@ RequestHandler::processStunMessage(AsyncSocketBase* turnSocket, TurnAllocationMa
       }
    }
 
+   if(request.mClass == StunMessage::StunClassRequest)
+   {
+      TurnStatistics::countRequest(request.mMethod, response.mClass == StunMessage::StunClassErrorResponse,
+         response.mHasErrorCode ? response.mErrorCode.errorClass * 100 + response.mErrorCode.number : 0);
+   }
+
    if(result != NoResponseToSend)
    {
       // Fill in common response properties
@@ -882,6 +889,7 @@ RequestHandler::processTurnSendIndication(TurnAllocationManager& turnAllocationM
    // Shouldn't have more than one xor-peer-address attribute in this request
    StunMessage::setTupleFromStunAtrAddress(remoteAddress, request.mTurnXorPeerAddress[0]);
 
+   TurnStatistics::increment(TurnStatistics::SendIndications);
    const auto data = std::make_shared<DataBuffer>(request.mTurnData->data(), request.mTurnData->size());
    allocation->sendDataToPeer(remoteAddress, data, false /* isFramed? */);
 }
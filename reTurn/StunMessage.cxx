@@ -1495,6 +1495,32 @@ StunMessage::hasMagicCookie()
    return mHeader.id.magicCookie == htonl(StunMessage::StunMagicCookie);
 }
 
+unsigned int
+StunMessage::dataIndicationHeaderSize(const StunTuple& peerAddress)
+{
+   // header + XOR-PEER-ADDRESS + DATA attribute header
+   return (unsigned int)sizeof(StunMsgHdr) + (peerAddress.getAddress().is_v6() ? 24 : 12) + 4;
+}
+
+char*
+StunMessage::encodeDataIndicationHeader(char* buf, unsigned int dataSize)
+{
+   resip_assert(mCntTurnXorPeerAddress == 1);
+   uint16_t padsize = dataSize % 4 == 0 ? 0 : 4 - (dataSize % 4);
+   char* ptr = buf;
+
+   mHeader.msgType = mClass | mMethod;
+   ptr = encode16(ptr, mHeader.msgType);
+   char* lengthp = ptr;
+   ptr = encode16(ptr, 0);
+   ptr = encode(ptr, reinterpret_cast<const char*>(&mHeader.id), sizeof(mHeader.id));
+   ptr = encodeAtrXorAddress(ptr, TurnXorPeerAddress, mTurnXorPeerAddress[0]);
+   ptr = encode16(ptr, TurnData);
+   ptr = encode16(ptr, (uint16_t)dataSize);
+   encode16(lengthp, (uint16_t)(ptr - buf - sizeof(StunMsgHdr) + dataSize + padsize));
+   return ptr;
+}
+
 unsigned int
 StunMessage::stunEncodeMessage(char* buf, unsigned int bufLen)
 {
@@ -42,6 +42,12 @@ public:
    unsigned int stunEncodeMessage(char* buf, unsigned int bufLen);
    unsigned int stunEncodeFramedMessage(char* buf, unsigned int bufLen);  // Used for TURN-05 framing only
 
+   // Data Indication framing for relayed data that already sits in the buffer right after the
+   // header.  Set the header and the one XOR-PEER-ADDRESS first; encodes dataIndicationHeaderSize()
+   // bytes into buf and returns a pointer past them.  The caller pads the data to 4 bytes.
+   static unsigned int dataIndicationHeaderSize(const StunTuple& peerAddress);
+   char* encodeDataIndicationHeader(char* buf, unsigned int dataSize);
+
    void setErrorCode(unsigned short errorCode, const char* reason);
    void setUsername(const char* username);
    void setPassword(const char* password);
@@ -60,6 +60,12 @@ StunTuple::operator<(const StunTuple& rhs) const
    return false;
 }
 
+size_t
+StunTuple::hash() const
+{
+   return (std::hash<asio::ip::address>()(mAddress) * 31 + mPort) * 31 + mTransport;
+}
+
 void
 StunTuple::toSockaddr(sockaddr* addr) const
 {
@@ -115,6 +121,8 @@ operator<<(EncodeStream& strm, const StunTuple& tuple)
 
 } // namespace
 
+HashValueImp(reTurn::StunTuple, data.hash());
+
 
 /* ====================================================================
 
@@ -17,6 +17,7 @@
 #include <asio/ip/address.hpp>
 
 #include <rutil/resipfaststreams.hxx>
+#include <rutil/HashMap.hxx>
 
 namespace reTurn {
 
@@ -37,6 +38,7 @@ public:
    bool operator==(const StunTuple& rhs) const;
    bool operator!=(const StunTuple& rhs) const;
    bool operator<(const StunTuple& rhs) const;
+   size_t hash() const;
 
    TransportType getTransportType() const { return mTransport; }
    void setTransportType(TransportType transport) { mTransport = transport; }
@@ -61,6 +63,8 @@ EncodeStream& operator<<(EncodeStream& strm, const StunTuple& tuple);
 
 } 
 
+HashValue(reTurn::StunTuple);
+
 #endif
 
 
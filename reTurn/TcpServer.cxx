@@ -8,7 +8,7 @@
 
 namespace reTurn {
 
-TcpServer::TcpServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port)
+TcpServer::TcpServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port, bool reusePort)
 : mIOService(ioService),
   mAcceptor(ioService),
   mConnectionManager(),
@@ -20,6 +20,12 @@ TcpServer::TcpServer(asio::io_context& ioService, RequestHandler& requestHandler
 
    mAcceptor.open(endpoint.protocol());
    mAcceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+   if(reusePort)
+   {
+      mAcceptor.set_option(ReusePortOption(true));
+   }
+#endif
 #ifdef USE_IPV6
 #ifdef __linux__
    if(address.is_v6())
@@ -20,7 +20,7 @@ public:
   TcpServer& operator=(const TcpServer&) = delete;
 
   /// Create the server to listen on the specified TCP address and port
-  explicit TcpServer(asio::io_context& ioService, RequestHandler& rqeuestHandler, const asio::ip::address& address, unsigned short port);
+  explicit TcpServer(asio::io_context& ioService, RequestHandler& rqeuestHandler, const asio::ip::address& address, unsigned short port, bool reusePort = false);
 
   void start();
 
@@ -15,7 +15,7 @@
 
 namespace reTurn {
 
-TlsServer::TlsServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port)
+TlsServer::TlsServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port, bool reusePort)
 : mIOService(ioService),
   mAcceptor(ioService),
   mContext(asio::ssl::context::sslv23),  // SSLv23 (actually chooses TLS version dynamically)
@@ -64,6 +64,12 @@ TlsServer::TlsServer(asio::io_context& ioService, RequestHandler& requestHandler
 
    mAcceptor.open(endpoint.protocol());
    mAcceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+   if(reusePort)
+   {
+      mAcceptor.set_option(ReusePortOption(true));
+   }
+#endif
 #ifdef USE_IPV6
 #ifdef __linux__
    if(address.is_v6())
@@ -24,7 +24,7 @@ public:
   TlsServer& operator=(const TlsServer&) = delete;
 
   /// Create the server to listen on the specified TCP address and port
-  explicit TlsServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port);
+  explicit TlsServer(asio::io_context& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port, bool reusePort = false);
 
   void start();
 
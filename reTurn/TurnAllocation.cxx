@@ -2,6 +2,7 @@
 #include "TurnAllocationManager.hxx"
 #include "TurnManager.hxx"
 #include "TurnPermission.hxx"
+#include "TurnStatistics.hxx"
 #include "AsyncSocketBase.hxx"
 #include "UdpRelayServer.hxx"
 #include "RemotePeer.hxx"
@@ -41,7 +42,7 @@ TurnAllocation::TurnAllocation(TurnManager& turnManager,
    mRequestedTuple(requestedTuple),
    mTurnManager(turnManager),
    mTurnAllocationManager(turnAllocationManager),
-   mAllocationTimer(turnManager.getIOService()),
+   mAllocationTimer(localTurnSocket->getIOService()),
    mLocalTurnSocket(localTurnSocket),
    mBadChannelErrorLogged(false),
    mNoPermissionToPeerLogged(false),
@@ -50,6 +51,8 @@ TurnAllocation::TurnAllocation(TurnManager& turnManager,
    InfoLog(<< "TurnAllocation created: clientLocal=" << clientLocalTuple << " clientRemote=" << 
            clientRemoteTuple << " allocation=" << requestedTuple << " lifetime=" << lifetime);
 
+   TurnStatistics::increment(TurnStatistics::AllocationsCreated);
+
    refresh(lifetime);
 
    // Register for Turn Transport onDestroyed notification
@@ -60,6 +63,8 @@ TurnAllocation::~TurnAllocation()
 {
    // Destructors are implicitly noexcept, so any exception escaping here would
    // call std::terminate. Swallow anything thrown by logging or cleanup.
+   TurnStatistics::increment(TurnStatistics::AllocationsDestroyed);
+
    try
    {
       InfoLog(<< "TurnAllocation destroyed: clientLocal=" << mKey.getClientLocalTuple() << " clientRemote=" <<
@@ -93,7 +98,7 @@ TurnAllocation::startRelay()
 {
    if(mRequestedTuple.getTransportType() == StunTuple::UDP)
    {
-      mUdpRelayServer = std::make_shared<UdpRelayServer>(mTurnManager.getIOService(), *this);
+      mUdpRelayServer = std::make_shared<UdpRelayServer>(mLocalTurnSocket->getIOService(), *this);
       if(!mUdpRelayServer->startReceiving())
       {
          stopRelay();  // Ensure allocation timer is stopped
@@ -194,6 +199,7 @@ TurnAllocation::sendDataToPeer(unsigned short channelNumber, const std::shared_p
    }
    else
    {
+      TurnStatistics::increment(TurnStatistics::PacketsDropped);
       // Log at Warning level first time only
       if(mBadChannelErrorLogged)
       {
@@ -218,6 +224,7 @@ TurnAllocation::sendDataToPeer(const StunTuple& peerAddress, const std::shared_p
    // Ensure permission exists
    if(!existsPermission(peerAddress.getAddress()))
    {
+      TurnStatistics::increment(TurnStatistics::PacketsDropped);
       // Log at Warning level first time only
       if(mNoPermissionToPeerLogged)
       {
@@ -233,6 +240,8 @@ TurnAllocation::sendDataToPeer(const StunTuple& peerAddress, const std::shared_p
    if(mRequestedTuple.getTransportType() == StunTuple::UDP)
    {
       resip_assert(mUdpRelayServer);
+      TurnStatistics::increment(TurnStatistics::PacketsToPeers);
+      TurnStatistics::increment(TurnStatistics::BytesToPeers, isFramed ? data->size() - 4 : data->size());
       mUdpRelayServer->doSend(peerAddress, data, isFramed ? 4 /* bufferStartPos is 4 so that framing is skipped */ : 0);
    }
    else
@@ -253,6 +262,7 @@ TurnAllocation::sendDataToClient(const StunTuple& peerAddress, const std::shared
    // See if a permission exists
    if(!existsPermission(peerAddress.getAddress()))
    {
+      TurnStatistics::increment(TurnStatistics::PacketsDropped);
       // Log at Warning level first time only
       if(mNoPermissionFromPeerLogged)
       {
@@ -265,12 +275,28 @@ TurnAllocation::sendDataToClient(const StunTuple& peerAddress, const std::shared
       }
       return;
    }
+   TurnStatistics::increment(TurnStatistics::PacketsToClients);
+   TurnStatistics::increment(TurnStatistics::BytesToClients, data->size());
+
    // See if a channel binding exists - if so, use it
    RemotePeer* remotePeer = mChannelManager.findRemotePeerByPeerAddress(peerAddress);
    if(remotePeer)
    {
-      // send data to local client
-      mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), remotePeer->getChannel(), data);
+      // send data to local client - data is ours (the relay socket receives into a
+      // new buffer), so add the ChannelData header in place when there is room for it
+      if(data->headroom() >= 4)
+      {
+         data->prepend(4);
+         uint16_t channel = htons(remotePeer->getChannel());
+         uint16_t dataLen = htons((uint16_t)(data->size() - 4));
+         memcpy(data->mutableData(), &channel, 2);
+         memcpy(data->mutableData() + 2, &dataLen, 2);
+         mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), data);
+      }
+      else
+      {
+         mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), remotePeer->getChannel(), data);
+      }
 
       DebugLog(<< "TurnAllocation sendDataToClient: clientLocal=" << mKey.getClientLocalTuple() << " clientRemote=" << 
                   mKey.getClientRemoteTuple() << " allocation=" << mRequestedTuple << " peer=" << peerAddress << 
@@ -283,14 +309,30 @@ TurnAllocation::sendDataToClient(const StunTuple& peerAddress, const std::shared
       dataInd.createHeader(StunMessage::StunClassIndication, StunMessage::TurnDataMethod);
       dataInd.mCntTurnXorPeerAddress = 1;
       StunMessage::setStunAtrAddressFromTuple(dataInd.mTurnXorPeerAddress[0], peerAddress);
-      dataInd.setTurnData(data->data(), (unsigned int)data->size());
-
-      // send DataInd to local client
-      unsigned int bufferSize = (unsigned int)data->size() + 8 /* Stun Header */ + 36 /* Remote Address (v6) */ + 8 /* TurnData Header + potential pad */;
-      const auto buffer = AsyncSocketBase::allocateBuffer(bufferSize);
-      unsigned int size = dataInd.stunEncodeMessage((char*)buffer->data(), bufferSize);
-      buffer->truncate(size);  // Set size to proper size
-      mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), buffer);
+
+      unsigned int dataSize = (unsigned int)data->size();
+      unsigned int headerSize = StunMessage::dataIndicationHeaderSize(peerAddress);
+      unsigned int padSize = dataSize % 4 == 0 ? 0 : 4 - (dataSize % 4);
+      if(data->headroom() >= headerSize && data->tailroom() >= padSize)
+      {
+         // encode the DataInd around the data, in place
+         data->prepend(headerSize);
+         dataInd.encodeDataIndicationHeader(data->mutableData(), dataSize);
+         memset(data->mutableData() + data->size(), 0, padSize);
+         data->append(padSize);
+         mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), data);
+      }
+      else
+      {
+         dataInd.setTurnData(data->data(), dataSize);
+
+         // send DataInd to local client
+         unsigned int bufferSize = dataSize + 8 /* Stun Header */ + 36 /* Remote Address (v6) */ + 8 /* TurnData Header + potential pad */;
+         const auto buffer = AsyncSocketBase::allocateBuffer(bufferSize);
+         unsigned int size = dataInd.stunEncodeMessage((char*)buffer->data(), bufferSize);
+         buffer->truncate(size);  // Set size to proper size
+         mLocalTurnSocket->doSend(mKey.getClientRemoteTuple(), buffer);
+      }
 
       DebugLog(<< "TurnAllocation sendDataToClient: clientLocal=" << mKey.getClientLocalTuple() << " clientRemote=" << 
                   mKey.getClientRemoteTuple() << " allocation=" << mRequestedTuple << " peer=" << peerAddress << 
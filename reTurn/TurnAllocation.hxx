@@ -1,7 +1,7 @@
 #ifndef TURNALLOCATION_HXX
 #define TURNALLOCATION_HXX
 
-#include <map>
+#include <rutil/HashMap.hxx>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
@@ -64,7 +64,7 @@ public:
    void sendDataToPeer(unsigned short channelNumber, const std::shared_ptr<DataBuffer>& data, bool isFramed);
    // Used when Send Indication is received from client, to forward data to peer
    void sendDataToPeer(const StunTuple& peerAddress, const std::shared_ptr<DataBuffer>& data, bool isFramed);  
-   // Used when Data is received from peer, to forward data to client
+   // Used when Data is received from peer, to forward data to client - data is framed in place if its buffer has room
    void sendDataToClient(const StunTuple& peerAddress, const std::shared_ptr<DataBuffer>& data); 
 
    // Called when a ChannelBind Request is received
@@ -82,7 +82,7 @@ private:
    time_t    mExpires;
    //unsigned int mBandwidth; // future use
 
-   typedef std::map<asio::ip::address,TurnPermission*> TurnPermissionMap;
+   typedef HashMap<asio::ip::address,TurnPermission*> TurnPermissionMap;
    TurnPermissionMap mTurnPermissionMap;
 
    TurnManager& mTurnManager;
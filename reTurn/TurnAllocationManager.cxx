@@ -31,6 +31,20 @@ TurnAllocationManager::addTurnAllocation(TurnAllocation* turnAllocation)
 {
    resip_assert(findTurnAllocation(turnAllocation->getKey()) == 0);   
    mTurnAllocationMap[turnAllocation->getKey()] = turnAllocation;
+   mRequestedTupleMap[turnAllocation->getRequestedTuple()] = turnAllocation;
+}
+
+void
+TurnAllocationManager::eraseTurnAllocation(TurnAllocationMap::iterator it)
+{
+   TurnAllocation* turnAllocation = it->second;
+   RequestedTupleMap::iterator tupleIt = mRequestedTupleMap.find(turnAllocation->getRequestedTuple());
+   if(tupleIt != mRequestedTupleMap.end() && tupleIt->second == turnAllocation)
+   {
+      mRequestedTupleMap.erase(tupleIt);
+   }
+   mTurnAllocationMap.erase(it);
+   delete turnAllocation;
 }
 
 void 
@@ -39,8 +53,7 @@ TurnAllocationManager::removeTurnAllocation(const TurnAllocationKey& turnAllocat
    TurnAllocationMap::iterator it = mTurnAllocationMap.find(turnAllocationKey);
    if(it != mTurnAllocationMap.end())
    {
-      delete it->second;
-      mTurnAllocationMap.erase(it);
+      eraseTurnAllocation(it);
    }
 }
 
@@ -58,13 +71,10 @@ TurnAllocationManager::findTurnAllocation(const TurnAllocationKey& turnAllocatio
 TurnAllocation* 
 TurnAllocationManager::findTurnAllocation(const StunTuple& requestedTuple)
 {
-   TurnAllocationMap::iterator it;
-   for(it = mTurnAllocationMap.begin(); it != mTurnAllocationMap.end(); it++)
+   RequestedTupleMap::iterator it = mRequestedTupleMap.find(requestedTuple);
+   if(it != mRequestedTupleMap.end())
    {
-      if(it->second->getRequestedTuple() == requestedTuple)
-      {
-         return it->second;
-      }
+      return it->second;
    }
    return 0;
 }
@@ -82,8 +92,7 @@ TurnAllocationManager::allocationExpired(const asio::error_code& e, const TurnAl
       {
          if(time(0) >= it->second->getExpires())
          {
-            delete it->second;
-            mTurnAllocationMap.erase(it);
+            eraseTurnAllocation(it);
          }
       }
    }
@@ -1,7 +1,6 @@
 #ifndef TURNALLOCATIONMANAGER_HXX
 #define TURNALLOCATIONMANAGER_HXX
 
-#include <map>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
@@ -9,6 +8,7 @@
 #include "TurnAllocationKey.hxx"
 #include "ReTurnConfig.hxx"
 #include "StunTuple.hxx"
+#include <rutil/HashMap.hxx>
 
 namespace reTurn {
 
@@ -29,8 +29,12 @@ public:
    void allocationExpired(const asio::error_code& e, const TurnAllocationKey& turnAllocationKey);
 
 private:
-   typedef std::map<TurnAllocationKey, TurnAllocation*> TurnAllocationMap;  // .slg. consider using hash table
+   typedef HashMap<TurnAllocationKey, TurnAllocation*> TurnAllocationMap;
    TurnAllocationMap mTurnAllocationMap;
+   typedef HashMap<StunTuple, TurnAllocation*> RequestedTupleMap;  // second index, by relay address
+   RequestedTupleMap mRequestedTupleMap;
+
+   void eraseTurnAllocation(TurnAllocationMap::iterator it);  // deletes the allocation
 };
 
 } 
@@ -6,17 +6,21 @@
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
 #endif
+#include <rutil/Mutex.hxx>
 #include "ReTurnConfig.hxx"
 #include "StunTuple.hxx"
 
 namespace reTurn {
 
+/// Owns the relay port space.  The port allocation API's are thread safe, so
+/// that one TurnManager can be shared by servers running on several io_contexts.
 class TurnManager
 {
 public:
    explicit TurnManager(asio::io_context& ioService, const ReTurnConfig& config);  // ioService used to start timers
    ~TurnManager();
 
+   /// Note:  allocations run on the io_context of the socket they were requested on, not this one
    asio::io_context& getIOService() { return mIOService; }
 
    unsigned short allocateAnyPort(StunTuple::TransportType transport);
@@ -43,6 +47,7 @@ private:
    unsigned short mLastAllocatedTcpPort;
    PortAllocationMap& getPortAllocationMap(StunTuple::TransportType transport);
    unsigned short advanceLastAllocatedPort(StunTuple::TransportType transport, unsigned int numToAdvance = 1);
+   resip::Mutex mMutex;  // protects the port maps and last allocated ports
 
    asio::io_context& mIOService;
    const ReTurnConfig& mConfig;
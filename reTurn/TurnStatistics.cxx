@@ -0,0 +1,173 @@
+#include "TurnStatistics.hxx"
+#include "StunMessage.hxx"
+
+#include <atomic>
+#include <vector>
+#include <rutil/Lock.hxx>
+#include <rutil/Mutex.hxx>
+
+using namespace resip;
+
+namespace reTurn {
+
+namespace
+{
+
+// Aligned so that the blocks of two threads never share a cache line
+struct alignas(64) CounterBlock
+{
+   CounterBlock()
+   {
+      for(unsigned int i = 0; i < TurnStatistics::NumCounters; i++)
+      {
+         mCounters[i].store(0, std::memory_order_relaxed);
+      }
+   }
+   std::atomic<uint64_t> mCounters[TurnStatistics::NumCounters];
+};
+
+// The blocks are never freed, so that neither a thread exiting nor the static
+// destructors at exit can race with a snapshot
+struct Registry
+{
+   Mutex mMutex;
+   std::vector<CounterBlock*> mBlocks;
+};
+
+Registry& registry()
+{
+   static Registry* registry = new Registry;
+   return *registry;
+}
+
+thread_local CounterBlock* tBlock = 0;
+
+CounterBlock& threadBlock()
+{
+   if(!tBlock)
+   {
+      tBlock = new CounterBlock;
+      Registry& reg = registry();
+      Lock lock(reg.mMutex);
+      reg.mBlocks.push_back(tBlock);
+   }
+   return *tBlock;
+}
+
+}
+
+void
+TurnStatistics::increment(Counter counter, uint64_t amount)
+{
+   // Only this thread writes its block, so there is no read-modify-write race
+   std::atomic<uint64_t>& value = threadBlock().mCounters[counter];
+   value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void
+TurnStatistics::countRequest(unsigned short stunMethod, bool errorResponse, unsigned short errorCode)
+{
+   RequestMethod method;
+   switch(stunMethod)
+   {
+   case StunMessage::BindMethod:
+      method = BindingMethod;
+      break;
+   case StunMessage::TurnAllocateMethod:
+      method = AllocateMethod;
+      break;
+   case StunMessage::TurnRefreshMethod:
+      method = RefreshMethod;
+      break;
+   case StunMessage::TurnCreatePermissionMethod:
+      method = CreatePermissionMethod;
+      break;
+   case StunMessage::TurnChannelBindMethod:
+      method = ChannelBindMethod;
+      break;
+   default:
+      method = OtherMethod;
+      break;
+   }
+   RequestOutcome outcome = Success;
+   if(errorResponse)
+   {
+      outcome = (errorCode == 401 || errorCode == 438) ? Challenged : Error;
+   }
+   increment(requestCounter(method, outcome));
+}
+
+const char*
+TurnStatistics::requestMethodName(RequestMethod method)
+{
+   switch(method)
+   {
+   case BindingMethod:
+      return "Binding";
+   case AllocateMethod:
+      return "Allocate";
+   case RefreshMethod:
+      return "Refresh";
+   case CreatePermissionMethod:
+      return "CreatePermission";
+   case ChannelBindMethod:
+      return "ChannelBind";
+   default:
+      return "Other";
+   }
+}
+
+void
+TurnStatistics::snapshot(uint64_t* counters)
+{
+   for(unsigned int i = 0; i < NumCounters; i++)
+   {
+      counters[i] = 0;
+   }
+   Registry& reg = registry();
+   Lock lock(reg.mMutex);
+   for(std::vector<CounterBlock*>::const_iterator it = reg.mBlocks.begin(); it != reg.mBlocks.end(); it++)
+   {
+      for(unsigned int i = 0; i < NumCounters; i++)
+      {
+         counters[i] += (*it)->mCounters[i].load(std::memory_order_relaxed);
+      }
+   }
+}
+
+} // namespace
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of Plantronics nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
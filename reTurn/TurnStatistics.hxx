@@ -0,0 +1,102 @@
+#ifndef TURNSTATISTICS_HXX
+#define TURNSTATISTICS_HXX
+
+#include <stdint.h>
+
+namespace reTurn {
+
+/// Counts what the server has done since it started, for the metrics listener.
+///
+/// Every io thread counts into a block of counters of its own, that only it
+/// writes, so counting on the relay path costs a load and a store rather than
+/// a locked instruction on a cache line shared by all threads.  snapshot()
+/// adds up the blocks of all threads.  Blocks are kept after their thread
+/// exits, so that the totals never go down.
+class TurnStatistics
+{
+public:
+   typedef enum
+   {
+      BindingMethod,
+      AllocateMethod,
+      RefreshMethod,
+      CreatePermissionMethod,
+      ChannelBindMethod,
+      OtherMethod,
+      NumRequestMethods
+   } RequestMethod;
+
+   typedef enum
+   {
+      Success,
+      Challenged,    // 401 or 438, normally answered with a retry carrying credentials
+      Error,
+      NumRequestOutcomes
+   } RequestOutcome;
+
+   typedef enum
+   {
+      AllocationsCreated,
+      AllocationsDestroyed,
+      SendIndications,
+      PacketsToPeers,
+      BytesToPeers,
+      PacketsToClients,
+      BytesToClients,
+      PacketsDropped,   // no permission for the peer, or an unbound channel
+      Requests,         // NumRequestMethods * NumRequestOutcomes counters, see requestCounter
+      NumCounters = Requests + NumRequestMethods * NumRequestOutcomes
+   } Counter;
+
+   static void increment(Counter counter, uint64_t amount = 1);
+   /// Counts a STUN/TURN request by its STUN method and the class and error code of its response
+   static void countRequest(unsigned short stunMethod, bool errorResponse, unsigned short errorCode);
+
+   static Counter requestCounter(RequestMethod method, RequestOutcome outcome)
+   {
+      return (Counter)(Requests + method * NumRequestOutcomes + outcome);
+   }
+   static const char* requestMethodName(RequestMethod method);
+
+   /// Sums the counters of all threads into counters, which must hold NumCounters values
+   static void snapshot(uint64_t* counters);
+};
+
+} // namespace
+
+#endif
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of Plantronics nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
@@ -9,6 +9,7 @@
 #include "TurnLoadGenAsyncSocketHandler.hxx"
 #include "../TurnSocket.hxx"
 #include <rutil/Logger.hxx>
+#include <rutil/Timer.hxx>
 #include <rutil/WinLeakCheck.hxx>
 
 #ifdef BOOST_ASIO_HAS_STD_CHRONO
@@ -27,6 +28,7 @@ using namespace resip;
 #define LOG_PREFIX << "[" << mClientNum << "] "
 
 resip::Data* g_Payload = NULL;
+TurnLoadGenStats g_Stats = { 0, 0, 0, 0, 0 };
 
 TurnLoadGenAsyncSocketHandler::TurnLoadGenAsyncSocketHandler(
    int clientNum, 
@@ -47,6 +49,8 @@ TurnLoadGenAsyncSocketHandler::TurnLoadGenAsyncSocketHandler(
       mNumSendFailures(0),
       mNumReceiveSuccesses(0),
       mNumReceiveFailures(0),
+      mStartTime(0),
+      mSending(false),
       mDelayBetweenClientStartsMs(config.getConfigInt("DelayBetweenClientStartsMs", 2000)),
       mAllocationTimeSecs(config.getConfigInt("AllocationTimeSecs", 60)),
       mAllocationLifetimeSecs(config.getConfigInt("AllocationLifetimeSecs", TurnSocket::UnspecifiedLifetime)),
@@ -110,6 +114,11 @@ void TurnLoadGenAsyncSocketHandler::startSendingPayload()
 {
    DebugLog(LOG_PREFIX << "Sending RTP payload...");
    mStartTime = time(0);
+   if (!mSending)
+   {
+      mSending = true;
+      ++g_Stats.mActiveAllocations;
+   }
    sendPayload();
 }
 
@@ -120,11 +129,25 @@ void TurnLoadGenAsyncSocketHandler::sendPayload()
    {
       mTimer.expires_after(milliseconds(mPayloadIntervalMs));
       mTimer.async_wait(std::bind(&TurnLoadGenAsyncSocketHandler::sendPayload, this));
-      mTurnAsyncSocket->send(g_Payload->data(), g_Payload->size());
+      // Stamp the send time into the payload so the echoed copy gives the round trip through the relay
+      char payload[1400];
+      memcpy(payload, g_Payload->data(), g_Payload->size());
+      if (g_Payload->size() >= sizeof(uint64_t))
+      {
+         uint64_t now = Timer::getTimeMicroSec();
+         memcpy(payload, &now, sizeof(now));
+      }
+      mTurnAsyncSocket->send(payload, (unsigned int)g_Payload->size());
       ++mNumSends;
+      ++g_Stats.mPacketsSent;
    }
    else
    {
+      if (mSending)
+      {
+         mSending = false;
+         --g_Stats.mActiveAllocations;
+      }
       DebugLog(LOG_PREFIX << "Configured AllocationTimeSecs has expired, configured=" << mAllocationTimeSecs << ", secondsElapsed=" << secondsElapsed << " destroying allocation.");
       mTurnAsyncSocket->destroyAllocation();
    }
@@ -268,6 +291,18 @@ void TurnLoadGenAsyncSocketHandler::onReceiveSuccess(unsigned int socketDesc, co
 {
    //InfoLog(LOG_PREFIX << "MyTurnAsyncSocketHandler::onReceiveSuccess: socketDest=" << socketDesc << ", fromAddress=" << address << ", fromPort=" << turnPort << ", size=" << data->size() << ", data=" << data->data()); 
    ++mNumReceiveSuccesses;
+   ++g_Stats.mPacketsReceived;
+   if (data->size() >= sizeof(uint64_t))
+   {
+      uint64_t sentAt;
+      memcpy(&sentAt, data->data(), sizeof(sentAt));
+      uint64_t roundTrip = Timer::getTimeMicroSec() - sentAt;
+      g_Stats.mTotalRoundTripUs += roundTrip;
+      if (roundTrip > g_Stats.mMaxRoundTripUs)
+      {
+         g_Stats.mMaxRoundTripUs = roundTrip;
+      }
+   }
 }
 
 void TurnLoadGenAsyncSocketHandler::onReceiveFailure(unsigned int socketDesc, const asio::error_code& e)
@@ -13,6 +13,18 @@ using namespace reTurn;
 using namespace std;
 using namespace resip;
 
+// Relay statistics summed over all simulated clients - they all run on the one
+// io_context thread, so no locking is needed
+struct TurnLoadGenStats
+{
+   unsigned int mActiveAllocations;
+   uint64_t mPacketsSent;
+   uint64_t mPacketsReceived;
+   uint64_t mTotalRoundTripUs;
+   uint64_t mMaxRoundTripUs;
+};
+extern TurnLoadGenStats g_Stats;
+
 class TurnLoadGenAsyncSocketHandler : public TurnAsyncSocketHandler
 {
 public:
@@ -70,6 +82,7 @@ private:
    unsigned int mNumReceiveSuccesses;
    unsigned int mNumReceiveFailures;
    time_t mStartTime;
+   bool mSending;
 
    // Config settings
    int mDelayBetweenClientStartsMs;
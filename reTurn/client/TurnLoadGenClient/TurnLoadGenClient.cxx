@@ -53,6 +53,30 @@ void sleepMS(unsigned int ms)
 
 extern resip::Data* g_Payload;
 
+// Logs relay throughput and round trip times over the last interval, then re-arms the timer
+void reportStats(asio::steady_timer& timer, unsigned int intervalSecs, const asio::error_code& e)
+{
+   static TurnLoadGenStats last = { 0, 0, 0, 0, 0 };
+   if (e)
+   {
+      return;
+   }
+   uint64_t sent = g_Stats.mPacketsSent - last.mPacketsSent;
+   uint64_t received = g_Stats.mPacketsReceived - last.mPacketsReceived;
+   uint64_t roundTripUs = g_Stats.mTotalRoundTripUs - last.mTotalRoundTripUs;
+   InfoLog(<< "Stats: activeAllocations=" << g_Stats.mActiveAllocations <<
+      ", sent=" << sent / intervalSecs << "/s" <<
+      ", relayed=" << received / intervalSecs << "/s" <<
+      ", lost=" << (sent > received ? sent - received : 0) <<
+      ", avgRoundTripUs=" << (received ? roundTripUs / received : 0) <<
+      ", maxRoundTripUs=" << g_Stats.mMaxRoundTripUs);
+   g_Stats.mMaxRoundTripUs = 0;
+   last = g_Stats;
+
+   timer.expires_after(seconds(intervalSecs));
+   timer.async_wait(std::bind(&reportStats, std::ref(timer), intervalSecs, std::placeholders::_1));
+}
+
 class TurnLoadGenConfig : public ConfigParse
 {
    void printHelpText(int argc, char** argv) override
@@ -119,6 +143,14 @@ int main(int argc, char* argv[])
 
       asio::io_context ioService;
 
+      unsigned int statsIntervalSecs = config.getConfigInt("StatsIntervalSecs", 10);
+      asio::steady_timer statsTimer(ioService);
+      if (statsIntervalSecs > 0)
+      {
+         statsTimer.expires_after(seconds(statsIntervalSecs));
+         statsTimer.async_wait(std::bind(&reportStats, std::ref(statsTimer), statsIntervalSecs, std::placeholders::_1));
+      }
+
       int numClientsToSimulate = config.getConfigInt("NumClientsToSimulate", 1);
       std::list<TurnLoadGenAsyncSocketHandler*> mClients;
       for (int clientNum = 1; clientNum <= numClientsToSimulate; clientNum++)
@@ -7,6 +7,7 @@
 #error You must define ASIO_ENABLE_CANCELIO in your build settings.
 #endif
 
+#include <map>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
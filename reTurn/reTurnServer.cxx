@@ -14,6 +14,7 @@
 #include "TcpServer.hxx"
 #include "TlsServer.hxx"
 #include "UdpServer.hxx"
+#include "MetricsServer.hxx"
 #include "ReTurnConfig.hxx"
 #include "RequestHandler.hxx"
 #include "TurnManager.hxx"
@@ -23,6 +24,8 @@
 #include "ReTurnSubsystem.hxx"
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 #define RESIPROCATE_SUBSYSTEM ReTurnSubsystem::RETURN
 
@@ -46,6 +49,98 @@ BOOL WINAPI console_ctrl_handler(DWORD ctrl_type)
 }
 #endif // defined(_WIN32)
 
+namespace
+{
+
+// The STUN/TURN listeners served by one io_context
+class ListenerSet
+{
+public:
+   ListenerSet(asio::io_context& ioService, reTurn::RequestHandler& requestHandler, const reTurn::ReTurnConfig& reTurnConfig, bool reusePort)
+   {
+      mUdpTurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort, reusePort);
+      mTcpTurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort, reusePort);
+#ifdef USE_SSL
+      if(reTurnConfig.mTlsTurnPort != 0)
+      {
+         mTlsTurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTlsTurnPort, reusePort);
+      }
+#endif
+
+#ifdef USE_IPV6
+      mUdpV6TurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort, reusePort);
+      mTcpV6TurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort, reusePort);
+#ifdef USE_SSL
+      if(reTurnConfig.mTlsTurnPort != 0)
+      {
+         mTlsV6TurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTlsTurnPort, reusePort);
+      }
+#endif
+#endif
+
+      if(reTurnConfig.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
+      {
+         mA1p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mAltStunPort, reusePort);
+         mA2p1StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mTurnPort, reusePort);
+         mA2p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mAltStunPort, reusePort);
+         mUdpTurnServer->setAlternateUdpServers(mA1p2StunUdpServer.get(), mA2p1StunUdpServer.get(), mA2p2StunUdpServer.get());
+         mA1p2StunUdpServer->setAlternateUdpServers(mUdpTurnServer.get(), mA2p2StunUdpServer.get(), mA2p1StunUdpServer.get());
+         mA2p1StunUdpServer->setAlternateUdpServers(mA2p2StunUdpServer.get(), mUdpTurnServer.get(), mA1p2StunUdpServer.get());
+         mA2p2StunUdpServer->setAlternateUdpServers(mA2p1StunUdpServer.get(), mA1p2StunUdpServer.get(), mUdpTurnServer.get());
+      }
+   }
+
+   void start()
+   {
+      if(mA1p2StunUdpServer)
+      {
+         mA1p2StunUdpServer->start();
+         mA2p1StunUdpServer->start();
+         mA2p2StunUdpServer->start();
+      }
+
+      mUdpTurnServer->start();
+      mTcpTurnServer->start();
+#ifdef USE_SSL
+      if(mTlsTurnServer)
+      {
+         mTlsTurnServer->start();
+      }
+#endif
+
+#ifdef USE_IPV6
+      mUdpV6TurnServer->start();
+      mTcpV6TurnServer->start();
+#ifdef USE_SSL
+      if(mTlsV6TurnServer)
+      {
+         mTlsV6TurnServer->start();
+      }
+#endif
+#endif
+   }
+
+private:
+   std::shared_ptr<reTurn::UdpServer> mUdpTurnServer;  // also a1p1StunUdpServer
+   std::shared_ptr<reTurn::TcpServer> mTcpTurnServer;
+#ifdef USE_SSL
+   std::shared_ptr<reTurn::TlsServer> mTlsTurnServer;
+#endif
+   std::shared_ptr<reTurn::UdpServer> mA1p2StunUdpServer;
+   std::shared_ptr<reTurn::UdpServer> mA2p1StunUdpServer;
+   std::shared_ptr<reTurn::UdpServer> mA2p2StunUdpServer;
+
+#ifdef USE_IPV6
+   std::shared_ptr<reTurn::UdpServer> mUdpV6TurnServer;
+   std::shared_ptr<reTurn::TcpServer> mTcpV6TurnServer;
+#ifdef USE_SSL
+   std::shared_ptr<reTurn::TlsServer> mTlsV6TurnServer;
+#endif
+#endif
+};
+
+}
+
 int main(int argc, char* argv[])
 {
    reTurn::ReTurnServerProcess proc;
@@ -96,82 +191,61 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       resip::Log::initialize(reTurnConfig, argv[0]);
 
       // Initialize server.
-      asio::io_context ioService;                                // The one and only ioService for the stunServer
-      reTurn::TurnManager turnManager(ioService, reTurnConfig);  // The one and only Turn Manager
-
-      std::shared_ptr<reTurn::UdpServer> udpTurnServer;  // also a1p1StunUdpServer
-      std::shared_ptr<reTurn::TcpServer> tcpTurnServer;
-#ifdef USE_SSL
-      std::shared_ptr<reTurn::TlsServer> tlsTurnServer;
-#endif
-      std::shared_ptr<reTurn::UdpServer> a1p2StunUdpServer;
-      std::shared_ptr<reTurn::UdpServer> a2p1StunUdpServer;
-      std::shared_ptr<reTurn::UdpServer> a2p2StunUdpServer;
-
-#ifdef USE_IPV6
-      std::shared_ptr<reTurn::UdpServer> udpV6TurnServer;
-      std::shared_ptr<reTurn::TcpServer> tcpV6TurnServer;
-      std::shared_ptr<reTurn::TlsServer> tlsV6TurnServer;
+      // One io_context per thread; with more than one, every thread gets its own
+      // set of listeners bound with SO_REUSEPORT and the kernel spreads the
+      // clients across them.  An allocation lives on the io_context of the socket
+      // that created it, so its TurnAllocationManager is only ever touched by one
+      // thread.  Relay ports are shared through the TurnManager.
+      unsigned int numThreads = reTurnConfig.mNumIOThreads;
+#if !defined(SO_REUSEPORT)
+      if(numThreads > 1)
+      {
+         WarningLog(<< "NumIOThreads=" << numThreads << " requires SO_REUSEPORT, which is not available - using 1 thread");
+         numThreads = 1;
+      }
 #endif
+      // Declared ahead of the io_contexts so that they outlive them: handlers
+      // still queued when an io_context is destroyed may hold the last reference
+      // to a server, whose allocations then hand their ports back to the TurnManager.
+      std::unique_ptr<reTurn::TurnManager> turnManager;
+      std::unique_ptr<reTurn::RequestHandler> requestHandler;
+
+      std::vector<std::unique_ptr<asio::io_context> > ioServices;
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         ioServices.push_back(std::make_unique<asio::io_context>(1));
+      }
+      asio::io_context& ioService = *ioServices.front();
+      turnManager = std::make_unique<reTurn::TurnManager>(ioService, reTurnConfig);  // The one and only Turn Manager
 
       // The one and only RequestHandler - if altStunPort is non-zero, then assume RFC3489 support is enabled and pass settings to request handler
-      reTurn::RequestHandler requestHandler(turnManager, 
+      requestHandler = std::make_unique<reTurn::RequestHandler>(*turnManager, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mTurnAddress : 0, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mTurnPort : 0, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunAddress : 0, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunPort : 0); 
 
-      udpTurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort);
-      tcpTurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort);
-#ifdef USE_SSL
-      if(reTurnConfig.mTlsTurnPort != 0)
+      std::vector<std::unique_ptr<ListenerSet> > listenerSets;
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         tlsTurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTlsTurnPort);
+         listenerSets.push_back(std::make_unique<ListenerSet>(*ioServices[i], *requestHandler, reTurnConfig, numThreads > 1));
       }
-#endif
-
-#ifdef USE_IPV6
-      udpV6TurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort);
-      tcpV6TurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort);
-      if(reTurnConfig.mTlsTurnPort != 0)
-      {
-         tlsV6TurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTlsTurnPort);
-      }
-#endif
-
-      if(reTurnConfig.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         a1p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mAltStunPort);
-         a2p1StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mTurnPort);
-         a2p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mAltStunPort);
-         udpTurnServer->setAlternateUdpServers(a1p2StunUdpServer.get(), a2p1StunUdpServer.get(), a2p2StunUdpServer.get());
-         a1p2StunUdpServer->setAlternateUdpServers(udpTurnServer.get(), a2p2StunUdpServer.get(), a2p1StunUdpServer.get());
-         a2p1StunUdpServer->setAlternateUdpServers(a2p2StunUdpServer.get(), udpTurnServer.get(), a1p2StunUdpServer.get());
-         a2p2StunUdpServer->setAlternateUdpServers(a2p1StunUdpServer.get(), a1p2StunUdpServer.get(), udpTurnServer.get());
-         a1p2StunUdpServer->start();
-         a2p1StunUdpServer->start();
-         a2p2StunUdpServer->start();
+         listenerSets[i]->start();
       }
-
-      udpTurnServer->start();
-      tcpTurnServer->start();
-#ifdef USE_SSL
-      if(tlsTurnServer)
+      if(numThreads > 1)
       {
-         tlsTurnServer->start();
+         InfoLog(<< "Serving STUN/TURN on " << numThreads << " threads");
       }
-#endif
 
-#ifdef USE_IPV6
-      udpV6TurnServer->start();
-      tcpV6TurnServer->start();
-#ifdef USE_SSL
-      if(tlsV6TurnServer)
+      // Bound before privileges are dropped, in case a privileged port is configured
+      std::unique_ptr<reTurn::MetricsServer> metricsServer;
+      if(reTurnConfig.mMetricsPort != 0)
       {
-         tlsV6TurnServer->start();
+         metricsServer = std::make_unique<reTurn::MetricsServer>(ioService, reTurnConfig.mMetricsAddress, reTurnConfig.mMetricsPort);
+         metricsServer->start();
       }
-#endif
-#endif
 
       // Drop privileges (can do this now that sockets are bound)
       if(!reTurnConfig.mRunAsUser.empty() && checkPosixProcessControl("RunAsUser/RunAsGroup"))
@@ -185,7 +259,7 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
 
 #ifdef _WIN32
       // Set console control handler to allow server to be stopped.
-      console_ctrl_function = [&ioService] { ioService.stop(); };
+      console_ctrl_function = [&ioServices] { for(auto& io : ioServices) io->stop(); };
       SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
 #else
       // Block all signals for background thread.
@@ -195,9 +269,14 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &new_mask, &old_mask);
 #endif
 
-      // Run the ioService until stopped.
+      // Run the ioServices until stopped.
       // Create a pool of threads to run all of the io_contexts.
-      asio::thread thread([&ioService] { ioService.run(); });
+      std::vector<std::unique_ptr<asio::thread> > threads;
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         asio::io_context& io = *ioServices[i];
+         threads.push_back(std::make_unique<asio::thread>([&io] { io.run(); }));
+      }
 
 #ifndef _WIN32
       // Restore previous signals.
@@ -212,11 +291,17 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &wait_mask, 0);
       int sig = 0;
       sigwait(&wait_mask, &sig);
-      ioService.stop();
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         ioServices[i]->stop();
+      }
 #endif
 
-      // Wait for thread to exit
-      thread.join();
+      // Wait for threads to exit
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         threads[i]->join();
+      }
    }
    catch (const std::exception& e)
    {
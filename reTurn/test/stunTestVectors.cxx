@@ -166,6 +166,30 @@ try
    reqltcMessage.calculateHmacKeyForHa1(hmacKey, password_ha1);
    assert(reqltcMessage.checkMessageIntegrity(hmacKey));  
 
+   // Data Indications framed in place around relayed data must match the regular encoder
+   const char* peers[] = { "192.0.2.1", "2001:db8::1" };
+   for (const char* peer : peers)
+   {
+      StunTuple peerTuple(StunTuple::UDP, asio::ip::make_address(peer), 32853);
+      StunMessage dataInd;
+      dataInd.createHeader(StunMessage::StunClassIndication, StunMessage::TurnDataMethod);
+      dataInd.mCntTurnXorPeerAddress = 1;
+      StunMessage::setStunAtrAddressFromTuple(dataInd.mTurnXorPeerAddress[0], peerTuple);
+
+      const char payload[] = "hello";
+      char inPlace[128];
+      unsigned int headerSize = StunMessage::dataIndicationHeaderSize(peerTuple);
+      assert(dataInd.encodeDataIndicationHeader(inPlace, 5) == inPlace + headerSize);
+      memcpy(inPlace + headerSize, payload, 5);
+      memset(inPlace + headerSize + 5, 0, 3);
+
+      char encoded[128];
+      dataInd.setTurnData(payload, 5);
+      unsigned int size = dataInd.stunEncodeMessage(encoded, sizeof(encoded));
+      assert(size == headerSize + 8);
+      assert(memcmp(inPlace, encoded, size) == 0);
+   }
+
    InfoLog(<< "All tests passed!");
    return 0;
 }
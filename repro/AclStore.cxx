@@ -52,6 +52,7 @@ AclStore::AclStore(AbstractDb& db):
    } 
    mTlsPeerNameCursor = mTlsPeerNameList.begin();
    mAddressCursor = mAddressList.begin();
+   rebuildAddressTrees();
 }
 
 AclStore::~AclStore()
@@ -114,6 +115,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mAddressList.push_back(addressRecord);
          mAddressCursor = mAddressList.begin();  // Put cursor back at start
+         rebuildAddressTrees();
       }
    }
    else
@@ -311,6 +313,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findAddressKey(key))
       {
          mAddressCursor = mAddressList.erase(mAddressCursor);
+         rebuildAddressTrees();
       }
    }
    else
@@ -512,18 +515,67 @@ AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 }
  
 
-bool 
-AclStore::isAddressTrusted(const Tuple& address)
+// The binary address of a tuple in network byte order, as the prefix trees
+// key it; returns the length in bits, 0 for an unsupported family.
+static unsigned int
+addressKey(const Tuple& address, unsigned char* key)
 {
-   ReadLock lock(mMutex);
+   if(address.ipVersion() == V4)
+   {
+      memcpy(key, &reinterpret_cast<const sockaddr_in&>(address.getSockaddr()).sin_addr, 4);
+      return 32;
+   }
+#ifdef USE_IPV6
+   if(address.getSockaddr().sa_family == AF_INET6)
+   {
+      memcpy(key, &reinterpret_cast<const sockaddr_in6&>(address.getSockaddr()).sin6_addr, 16);
+      return 128;
+   }
+#endif
+   return 0;
+}
+
+void
+AclStore::rebuildAddressTrees()
+{
+   std::shared_ptr<AddressTrees> trees = std::make_shared<AddressTrees>();
    for(AddressList::iterator i = mAddressList.begin(); i != mAddressList.end(); i++)
    {
-      if(i->mAddressTuple.isEqualWithMask(address, i->mMask, i->mAddressTuple.getPort() == 0))
+      unsigned char key[PrefixTree<AddressFilter>::MaxKeyBytes];
+      unsigned int keyLength = addressKey(i->mAddressTuple, key);
+      if(keyLength == 0)
       {
-         return true;
+         continue;
       }
+      // Masks longer than the address compare all of it, as isEqualWithMask does
+      unsigned int prefixLength = (i->mMask < 0) ? 0 : (unsigned int)i->mMask;
+      if(prefixLength > keyLength)
+      {
+         prefixLength = keyLength;
+      }
+      AddressFilter filter(i->mAddressTuple.getPort(), i->mAddressTuple.getType());
+      (keyLength == 32 ? trees->mV4 : trees->mV6).insert(key, prefixLength, filter);
    }
-   return false;
+   std::atomic_store(&mAddressTrees, std::shared_ptr<const AddressTrees>(trees));
+}
+
+bool 
+AclStore::isAddressTrusted(const Tuple& address)
+{
+   std::shared_ptr<const AddressTrees> trees = std::atomic_load(&mAddressTrees);
+   unsigned char key[PrefixTree<AddressFilter>::MaxKeyBytes];
+   unsigned int keyLength = addressKey(address, key);
+   if(keyLength == 0)
+   {
+      return false;
+   }
+   const int port = address.getPort();
+   const TransportType type = address.getType();
+   auto match = [port, type](const AddressFilter& filter)
+   {
+      return filter.mType == type && (filter.mPort == 0 || filter.mPort == port);
+   };
+   return (keyLength == 32 ? trees->mV4 : trees->mV6).find(key, keyLength, match);
 }
 
 
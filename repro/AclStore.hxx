@@ -2,7 +2,9 @@
 #define REPRO_ACLSTORE_HXX
 
 #include <list>
+#include <memory>
 #include "rutil/Data.hxx"
+#include "rutil/PrefixTree.hxx"
 #include "rutil/RWMutex.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Tuple.hxx"
@@ -83,11 +85,32 @@ class AclStore
       bool findTlsPeerNameKey(const Key& key); // move cursor to key
       bool findAddressKey(const Key& key); // move cursor to key
 
+      // The port and transport an address ACL is limited to; port 0 allows any.
+      class AddressFilter
+      {
+         public:
+            AddressFilter(int port, resip::TransportType type) : mPort(port), mType(type) {}
+            int mPort;
+            resip::TransportType mType;
+      };
+
+      // The address ACLs as one prefix tree per address family.  They are
+      // rebuilt from mAddressList whenever it changes and swapped in whole,
+      // so isAddressTrusted needs no lock and never sees a partial update.
+      class AddressTrees
+      {
+         public:
+            resip::PrefixTree<AddressFilter> mV4;
+            resip::PrefixTree<AddressFilter> mV6;
+      };
+      void rebuildAddressTrees(); // mMutex must be held
+
       resip::RWMutex mMutex;
       TlsPeerNameList mTlsPeerNameList;
       TlsPeerNameList::iterator mTlsPeerNameCursor;
       AddressList mAddressList;
       AddressList::iterator mAddressCursor;
+      std::shared_ptr<const AddressTrees> mAddressTrees;
 };
 
 }
@@ -18,6 +18,7 @@
 #include "repro/XmlRpcConnection.hxx"
 #include "repro/ReproRunner.hxx"
 #include "repro/CommandServer.hxx"
+#include "repro/UserStore.hxx"
 #include "repro/WebAdmin.hxx"
 
 using namespace repro;
@@ -116,6 +117,14 @@ CommandServer::handleRequest(unsigned int connectionId, unsigned int requestId,
       {
          handleGetCongestionStatsRequest(connectionId, requestId, xml);
       }
+      else if(isEqualNoCase(xml.getTag(), "GetAuthCacheStats"))
+      {
+         handleGetAuthCacheStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "ClearAuthCache"))
+      {
+         handleClearAuthCacheRequest(connectionId, requestId, xml);
+      }
       else if(isEqualNoCase(xml.getTag(), "SetCongestionTolerance"))
       {
          handleSetCongestionToleranceRequest(connectionId, requestId, xml);
@@ -273,6 +282,40 @@ CommandServer::handleGetCongestionStatsRequest(unsigned int connectionId, unsign
    }
 }
 
+void 
+CommandServer::handleGetAuthCacheStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetAuthCacheStatsRequest");
+
+   UserStore::AuthCacheStats stats = mReproRunner.getProxy()->getUserStore().getAuthCacheStats();
+   if(stats.maxSize == 0)
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "Auth cache is not enabled.");
+      return;
+   }
+
+   Data buffer;
+   {
+      DataStream strm(buffer);
+      strm << "size=" << stats.size << "\r\n"
+           << "maxSize=" << stats.maxSize << "\r\n"
+           << "hits=" << stats.hits << "\r\n"
+           << "negativeHits=" << stats.negativeHits << "\r\n"
+           << "misses=" << stats.misses << "\r\n"
+           << "evictions=" << stats.evictions << "\r\n";
+   }
+   sendResponse(connectionId, requestId, buffer, 200, "Auth cache stats retrieved.");
+}
+
+void 
+CommandServer::handleClearAuthCacheRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleClearAuthCacheRequest");
+
+   mReproRunner.getProxy()->getUserStore().clearAuthCache();
+   sendResponse(connectionId, requestId, Data::Empty, 200, "Auth cache cleared.");
+}
+
 void 
 CommandServer::handleSetCongestionToleranceRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
 {
@@ -59,6 +59,8 @@ private:
    void handleClearDnsCacheRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleGetDnsCacheRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleGetCongestionStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleGetAuthCacheStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleClearAuthCacheRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleSetCongestionToleranceRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleShutdownRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleGetProxyConfigRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
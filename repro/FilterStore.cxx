@@ -2,6 +2,7 @@
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
 
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/ExtensionHeader.hxx"
@@ -9,6 +10,10 @@
 #include "repro/FilterStore.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
+#ifdef USE_RE2
+#include <re2/re2.h>
+#endif
+
 
 using namespace resip;
 using namespace repro;
@@ -23,13 +28,177 @@ using namespace std;
 // use the EMCAScript syntax.
 const std::regex_constants::syntax_option_type DefaultFlags = std::regex_constants::ECMAScript;
 
+// Replacements $x1-$x9 are allowed in the action data, where x is the condition number
+static const int MaxSubExpressions = 9;
+
+// Advances p by n characters, but not past end
+static void
+skip(const char*& p, const char* end, ptrdiff_t n)
+{
+   p += n < end - p ? n : end - p;
+}
+
+// Skips a character class, p pointing just past its opening '['
+static void
+skipClass(const char*& p, const char* end)
+{
+   if (p < end && *p == '^')
+   {
+      ++p;
+   }
+   if (p < end && *p == ']')
+   {
+      ++p;
+   }
+   while (p < end && *p != ']')
+   {
+      skip(p, end, *p == '\\' ? 2 : 1);
+   }
+   skip(p, end, 1);
+}
+
+// Errs on the side of returning less: an alternative at the top level or an
+// inline flag such as (?i) gives up, and groups, classes, escapes other than
+// of punctuation, anchors and quantified characters all end a run.
+Data
+FilterStore::requiredLiteral(const Data& regex)
+{
+   Data best;
+   Data run;
+   const char* p = regex.data();
+   const char* end = p + regex.size();
+   while (p < end)
+   {
+      bool endRun = true;
+      char c = *p++;
+      switch (c)
+      {
+         case '|':
+            return Data::Empty;
+         case '(':
+         {
+            if (end - p >= 2 && p[0] == '?' && !strchr(":=!<", p[1]))
+            {
+               return Data::Empty;
+            }
+            int depth = 1;
+            while (p < end && depth > 0)
+            {
+               if (*p == '\\')
+               {
+                  skip(p, end, 2);
+                  continue;
+               }
+               if (*p == '[')
+               {
+                  skipClass(++p, end);
+                  continue;
+               }
+               if (*p == '(')
+               {
+                  ++depth;
+               }
+               else if (*p == ')')
+               {
+                  --depth;
+               }
+               ++p;
+            }
+            break;
+         }
+         case '[':
+            skipClass(p, end);
+            break;
+         case '\\':
+            if (p >= end)
+            {
+               break;
+            }
+            c = *p++;
+            if (!isalnum((unsigned char)c))
+            {
+               run += c;
+               endRun = false;
+            }
+            // Character classes, assertions, control and numeric escapes;
+            // skip the characters the escape takes, so they are not
+            // mistaken for literals.
+            else if (p < end && *p == '{')
+            {
+               while (p < end && *p++ != '}')
+               {
+               }
+            }
+            else if (c == 'c' || c == 'p' || c == 'P')
+            {
+               skip(p, end, 1);
+            }
+            else if (c == 'x')
+            {
+               skip(p, end, 2);
+            }
+            else if (c == 'u')
+            {
+               skip(p, end, 4);
+            }
+            else
+            {
+               while (p < end && isdigit((unsigned char)*p))
+               {
+                  ++p;
+               }
+            }
+            break;
+         case '*':
+         case '?':
+         case '+':
+         case '{':
+            // the quantified character may match zero times
+            if (!run.empty())
+            {
+               run.truncate2(run.size() - 1);
+            }
+            if (c == '{')
+            {
+               while (p < end && *p++ != '}')
+               {
+               }
+            }
+            break;
+         case '.':
+         case '^':
+         case '$':
+            break;
+         default:
+            run += c;
+            endRun = false;
+            break;
+      }
+      if (endRun)
+      {
+         if (run.size() > best.size())
+         {
+            best = run;
+         }
+         run.clear();
+      }
+   }
+   if (run.size() > best.size())
+   {
+      best = run;
+   }
+   return best;
+}
+
 bool FilterStore::FilterOp::operator<(const FilterOp& rhs) const
 {
    return filterRecord.mOrder < rhs.filterRecord.mOrder;
 }
 
 FilterStore::FilterStore(AbstractDb& db):
-   mDb(db)
+   mDb(db),
+   mRequests(0),
+   mEvaluationTimeUs(0)
 {  
    Key key = mDb.firstFilterKey();
    while ( !key.empty() )
@@ -37,66 +206,129 @@ FilterStore::FilterStore(AbstractDb& db):
       FilterOp filter;
       filter.filterRecord =  mDb.getFilter(key);
       filter.key = key;
-      filter.pcond1 = 0;
-      filter.pcond2 = 0;
-      
-      std::regex_constants::syntax_option_type flags = DefaultFlags;
-      if(filter.filterRecord.mActionData.find("$") == Data::npos)
-      {
-         flags |= std::regex_constants::nosubs;
-      }
+      compileFilter(filter);
+      filter.cond1.header = filter.cond1.header < 0 ? -1 : headerIndex(filter.filterRecord.mCondition1Header);
+      filter.cond2.header = filter.cond2.header < 0 ? -1 : headerIndex(filter.filterRecord.mCondition2Header);
+
+      mFilterOperators.insert(filter);
+
+      key = mDb.nextFilterKey();
+   } 
+   mCursor = mFilterOperators.begin();
+}
+
+FilterStore::~FilterStore()
+{
+   for(FilterOpList::iterator i = mFilterOperators.begin(); i != mFilterOperators.end(); i++)
+   {
+      freeCondition(i->cond1);
+      freeCondition(i->cond2);
+   }
+   mFilterOperators.clear();
+}
 
-      if(!filter.filterRecord.mCondition1Regex.empty())
+void
+FilterStore::compileFilter(FilterOp& filter)
+{
+   const AbstractDb::FilterRecord& rec = filter.filterRecord;
+   bool subExpressions = rec.mActionData.find("$") != Data::npos;
+   compileCondition(1, rec.mCondition1Header, rec.mCondition1Regex, subExpressions, filter.cond1);
+   compileCondition(2, rec.mCondition2Header, rec.mCondition2Regex, subExpressions, filter.cond2);
+   filter.evaluations = std::make_shared<std::atomic<uint64_t> >(0);
+   filter.hits = std::make_shared<std::atomic<uint64_t> >(0);
+}
+
+// Leaves condition.header at -1 if the condition is not to be checked,
+// otherwise sets it to 0; the caller maps it to the header's index.
+void
+FilterStore::compileCondition(int conditionNum,
+                              const Data& headerName,
+                              const Data& regex,
+                              bool subExpressions,
+                              Condition& condition)
+{
+   if(headerName.empty() || regex.empty())
+   {
+      return;
+   }
+
+#ifdef USE_RE2
+   // Header values are matched byte by byte, as std::regex does
+   RE2::Options options;
+   options.set_encoding(RE2::Options::EncodingLatin1);
+   options.set_never_capture(!subExpressions);
+   options.set_log_errors(false);
+   condition.re2 = new RE2(re2::StringPiece(regex.data(), regex.size()), options);
+   if(!condition.re2->ok())
+   {
+      // eg back references or lookahead, which RE2 does not support
+      DebugLog( << "Condition" << conditionNum << "Regex not supported by RE2, using std::regex: "
+                << regex << ": " << condition.re2->error());
+      delete condition.re2;
+      condition.re2 = 0;
+   }
+#endif
+
+   if(!condition.re2)
+   {
+      if(!subExpressions)
       {
          try
          {
-            filter.pcond1 = new std::regex(filter.filterRecord.mCondition1Regex.c_str(), flags);
+            condition.regex = new std::regex(regex.c_str(), DefaultFlags | std::regex_constants::nosubs);
          }
          catch (std::regex_error&)
          {
-            delete filter.pcond1;
-            ErrLog( << "Condition1Regex has invalid match expression: "
-                   << filter.filterRecord.mCondition1Regex);
-            filter.pcond1 = 0;
+            // eg back references, which need the groups they refer to captured
          }
       }
-
-      if(!filter.filterRecord.mCondition2Regex.empty())
+      if(!condition.regex)
       {
          try
          {
-            filter.pcond2 = new std::regex(filter.filterRecord.mCondition2Regex.c_str(), flags);
+            condition.regex = new std::regex(regex.c_str(), DefaultFlags);
          }
          catch (std::regex_error&)
          {
-            delete filter.pcond2;
-            ErrLog( << "Condition2Regex has invalid match expression: "
-                   << filter.filterRecord.mCondition2Regex);
-            filter.pcond2 = 0;
+            ErrLog( << "Condition" << conditionNum << "Regex has invalid match expression: " << regex);
+            return;
          }
       }
+   }
 
-      mFilterOperators.insert(filter);
+   condition.literal = requiredLiteral(regex);
+   condition.header = 0;
+}
 
-      key = mDb.nextFilterKey();
-   } 
-   mCursor = mFilterOperators.begin();
+void
+FilterStore::freeCondition(const Condition& condition)
+{
+   delete condition.regex;
+#ifdef USE_RE2
+   delete condition.re2;
+#endif
 }
 
-FilterStore::~FilterStore()
+int
+FilterStore::headerIndex(const Data& headerName)
 {
-   for(FilterOpList::iterator i = mFilterOperators.begin(); i != mFilterOperators.end(); i++)
+   for(size_t i = 0; i < mHeaders.size(); i++)
    {
-      if (i->pcond1)
+      if(isEqualNoCase(mHeaders[i].name, headerName))
       {
-         delete i->pcond1;
-      }
-      if (i->pcond2)
-      {
-         delete i->pcond2;
+         return (int)i;
       }
    }
-   mFilterOperators.clear();
+
+   HeaderSelector header;
+   header.name = headerName;
+   header.requestLine = isEqualNoCase(headerName, "request-line");
+   if(!header.requestLine)
+   {
+      header.type = Headers::getType(headerName.c_str(), (int)headerName.size());
+   }
+   mHeaders.push_back(header);
+   return (int)mHeaders.size() - 1;
 }
 
 bool 
@@ -134,40 +366,12 @@ FilterStore::addFilter(const resip::Data& cond1Header,
    }
 
    filter.key = key;
-   filter.pcond1 = 0;
-   filter.pcond2 = 0;
-   std::regex_constants::syntax_option_type flags = DefaultFlags;
-   if(filter.filterRecord.mActionData.find("$") == Data::npos)
-   {
-      flags |= std::regex_constants::nosubs;
-   }
-   if(!filter.filterRecord.mCondition1Regex.empty())
-   {
-      try
-      {
-         filter.pcond1 = new std::regex(filter.filterRecord.mCondition1Regex.c_str(), flags);
-      }
-      catch (std::regex_error&)
-      {
-         delete filter.pcond1;
-         filter.pcond1 = 0;
-      }
-   }
-   if(!filter.filterRecord.mCondition2Regex.empty())
-   {
-      try
-      {
-         filter.pcond2 = new std::regex(filter.filterRecord.mCondition2Regex.c_str(), flags);
-      }
-      catch (std::regex_error&)
-      {
-         delete filter.pcond2;
-         filter.pcond2 = 0;
-      }
-   }
+   compileFilter(filter);
 
    {
       WriteLock lock(mMutex);
+      filter.cond1.header = filter.cond1.header < 0 ? -1 : headerIndex(cond1Header);
+      filter.cond2.header = filter.cond2.header < 0 ? -1 : headerIndex(cond2Header);
       mFilterOperators.insert( filter );
    }
    mCursor = mFilterOperators.begin(); 
@@ -218,14 +422,8 @@ FilterStore::eraseFilter(const resip::Data& key)
          {
             FilterOpList::iterator i = it;
             it++;
-            if(i->pcond1)
-            {
-               delete i->pcond1;
-            }
-            if(i->pcond2)
-            {
-               delete i->pcond2;
-            }
+            freeCondition(i->cond1);
+            freeCondition(i->cond2);
             mFilterOperators.erase(i);
          }
          else
@@ -325,63 +523,100 @@ FilterStore::getFilterRecord(const resip::Data& key)
 }
 
 void
-FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerName, list<Data>& headerList)
+FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const HeaderSelector& header, vector<Data>& values) const
 {
-   // First see if header string is "request-line"
-   if(isEqualNoCase(headerName, "request-line"))
+   if(header.requestLine)
    {
-      headerList.push_back(Data::from(msg.header(h_RequestLine)));
+      values.push_back(Data::from(msg.header(h_RequestLine)));
       return;
    }
   
-   // Next check to see if it is a standard header
-   Headers::Type headerType = Headers::getType(headerName.c_str(), headerName.size());
-   if(headerType != Headers::UNKNOWN)
+   if(header.type != Headers::UNKNOWN)
    {
       Data headerData;
-      const HeaderFieldValueList* hfv = msg.getRawHeader(headerType);
+      const HeaderFieldValueList* hfv = msg.getRawHeader(header.type);
+      if(!hfv)
+      {
+         return;
+      }
       for(HeaderFieldValueList::const_iterator it = hfv->begin(); it != hfv->end(); it++)
       {
          it->toShareData(headerData);
-         headerList.push_back(headerData);
+         values.push_back(headerData);
       }
    }
    else // Check if custom header
    {
-      ExtensionHeader exHeader(headerName);
+      ExtensionHeader exHeader(header.name);
       if(msg.exists(exHeader))
       {
          const StringCategories& exHeaders = msg.header(exHeader);
          for(StringCategories::const_iterator it = exHeaders.begin(); it != exHeaders.end(); it++)
          {
-            headerList.push_back(it->value());
+            values.push_back(it->value());
          }
       }
    }
 }
 
 bool 
-FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, std::regex *_regex, Data& rewrite)
+FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, const Condition& condition, Data& rewrite) const
 {
    resip_assert(conditionNum < 10);
-   
-   std::cmatch matches; // replacements $x1-$x9 are allowed, where x is the condition number
 
-   // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
-   //        the string, this is backwards compatible with the previous regexec PCRE implementation
-   if(!std::regex_search(header.c_str(), matches, *_regex))
+   if(!condition.literal.empty() && header.find(condition.literal) == Data::npos)
    {
-      // did not match 
       return false;
    }
 
+   bool subExpressions = rewrite.find("$") != Data::npos;
+   Data subExps[MaxSubExpressions + 1];
+   int numSubExps = 0;
+
+#ifdef USE_RE2
+   if(condition.re2)
+   {
+      re2::StringPiece text(header.c_str());
+      re2::StringPiece matches[MaxSubExpressions + 1];
+      if(subExpressions)
+      {
+         numSubExps = resipMin(condition.re2->NumberOfCapturingGroups(), MaxSubExpressions);
+      }
+      if(!condition.re2->Match(text, 0, text.size(), RE2::UNANCHORED, matches, subExpressions ? numSubExps + 1 : 0))
+      {
+         return false;
+      }
+      for (int i=1; i<=numSubExps; i++)
+      {
+         subExps[i] = Data(matches[i].data(), matches[i].size());
+      }
+   }
+   else
+#endif
+   {
+      std::cmatch matches;
+
+      // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
+      //        the string, this is backwards compatible with the previous regexec PCRE implementation
+      if(!std::regex_search(header.c_str(), matches, *condition.regex))
+      {
+         // did not match 
+         return false;
+      }
+      numSubExps = resipMin((int)matches.size() - 1, MaxSubExpressions);
+      for (int i=1; i<=numSubExps; i++)
+      {
+         subExps[i] = Data(matches[i]);
+      }
+   }
+
    DebugLog( << "  Filter matched: header=" << header << ", regex=" << match);
 
-   if (rewrite.find("$") != Data::npos)
+   if (subExpressions)
    {
-      for (int i=1; i<(int)matches.size(); i++)
+      for (int i=1; i<=numSubExps; i++)
       {
-         Data subExp(matches[i]);
+         const Data& subExp = subExps[i];
          DebugLog( << "  subExpression[" <<i <<"]="<< subExp );
 
          Data result;
@@ -420,80 +655,94 @@ FilterStore::process(const SipMessage& request,
 {
    if(mFilterOperators.empty()) return false;  // If there are no filters bail early to save a few cycles (size check is atomic enough, we don't need a lock)
 
-   ReadLock lock(mMutex);
-
-   Data method(request.methodStr());
-   Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
-
-   for (FilterOpList::iterator it = mFilterOperators.begin();
-        it != mFilterOperators.end(); it++)
+   uint64_t startTime = Timer::getTimeMicroSec();
+   bool result = false;
    {
-      const AbstractDb::FilterRecord& rec = it->filterRecord;
+      ReadLock lock(mMutex);
+
+      Data method(request.methodStr());
+      Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
+
+      // Values of each header in mHeaders, extracted the first time a
+      // filter needs them.  Per thread rather than members, as several
+      // threads process requests under the read lock at once; kept from
+      // request to request so that their storage is reused.
+      static thread_local vector<vector<Data> > headerValues;
+      static thread_local vector<bool> extracted;
+      if(headerValues.size() < mHeaders.size())
+      {
+         headerValues.resize(mHeaders.size());
+      }
+      extracted.assign(mHeaders.size(), false);
 
-      if(!rec.mMethod.empty())
+      auto conditionMatches = [&](int conditionNum, const Condition& condition, const Data& regex)
       {
-         if(!isEqualNoCase(rec.mMethod, method))
+         if(!extracted[condition.header])
          {
-            DebugLog( << "  Skipped - method did not match" );
-            continue;
+            headerValues[condition.header].clear();
+            getHeaderFromSipMessage(request, mHeaders[condition.header], headerValues[condition.header]);
+            extracted[condition.header] = true;
          }
-      }
-      if(!rec.mEvent.empty())
-      {
-         if(!isEqualNoCase(rec.mEvent,event)) 
+         const vector<Data>& values = headerValues[condition.header];
+         for(vector<Data>::const_iterator hit = values.begin(); hit != values.end(); hit++)
          {
-            DebugLog( << "  Skipped - event did not match" );
-            continue;
+            bool match = applyRegex(conditionNum, *hit, regex, condition, actionData);
+            DebugLog( << "  Cond" << conditionNum << " HeaderName=" << mHeaders[condition.header].name << ", Value=" << *hit << ", Regex=" << regex << ", match=" << match);
+            if(match)
+            {
+               return true;
+            }
          }
-      }
+         return false;
+      };
 
-      // Get requests SIP headers from SipMessage
-      list<Data> condition1Headers;
-      list<Data> condition2Headers;
-      actionData = rec.mActionData;
-      if(!rec.mCondition1Header.empty() && it->pcond1)
+      for (FilterOpList::iterator it = mFilterOperators.begin();
+           it != mFilterOperators.end(); it++)
       {
-         getHeaderFromSipMessage(request, rec.mCondition1Header, condition1Headers);
+         const AbstractDb::FilterRecord& rec = it->filterRecord;
 
-         // Check condition 1 regex
-         list<Data>::iterator hit = condition1Headers.begin();
-         bool match = false;
-         for(; hit != condition1Headers.end() && match == false; hit++)
+         if(!rec.mMethod.empty())
          {
-            match = applyRegex(1, *hit, rec.mCondition1Regex, it->pcond1, actionData);
-            DebugLog( << "  Cond1 HeaderName=" << rec.mCondition1Header << ", Value=" << *hit << ", Regex=" << rec.mCondition1Regex << ", match=" << match);
+            if(!isEqualNoCase(rec.mMethod, method))
+            {
+               DebugLog( << "  Skipped - method did not match" );
+               continue;
+            }
          }
-         if(!match)
+         if(!rec.mEvent.empty())
          {
-            DebugLog( << "  Skipped - request did not match first condition: " << request.brief());
-            continue;
+            if(!isEqualNoCase(rec.mEvent,event)) 
+            {
+               DebugLog( << "  Skipped - event did not match" );
+               continue;
+            }
          }
-      }
-      if(!rec.mCondition2Header.empty() && it->pcond2)
-      {
-         getHeaderFromSipMessage(request, rec.mCondition2Header, condition2Headers);
 
-         // Check condition 2 regex
-         list<Data>::iterator hit = condition2Headers.begin();
-         bool match = false;
-         for(; hit != condition2Headers.end() && match == false; hit++)
+         ++*it->evaluations;
+         actionData = rec.mActionData;
+         if(it->cond1.header >= 0 && !conditionMatches(1, it->cond1, rec.mCondition1Regex))
          {
-            match = applyRegex(2, *hit, rec.mCondition2Regex, it->pcond2, actionData);
-            DebugLog( << "  Cond2 HeaderName=" << rec.mCondition2Header << ", Value=" << *hit << ", Regex=" << rec.mCondition2Regex << ", match=" << match);
+            DebugLog( << "  Skipped - request did not match first condition: " << request.brief());
+            continue;
          }
-         if(!match)
+         if(it->cond2.header >= 0 && !conditionMatches(2, it->cond2, rec.mCondition2Regex))
          {
             DebugLog( << "  Skipped - request did not match second condition: " << request.brief());
             continue;
          }
+         // If we make it here Method, Event and both conditions matched - return configured action
+         ++*it->hits;
+         action = rec.mAction;
+         result = true;
+         break;
       }
-      // If we make it here Method, Event and both conditions matched - return configured action
-      action = rec.mAction;
-      return true;
    }
 
-   // If we make it here, then none of the conditions matched - return false
-   return false;
+   ++mRequests;
+   mEvaluationTimeUs += Timer::getTimeMicroSec() - startTime;
+
+   // If none of the conditions matched result is false
+   return result;
 }
 
 bool 
@@ -511,18 +760,18 @@ FilterStore::test(const resip::Data& cond1Header,
       actionData = rec.mActionData;
 
       // Check condition 1 regex
-      if(!rec.mCondition1Header.empty() && it->pcond1)
+      if(it->cond1.header >= 0)
       {
-         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, it->pcond1, actionData))
+         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, it->cond1, actionData))
          {
             continue;
          }
       }
 
       // Check condition 2 regex
-      if(!rec.mCondition2Header.empty() && it->pcond2)
+      if(it->cond2.header >= 0)
       {
-         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, it->pcond2, actionData))
+         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, it->cond2, actionData))
          {
             continue;
          }
@@ -537,6 +786,42 @@ FilterStore::test(const resip::Data& cond1Header,
    return false;
 }
 
+FilterStore::Stats
+FilterStore::getStats()
+{
+   ReadLock lock(mMutex);
+
+   Stats stats;
+   stats.requests = mRequests;
+   stats.evaluationTimeUs = mEvaluationTimeUs;
+   stats.filters.reserve(mFilterOperators.size());
+   for (FilterOpList::iterator it = mFilterOperators.begin();
+        it != mFilterOperators.end(); it++)
+   {
+      FilterStats filterStats;
+      filterStats.key = it->key;
+      filterStats.evaluations = *it->evaluations;
+      filterStats.hits = *it->hits;
+      stats.filters.push_back(filterStats);
+   }
+   return stats;
+}
+
+void
+FilterStore::resetStats()
+{
+   ReadLock lock(mMutex);
+
+   mRequests = 0;
+   mEvaluationTimeUs = 0;
+   for (FilterOpList::iterator it = mFilterOperators.begin();
+        it != mFilterOperators.end(); it++)
+   {
+      *it->evaluations = 0;
+      *it->hits = 0;
+   }
+}
+
 FilterStore::Key 
 FilterStore::buildKey(const resip::Data& cond1Header,
                       const resip::Data& cond1Regex,
@@ -1,14 +1,18 @@
 #if !defined(REPRO_FILTERSTORE_HXX)
 #define REPRO_FILTERSTORE_HXX
 
+#include <atomic>
+#include <memory>
 #include <regex>
 
 #include <set>
 #include <list>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
 
+#include "resip/stack/HeaderTypes.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -16,6 +20,11 @@ namespace resip
    class SipMessage;
 }
 
+namespace re2
+{
+   class RE2;
+}
+
 namespace repro
 {
 
@@ -77,6 +86,33 @@ class FilterStore
                 short& action,
                 resip::Data& actionData);
 
+      class FilterStats
+      {
+         public:
+            FilterStats() : evaluations(0), hits(0) {}
+            Key key;
+            uint64_t evaluations;  // requests whose method and event matched, so the conditions were checked
+            uint64_t hits;         // requests the filter's action was returned for
+      };
+
+      class Stats
+      {
+         public:
+            Stats() : requests(0), evaluationTimeUs(0) {}
+            uint64_t requests;          // requests passed to process() while any filter was configured
+            uint64_t evaluationTimeUs;  // total time process() spent on them
+            std::vector<FilterStats> filters;  // in evaluation order
+      };
+
+      // Counters since startup or the last resetStats()
+      Stats getStats();
+      void resetStats();
+
+      // Returns the longest run of literal characters every match of the
+      // expression "regex" must contain, or empty if it cannot tell.
+      // Values without it are skipped before running the expression.
+      static resip::Data requiredLiteral(const resip::Data& regex);
+
    private:
       bool findKey(const Key& key); // move cursor to key
       
@@ -87,31 +123,75 @@ class FilterStore
                    const resip::Data& method,
                    const resip::Data& event) const;
 
-      void getHeaderFromSipMessage(const resip::SipMessage& msg, 
-                                   const resip::Data& headerName, 
-                                   std::list<resip::Data>& headerList);
-      bool applyRegex(int conditionNum,
-                      const resip::Data& header, 
-                      const resip::Data& match, 
-                      std::regex *_regex,
-                      resip::Data& rewrite);
+      // Where a condition finds its values: the request line, a known
+      // header, or an extension header.  Resolved once, when the filter is
+      // added, rather than per request.
+      class HeaderSelector
+      {
+         public:
+            HeaderSelector() : requestLine(false), type(resip::Headers::UNKNOWN) {}
+            resip::Data name;
+            bool requestLine;
+            resip::Headers::Type type;
+      };
 
-      AbstractDb& mDb;  
+      // A compiled condition.  Any value it matches must contain "literal",
+      // so values without it are skipped before running the expression.
+      class Condition
+      {
+         public:
+            Condition() : header(-1), regex(0), re2(0) {}
+            int header;          // index into mHeaders, -1 if the condition is not checked
+            resip::Data literal;
+            std::regex* regex;
+            re2::RE2* re2;       // used instead of regex when set
+      };
 
       class FilterOp
       {
          public:
             Key key;
-            std::regex *pcond1;
-            std::regex *pcond2;
+            Condition cond1;
+            Condition cond2;
             AbstractDb::FilterRecord filterRecord;
+            // shared, as the multiset only holds const copies
+            std::shared_ptr<std::atomic<uint64_t> > evaluations;
+            std::shared_ptr<std::atomic<uint64_t> > hits;
             bool operator<(const FilterOp&) const;
       };
-      
+
+      void compileFilter(FilterOp& filter);
+      void compileCondition(int conditionNum,
+                            const resip::Data& headerName,
+                            const resip::Data& regex,
+                            bool subExpressions,
+                            Condition& condition);
+      static void freeCondition(const Condition& condition);
+      int headerIndex(const resip::Data& headerName);
+
+      void getHeaderFromSipMessage(const resip::SipMessage& msg, 
+                                   const HeaderSelector& header, 
+                                   std::vector<resip::Data>& values) const;
+      bool applyRegex(int conditionNum,
+                      const resip::Data& header, 
+                      const resip::Data& match, 
+                      const Condition& condition,
+                      resip::Data& rewrite) const;
+
+      AbstractDb& mDb;  
+
       resip::RWMutex mMutex;
       typedef std::multiset<FilterOp> FilterOpList;
       FilterOpList mFilterOperators; 
       FilterOpList::iterator mCursor;
+
+      // Every header any filter inspects, so process() extracts each of
+      // them from a request at most once however many filters use it.
+      // Only ever grows; entries left over by erased filters cost nothing.
+      std::vector<HeaderSelector> mHeaders;
+
+      std::atomic<uint64_t> mRequests;
+      std::atomic<uint64_t> mEvaluationTimeUs;
 };
 
  }
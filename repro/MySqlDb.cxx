@@ -81,9 +81,9 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConns(connectionPoolSize(), (MYSQL*)0)
 { 
-   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port << ", connections=" << connectionPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
@@ -97,14 +97,29 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    }
    else
    {
-      connectToDatabase();
+      for(unsigned int i = 0; i < mConns.size(); i++)
+      {
+         connectToDatabase(i);
+      }
    }
 }
 
 
 MySqlDb::~MySqlDb()
 {
-   disconnectFromDatabase();
+   // Stored results are held client side and do not need the connection
+   for (int i=0;i<MaxTable;i++)
+   {
+      if (mResult[i])
+      {  
+         mysql_free_result(mResult[i]); 
+         mResult[i]=0;
+      }
+   }
+   for(unsigned int i = 0; i < mConns.size(); i++)
+   {
+      disconnectFromDatabase(i);
+   }
 }
 
 void
@@ -118,43 +133,33 @@ MySqlDb::initialize() const
 }
 
 void
-MySqlDb::disconnectFromDatabase() const
+MySqlDb::disconnectFromDatabase(unsigned int index) const
 {
-   if(mConn)
+   if(mConns[index])
    {
-      for (int i=0;i<MaxTable;i++)
-      {
-         if (mResult[i])
-         {  
-            mysql_free_result(mResult[i]); 
-            mResult[i]=0;
-         }
-      }
-   
-      mysql_close(mConn);
-      mConn = 0;
-      setConnected(false);
+      mysql_close(mConns[index]);
+      mConns[index] = 0;
    }
 }
 
 int 
-MySqlDb::connectToDatabase() const
+MySqlDb::connectToDatabase(unsigned int index) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(index);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(mConns[index] == 0);
 
-   mConn = mysql_init(0);
-   if(mConn == 0)
+   MYSQL* conn = mysql_init(0);
+   if(conn == 0)
    {
       ErrLog( << "MySQL init failed: insufficient memory.");
+      setConnected(false);
       return CR_OUT_OF_MEMORY;
    }
 
-   MYSQL* ret = mysql_real_connect(mConn,
+   MYSQL* ret = mysql_real_connect(conn,
                                    mDBServer.c_str(),   // hostname
                                    mDBUser.c_str(),     // user
                                    mDBPassword.c_str(), // password
@@ -165,15 +170,15 @@ MySqlDb::connectToDatabase() const
 
    if (ret == 0)
    { 
-      int rc = mysql_errno(mConn);
-      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(mConn));
-      mysql_close(mConn); 
-      mConn = 0;
+      int rc = mysql_errno(conn);
+      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(conn));
+      mysql_close(conn); 
       setConnected(false);
       return rc;
    }
    else
    {
+      mConns[index] = conn;
       setConnected(true);
       return 0;
    }
@@ -188,37 +193,43 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
 
    DebugLog( << "MySqlDb::query: executing query: " << queryCommand);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   ConnectionLease lease(*this);
+   const unsigned int index = lease.index();
+   if(mConns[index] != 0 && needsHealthCheck(index) && mysql_ping(mConns[index]) != 0)
    {
-      rc = connectToDatabase();
+      // The server dropped this connection while it sat idle in the pool
+      InfoLog( << "MySQL connection " << index << " failed health check: " << mysql_error(mConns[index]) << ", reconnecting");
+      disconnectFromDatabase(index);
+   }
+   if(mConns[index] == 0)
+   {
+      rc = connectToDatabase(index);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      rc = mysql_query(mConn,queryCommand.c_str());
+      resip_assert(mConns[index]!=0);
+      rc = mysql_query(mConns[index],queryCommand.c_str());
       if(rc != 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(mConns[index]);
          if(rc == CR_SERVER_GONE_ERROR ||
             rc == CR_SERVER_LOST)
          {
             // First failure is a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            rc = connectToDatabase(index);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               rc = mysql_query(mConn,queryCommand.c_str());
+               rc = mysql_query(mConns[index],queryCommand.c_str());
                if( rc != 0)
                {
-                  ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+                  ErrLog( << "MySQL query failed: error=" << mysql_errno(mConns[index]) << ": " << mysql_error(mConns[index]));
                }
             }
          }
          else
          {
-            ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL query failed: error=" << mysql_errno(mConns[index]) << ": " << mysql_error(mConns[index]));
          }
       }
    }
@@ -226,13 +237,13 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
    // Now store result - if pointer to result pointer was supplied and no errors
    if(rc == 0 && result)
    {
-      *result = mysql_store_result(mConn);
+      *result = mysql_store_result(mConns[index]);
       if(*result == 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(mConns[index]);
          if(rc != 0)
          {
-            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConns[index]));
          }
       }
    }
@@ -274,15 +285,9 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
       }
       else
       {
-         rc = mysql_errno(mConn);
-         if(rc != 0)
-         {
-            ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error(mConn));
-         }
-         else
-         {
-            DebugLog(<<"singleResultQuery: no rows returned by query");
-         }
+         // the result was stored client side, so running out of rows is
+         // the only way mysql_fetch_row can fail here
+         DebugLog(<<"singleResultQuery: no rows returned by query");
       }
       mysql_free_result(result);
    }
@@ -292,7 +297,18 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
 resip::Data& 
 MySqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
-   escapedStr.truncate2(mysql_real_escape_string(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+   // Escaping depends on the connection character set, so it needs a live
+   // connection too
+   initialize();
+   ConnectionLease lease(*this);
+   const unsigned int index = lease.index();
+   if(mConns[index] == 0 && connectToDatabase(index) != 0)
+   {
+      // No connection - fall back to the client default character set
+      escapedStr.truncate2(mysql_escape_string((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
+   escapedStr.truncate2(mysql_real_escape_string(mConns[index], (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
    return escapedStr;
 }
 
@@ -347,7 +363,7 @@ MySqlDb::getUser( const AbstractDb::Key& key ) const
    
    if (result==0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return ret;
    }
 
@@ -429,7 +445,7 @@ MySqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return Data::Empty;
    }
    
@@ -498,7 +514,7 @@ MySqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
 
    if (result==0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return ret;
    }
 
@@ -539,7 +555,7 @@ MySqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return Data::Empty;
    }
 
@@ -625,7 +641,7 @@ MySqlDb::dbReadRecord(const Table table,
 
    if (result == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return false;
    }
    else
@@ -668,7 +684,7 @@ MySqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: query returned no result set");
          return Data::Empty;
       }
    }
@@ -732,7 +748,7 @@ MySqlDb::dbNextRecord(const Table table,
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: query returned no result set");
          return false;
       }
    }
@@ -758,12 +774,19 @@ MySqlDb::dbNextRecord(const Table table,
 bool 
 MySqlDb::dbBeginTransaction(const Table table)
 {
+   // The session settings and the transaction belong to one connection, so
+   // keep this thread on the same pool slot until commit or rollback
+   pinConnection();
    Data command("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
    if(query(command, 0) == 0)
    {
       command = "START TRANSACTION";
-      return query(command, 0) == 0;
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   unpinConnection();
    return false;
 }
 
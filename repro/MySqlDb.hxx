@@ -63,8 +63,8 @@ class MySqlDb: public SqlDb
       virtual bool dbBeginTransaction(const Table table);
 
       void initialize() const;
-      void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(unsigned int index) const;
+      int connectToDatabase(unsigned int index) const;
       int query(const resip::Data& queryCommand, MYSQL_RES** result) const;
       virtual int query(const resip::Data& queryCommand) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
@@ -76,7 +76,8 @@ class MySqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable MYSQL* mConn;
+      // one handle per connection pool slot, 0 if not connected
+      mutable std::vector<MYSQL*> mConns;
       mutable MYSQL_RES* mResult[MaxTable];
 
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
@@ -77,9 +77,9 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConns(connectionPoolSize(), (PGconn*)0)
 { 
-   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port << ", connections=" << connectionPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
@@ -93,14 +93,30 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
    }
    else
    {
-      connectToDatabase();
+      for(unsigned int i = 0; i < mConns.size(); i++)
+      {
+         connectToDatabase(i);
+      }
    }
 }
 
 
 PostgreSqlDb::~PostgreSqlDb()
 {
-   disconnectFromDatabase();
+   // Results do not refer back to the connection they came from
+   for (int i=0;i<MaxTable;i++)
+   {
+      if (mResult[i])
+      {  
+         PQclear(mResult[i]); 
+         mResult[i]=0;
+         mRow[i]=0;
+      }
+   }
+   for(unsigned int i = 0; i < mConns.size(); i++)
+   {
+      disconnectFromDatabase(i);
+   }
 }
 
 void
@@ -114,35 +130,23 @@ PostgreSqlDb::initialize() const
 }
 
 void
-PostgreSqlDb::disconnectFromDatabase() const
+PostgreSqlDb::disconnectFromDatabase(unsigned int index) const
 {
-   if(mConn)
+   if(mConns[index])
    {
-      for (int i=0;i<MaxTable;i++)
-      {
-         if (mResult[i])
-         {  
-            PQclear(mResult[i]); 
-            mResult[i]=0;
-            mRow[i]=0;
-         }
-      }
-   
-      PQfinish(mConn);
-      mConn = 0;
-      setConnected(false);
+      PQfinish(mConns[index]);
+      mConns[index] = 0;
    }
 }
 
 int 
-PostgreSqlDb::connectToDatabase() const
+PostgreSqlDb::connectToDatabase(unsigned int index) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(index);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(mConns[index] == 0);
 
    Data connInfo(mDBConnInfo);
    if(!mDBServer.empty())
@@ -169,18 +173,19 @@ PostgreSqlDb::connectToDatabase() const
    }
 
    DebugLog(<<"Trying to connect to PostgreSQL server with conninfo string: " << connInfoLogString);
-   mConn = PQconnectdb(connInfo.c_str());
+   PGconn* conn = PQconnectdb(connInfo.c_str());
 
-   int rc = PQstatus(mConn);
+   int rc = PQstatus(conn);
    if (rc != CONNECTION_OK)
    { 
-      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(mConn));
-      mConn = 0;
+      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(conn));
+      PQfinish(conn);
       setConnected(false);
       return -1;
    }
    else
    {
+      mConns[index] = conn;
       setConnected(true);
       return 0;
    }
@@ -202,38 +207,50 @@ PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
 
    DebugLog( << "PostgreSqlDb::query: executing query: " << queryCommand);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   ConnectionLease lease(*this);
+   const unsigned int index = lease.index();
+   if(mConns[index] != 0 && needsHealthCheck(index))
+   {
+      // An empty query is a cheap round trip that tells us whether the
+      // server dropped this connection while it sat idle in the pool
+      PQclear(PQexec(mConns[index], ""));
+      if(PQstatus(mConns[index]) != CONNECTION_OK)
+      {
+         InfoLog( << "PostgreSQL connection " << index << " failed health check: " << PQerrorMessage(mConns[index]) << ", reconnecting");
+         disconnectFromDatabase(index);
+      }
+   }
+   if(mConns[index] == 0)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(index);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      _result = PQexec(mConn, queryCommand.c_str());
+      resip_assert(mConns[index]!=0);
+      _result = PQexec(mConns[index], queryCommand.c_str());
       rc = pqOK(_result);
       if(rc != 0)
       {
          PQclear(_result);
-         if(rc == PGRES_FATAL_ERROR)
+         if(PQstatus(mConns[index]) != CONNECTION_OK)
          {
-            // First failure may be a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            // Failure was a connection error - try to re-connect and then try again
+            rc = connectToDatabase(index);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               _result = PQexec(mConn,queryCommand.c_str());
+               _result = PQexec(mConns[index],queryCommand.c_str());
                rc = pqOK(_result);
                if( rc != 0)
                {
-                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(mConn));
+                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(mConns[index]));
+                  PQclear(_result);
                }
             }
          }
          else
          {
-            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(mConn));
+            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(mConns[index]));
          }
       }
    }
@@ -243,6 +260,10 @@ PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
    {
       *result = _result;
    }
+   else if(rc == 0)
+   {
+      PQclear(_result);
+   }
 
    if(rc != 0)
    {
@@ -291,11 +312,22 @@ PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fie
 resip::Data& 
 PostgreSqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
+   // Escaping depends on the connection encoding, so it needs a live
+   // connection too
+   initialize();
+   ConnectionLease lease(*this);
+   const unsigned int index = lease.index();
+   if(mConns[index] == 0 && connectToDatabase(index) != 0)
+   {
+      // No connection - fall back to the client default encoding
+      escapedStr.truncate2(PQescapeString((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
    int rc = 0;
-   escapedStr.truncate2(PQescapeStringConn(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
+   escapedStr.truncate2(PQescapeStringConn(mConns[index], (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
    if(rc != 0)
    {
-      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(mConn));
+      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(mConns[index]));
       // FIXME - should probably throw here.  According to the docs, there is a value in
       // the output buffer even after failure so we'll try to use it and fail later.
    }
@@ -357,7 +389,7 @@ PostgreSqlDb::getUser( const AbstractDb::Key& key ) const
    
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return ret;
    }
 
@@ -439,7 +471,7 @@ PostgreSqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return Data::Empty;
    }
    
@@ -514,7 +546,7 @@ PostgreSqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
  
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return ret;
    }
 
@@ -555,7 +587,7 @@ PostgreSqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return Data::Empty;
    }
 
@@ -651,7 +683,7 @@ PostgreSqlDb::dbReadRecord(const Table table,
 
    if (result == 0)
    {
-      ErrLog( << "PostgreSQL result failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL result failed: query returned no result");
       return false;
    }
    else
@@ -696,7 +728,7 @@ PostgreSqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL failed: query returned no result");
          return Data::Empty;
       }
    }
@@ -761,7 +793,7 @@ PostgreSqlDb::dbNextRecord(const Table table,
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL failed: query returned no result");
          return false;
       }
    }
@@ -788,12 +820,19 @@ PostgreSqlDb::dbNextRecord(const Table table,
 bool 
 PostgreSqlDb::dbBeginTransaction(const Table table)
 {
+   // The session settings and the transaction belong to one connection, so
+   // keep this thread on the same pool slot until commit or rollback
+   pinConnection();
    Data command("SET SESSION CHARACTERISTICS AS TRANSACTION ISOLATION LEVEL REPEATABLE READ");
-   if(query(command, 0))
+   if(query(command, 0) == 0)
    {
       command = "BEGIN";
-      return query(command, 0);
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   unpinConnection();
    return false;
 }
 
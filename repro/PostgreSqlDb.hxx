@@ -60,8 +60,8 @@ class PostgreSqlDb: public SqlDb
       virtual bool dbBeginTransaction(const Table table);
 
       void initialize() const;
-      void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(unsigned int index) const;
+      int connectToDatabase(unsigned int index) const;
       int query(const resip::Data& queryCommand, PGresult** result) const;
       virtual int query(const resip::Data& queryCommand) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
@@ -74,7 +74,8 @@ class PostgreSqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable PGconn* mConn;
+      // one handle per connection pool slot, 0 if not connected
+      mutable std::vector<PGconn*> mConns;
       mutable PGresult* mResult[MaxTable];
       mutable int mRow[MaxTable];
 
@@ -0,0 +1,399 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <resip/stack/Tuple.hxx>
+#include <rutil/Logger.hxx>
+
+#include "repro/RegSyncBinary.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+// Snapshots are sent in frames far smaller than this; it only bounds what a
+// malformed or hostile frame can make us allocate.
+static const uint64_t MaxInflatedSize = 64 * 1024 * 1024;
+
+static void
+encodeString(Data& buffer, const Data& value)
+{
+   RegSyncBinary::encodeVarint(buffer, value.size());
+   buffer.append(value.data(), value.size());
+}
+
+static Data
+decodeString(ParseBuffer& pb)
+{
+   uint64_t size = RegSyncBinary::decodeVarint(pb);
+   if(size > pb.lengthRemaining())
+   {
+      pb.fail(__FILE__, __LINE__, "string runs past end of record");
+   }
+   const char* start = pb.position();
+   pb.skipN((size_t)size);
+   return pb.data(start);
+}
+
+static void
+copyString(ParseBuffer& pb, Data& buffer)
+{
+   encodeString(buffer, decodeString(pb));
+}
+
+// Copies the AOR record at pb's position into buffer, aged by "age" seconds:
+// contacts expire that much sooner (0, expired, if they have since) and were
+// last updated that much longer ago.
+static void
+ageAor(ParseBuffer& pb, Data& buffer, uint64_t age)
+{
+   copyString(pb, buffer);
+   uint64_t numContacts = RegSyncBinary::decodeVarint(pb);
+   RegSyncBinary::encodeVarint(buffer, numContacts);
+   for(uint64_t i = 0; i < numContacts; i++)
+   {
+      copyString(pb, buffer);
+      uint64_t expires = RegSyncBinary::decodeVarint(pb);
+      RegSyncBinary::encodeVarint(buffer, expires > age ? expires - age : 0);
+      RegSyncBinary::encodeVarint(buffer, RegSyncBinary::decodeVarint(pb) + age);
+      copyString(pb, buffer);
+      copyString(pb, buffer);
+      uint64_t numPaths = RegSyncBinary::decodeVarint(pb);
+      RegSyncBinary::encodeVarint(buffer, numPaths);
+      for(uint64_t j = 0; j < numPaths; j++)
+      {
+         copyString(pb, buffer);
+      }
+      copyString(pb, buffer);
+      RegSyncBinary::encodeVarint(buffer, RegSyncBinary::decodeVarint(pb));
+      copyString(pb, buffer);
+   }
+}
+
+bool
+RegSyncBinary::encodeAor(Data& buffer, const Uri& aor, const ContactList& contacts, uint64_t now)
+{
+   uint64_t numContacts = 0;
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      if(!it->mReceivedFrom.onlyUseExistingConnection && it->mRegExpires != NeverExpire)  // Don't sync over static registrations
+      {
+         numContacts++;
+      }
+   }
+   if(numContacts == 0)
+   {
+      return false;
+   }
+
+   encodeString(buffer, Data::from(aor));
+   encodeVarint(buffer, numContacts);
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      const ContactInstanceRecord& rec = *it;
+      if(rec.mReceivedFrom.onlyUseExistingConnection || rec.mRegExpires == NeverExpire)
+      {
+         continue;
+      }
+      encodeString(buffer, Data::from(rec.mContact));
+      // If contact is expired or removed, then pass expires time as 0, otherwise send number of seconds until expirey
+      encodeVarint(buffer, ((rec.mRegExpires == 0) || (rec.mRegExpires <= now)) ? 0 : (rec.mRegExpires - now));
+      encodeVarint(buffer, rec.mLastUpdated < now ? now - rec.mLastUpdated : 0);
+      Data token;
+      if(rec.mReceivedFrom.getPort() != 0)
+      {
+         Tuple::writeBinaryToken(rec.mReceivedFrom, token);
+      }
+      encodeString(buffer, token);
+      token.clear();
+      if(rec.mPublicAddress.getType() != UNKNOWN_TRANSPORT)
+      {
+         Tuple::writeBinaryToken(rec.mPublicAddress, token);
+      }
+      encodeString(buffer, token);
+      encodeVarint(buffer, rec.mSipPath.size());
+      for(NameAddrs::const_iterator naIt = rec.mSipPath.begin(); naIt != rec.mSipPath.end(); naIt++)
+      {
+         encodeString(buffer, Data::from(naIt->uri()));
+      }
+      encodeString(buffer, rec.mInstance);
+      encodeVarint(buffer, rec.mRegId);
+      encodeString(buffer, rec.mUserAgent);
+   }
+   return true;
+}
+
+void
+RegSyncBinary::decodeAor(ParseBuffer& pb, Uri& aor, ContactList& contacts, uint64_t now)
+{
+   aor = Uri(decodeString(pb));
+   uint64_t numContacts = decodeVarint(pb);
+   for(uint64_t i = 0; i < numContacts; i++)
+   {
+      ContactInstanceRecord rec;
+      rec.mContact = NameAddr(decodeString(pb));
+      uint64_t expires = decodeVarint(pb);
+      rec.mRegExpires = (expires == 0 ? 0 : now + expires);
+      rec.mLastUpdated = now - decodeVarint(pb);
+      Data token = decodeString(pb);
+      if(!token.empty())
+      {
+         rec.mReceivedFrom = Tuple::makeTupleFromBinaryToken(token);
+      }
+      token = decodeString(pb);
+      if(!token.empty())
+      {
+         rec.mPublicAddress = Tuple::makeTupleFromBinaryToken(token);
+      }
+      uint64_t numPaths = decodeVarint(pb);
+      for(uint64_t j = 0; j < numPaths; j++)
+      {
+         rec.mSipPath.push_back(NameAddr(decodeString(pb)));
+      }
+      rec.mInstance = decodeString(pb);
+      rec.mRegId = (uint32_t)decodeVarint(pb);
+      rec.mUserAgent = decodeString(pb);
+      rec.mSyncContact = true;  // This ContactInstanceRecord came from registration sync process
+      contacts.push_back(rec);
+   }
+}
+
+void
+RegSyncBinary::encodeUpdate(Data& payload, uint64_t sequence, const Data& record, uint64_t encodedAt, uint64_t now)
+{
+   encodeVarint(payload, sequence);
+   if(now <= encodedAt)
+   {
+      payload += record;
+      return;
+   }
+   ParseBuffer pb(record);
+   ageAor(pb, payload, now - encodedAt);
+}
+
+void
+RegSyncBinary::encodeVarint(Data& buffer, uint64_t value)
+{
+   while(value >= 0x80)
+   {
+      buffer += (char)((value & 0x7f) | 0x80);
+      value >>= 7;
+   }
+   buffer += (char)value;
+}
+
+uint64_t
+RegSyncBinary::decodeVarint(ParseBuffer& pb)
+{
+   uint64_t value = 0;
+   for(unsigned int shift = 0; shift < 64; shift += 7)
+   {
+      pb.assertNotEof();
+      unsigned char c = (unsigned char)*pb.position();
+      pb.skipChar();
+      if(shift == 63 && c > 1)
+      {
+         pb.fail(__FILE__, __LINE__, "varint too large");
+      }
+      value |= (uint64_t)(c & 0x7f) << shift;
+      if(!(c & 0x80))
+      {
+         return value;
+      }
+   }
+   pb.fail(__FILE__, __LINE__, "varint too long");
+   return 0;
+}
+
+void
+RegSyncBinary::encodeUInt64(Data& buffer, uint64_t value)
+{
+   for(int shift = 56; shift >= 0; shift -= 8)
+   {
+      buffer += (char)(value >> shift);
+   }
+}
+
+uint64_t
+RegSyncBinary::decodeUInt64(ParseBuffer& pb)
+{
+   if(pb.lengthRemaining() < 8)
+   {
+      pb.fail(__FILE__, __LINE__, "truncated number");
+   }
+   uint64_t value = 0;
+   for(int i = 0; i < 8; i++)
+   {
+      value = (value << 8) | (unsigned char)*pb.position();
+      pb.skipChar();
+   }
+   return value;
+}
+
+Data
+RegSyncBinary::frame(FrameType type, const Data& payload)
+{
+   resip_assert(payload.size() <= MaxPayloadSize);
+   Data frame(HeaderSize + payload.size(), Data::Preallocate);
+   frame += (char)FrameMarker;
+   frame += (char)type;
+   uint32_t size = (uint32_t)payload.size();
+   frame += (char)(size >> 24);
+   frame += (char)(size >> 16);
+   frame += (char)(size >> 8);
+   frame += (char)size;
+   frame += payload;
+   return frame;
+}
+
+void
+RegSyncBinary::decodeHeader(const char* buffer, unsigned char& type, uint32_t& payloadSize)
+{
+   const unsigned char* header = (const unsigned char*)buffer;
+   resip_assert(header[0] == FrameMarker);
+   type = header[1];
+   payloadSize = ((uint32_t)header[2] << 24) | ((uint32_t)header[3] << 16) |
+                 ((uint32_t)header[4] << 8) | (uint32_t)header[5];
+}
+
+bool
+RegSyncBinary::compressionSupported()
+{
+#ifdef USE_ZLIB
+   return true;
+#else
+   return false;
+#endif
+}
+
+Data
+RegSyncBinary::encodeSnapshot(const Data& records, bool compress)
+{
+#ifdef USE_ZLIB
+   if(compress)
+   {
+      uLongf compressedSize = compressBound((uLong)records.size());
+      Data compressed;
+      // Fastest level: most of the gain for a fraction of the CPU, and the
+      // snapshot is built while the database is being walked
+      if(compress2((Bytef*)compressed.getBuf((Data::size_type)compressedSize), &compressedSize,
+                   (const Bytef*)records.data(), (uLong)records.size(), Z_BEST_SPEED) == Z_OK)
+      {
+         compressed.truncate2((Data::size_type)compressedSize);
+         Data payload(11 + compressed.size(), Data::Preallocate);
+         payload += (char)Deflate;
+         encodeVarint(payload, records.size());
+         payload += compressed;
+         return payload;
+      }
+      WarningLog(<< "RegSyncBinary::encodeSnapshot: compression failed, sending uncompressed");
+   }
+#endif
+   Data payload(1 + records.size(), Data::Preallocate);
+   payload += (char)None;
+   payload += records;
+   return payload;
+}
+
+bool
+RegSyncBinary::decodeSnapshot(const Data& payload, Data& records)
+{
+   if(payload.empty())
+   {
+      return false;
+   }
+   switch(payload[0])
+   {
+      case None:
+         records = payload.substr(1);
+         return true;
+#ifdef USE_ZLIB
+      case Deflate:
+      {
+         try
+         {
+            ParseBuffer pb(payload.data() + 1, payload.size() - 1);
+            uint64_t size = decodeVarint(pb);
+            if(size > MaxInflatedSize)
+            {
+               return false;
+            }
+            uLongf inflatedSize = (uLongf)size;
+            Data inflated;
+            char* buffer = inflated.getBuf((Data::size_type)size);
+            const char* compressed = pb.position();
+            if(uncompress((Bytef*)buffer, &inflatedSize,
+                          (const Bytef*)compressed, (uLong)pb.lengthRemaining()) != Z_OK ||
+               inflatedSize != size)
+            {
+               return false;
+            }
+            records = inflated;
+            return true;
+         }
+         catch(ParseException&)
+         {
+            return false;
+         }
+      }
+#endif
+      default:
+         return false;
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,143 @@
+#if !defined(RegSyncBinary_hxx)
+#define RegSyncBinary_hxx
+
+#include <rutil/Data.hxx>
+#include <rutil/ParseBuffer.hxx>
+#include <resip/stack/Uri.hxx>
+#include <resip/dum/ContactInstanceRecord.hxx>
+
+namespace repro
+{
+
+/**
+  Binary encoding of registration sync, used instead of <reginfo>
+  documents when a RegSyncClient asks for it with <Encoding>binary</Encoding>
+  in its InitialSync request.  Requests, responses and <pubinfo> events stay
+  XML; a frame is told apart from them by its first byte.
+
+  A frame is FrameMarker, a FrameType byte, the payload length as 32 bits in
+  network byte order, and the payload.  Numbers in a payload are unsigned
+  LEB128 varints and strings a varint length followed by the bytes.
+
+  An AOR record is the AOR, the number of contacts and, for each contact,
+  its URI, the seconds until it expires (0 once removed), the seconds since
+  it was last updated, the received-from and public address flow tokens
+  (empty if unset), the Path URIs, instance, reg-id and User-Agent.  As with
+  the XML encoding, times are relative so the peers' clocks need not agree.
+
+  Snapshot    - AOR records of the initial sync.  The first byte is the
+                Compression used for the rest; deflated records are
+                preceded by their inflated size.
+  SnapshotEnd - the server's epoch as 8 bytes in network byte order and the
+                sequence number the snapshot is complete up to.
+  Updates     - AOR records changed since, each preceded by its sequence
+                number.  A record kept for a while before it is sent has
+                its times made relative to when it is sent.
+
+  A client that has seen a SnapshotEnd can send that epoch and the last
+  sequence number it applied in a later InitialSync request; if the server
+  still has the changes since, it sends only those.
+*/
+class RegSyncBinary
+{
+public:
+   enum FrameType
+   {
+      Snapshot = 1,
+      SnapshotEnd = 2,
+      Updates = 3
+   };
+
+   enum Compression
+   {
+      None = 0,
+      Deflate = 1
+   };
+
+   static const unsigned char FrameMarker = 0xFB;
+   static const unsigned int HeaderSize = 6;
+   static const unsigned int MaxPayloadSize = 16 * 1024 * 1024;
+
+   /// Appends a record of the contacts of "aor" that are synced (not static
+   /// and not flow bound); returns false, appending nothing, if there are none.
+   static bool encodeAor(resip::Data& buffer, const resip::Uri& aor, const resip::ContactList& contacts, uint64_t now);
+   /// Throws a ParseException if the record is malformed.
+   static void decodeAor(resip::ParseBuffer& pb, resip::Uri& aor, resip::ContactList& contacts, uint64_t now);
+
+   /// Appends an Updates entry: "sequence" and "record", an AOR record that
+   /// encodeAor() built at time "encodedAt", with its times made relative
+   /// to "now" rather than to when it was built.
+   static void encodeUpdate(resip::Data& payload, uint64_t sequence, const resip::Data& record, uint64_t encodedAt, uint64_t now);
+
+   static void encodeVarint(resip::Data& buffer, uint64_t value);
+   static uint64_t decodeVarint(resip::ParseBuffer& pb);
+   static void encodeUInt64(resip::Data& buffer, uint64_t value);
+   static uint64_t decodeUInt64(resip::ParseBuffer& pb);
+
+   static resip::Data frame(FrameType type, const resip::Data& payload);
+   /// Reads the header at the start of "buffer", which must hold HeaderSize bytes.
+   static void decodeHeader(const char* buffer, unsigned char& type, uint32_t& payloadSize);
+
+   /// Whether this build can deflate snapshots.
+   static bool compressionSupported();
+   /// Builds a Snapshot payload from "records", deflated if "compress" is
+   /// set and deflating is supported.
+   static resip::Data encodeSnapshot(const resip::Data& records, bool compress);
+   /// Returns false if the payload is malformed or uses a compression this
+   /// build does not support.
+   static bool decodeSnapshot(const resip::Data& payload, resip::Data& records);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -12,6 +12,7 @@
 #include <rutil/TransportType.hxx>
 #include <rutil/Timer.hxx>
 
+#include "repro/RegSyncBinary.hxx"
 #include "repro/RegSyncClient.hxx"
 #include "repro/RegSyncServer.hxx"
 
@@ -24,12 +25,18 @@ using namespace std;
 RegSyncClient::RegSyncClient(InMemorySyncRegDb* regDb,
                              Data address,
                              unsigned short port,
-                             InMemorySyncPubDb* pubDb) :
+                             InMemorySyncPubDb* pubDb,
+                             bool binaryEncoding) :
    mRegDb(regDb),
    mPubDb(pubDb),
    mAddress(address),
    mPort(port),
-   mSocketDesc(0)
+   mSocketDesc(0),
+   mBinaryEncoding(binaryEncoding),
+   mResumable(false),
+   mEpoch(0),
+   mSequence(0),
+   mProtocolError(false)
 {
     resip_assert(mRegDb);
 }
@@ -124,9 +131,25 @@ RegSyncClient::thread()
       Data request(
          "<InitialSync>\r\n"
          "  <Request>\r\n"
-         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n"   // For use in detecting if client/server are a compatible version
-         "  </Request>\r\n"
-         "</InitialSync>\r\n");   
+         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n");   // For use in detecting if client/server are a compatible version
+      if(mBinaryEncoding)
+      {
+         // Servers that predate the binary encoding ignore these and send XML
+         request += "     <Encoding>binary</Encoding>\r\n";
+         if(RegSyncBinary::compressionSupported())
+         {
+            request += "     <Compression>deflate</Compression>\r\n";
+         }
+         if(mResumable)
+         {
+            request += "     <Epoch>" + Data(mEpoch) + "</Epoch>\r\n"
+                       "     <Sequence>" + Data(mSequence) + "</Sequence>\r\n";
+         }
+      }
+      request += "  </Request>\r\n"
+                 "</InitialSync>\r\n";
+      mRxDataBuffer.clear();
+      mProtocolError = false;
       rc = ::send(mSocketDesc, request.c_str(), (int)request.size(), 0);
       if(rc < 0) 
       {
@@ -173,11 +196,19 @@ RegSyncClient::thread()
             {
                mRxDataBuffer += Data(Data::Borrow, (const char*)&mRxBuffer, rc);   
                while(tryParse());
+               if(mProtocolError)
+               {
+                  // Resynchronize from scratch on a new connection
+                  mResumable = false;
+                  closeSocket(mSocketDesc);
+                  mSocketDesc = 0;
+                  break;
+               }
             }
          }
          else if(rc == 0) // timeout - send keepalive
          {
-            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, (int)request.size(), 0);
+            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, 4, 0);
             if(rc < 0) 
             {
                int e = getErrno();
@@ -204,6 +235,12 @@ RegSyncClient::thread()
              break;
          }
       }
+      if(mSocketDesc && !mShutdown)
+      {
+         // Connection closed by the peer
+         closeSocket(mSocketDesc);
+         mSocketDesc = 0;
+      }
    } // end while
 
    if(mSocketDesc) closeSocket(mSocketDesc);
@@ -214,8 +251,39 @@ RegSyncClient::tryParse()
 {
    ParseBuffer pb(mRxDataBuffer);
    Data initialTag;
-   const char* start = pb.position();
    pb.skipWhitespace();
+   if(!pb.eof() && (unsigned char)*pb.position() == RegSyncBinary::FrameMarker)
+   {
+      if(pb.lengthRemaining() < RegSyncBinary::HeaderSize)
+      {
+         return false;
+      }
+      unsigned char type;
+      uint32_t payloadSize;
+      RegSyncBinary::decodeHeader(pb.position(), type, payloadSize);
+      if(payloadSize > RegSyncBinary::MaxPayloadSize)
+      {
+         ErrLog(<< "RegSyncClient::tryParse: frame of " << payloadSize << " bytes is too large");
+         mProtocolError = true;
+         return false;
+      }
+      if(pb.lengthRemaining() < RegSyncBinary::HeaderSize + payloadSize)
+      {
+         return false;
+      }
+      pb.skipN(RegSyncBinary::HeaderSize);
+      handleFrame(type, Data(Data::Share, pb.position(), payloadSize));
+      pb.skipN(payloadSize);
+      if(mProtocolError)
+      {
+         return false;
+      }
+      const char* anchor = pb.position();
+      pb.skipToEnd();
+      mRxDataBuffer = pb.data(anchor);
+      return !mRxDataBuffer.empty();
+   }
+   const char* start = pb.position();
    pb.skipToChar('<');   
    if(!pb.eof())
    {
@@ -299,6 +367,68 @@ RegSyncClient::handleXml(const Data& xmlData)
    }
 }
 
+void
+RegSyncClient::handleFrame(unsigned char type, const Data& payload)
+{
+   uint64_t now = Timer::getTimeSecs();
+   try
+   {
+      switch(type)
+      {
+         case RegSyncBinary::Snapshot:
+         {
+            Data records;
+            if(!RegSyncBinary::decodeSnapshot(payload, records))
+            {
+               ErrLog(<< "RegSyncClient::handleFrame: cannot decode snapshot");
+               mProtocolError = true;
+               return;
+            }
+            ParseBuffer pb(records);
+            while(!pb.eof())
+            {
+               Uri aor;
+               ContactList contacts;
+               RegSyncBinary::decodeAor(pb, aor, contacts, now);
+               processModify(aor, contacts);
+            }
+            break;
+         }
+         case RegSyncBinary::SnapshotEnd:
+         {
+            ParseBuffer pb(payload);
+            mEpoch = RegSyncBinary::decodeUInt64(pb);
+            mSequence = RegSyncBinary::decodeVarint(pb);
+            mResumable = true;
+            InfoLog(<< "RegSyncClient::handleFrame: InitialSync snapshot complete at sequence " << mSequence);
+            break;
+         }
+         case RegSyncBinary::Updates:
+         {
+            ParseBuffer pb(payload);
+            while(!pb.eof())
+            {
+               uint64_t sequence = RegSyncBinary::decodeVarint(pb);
+               Uri aor;
+               ContactList contacts;
+               RegSyncBinary::decodeAor(pb, aor, contacts, now);
+               processModify(aor, contacts);
+               mSequence = sequence;
+            }
+            break;
+         }
+         default:
+            WarningLog(<< "RegSyncClient::handleFrame: Ignoring frame of unknown type " << (unsigned int)type);
+            break;
+      }
+   }
+   catch(BaseException& e)
+   {
+      ErrLog(<< "RegSyncClient::handleFrame: exception: " << e);
+      mProtocolError = true;
+   }
+}
+
 void 
 RegSyncClient::handleRegInfoEvent(resip::XMLCursor& xml)
 {
@@ -435,7 +565,7 @@ RegSyncClient::processModify(const resip::Uri& aor, ContactList& syncContacts)
    mRegDb->lockRecord(aor);
    mRegDb->getContacts(aor, currentContacts);
 
-   InfoLog(<< "RegSyncClient::processModify: for aor=" << aor << 
+   DebugLog(<< "RegSyncClient::processModify: for aor=" << aor << 
               ", numSyncContacts=" << syncContacts.size() << 
               ", numCurrentContacts=" << currentContacts.size());
 
@@ -445,7 +575,7 @@ RegSyncClient::processModify(const resip::Uri& aor, ContactList& syncContacts)
    bool found;
    for(; itSync != syncContacts.end(); itSync++)
    {
-      InfoLog(<< "  RegSyncClient::processModify: contact=" << itSync->mContact << ", instance=" << itSync->mInstance << ", regid=" << itSync->mRegId);
+      DebugLog(<< "  RegSyncClient::processModify: contact=" << itSync->mContact << ", instance=" << itSync->mInstance << ", regid=" << itSync->mRegId);
 
       // See if contact already exists in currentContacts       
       found = false;
@@ -16,7 +16,8 @@ public:
    RegSyncClient(resip::InMemorySyncRegDb* regDb,
                  resip::Data address,
                  unsigned short port,
-                 resip::InMemorySyncPubDb* pubDb = 0);
+                 resip::InMemorySyncPubDb* pubDb = 0,
+                 bool binaryEncoding = true);
 
    virtual void thread();
    virtual void shutdown();
@@ -25,6 +26,7 @@ private:
    void delaySeconds(unsigned int seconds);
    bool tryParse();  // returns true if we processed something and there is more data in the buffer
    void handleXml(const resip::Data& xmlData);
+   void handleFrame(unsigned char type, const resip::Data& payload);
    void handleRegInfoEvent(resip::XMLCursor& xml);
    void handlePubInfoEvent(resip::XMLCursor& xml);
    void processModify(const resip::Uri& aor, resip::ContactList& syncContacts);
@@ -36,6 +38,14 @@ private:
    char mRxBuffer[8000];
    resip::Data mRxDataBuffer;
    int mSocketDesc;
+
+   // Binary encoding (see RegSyncBinary) - once a snapshot has completed, a
+   // reconnect asks the server for only the changes after mSequence
+   bool mBinaryEncoding;
+   bool mResumable;
+   uint64_t mEpoch;
+   uint64_t mSequence;
+   bool mProtocolError;
 };
 
 }
@@ -9,14 +9,17 @@
 #include <rutil/ResipAssert.h>
 #include <rutil/Data.hxx>
 #include <rutil/DnsUtil.hxx>
+#include <rutil/Lock.hxx>
 #include <rutil/Logger.hxx>
 #include <rutil/ParseBuffer.hxx>
+#include <rutil/Random.hxx>
 #include <rutil/Socket.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/Timer.hxx>
 
 #include "repro/XmlRpcServerBase.hxx"
 #include "repro/XmlRpcConnection.hxx"
+#include "repro/RegSyncBinary.hxx"
 #include "repro/RegSyncServer.hxx"
 
 using namespace repro;
@@ -25,14 +28,37 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
 
+// Binary frames are cut at about these sizes
+static const Data::size_type UpdatesFrameSize = 64 * 1024;
+static const Data::size_type SnapshotFrameSize = 256 * 1024;
+
+static uint64_t
+newEpoch()
+{
+   unsigned char buffer[8];
+   Random::getCryptoRandom(buffer, sizeof(buffer));
+   uint64_t epoch = 0;
+   for(unsigned int i = 0; i < sizeof(buffer); i++)
+   {
+      epoch = (epoch << 8) | buffer[i];
+   }
+   return epoch;
+}
 
 RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              int port, 
                              IpVersion version,
-                             resip::InMemorySyncPubDb* pubDb) :
+                             resip::InMemorySyncPubDb* pubDb,
+                             unsigned int journalSize) :
    XmlRpcHandler(std::unique_ptr<XmlRpcServerBase>(new XmlRpcSocketServer(*this, port, version))),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBinaryConnections(0),
+   mJournalSize(journalSize),
+   mSequence(0),
+   mEpoch(newEpoch()),
+   mSnapshotConnectionId(0),
+   mSnapshotCompressed(false)
 {
    if (mRegDb)
    {
@@ -50,7 +76,13 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcHandler(std::unique_ptr<XmlRpcProtonServer>(new XmlRpcProtonServer(*this, brokerQueue, true))),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBinaryConnections(0),
+   mJournalSize(DefaultJournalSize),
+   mSequence(0),
+   mEpoch(newEpoch()),
+   mSnapshotConnectionId(0),
+   mSnapshotCompressed(false)
 {
    if (mRegDb)
    {
@@ -253,43 +285,210 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
 {
    InfoLog(<< "RegSyncServer::handleInitialSyncRequest");
 
-   // Check for correct Version
+   // Check for correct Version, and whether the client wants the binary
+   // encoding and can resume from where an earlier connection left off
    unsigned int version = 0;
+   bool binary = false;
+   bool compress = false;
+   bool resume = false;
+   uint64_t epoch = 0;
+   uint64_t sequence = 0;
    if(xml.firstChild())
    {
       if(isEqualNoCase(xml.getTag(), "request"))
       {
          if(xml.firstChild())
          {
-            if(isEqualNoCase(xml.getTag(), "version"))
+            do
             {
+               Data tag = xml.getTag();
+               Data value;
                if(xml.firstChild())
                {
-                  version = xml.getValue().convertUnsignedLong();
+                  value = xml.getValue();
                   xml.parent();
                }
-            }
+               if(isEqualNoCase(tag, "version"))
+               {
+                  version = value.convertUnsignedLong();
+               }
+               else if(isEqualNoCase(tag, "encoding"))
+               {
+                  binary = isEqualNoCase(value, "binary");
+               }
+               else if(isEqualNoCase(tag, "compression"))
+               {
+                  compress = isEqualNoCase(value, "deflate") && RegSyncBinary::compressionSupported();
+               }
+               else if(isEqualNoCase(tag, "epoch"))
+               {
+                  epoch = value.convertUInt64();
+               }
+               else if(isEqualNoCase(tag, "sequence"))
+               {
+                  sequence = value.convertUInt64();
+                  resume = true;
+               }
+            } while(xml.nextSibling());
             xml.parent();
          }
       }
       xml.parent();
    }
 
-   if(version == REGSYNC_VERSION)
+   if(version != REGSYNC_VERSION)
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 505, "Version not supported.");
+      return;
+   }
+
+   bool resumed = false;
+   uint64_t snapshotSequence;
+   {
+      Lock lock(mMutex);
+      SyncConnection& connection = mSyncConnections[connectionId];
+      if(binary && !connection.mBinary)
+      {
+         connection.mBinary = true;
+         mBinaryConnections++;
+      }
+      if(binary && resume && epoch == mEpoch && sequence <= mSequence &&
+         (sequence == mSequence || (!mJournal.empty() && mJournal.front().mSequence <= sequence + 1)))
+      {
+         resumed = true;
+      }
+      snapshotSequence = resumed ? sequence : mSequence;
+      // Changes after the snapshot (or the point resumed from) are sent from the journal
+      connection.mNextSequence = snapshotSequence + 1;
+   }
+
+   if(!binary)
    {
       if (mRegDb)
       {
-         mRegDb->initialSync(connectionId);
+         mRegDb->initialSync(*this, connectionId);
       }
-      if (mPubDb)
+   }
+   else if(!resumed)
+   {
+      InfoLog(<< "RegSyncServer::handleInitialSyncRequest: sending binary snapshot" << (compress ? ", compressed" : "") << " up to sequence " << snapshotSequence);
+      if (mRegDb)
       {
-         mPubDb->initialSync(connectionId);
+         mSnapshotConnectionId = connectionId;
+         mSnapshotCompressed = compress;
+         mRegDb->initialSync(*this, connectionId);
+         sendSnapshot();
+         mSnapshotConnectionId = 0;
       }
-      sendResponse(connectionId, requestId, Data::Empty, 200, "Initial Sync Completed.");
+      Data end;
+      RegSyncBinary::encodeUInt64(end, mEpoch);
+      RegSyncBinary::encodeVarint(end, snapshotSequence);
+      mRpc->sendEvent(connectionId, RegSyncBinary::frame(RegSyncBinary::SnapshotEnd, end));
    }
    else
    {
-      sendResponse(connectionId, requestId, Data::Empty, 505, "Version not supported.");
+      InfoLog(<< "RegSyncServer::handleInitialSyncRequest: resuming from sequence " << sequence);
+   }
+   if (mPubDb)
+   {
+      mPubDb->initialSync(*this, connectionId);
+   }
+   sendResponse(connectionId, requestId, Data::Empty, 200, resumed ? "Sync Resumed." : "Initial Sync Completed.");
+}
+
+void
+RegSyncServer::sendSnapshot()
+{
+   if(!mSnapshotRecords.empty())
+   {
+      mRpc->sendEvent(mSnapshotConnectionId,
+                      RegSyncBinary::frame(RegSyncBinary::Snapshot,
+                                           RegSyncBinary::encodeSnapshot(mSnapshotRecords, mSnapshotCompressed)));
+      mSnapshotRecords.clear();
+   }
+}
+
+void
+RegSyncServer::buildFdSet(FdSet& fdset)
+{
+   sendJournal();
+   XmlRpcHandler::buildFdSet(fdset);
+}
+
+void
+RegSyncServer::sendJournal()
+{
+   std::vector<std::pair<unsigned int, Data> > frames;
+   {
+      Lock lock(mMutex);
+      if(mBinaryConnections == 0)
+      {
+         return;
+      }
+      // Entries may have waited in the journal, for a connection resuming
+      // from one of them, so their times are made relative to now
+      uint64_t now = Timer::getTimeSecs();
+      for(std::map<unsigned int, SyncConnection>::iterator it = mSyncConnections.begin(); it != mSyncConnections.end(); it++)
+      {
+         SyncConnection& connection = it->second;
+         if(!connection.mBinary || connection.mNextSequence > mSequence)
+         {
+            continue;
+         }
+         // trimJournal() keeps every entry a connection still needs
+         resip_assert(!mJournal.empty() && mJournal.front().mSequence <= connection.mNextSequence);
+         Data payload;
+         for(size_t i = (size_t)(connection.mNextSequence - mJournal.front().mSequence); i < mJournal.size(); i++)
+         {
+            const JournalEntry& entry = mJournal[i];
+            if(!payload.empty() && payload.size() + entry.mRecord.size() > UpdatesFrameSize)
+            {
+               frames.push_back(std::make_pair(it->first, RegSyncBinary::frame(RegSyncBinary::Updates, payload)));
+               payload.clear();
+            }
+            RegSyncBinary::encodeUpdate(payload, entry.mSequence, entry.mRecord, entry.mEncodedAt, now);
+         }
+         frames.push_back(std::make_pair(it->first, RegSyncBinary::frame(RegSyncBinary::Updates, payload)));
+         connection.mNextSequence = mSequence + 1;
+      }
+      trimJournal();
+   }
+   for(std::vector<std::pair<unsigned int, Data> >::iterator it = frames.begin(); it != frames.end(); it++)
+   {
+      mRpc->sendEvent(it->first, it->second);
+   }
+}
+
+// mMutex must be held
+void
+RegSyncServer::trimJournal()
+{
+   uint64_t oldestNeeded = mSequence + 1;
+   for(std::map<unsigned int, SyncConnection>::iterator it = mSyncConnections.begin(); it != mSyncConnections.end(); it++)
+   {
+      if(it->second.mBinary && it->second.mNextSequence < oldestNeeded)
+      {
+         oldestNeeded = it->second.mNextSequence;
+      }
+   }
+   while(mJournal.size() > mJournalSize && mJournal.front().mSequence < oldestNeeded)
+   {
+      mJournal.pop_front();
+   }
+}
+
+void
+RegSyncServer::onConnectionClosed(unsigned int connectionId)
+{
+   Lock lock(mMutex);
+   std::map<unsigned int, SyncConnection>::iterator it = mSyncConnections.find(connectionId);
+   if(it != mSyncConnections.end())
+   {
+      if(it->second.mBinary)
+      {
+         mBinaryConnections--;
+      }
+      mSyncConnections.erase(it);
    }
 }
 
@@ -338,13 +537,65 @@ RegSyncServer::streamContactInstanceRecord(std::stringstream& ss, const ContactI
 void 
 RegSyncServer::onAorModified(const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(0, aor, contacts);
+   JournalEntry entry;
+   entry.mEncodedAt = Timer::getTimeSecs();
+   bool journaled = RegSyncBinary::encodeAor(entry.mRecord, aor, contacts, entry.mEncodedAt);
+   std::vector<unsigned int> xmlConnections;
+   bool binaryConnections;
+   {
+      Lock lock(mMutex);
+      if(journaled)
+      {
+         entry.mSequence = ++mSequence;
+         mJournal.push_back(entry);
+         trimJournal();
+      }
+      binaryConnections = mBinaryConnections > 0;
+      if(binaryConnections)
+      {
+         for(std::map<unsigned int, SyncConnection>::iterator it = mSyncConnections.begin(); it != mSyncConnections.end(); it++)
+         {
+            if(!it->second.mBinary)
+            {
+               xmlConnections.push_back(it->first);
+            }
+         }
+      }
+   }
+
+   if(!binaryConnections)
+   {
+      sendRegistrationModifiedEvent(0, aor, contacts);
+      return;
+   }
+
+   // Binary connections get the change from the journal, batched with any
+   // others, when the server's thread wakes up
+   if(journaled)
+   {
+      mRpc->wakeup();
+   }
+   for(std::vector<unsigned int>::iterator it = xmlConnections.begin(); it != xmlConnections.end(); it++)
+   {
+      sendRegistrationModifiedEvent(*it, aor, contacts);
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   if(connectionId == mSnapshotConnectionId)
+   {
+      RegSyncBinary::encodeAor(mSnapshotRecords, aor, contacts, Timer::getTimeSecs());
+      if(mSnapshotRecords.size() >= SnapshotFrameSize)
+      {
+         sendSnapshot();
+      }
+   }
+   else
+   {
+      sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   }
 }
 
 void 
@@ -1,7 +1,11 @@
 #if !defined(RegSyncServer_hxx)
 #define RegSyncServer_hxx 
 
+#include <deque>
+#include <map>
+
 #include <rutil/Data.hxx>
+#include <rutil/Mutex.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
@@ -19,10 +23,15 @@ class RegSyncServer: public XmlRpcHandler,
                      public resip::InMemorySyncPubDbHandler
 {
 public:
+   // Number of registration changes kept so that a binary client which
+   // reconnects can catch up on just what it missed
+   static const unsigned int DefaultJournalSize = 50000;
+
    RegSyncServer(resip::InMemorySyncRegDb* regDb,
                  int port, 
                  resip::IpVersion version,
-                 resip::InMemorySyncPubDb* pubDb = 0);
+                 resip::InMemorySyncPubDb* pubDb = 0,
+                 unsigned int journalSize = DefaultJournalSize);
 #ifdef BUILD_QPID_PROTON
    RegSyncServer(resip::InMemorySyncRegDb* regDb,
                  const resip::Data& brokerQueue,
@@ -43,8 +52,13 @@ public:
    virtual void sendDocumentModifiedEvent(unsigned int connectionId, const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, uint64_t expirationTime, uint64_t lastUpdated, const resip::Contents* contents, const resip::SecurityAttributes* securityAttributes);
    virtual void sendDocumentRemovedEvent(unsigned int connectionId, const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, uint64_t lastUpdated);
 
+   // Also sends binary clients the registration changes made since the
+   // last call, batched
+   virtual void buildFdSet(resip::FdSet& fdset);
+
 protected:
    virtual void handleRequest(unsigned int connectionId, unsigned int requestId, const resip::Data& request); 
+   virtual void onConnectionClosed(unsigned int connectionId);
 
    // InMemorySyncRegDbHandler methods
    virtual void onAorModified(const resip::Uri& aor, const resip::ContactList& contacts);
@@ -58,9 +72,43 @@ protected:
 private: 
    void handleInitialSyncRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void streamContactInstanceRecord(std::stringstream& ss, const resip::ContactInstanceRecord& rec);
+   void sendJournal();
+   void sendSnapshot();
+   void trimJournal();
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
+
+   // A connection that has completed an InitialSync request
+   class SyncConnection
+   {
+   public:
+      SyncConnection() : mBinary(false), mNextSequence(0) {}
+      bool mBinary;
+      uint64_t mNextSequence;  // first journal entry not yet sent to a binary connection
+   };
+   class JournalEntry
+   {
+   public:
+      uint64_t mSequence;
+      uint64_t mEncodedAt;  // the time mRecord's relative times are from
+      resip::Data mRecord;  // RegSyncBinary AOR record
+   };
+
+   resip::Mutex mMutex;  // protects the members below
+   std::map<unsigned int, SyncConnection> mSyncConnections;
+   unsigned int mBinaryConnections;
+   std::deque<JournalEntry> mJournal;
+   unsigned int mJournalSize;
+   uint64_t mSequence;  // of the latest change
+   uint64_t mEpoch;     // identifies this run of the server, and so its sequence numbers
+
+   // Initial sync in progress for a binary connection; only used by
+   // handleRequest() and the onInitialSyncAor() calls it makes through
+   // InMemorySyncRegDb::initialSync(), which go to this server only
+   unsigned int mSnapshotConnectionId;
+   bool mSnapshotCompressed;
+   resip::Data mSnapshotRecords;
 };
 
 }
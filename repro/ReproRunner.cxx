@@ -20,6 +20,7 @@
 #include "rutil/hep/HepAgent.hxx"
 
 #include "resip/stack/SipStack.hxx"
+#include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Compression.hxx"
 #include "resip/stack/EventStackThread.hxx"
 #include "resip/stack/ExtendedDomainMatcher.hxx"
@@ -27,7 +28,9 @@
 #include "resip/stack/InteropHelper.hxx"
 #include "resip/stack/ConnectionManager.hxx"
 #include "resip/stack/TransactionState.hxx"
+#include "resip/stack/TimerQueue.hxx"
 #include "resip/stack/WsCookieContextFactory.hxx"
+#include "resip/stack/UdpTransport.hxx"
 
 #include "resip/dum/InMemorySyncRegDb.hxx"
 #include "resip/dum/InMemorySyncPubDb.hxx"
@@ -613,6 +616,24 @@ ReproRunner::createSipStack()
    // Set TCP Connect timeout 
    resip::Timer::TcpConnectTimeout = mProxyConfig->getConfigUnsignedLong("TCPConnectTimeout", 10000);  // Default to 10 seconds
 
+   // Select the data structure backing the stack's timer queues
+   Data timerQueue = mProxyConfig->getConfigData("TimerQueue", "wheel");
+   if(isEqualNoCase(timerQueue, "heap"))
+   {
+      TimerQueueBase::setDefaultImplementation(TimerQueueBase::Heap);
+   }
+   else
+   {
+      if(!isEqualNoCase(timerQueue, "wheel"))
+      {
+         WarningLog(<< "Unknown TimerQueue value " << timerQueue << ", using wheel");
+      }
+      TimerQueueBase::setDefaultImplementation(TimerQueueBase::Wheel);
+   }
+
+   // Number of freed SipMessages (and datagram buffers) each thread keeps for reuse
+   SipMessage::setRecyclingCacheSize(mProxyConfig->getConfigUnsignedLong("MessageRecyclingCacheSize", 0));
+
    // Set DNS Greylist Duration
    resip::TransactionState::DnsGreylistDurationMs = mProxyConfig->getConfigUnsignedLong("DNSGreylistDuration", 1800000);  // Default to 30mins
 
@@ -709,6 +730,7 @@ ReproRunner::createSipStack()
                             /*socketFunc*/0,
                             compression,
                             mFdPollGrp);
+   mSipStack->setTransactionShards(mProxyConfig->getConfigUnsignedLong("TransactionShards", 1));
 
    // Set any enum suffixes from configuration
    std::vector<Data> enumSuffixes;
@@ -731,6 +753,11 @@ ReproRunner::createSipStack()
       mSipStack->setEnumDomains(enumDomains);
    }
 
+   // DNS cache sizing and refresh-ahead of busy records
+   mSipStack->getDnsStub().setDnsCacheSize(mProxyConfig->getConfigInt("DNSCacheSize", 512));
+   mSipStack->getDnsStub().setDnsCachePrefetch(mProxyConfig->getConfigInt("DNSCachePrefetchSecs", 0),
+                                               mProxyConfig->getConfigUnsignedLong("DNSCachePrefetchMinHits", 2));
+
    // Add External Stats handler
    mSipStack->setExternalStatsHandler(this);
 
@@ -774,6 +801,7 @@ ReproRunner::createSipStack()
       InteropHelper::setClientNATDetectionMode(InteropHelper::ClientNATDetectionPrivateToPublicOnly);
    }
    ConnectionManager::MinimumGcHeadroom = mProxyConfig->getConfigUnsignedLong("TCPMinimumGCHeadroom", 0);
+   Connection::setMaxWriteBatchBytes(mProxyConfig->getConfigUnsignedLong("TCPMaxWriteBatchBytes", 65536));
    unsigned long tcpConnectionGCAge = mProxyConfig->getConfigUnsignedLong("TCPConnectionGCAge", 0);
    if(tcpConnectionGCAge > 0)
    {
@@ -942,6 +970,10 @@ ReproRunner::createDatastore()
       return false;
    }
    mProxyConfig->createDataStore(mAbstractDb, mRuntimeAbstractDb);
+   mProxyConfig->getDataStore()->mUserStore.setAuthCache(
+      mProxyConfig->getConfigUnsignedLong("AuthCacheSize", 0),
+      mProxyConfig->getConfigUnsignedLong("AuthCacheTTL", 60),
+      mProxyConfig->getConfigUnsignedLong("AuthCacheNegativeTTL", 5));
 
    // Create ImMemory Registration Database
    mRegSyncPort = mProxyConfig->getConfigInt("RegSyncPort", 0);
@@ -1365,18 +1397,21 @@ ReproRunner::createRegSync()
    }
    if(mRegSyncPort != 0 || regSyncServerList.size() > 0)
    {
+      unsigned int regSyncJournalSize = mProxyConfig->getConfigUnsignedLong("RegSyncJournalSize", RegSyncServer::DefaultJournalSize);
       if(mUseV4) 
       {
          mRegSyncServerV4 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager), 
                                               mRegSyncPort, V4, 
-                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                              regSyncJournalSize);
          regSyncServerList.push_back(mRegSyncServerV4);
       }
       if(mUseV6) 
       {
          mRegSyncServerV6 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                               mRegSyncPort, V6,
-                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                              regSyncJournalSize);
          regSyncServerList.push_back(mRegSyncServerV6);
       }
       if(!regSyncServerList.empty())
@@ -1395,7 +1430,8 @@ ReproRunner::createRegSync()
          {
             mRegSyncClient = new RegSyncClient(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                                regSyncPeerAddress, remoteRegSyncPort,
-                                               enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                               enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                               mProxyConfig->getConfigBool("RegSyncBinaryEncoding", true));
          }
       }
    }
@@ -1639,6 +1675,8 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
          // Transport1TlsClientVerification = None
          // Transport1RecordRouteUri = sip:sipdomain.com;transport=TLS
          // Transport1RcvBufLen = 2000
+         // Transport1UdpBatchDepth = 16
+         // Transport1Shards = 4
 
          allTransportsSpecifyRecordRoute = true;
 
@@ -1710,6 +1748,13 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                }
 #endif
 
+               unsigned int shards = (unsigned int)tc.getConfigUnsignedLong("Shards", 1);
+               if(shards > 1 && tt != UDP)
+               {
+                  WarningLog(<< transportPrefix << "Shards is only supported for UDP transports, ignoring");
+                  shards = 1;
+               }
+
                Transport *t = mSipStack->addTransport(tt,
                                  port,
                                  DnsUtil::isIpV6Address(ipAddr) ? V6 : V4,
@@ -1722,7 +1767,9 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                                  tlsCertificate, tlsPrivateKey,
                                  cvm,          // tls client verification mode
                                  useEmailAsSIP,
-                                 basicWsConnectionValidator, wsCookieContextFactory);
+                                 basicWsConnectionValidator, wsCookieContextFactory,
+                                 Data::Empty,  // netns
+                                 shards);
 
                if (t)
                {
@@ -1738,6 +1785,16 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
 #endif
                   }
 
+                  int udpBatchDepth = tc.getConfigInt("UdpBatchDepth", 0);
+                  if (udpBatchDepth > 1 && tt == UDP)
+                  {
+                     UdpTransport* udp = dynamic_cast<UdpTransport*>(t);
+                     if (udp)
+                     {
+                        udp->setBatchDepth(udpBatchDepth);
+                     }
+                  }
+
                   Data recordRouteUri = tc.getConfigData("RecordRouteUri", Data::Empty);
                   if(!recordRouteUri.empty())
                   {
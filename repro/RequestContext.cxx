@@ -1097,21 +1097,21 @@ RequestContext::getDigestRealm()
    }
 
    // (2) Check From domain
-   if (mProxy.isMyDomain(mOriginalRequest->header(h_From).uri().host()))
+   if (mProxy.isMyDomain(mOriginalRequest->const_header(h_From).uri().host()))
    {
-      return mOriginalRequest->header(h_From).uri().host();
+      return mOriginalRequest->const_header(h_From).uri().host();
    }
 
    // (3) Check Top Route Header
    if (mOriginalRequest->exists(h_Routes) &&
-         mOriginalRequest->header(h_Routes).size()!=0 &&
-         mOriginalRequest->header(h_Routes).front().isWellFormed())
+         mOriginalRequest->const_header(h_Routes).size()!=0 &&
+         mOriginalRequest->const_header(h_Routes).front().isWellFormed())
    {
       // !abr! Add this when we get a chance
    }
 
    // (4) Punt: Use Request URI
-   return mOriginalRequest->header(h_RequestLine).uri().host();
+   return mOriginalRequest->const_header(h_RequestLine).uri().host();
 }
 
 EncodeStream&
@@ -507,7 +507,7 @@ ResponseContext::buildTargetRequest(Target *target)
 
    try
    {
-      inDialog = request->header(h_To).exists(p_tag);
+      inDialog = request->const_header(h_To).exists(p_tag);
    }
    catch (resip::ParseException &)
    {
@@ -669,7 +669,7 @@ ResponseContext::insertRecordRoute(SipMessage& outgoing,
          {
             // Only add ;ob parameter if client really supports outbound (ie. not for NAT detection mode or flow token hack)
             if(!mRequestContext.getOriginalRequest().empty(h_Supporteds) &&
-               mRequestContext.getOriginalRequest().header(h_Supporteds).find(Token(Symbols::Outbound)))
+               mRequestContext.getOriginalRequest().const_header(h_Supporteds).find(Token(Symbols::Outbound)))
             {
                rt.uri().param(p_ob);
             }
@@ -711,7 +711,7 @@ resip::Data
 ResponseContext::getInboundFlowToken(bool doPathInstead)
 {
    resip::Data flowToken=resip::Data::Empty;
-   resip::SipMessage& orig=mRequestContext.getOriginalRequest();
+   const resip::SipMessage& orig=mRequestContext.getOriginalRequest();
    if(orig.empty(h_Contacts) || !orig.header(h_Contacts).front().isWellFormed())
    {
       return flowToken;
@@ -1104,7 +1104,7 @@ ResponseContext::processResponse(SipMessage& response)
          return;
       }
 
-      const Via& origVia = mRequestContext.getOriginalRequest().header(h_Vias).front();
+      const Via& origVia = mRequestContext.getOriginalRequest().const_header(h_Vias).front();
       const Data& branch=(via.exists(p_branch) ? via.param(p_branch).getTransactionId() : Data::Empty);
       const Data& origBranch=(origVia.exists(p_branch) ? origVia.param(p_branch).getTransactionId() : Data::Empty);
 
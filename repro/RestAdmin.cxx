@@ -4,7 +4,6 @@
   #include "config.h"
 #endif
 
-#include <chrono>
 #include <sstream>
 
 #include "cajun/json/elements.h"
@@ -172,6 +171,48 @@ json::Object methodCodeMap(const unsigned int (*arr)[resip::StatisticsMessage::P
    return obj;
 }
 
+// Summarise a latency histogram (micro-seconds). The buckets are sparse:
+// each non-empty one as [upper bound, count], in ascending order.
+json::Object latencyToJson(const resip::LatencyHistogram& h)
+{
+   json::Object obj;
+   obj["count"] = json::Number((double)h.count());
+   obj["meanUs"] = json::Number((double)h.meanMicroSec());
+   obj["p50Us"] = json::Number((double)h.percentile(0.5));
+   obj["p90Us"] = json::Number((double)h.percentile(0.9));
+   obj["p99Us"] = json::Number((double)h.percentile(0.99));
+   obj["maxUs"] = json::Number((double)h.maxMicroSec());
+   json::Array buckets;
+   for (unsigned int b = 0; b < resip::LatencyHistogram::NumBuckets; ++b)
+   {
+      if (h.bucketCount(b) != 0)
+      {
+         json::Array bucket;
+         bucket.Insert(json::Number((double)resip::LatencyHistogram::bucketUpperBound(b)));
+         bucket.Insert(json::Number(h.bucketCount(b)));
+         buckets.Insert(bucket);
+      }
+   }
+   obj["buckets"] = buckets;
+   return obj;
+}
+
+// Per-method latency histograms, keyed by method name; methods with no
+// samples are omitted.
+json::Object methodLatencyMap(const resip::LatencyHistogram* methodArr)
+{
+   json::Object obj;
+   for (size_t i = 0; i < kNumTrackedMethods; ++i)
+   {
+      const resip::LatencyHistogram& h = methodArr[kTrackedMethods[i].type];
+      if (h.count() != 0)
+      {
+         obj[kTrackedMethods[i].name] = latencyToJson(h);
+      }
+   }
+   return obj;
+}
+
 // Turn a StatisticsMessage::Payload into a json::Object with one entry per
 // counter / sparse sub-object per array. Only response codes and methods
 // that have non-zero counts are included, to keep payload size bounded.
@@ -188,6 +229,7 @@ json::Object payloadToJson(const resip::StatisticsMessage::Payload& p)
    obj["activeClientTransactions"] = json::Number(p.activeClientTransactions);
    obj["activeServerTransactions"] = json::Number(p.activeServerTransactions);
    obj["pendingDnsQueries"]        = json::Number(p.pendingDnsQueries);
+   obj["zeroedOutAt"]              = json::Number((double)p.zeroedOutAt);
 
    obj["requestsSent"]             = json::Number(p.requestsSent);
    obj["responsesSent"]            = json::Number(p.responsesSent);
@@ -214,6 +256,14 @@ json::Object payloadToJson(const resip::StatisticsMessage::Payload& p)
    obj["responsesRetransmittedByMethodByCode"] = methodCodeMap(p.responsesRetransmittedByMethodByCode);
    obj["responsesReceivedByMethodByCode"]      = methodCodeMap(p.responsesReceivedByMethodByCode);
 
+   // --- Latency histograms (micro-seconds) ---
+   obj["clientTransactionLatencyByMethod"] = methodLatencyMap(p.clientTransactionLatencyByMethod);
+   obj["serverTransactionLatencyByMethod"] = methodLatencyMap(p.serverTransactionLatencyByMethod);
+   obj["transactionFifoWait"]              = latencyToJson(p.transactionFifoWait);
+   obj["tuFifoWait"]                       = latencyToJson(p.tuFifoWait);
+   obj["transportFifoWait"]                = latencyToJson(p.transportFifoWait);
+   obj["dnsLatency"]                       = latencyToJson(p.dnsLatency);
+
    return obj;
 }
 }
@@ -1095,7 +1145,7 @@ RestAdmin::handleRoutes(const Data& method,
 }
 
 // ---------------------------------------------------------------------------
-// Filters (GET only)
+// Filters (read only, plus evaluation statistics)
 // ---------------------------------------------------------------------------
 void
 RestAdmin::handleFilters(const Data& method,
@@ -1134,9 +1184,46 @@ RestAdmin::handleFilters(const Data& method,
       return;
    }
 
+   // POST /api/v1/filters/stats/reset -> zero the filter counters.
+   if (method == "POST" && path.size() == 3 && path[1] == "stats" && path[2] == "reset")
+   {
+      filterStore.resetStats();
+      sendOk(pageNumber);
+      return;
+   }
+
+   // GET /api/v1/filters/stats -> per filter evaluation and hit counts, in
+   // evaluation order, and the time spent evaluating requests overall.
+   if (method == "GET" && path.size() == 2 && path[1] == "stats")
+   {
+      sendJson(pageNumber, 200, filterStatsJson(filterStore));
+      return;
+   }
+
    sendMethodNotAllowed(pageNumber, method);
 }
 
+Data
+RestAdmin::filterStatsJson(FilterStore& filterStore)
+{
+   FilterStore::Stats stats = filterStore.getStats();
+   json::Array filters;
+   for (std::vector<FilterStore::FilterStats>::const_iterator it = stats.filters.begin();
+        it != stats.filters.end(); ++it)
+   {
+      json::Object obj;
+      obj["key"]         = json::String(it->key.c_str());
+      obj["evaluations"] = json::Number((double)it->evaluations);
+      obj["hits"]        = json::Number((double)it->hits);
+      filters.Insert(obj);
+   }
+   json::Object obj;
+   obj["requests"]         = json::Number((double)stats.requests);
+   obj["evaluationTimeUs"] = json::Number((double)stats.evaluationTimeUs);
+   obj["filters"]          = filters;
+   return successEnvelope(obj);
+}
+
 // ---------------------------------------------------------------------------
 // Settings / stack info / stack statistics / congestion
 // ---------------------------------------------------------------------------
@@ -1190,58 +1277,22 @@ RestAdmin::handleStats(const Data& method,
    }
 
    // GET /api/v1/stats -> fresh stack statistics from the StatisticsManager.
-   // This is async: pollStatistics() asks the stack to deliver a message, and
-   // we wait (with a timeout) for ReproRunner to route that message to
-   // WebAdmin::handleStatisticsMessage, which populates mStatsPayload.
    if (method == "GET" && path.size() == 1)
    {
       StatisticsMessage::Payload payload;
-      bool gotPayload = false;
-
+      switch (mWebAdmin.getStatistics(payload))
       {
-         Lock lock(mWebAdmin.mStatsMutex);
-
-         // Clear any previous payload so we wait for *this* request's poll.
-         mWebAdmin.mStatsReady = false;
-
-         if (!mWebAdmin.mProxy.getStack().pollStatistics())
-         {
+         case WebAdmin::StatisticsDisabled:
             sendError(pageNumber, 503,
                       "Statistics Manager is not enabled "
                       "(set StatisticsLogInterval in repro.config)");
             return;
-         }
-
-         // Wait up to 10 seconds for the stats message to arrive. Loop to
-         // handle spurious wakeups; exit when either mStatsReady becomes
-         // true or the deadline passes.
-         const std::chrono::steady_clock::time_point deadline =
-            std::chrono::steady_clock::now() + std::chrono::seconds(10);
-         while (!mWebAdmin.mStatsReady)
-         {
-            std::chrono::steady_clock::duration remaining =
-               deadline - std::chrono::steady_clock::now();
-            if (remaining <= std::chrono::steady_clock::duration::zero())
-            {
-               break;
-            }
-            mWebAdmin.mStatsCondition.wait_for(lock, remaining);
-         }
-
-         if (mWebAdmin.mStatsReady)
-         {
-            // Copy the payload under the lock, then serialize to JSON
-            // outside the critical section.
-            payload = mWebAdmin.mStatsPayload;
-            gotPayload = true;
-         }
-      }
-
-      if (!gotPayload)
-      {
-         sendError(pageNumber, 504,
-                   "Timed out waiting for stack statistics");
-         return;
+         case WebAdmin::StatisticsTimedOut:
+            sendError(pageNumber, 504,
+                      "Timed out waiting for stack statistics");
+            return;
+         case WebAdmin::StatisticsReady:
+            break;
       }
 
       sendJson(pageNumber, 200, successEnvelope(payloadToJson(payload)));
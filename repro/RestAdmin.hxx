@@ -13,6 +13,7 @@ class DataStream;
 
 namespace repro
 {
+class FilterStore;
 class WebAdmin;
 
 // RestAdmin provides a simple JSON/REST interface to repro, living alongside
@@ -47,6 +48,8 @@ class WebAdmin;
 //   PUT    /api/v1/routes/{key}?uri=...&destination=...&method=...&event=...&order=...
 //   DELETE /api/v1/routes/{key}
 //   GET    /api/v1/filters
+//   GET    /api/v1/filters/stats
+//   POST   /api/v1/filters/stats/reset
 //   GET    /api/v1/settings
 //   GET    /api/v1/stackinfo
 //   GET    /api/v1/stats
@@ -75,6 +78,9 @@ public:
                  int pageNumber,
                  const resip::Data& authenticatedUser);
 
+   // The body of the GET /api/v1/filters/stats response
+   static resip::Data filterStatsJson(FilterStore& filterStore);
+
 private:
    typedef std::map<resip::Data, resip::Data> ParamMap;
 
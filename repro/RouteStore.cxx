@@ -1,3 +1,5 @@
+#include <cctype>
+#include <cstring>
 
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
@@ -35,28 +37,7 @@ RouteStore::RouteStore(AbstractDb& db):
       route.routeRecord = mDb.getRoute(key);
 
       route.key = key;
-      route.preq = 0;
-      
-      if(!route.routeRecord.mMatchingPattern.empty())
-      {
-         std::regex_constants::syntax_option_type flags = DefaultFlags;
-         if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
-         {
-            flags |= std::regex_constants::nosubs;
-         }
-         try
-         {
-            route.preq = new std::regex(route.routeRecord.mMatchingPattern.c_str(), flags);
-         }
-         catch (std::regex_error& e)
-         {
-            delete route.preq;
-            ErrLog(<< "Routing rule has invalid match expression: "
-                   << route.routeRecord.mMatchingPattern
-                   << ", ex=" << e.what());
-            route.preq = 0;
-         }
-      }
+      compileRoute(route);
 
       mRouteOperators.insert( route );
 
@@ -80,10 +61,177 @@ RouteStore::RouteStore(AbstractDb& db):
       }
    }
 
+   buildIndex();
+
    // Initialize cursor to the start
    mCursor = mRouteOperators.begin();
 }
 
+void
+RouteStore::compileRoute(RouteOp& route)
+{
+   route.preq = 0;
+   route.literalOnly = getLiteralPrefix(route.routeRecord.mMatchingPattern, route.literalPrefix);
+   if(!route.routeRecord.mMatchingPattern.empty())
+   {
+      std::regex_constants::syntax_option_type flags = DefaultFlags;
+      if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
+      {
+         flags |= std::regex_constants::nosubs;
+      }
+      try
+      {
+         route.preq = new std::regex(route.routeRecord.mMatchingPattern.c_str(), flags);
+      }
+      catch (std::regex_error& e)
+      {
+         delete route.preq;
+         ErrLog(<< "Routing rule has invalid match expression: "
+                << route.routeRecord.mMatchingPattern
+                << ", ex=" << e.what());
+         route.preq = 0;
+      }
+   }
+}
+
+// Conservative: anything that is not plainly a literal ends the prefix.
+bool
+RouteStore::getLiteralPrefix(const Data& pattern, Data& prefix)
+{
+   prefix.clear();
+   if(pattern.empty() || pattern[0] != '^')
+   {
+      return false;
+   }
+
+   // With an alternation outside any group the ^ only anchors the first
+   // branch, so nothing can be said about the prefix
+   int depth = 0;
+   bool inClass = false;
+   for(Data::size_type i = 0; i < pattern.size(); i++)
+   {
+      char c = pattern[i];
+      if(c == '\\')
+      {
+         i++;
+      }
+      else if(inClass)
+      {
+         inClass = (c != ']');
+      }
+      else if(c == '[')
+      {
+         inClass = true;
+      }
+      else if(c == '(')
+      {
+         depth++;
+      }
+      else if(c == ')')
+      {
+         depth--;
+      }
+      else if(c == '|' && depth == 0)
+      {
+         return false;
+      }
+   }
+
+   Data::size_type i = 1;
+   while(i < pattern.size())
+   {
+      char literal = pattern[i];
+      Data::size_type next = i + 1;
+      if(literal == '\\')
+      {
+         // only an escaped punctuation character is a literal, \d, \w, \b,
+         // \x41 and friends are not
+         if(next == pattern.size() || isalnum((unsigned char)pattern[next]))
+         {
+            return false;
+         }
+         literal = pattern[next++];
+      }
+      else if(strchr("^$.|?*+()[]{}", literal))
+      {
+         return false;
+      }
+
+      if(next < pattern.size() && strchr("?*+{", pattern[next]))
+      {
+         // a quantifier makes the character optional, except that + still
+         // requires one of it
+         if(pattern[next] == '+')
+         {
+            prefix += literal;
+         }
+         return false;
+      }
+      prefix += literal;
+      i = next;
+   }
+   return true;
+}
+
+void
+RouteStore::buildIndex()
+{
+   mIndexedRoutes.clear();
+   mRoutesByMethod.clear();
+   mAnyMethodRoutes.clear();
+   mPrefixTrie.assign(1, PrefixNode());
+
+   for(RouteOpList::const_iterator it = mRouteOperators.begin(); it != mRouteOperators.end(); it++)
+   {
+      unsigned int pos = (unsigned int)mIndexedRoutes.size();
+      mIndexedRoutes.push_back(&(*it));
+
+      const Data& method = it->routeRecord.mMethod;
+      if(method.empty())
+      {
+         mAnyMethodRoutes.push_back(pos);
+         for(MethodIndex::iterator m = mRoutesByMethod.begin(); m != mRoutesByMethod.end(); m++)
+         {
+            m->second.push_back(pos);
+         }
+      }
+      else
+      {
+         Data lowerMethod(method);
+         lowerMethod.lowercase();
+         MethodIndex::iterator m = mRoutesByMethod.find(lowerMethod);
+         if(m == mRoutesByMethod.end())
+         {
+            // a new method also sees every any-method rule before it
+            m = mRoutesByMethod.insert(MethodIndex::value_type(lowerMethod, mAnyMethodRoutes)).first;
+         }
+         m->second.push_back(pos);
+      }
+
+      if(!it->literalPrefix.empty())
+      {
+         unsigned int node = 0;
+         for(Data::size_type i = 0; i < it->literalPrefix.size(); i++)
+         {
+            char c = it->literalPrefix[i];
+            std::map<char, unsigned int>::const_iterator child = mPrefixTrie[node].children.find(c);
+            if(child == mPrefixTrie[node].children.end())
+            {
+               unsigned int newNode = (unsigned int)mPrefixTrie.size();
+               mPrefixTrie.push_back(PrefixNode());
+               mPrefixTrie[node].children[c] = newNode;
+               node = newNode;
+            }
+            else
+            {
+               node = child->second;
+            }
+         }
+         mPrefixTrie[node].routes.push_back(pos);
+      }
+   }
+}
+
 RouteStore::~RouteStore()
 {
    for(RouteOpList::iterator i = mRouteOperators.begin(); i != mRouteOperators.end(); i++)
@@ -126,31 +274,12 @@ RouteStore::addRoute(const resip::Data& method,
    }
 
    route.key = key;
-   route.preq = 0;
-   if (!route.routeRecord.mMatchingPattern.empty())
-   {
-      std::regex_constants::syntax_option_type flags = DefaultFlags;
-      if (route.routeRecord.mRewriteExpression.find("$") == Data::npos)
-      {
-         flags |= std::regex_constants::nosubs;
-      }
-      try
-      {
-         route.preq = new std::regex(route.routeRecord.mMatchingPattern.c_str(), flags);
-      }
-      catch (std::regex_error& e)
-      {
-         delete route.preq;
-         ErrLog(<< "Routing rule has invalid match expression: "
-            << route.routeRecord.mMatchingPattern
-            << ", ex=" << e.what());
-         route.preq = 0;
-      }
-   }
+   compileRoute(route);
 
    {
       WriteLock lock(mMutex);
       mRouteOperators.insert( route );
+      buildIndex();
    }
    mCursor = mRouteOperators.begin(); 
 
@@ -212,6 +341,7 @@ RouteStore::eraseRoute(const resip::Data& key )
             it++;
          }
       }
+      buildIndex();
    }
    mCursor = mRouteOperators.begin();  // reset the cursor since it may have been on deleted route
 }
@@ -311,25 +441,44 @@ RouteStore::process(const resip::Uri& ruri,
 
    ReadLock lock(mMutex);
 
-   for (RouteOpList::iterator it = mRouteOperators.begin();
-        it != mRouteOperators.end(); it++)
+   Data lowerMethod(method);
+   lowerMethod.lowercase();
+   MethodIndex::const_iterator m = mRoutesByMethod.find(lowerMethod);
+   const std::vector<unsigned int>& candidates = (m != mRoutesByMethod.end()) ? m->second : mAnyMethodRoutes;
+
+   // Mark every rule whose literal prefix the request URI starts with.  Any
+   // number of threads can be in here under the read lock, so the scratch
+   // space is per thread rather than a member; it is only allocated again
+   // when the rule set grows.
+   static thread_local std::vector<bool> prefixMatched;
+   prefixMatched.assign(mIndexedRoutes.size(), false);
+   unsigned int node = 0;
+   for(Data::size_type i = 0; i < uri.size(); i++)
+   {
+      std::map<char, unsigned int>::const_iterator child = mPrefixTrie[node].children.find(uri[i]);
+      if(child == mPrefixTrie[node].children.end())
+      {
+         break;
+      }
+      node = child->second;
+      const std::vector<unsigned int>& routes = mPrefixTrie[node].routes;
+      for(std::vector<unsigned int>::const_iterator r = routes.begin(); r != routes.end(); r++)
+      {
+         prefixMatched[*r] = true;
+      }
+   }
+
+   for (std::vector<unsigned int>::const_iterator pos = candidates.begin();
+        pos != candidates.end(); pos++)
    {
+      const RouteOp& route = *mIndexedRoutes[*pos];
       DebugLog( << "Consider route " // << *it
                 << " reqUri=" << ruri
                 << " method=" << method 
                 << " event=" << event );
 
-      const AbstractDb::RouteRecord& rec = it->routeRecord;
+      const AbstractDb::RouteRecord& rec = route.routeRecord;
       
-      if(!rec.mMethod.empty())
-      {
-         if(!isEqualNoCase(rec.mMethod,method))
-         {
-            DebugLog( << "  Skipped - method did not match" );
-            continue;
-         }
-         
-      }
       if(!rec.mEvent.empty())
       {
          if(!isEqualNoCase(rec.mEvent, event))
@@ -340,13 +489,19 @@ RouteStore::process(const resip::Uri& ruri,
       }
       const Data& rewrite = rec.mRewriteExpression;
       const Data& match = rec.mMatchingPattern;
-      if ( it->preq ) 
+      if ( route.preq ) 
       {
+         if(!route.literalPrefix.empty() && !prefixMatched[*pos])
+         {
+            DebugLog( << "  Skipped - request URI "<< uri << " does not start with " << route.literalPrefix );
+            continue;
+         }
+
          std::cmatch matches;
 
          // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
          //        the string, this is backwards compatible with the previous regexec PCRE implementation
-         if(!std::regex_search(uri.c_str(), matches, *it->preq))
+         if(!route.literalOnly && !std::regex_search(uri.c_str(), matches, *route.preq))
          {
             // did not match 
             DebugLog( << "  Skipped - request URI "<< uri << " did not match " << match );
@@ -3,9 +3,12 @@
 
 #include <regex>
 
+#include <map>
 #include <set>
+#include <vector>
 
 #include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
 #include "rutil/RWMutex.hxx"
 #include "resip/stack/Uri.hxx"
 
@@ -53,6 +56,11 @@ class RouteStore
                       const resip::Data& method, 
                       const resip::Data& event );
 
+      /// Puts the literal text a ^ anchored pattern requires at the start of
+      /// the subject in prefix, and returns true if the pattern is nothing
+      /// but that text.  Used to index the rules.
+      static bool getLiteralPrefix(const resip::Data& pattern, resip::Data& prefix);
+
    private:
       bool findKey(const Key& key); // move cursor to key
       
@@ -69,13 +77,40 @@ class RouteStore
             Key key;
             std::regex *preq;
             AbstractDb::RouteRecord routeRecord;
+            // Literal text every matching request URI must start with, taken
+            // from a ^ anchored matching pattern; empty if there is none
+            resip::Data literalPrefix;
+            // true if the pattern is nothing but ^literalPrefix, so the
+            // prefix test alone decides the match
+            bool literalOnly;
             bool operator<(const RouteOp&) const;
       };
+
+      static void compileRoute(RouteOp& route);
       
       resip::RWMutex mMutex;
       typedef std::multiset<RouteOp> RouteOpList;
       RouteOpList mRouteOperators; 
       RouteOpList::iterator mCursor;
+
+      // Matching index used by process(), rebuilt by buildIndex() whenever
+      // mRouteOperators changes (under the write lock).  Rules are referred
+      // to by their position in mRouteOperators, so walking any of the
+      // lists below in ascending order preserves the rule order.
+      void buildIndex();
+      std::vector<const RouteOp*> mIndexedRoutes;
+      typedef HashMap<resip::Data, std::vector<unsigned int> > MethodIndex;
+      MethodIndex mRoutesByMethod;              // lower case method -> rules for that method or for any method
+      std::vector<unsigned int> mAnyMethodRoutes;  // rules with no method
+
+      // Trie over the literal prefixes; walking it along a request URI
+      // finds every rule whose prefix the URI starts with in one pass.
+      struct PrefixNode
+      {
+         std::map<char, unsigned int> children;
+         std::vector<unsigned int> routes;
+      };
+      std::vector<PrefixNode> mPrefixTrie;
 };
 
  }
@@ -8,8 +8,10 @@
 #include "rutil/ResipAssert.h"
 #include "rutil/Data.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Time.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/SqlDb.hxx"
@@ -25,6 +27,107 @@ SqlDb::SqlDb(const resip::ConfigParse& config) : mConnected(false)
 {
    mTlsPeerAuthorizationQuery = config.getConfigData("CustomTlsAuthQuery", "");
    mTableNamePrefix = config.getConfigData("TableNamePrefix", "");
+   mConnectionPoolSize = config.getConfigUnsignedLong("ConnectionPoolSize", 1);
+   if(mConnectionPoolSize == 0)
+   {
+      mConnectionPoolSize = 1;
+   }
+   mHealthCheckIntervalMs = (uint64_t)config.getConfigUnsignedLong("ConnectionHealthCheckInterval", 60) * 1000;
+
+   // Free slots are handed out last-in first-out, so that under light load
+   // the same few connections stay warm and the rest are left to idle
+   uint64_t now = ResipClock::getTimeMs();
+   for(unsigned int i = 0; i < mConnectionPoolSize; i++)
+   {
+      mFreeConnections.push_back(i);
+      mLastReleased.push_back(now);
+   }
+}
+
+SqlDb::ConnectionLease::ConnectionLease(const SqlDb& db) :
+   mDb(db),
+   mIndex(db.acquireConnection(mPinned))
+{
+}
+
+SqlDb::ConnectionLease::~ConnectionLease()
+{
+   if(!mPinned)
+   {
+      mDb.releaseConnection(mIndex);
+   }
+}
+
+unsigned int
+SqlDb::acquireConnection(bool& pinned) const
+{
+   Lock lock(mPoolMutex);
+   std::map<std::thread::id, unsigned int>::const_iterator it = mPinnedConnections.find(std::this_thread::get_id());
+   if(it != mPinnedConnections.end())
+   {
+      pinned = true;
+      return it->second;
+   }
+   pinned = false;
+   if(mFreeConnections.empty())
+   {
+      DebugLog(<< "All " << mConnectionPoolSize << " database connections are busy, waiting");
+      mPoolCondition.wait(lock, [this]{ return !mFreeConnections.empty(); });
+   }
+   unsigned int index = mFreeConnections.back();
+   mFreeConnections.pop_back();
+   return index;
+}
+
+void
+SqlDb::releaseConnection(unsigned int index) const
+{
+   {
+      Lock lock(mPoolMutex); (void)lock;
+      mLastReleased[index] = ResipClock::getTimeMs();
+      mFreeConnections.push_back(index);
+   }
+   mPoolCondition.notify_one();
+}
+
+bool
+SqlDb::needsHealthCheck(unsigned int index) const
+{
+   if(mHealthCheckIntervalMs == 0)
+   {
+      return false;
+   }
+   Lock lock(mPoolMutex); (void)lock;
+   return ResipClock::getTimeMs() - mLastReleased[index] >= mHealthCheckIntervalMs;
+}
+
+void
+SqlDb::pinConnection()
+{
+   bool pinned;
+   unsigned int index = acquireConnection(pinned);
+   if(!pinned)
+   {
+      Lock lock(mPoolMutex); (void)lock;
+      mPinnedConnections[std::this_thread::get_id()] = index;
+   }
+}
+
+void
+SqlDb::unpinConnection()
+{
+   unsigned int index;
+   {
+      Lock lock(mPoolMutex); (void)lock;
+      std::map<std::thread::id, unsigned int>::iterator it = mPinnedConnections.find(std::this_thread::get_id());
+      if(it == mPinnedConnections.end())
+      {
+         return;
+      }
+      index = it->second;
+      mPinnedConnections.erase(it);
+   }
+   releaseConnection(index);
 }
 
 void 
@@ -138,14 +241,18 @@ bool
 SqlDb::dbCommitTransaction(const Table table)
 {
    Data command("COMMIT");
-   return query(command) == 0;
+   bool ret = query(command) == 0;
+   unpinConnection();
+   return ret;
 }
 
 bool 
 SqlDb::dbRollbackTransaction(const Table table)
 {
    Data command("ROLLBACK");
-   return query(command) == 0;
+   bool ret = query(command) == 0;
+   unpinConnection();
+   return ret;
 }
 
 static const char userTable[] = "users";
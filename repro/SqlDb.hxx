@@ -1,8 +1,14 @@
 #if !defined(RESIP_SQLDB_HXX)
 #define RESIP_SQLDB_HXX 
 
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "rutil/Condition.hxx"
 #include "rutil/ConfigParse.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -34,10 +40,37 @@ class SqlDb: public AbstractDb
 
       void setToData(const std::set<resip::Data>& items, resip::Data& result, const resip::Data& sep = ",", const char quote = '\'') const;
 
-      // when multiple threads are in use with the same connection, you need to
-      // mutex calls to mysql_query and mysql_store_result:
+      // Connection pool.  Derived classes keep one native connection handle
+      // per slot, 0 .. connectionPoolSize()-1, and only touch a slot while
+      // holding a ConnectionLease on it.  A client library connection must
+      // never be used by two threads at once:
       // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html
-      mutable resip::Mutex mMutex;
+      // so a lease blocks until a slot is free.  A thread that has begun a
+      // transaction keeps its slot until the commit or rollback, and all of
+      // its leases in between get that same slot.
+      class ConnectionLease
+      {
+         public:
+            ConnectionLease(const SqlDb& db);
+            ~ConnectionLease();
+            unsigned int index() const { return mIndex; }
+
+         private:
+            const SqlDb& mDb;
+            unsigned int mIndex;
+            bool mPinned;
+      };
+
+      unsigned int connectionPoolSize() const { return mConnectionPoolSize; }
+
+      // true if the leased slot has been idle for longer than the configured
+      // ConnectionHealthCheckInterval, and should be checked before use
+      bool needsHealthCheck(unsigned int index) const;
+
+      // dbBeginTransaction() pins a slot to the calling thread;
+      // dbCommitTransaction()/dbRollbackTransaction() unpin it
+      void pinConnection();
+      void unpinConnection();
 
       resip::Data tableName( Table table ) const;
 
@@ -50,6 +83,9 @@ class SqlDb: public AbstractDb
       virtual bool dbCommitTransaction(const Table table);
       virtual bool dbRollbackTransaction(const Table table);
 
+      unsigned int acquireConnection(bool& pinned) const;
+      void releaseConnection(unsigned int index) const;
+
       virtual int query(const resip::Data& queryCommand) const = 0;
       virtual resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const = 0;
 
@@ -57,6 +93,14 @@ class SqlDb: public AbstractDb
       resip::Data mTlsPeerAuthorizationQuery;
       resip::Data mTableNamePrefix;
 
+      unsigned int mConnectionPoolSize;
+      uint64_t mHealthCheckIntervalMs;
+      mutable resip::Mutex mPoolMutex;
+      mutable resip::Condition mPoolCondition;
+      mutable std::vector<unsigned int> mFreeConnections;
+      mutable std::vector<uint64_t> mLastReleased;
+      std::map<std::thread::id, unsigned int> mPinnedConnections;
+
       virtual void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
       virtual void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
 };
@@ -8,6 +8,8 @@
 #include "resip/stack/Symbols.hxx"
 #include "resip/stack/Helper.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/dum/UserAuthInfo.hxx"
 
@@ -24,7 +26,12 @@ using namespace std;
 
 const resip::Data UserStore::SEPARATOR("@");
 
-UserStore::UserStore(AbstractDb& db ) : mDb(db)
+UserStore::UserStore(AbstractDb& db ) : 
+   mDb(db),
+   mAuthCacheMaxEntries(0),
+   mAuthCacheTtlMs(0),
+   mAuthCacheNegativeTtlMs(0),
+   mAuthCacheGeneration(0)
 { 
 }
 
@@ -43,7 +50,130 @@ UserStore::getUserAuthInfo(  const resip::Data& user,
                              const resip::Data& realm ) const
 {
    Key key =  buildKey(user, realm);
-   return mDb.getUserAuthInfo( key );
+   uint64_t generation;
+
+   {
+      Lock lock(mAuthCacheMutex);
+      if (mAuthCacheMaxEntries == 0)
+      {
+         lock.unlock();
+         return mDb.getUserAuthInfo( key );
+      }
+
+      AuthCacheMap::iterator it = mAuthCacheMap.find(key);
+      if (it != mAuthCacheMap.end())
+      {
+         if (it->second->expires > Timer::getTimeMs())
+         {
+            mAuthCacheList.splice(mAuthCacheList.begin(), mAuthCacheList, it->second);
+            if (it->second->a1.empty())
+            {
+               mAuthCacheStats.negativeHits++;
+            }
+            else
+            {
+               mAuthCacheStats.hits++;
+            }
+            return it->second->a1;
+         }
+         mAuthCacheList.erase(it->second);
+         mAuthCacheMap.erase(it);
+      }
+      mAuthCacheStats.misses++;
+      generation = mAuthCacheGeneration;
+   }
+
+   // Not holding the lock for the lookup; two threads missing on the same
+   // key both go to the database, which is harmless.
+   Data a1 = mDb.getUserAuthInfo( key );
+
+   Lock lock(mAuthCacheMutex);
+   unsigned int ttl = a1.empty() ? mAuthCacheNegativeTtlMs : mAuthCacheTtlMs;
+   // An invalidation while we were reading may mean a1 is already stale;
+   // return it, but leave the next lookup to go back to the database
+   if (mAuthCacheMaxEntries == 0 || ttl == 0 || generation != mAuthCacheGeneration)
+   {
+      return a1;
+   }
+   AuthCacheMap::iterator it = mAuthCacheMap.find(key);
+   if (it != mAuthCacheMap.end())
+   {
+      mAuthCacheList.erase(it->second);
+      mAuthCacheMap.erase(it);
+   }
+   while (mAuthCacheList.size() >= mAuthCacheMaxEntries)
+   {
+      mAuthCacheMap.erase(mAuthCacheList.back().key);
+      mAuthCacheList.pop_back();
+      mAuthCacheStats.evictions++;
+   }
+   AuthCacheEntry entry;
+   entry.key = key;
+   entry.a1 = a1;
+   entry.expires = Timer::getTimeMs() + ttl;
+   mAuthCacheList.push_front(entry);
+   mAuthCacheMap[key] = mAuthCacheList.begin();
+   return a1;
+}
+
+void
+UserStore::setAuthCache(unsigned int maxEntries, unsigned int ttlSecs, unsigned int negativeTtlSecs)
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheGeneration++;
+   mAuthCacheMaxEntries = ttlSecs || negativeTtlSecs ? maxEntries : 0;
+   mAuthCacheTtlMs = ttlSecs * 1000;
+   mAuthCacheNegativeTtlMs = negativeTtlSecs * 1000;
+   while (mAuthCacheList.size() > mAuthCacheMaxEntries)
+   {
+      mAuthCacheMap.erase(mAuthCacheList.back().key);
+      mAuthCacheList.pop_back();
+   }
+}
+
+void
+UserStore::clearAuthCache()
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheGeneration++;
+   mAuthCacheList.clear();
+   mAuthCacheMap.clear();
+}
+
+UserStore::AuthCacheStats
+UserStore::getAuthCacheStats() const
+{
+   Lock lock(mAuthCacheMutex);
+   AuthCacheStats stats(mAuthCacheStats);
+   stats.size = mAuthCacheList.size();
+   stats.maxSize = mAuthCacheMaxEntries;
+   return stats;
+}
+
+bool
+UserStore::authCacheEnabled() const
+{
+   Lock lock(mAuthCacheMutex);
+   return mAuthCacheMaxEntries != 0;
+}
+
+void
+UserStore::invalidateAuthCache(const Data& user, const Data& realm)
+{
+   invalidateAuthCache(buildKey(user, realm));
+}
+
+void
+UserStore::invalidateAuthCache(const Key& key)
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheGeneration++;
+   AuthCacheMap::iterator it = mAuthCacheMap.find(key);
+   if (it != mAuthCacheMap.end())
+   {
+      mAuthCacheList.erase(it->second);
+      mAuthCacheMap.erase(it);
+   }
 }
 
 bool 
@@ -79,13 +209,28 @@ UserStore::addUser( const Data& username,
    rec.email = emailAddress;
    rec.forwardAddress = Data::Empty;
 
-   return mDb.addUser( buildKey(username,domain), rec);
+   bool ret = mDb.addUser( buildKey(username,domain), rec);
+   // also drops a cached "no such user"
+   invalidateAuthCache(username, realm);
+   return ret;
 }
 
 void 
 UserStore::eraseUser( const Key& key )
 { 
+   if (!authCacheEnabled())
+   {
+      mDb.eraseUser( key );
+      return;
+   }
+   // Auth lookups are keyed on user and realm, so find the realm first
+   AbstractDb::UserRecord rec = mDb.getUser( key );
    mDb.eraseUser( key );
+   invalidateAuthCache(key);
+   if (!rec.user.empty())
+   {
+      invalidateAuthCache(rec.user, rec.realm);
+   }
 }
 
 bool
@@ -101,6 +246,16 @@ UserStore::updateUser( const Key& originalKey,
 {
    Key newkey = buildKey(user, domain);
    
+   if ( newkey == originalKey && authCacheEnabled() )
+   {
+      // the realm may have changed; drop what is cached for the old one
+      AbstractDb::UserRecord old = mDb.getUser( originalKey );
+      if (!old.user.empty())
+      {
+         invalidateAuthCache(old.user, old.realm);
+      }
+   }
+
    bool ret = addUser(user, domain, realm, password, applyA1HashToPassword, fullName, emailAddress, passwordHashAlt);
    if ( newkey != originalKey )
    {
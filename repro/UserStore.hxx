@@ -1,8 +1,12 @@
 #if !defined(REPRO_USERSTORE_HXX)
 #define REPRO_USERSTORE_HXX
 
+#include <list>
+
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Message.hxx"
 
 #include "repro/AbstractDb.hxx"
@@ -58,10 +62,58 @@ class UserStore
       static Key buildKey(const resip::Data& user, const resip::Data& domain);
       static void getUserAndDomainFromKey(const AbstractDb::Key& key, resip::Data& user, resip::Data& domain);
 
+      /** Cache the results of getUserAuthInfo, so that digest challenges
+          do not each cost a database round trip.  Results are kept for
+          ttlSecs, and "no such user" results for negativeTtlSecs (0 means
+          they are not cached).  At most maxEntries are kept; the least
+          recently used entry is evicted first.  maxEntries 0 disables the
+          cache (the default).  Changes made through this class invalidate
+          the affected entries; changes made directly in the database are
+          only seen once the entry expires. */
+      void setAuthCache(unsigned int maxEntries, unsigned int ttlSecs, unsigned int negativeTtlSecs);
+      void clearAuthCache();
+
+      class AuthCacheStats
+      {
+         public:
+            AuthCacheStats() : hits(0), negativeHits(0), misses(0), evictions(0), size(0), maxSize(0) {}
+            uint64_t hits;
+            uint64_t negativeHits;  ///< hits on a cached "no such user"
+            uint64_t misses;
+            uint64_t evictions;
+            size_t size;
+            size_t maxSize;
+      };
+      AuthCacheStats getAuthCacheStats() const;
+
    private:
+      bool authCacheEnabled() const;
+      void invalidateAuthCache(const resip::Data& user, const resip::Data& realm);
+      void invalidateAuthCache(const Key& key);
 
       AbstractDb& mDb;
       static const resip::Data SEPARATOR;
+
+      class AuthCacheEntry
+      {
+         public:
+            Key key;
+            resip::Data a1;
+            uint64_t expires;
+      };
+      typedef std::list<AuthCacheEntry> AuthCacheList;  // most recently used first
+      typedef HashMap<Key, AuthCacheList::iterator> AuthCacheMap;
+
+      mutable resip::Mutex mAuthCacheMutex;
+      mutable AuthCacheList mAuthCacheList;
+      mutable AuthCacheMap mAuthCacheMap;
+      unsigned int mAuthCacheMaxEntries;
+      unsigned int mAuthCacheTtlMs;
+      unsigned int mAuthCacheNegativeTtlMs;
+      mutable AuthCacheStats mAuthCacheStats;
+      // Bumped by every invalidation, so that a lookup that raced with one
+      // does not cache what it read
+      uint64_t mAuthCacheGeneration;
 };
 
  }
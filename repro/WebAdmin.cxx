@@ -1,4 +1,5 @@
 #include "rutil/ResipAssert.h"
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -19,7 +20,10 @@
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/OpenMetrics.hxx"
 #include "rutil/DigestStream.hxx"
+#include "rutil/CongestionManager.hxx"
+#include "rutil/dns/DnsStub.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/Timer.hxx"
@@ -169,7 +173,8 @@ WebAdmin::WebAdmin(Proxy& proxy,
 #include "repro/webadmin/pageOutlinePost.ixx"
    ),
    mUserFile(proxy.getConfig().getConfigData("HttpAdminUserFile", "users.txt")),
-   mStatsReady(false)
+   mStatsReady(false),
+   mStatsPublishedAt(0)
 {
    // Place repro version into PageOutlinePre
    mPageOutlinePre.replace("VERSION", VersionUtils::instance().releaseVersion().c_str());
@@ -316,9 +321,12 @@ WebAdmin::buildPage( const Data& method,
    // Authentication still happens below; the REST handler is invoked only
    // after the user has been authenticated (or challenges disabled).
    bool isRestRequest = uri.prefix("/api/v1");
+   // /metrics is for Prometheus style scrapers, and is authenticated the
+   // same way
+   bool isMetricsRequest = ( pageName == Data("metrics") );
 
    // if this is not a valid page, redirect it
-   if ( !isRestRequest &&
+   if ( !isRestRequest && !isMetricsRequest &&
       ( pageName != Data("index.html") ) && 
       ( pageName != Data("input") ) && 
       ( pageName != Data("cert.cer") ) && 
@@ -466,6 +474,12 @@ WebAdmin::buildPage( const Data& method,
       mRestAdmin->dispatch(method, uri, pageNumber, authenticatedUser);
       return;
    }
+
+   if ( isMetricsRequest )
+   {
+      buildMetricsPage(method, pageNumber);
+      return;
+   }
       
    // parse any URI tags from form entry
    mRemoveSet.clear();
@@ -2422,18 +2436,253 @@ void
 WebAdmin::handleStatisticsMessage(StatisticsMessage& statsMessage)
 {
    // Called on the stack thread when a StatisticsMessage is delivered.
-   // Copy the payload struct under the lock and wake any RestAdmin::handleStats
-   // caller that is blocked waiting for fresh data. Serialization to JSON is
-   // deferred to the REST handler so that the stack thread isn't doing any
-   // more work here than necessary.
+   // Copy the payload struct under the lock and wake any getStatistics
+   // caller that is blocked waiting for fresh data. Serialization to JSON or
+   // OpenMetrics is deferred to the caller so that the stack thread isn't
+   // doing any more work here than necessary.
    {
       Lock lock(mStatsMutex); (void)lock;
       statsMessage.loadOut(mStatsPayload);
       mStatsReady = true;
+      mStatsPublishedAt = time(0);
    }
    mStatsCondition.notify_all();
 }
 
+WebAdmin::StatisticsResult
+WebAdmin::getStatistics(StatisticsMessage::Payload& payload)
+{
+   // This is async: pollStatistics() asks the stack to deliver a message, and
+   // we wait (with a timeout) for ReproRunner to route that message to
+   // handleStatisticsMessage, which populates mStatsPayload.
+   Lock lock(mStatsMutex);
+
+   // Clear any previous payload so we wait for *this* request's poll.
+   mStatsReady = false;
+
+   if (!mProxy.getStack().pollStatistics())
+   {
+      return StatisticsDisabled;
+   }
+
+   // Wait up to 10 seconds for the stats message to arrive. Loop to
+   // handle spurious wakeups; exit when either mStatsReady becomes
+   // true or the deadline passes.
+   const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+   while (!mStatsReady)
+   {
+      std::chrono::steady_clock::duration remaining =
+         deadline - std::chrono::steady_clock::now();
+      if (remaining <= std::chrono::steady_clock::duration::zero())
+      {
+         return StatisticsTimedOut;
+      }
+      mStatsCondition.wait_for(lock, remaining);
+   }
+
+   // Copy the payload under the lock; callers serialize it outside the
+   // critical section.
+   payload = mStatsPayload;
+   return StatisticsReady;
+}
+
+static void
+addMethodCounters(OpenMetricsWriter& writer, const unsigned int* byMethod, uint64_t created)
+{
+   for (int m = 0; m < MAX_METHODS; ++m)
+   {
+      if (byMethod[m])
+      {
+         writer.counter(byMethod[m], OpenMetricsWriter::Labels("method", getMethodName((MethodTypes)m)), created);
+      }
+   }
+}
+
+static void
+addMethodCodeCounters(OpenMetricsWriter& writer,
+                      const unsigned int (*byMethodByCode)[StatisticsMessage::Payload::MaxCode],
+                      uint64_t created)
+{
+   for (int m = 0; m < MAX_METHODS; ++m)
+   {
+      for (int code = 0; code < StatisticsMessage::Payload::MaxCode; ++code)
+      {
+         if (byMethodByCode[m][code])
+         {
+            writer.counter(byMethodByCode[m][code],
+                           OpenMetricsWriter::Labels("method", getMethodName((MethodTypes)m)).add("code", Data(code)),
+                           created);
+         }
+      }
+   }
+}
+
+static double
+toSeconds(uint64_t value, double perSecond)
+{
+   return (double)value / perSecond;
+}
+
+void
+WebAdmin::buildMetricsPage(const Data& method, int pageNumber)
+{
+   if (method != "GET")
+   {
+      setPage(resip::Data::Empty, pageNumber, 405);
+      return;
+   }
+
+   // Everything is copied out of the stack first (the statistics payload
+   // under mStatsMutex, the congestion state under the congestion manager's
+   // lock, the DNS statistics from atomics), and rendered afterwards.
+   //
+   // The statistics are those the stack last published, every
+   // StatisticsLogInterval seconds.  Asking for fresh ones, as getStatistics
+   // does, would make the stack log them on every scrape, and hold the
+   // scrape up while the stack is busy.
+   StatisticsMessage::Payload stats;
+   time_t statsPublishedAt;
+   {
+      Lock lock(mStatsMutex); (void)lock;
+      statsPublishedAt = mStatsPublishedAt;
+      if (statsPublishedAt)
+      {
+         stats = mStatsPayload;
+      }
+   }
+   std::vector<CongestionManager::FifoState> fifos;
+   CongestionManager* congestionManager = mProxy.getStack().getCongestionManager();
+   if (congestionManager)
+   {
+      congestionManager->getCurrentState(fifos);
+   }
+   DnsStub::Statistics dns = mProxy.getStack().getDnsStub().getStatistics();
+
+   Data page;
+   {
+      DataStream s(page);
+      OpenMetricsWriter writer(s);
+      typedef OpenMetricsWriter::Labels Labels;
+
+      if (statsPublishedAt)
+      {
+         // The counters count up from when the statistics were last zeroed
+         // out (stack start, or a reset through the command server or the
+         // REST API), which is their created time.
+         const uint64_t created = stats.zeroedOutAt;
+
+         // so that a stack that has stopped publishing shows up as stale
+         writer.family("repro_statistics_published_timestamp_seconds", OpenMetricsWriter::Gauge,
+                       "When the statistics below were published by the stack, in seconds since the epoch", "seconds");
+         writer.gauge((double)statsPublishedAt);
+
+         writer.family("repro_sip_requests_received", OpenMetricsWriter::Counter, "SIP requests received, by method");
+         addMethodCounters(writer, stats.requestsReceivedByMethod, created);
+         writer.family("repro_sip_requests_sent", OpenMetricsWriter::Counter, "SIP requests sent, by method, including retransmissions");
+         addMethodCounters(writer, stats.requestsSentByMethod, created);
+         writer.family("repro_sip_requests_retransmitted", OpenMetricsWriter::Counter, "SIP request retransmissions, by method");
+         addMethodCounters(writer, stats.requestsRetransmittedByMethod, created);
+         writer.family("repro_sip_responses_received", OpenMetricsWriter::Counter, "SIP responses received, by method and status code");
+         addMethodCodeCounters(writer, stats.responsesReceivedByMethodByCode, created);
+         writer.family("repro_sip_responses_sent", OpenMetricsWriter::Counter, "SIP responses sent, by method and status code, including retransmissions");
+         addMethodCodeCounters(writer, stats.responsesSentByMethodByCode, created);
+         writer.family("repro_sip_responses_retransmitted", OpenMetricsWriter::Counter, "SIP response retransmissions, by method and status code");
+         addMethodCodeCounters(writer, stats.responsesRetransmittedByMethodByCode, created);
+
+         writer.family("repro_sip_transaction_duration_seconds", OpenMetricsWriter::Histogram,
+                       "Time from a request to its first final response, by method; client transactions until the response reaches the TU, server transactions until it is sent",
+                       "seconds");
+         for (int m = 0; m < MAX_METHODS; ++m)
+         {
+            if (stats.clientTransactionLatencyByMethod[m].count())
+            {
+               writer.histogram(stats.clientTransactionLatencyByMethod[m],
+                                Labels("role", "client").add("method", getMethodName((MethodTypes)m)), created);
+            }
+            if (stats.serverTransactionLatencyByMethod[m].count())
+            {
+               writer.histogram(stats.serverTransactionLatencyByMethod[m],
+                                Labels("role", "server").add("method", getMethodName((MethodTypes)m)), created);
+            }
+         }
+         writer.family("repro_fifo_wait_seconds", OpenMetricsWriter::Histogram,
+                       "Sampled time messages spend waiting in the stack's fifos", "seconds");
+         writer.histogram(stats.transactionFifoWait, Labels("fifo", "transaction"), created);
+         writer.histogram(stats.tuFifoWait, Labels("fifo", "tu"), created);
+         writer.histogram(stats.transportFifoWait, Labels("fifo", "transport"), created);
+         writer.family("repro_dns_resolution_seconds", OpenMetricsWriter::Histogram,
+                       "Time from a client transaction starting DNS resolution to its first result", "seconds");
+         writer.histogram(stats.dnsLatency, Labels(), created);
+
+         writer.family("repro_fifo_messages", OpenMetricsWriter::Gauge, "Messages waiting in the stack's fifos");
+         writer.gauge(stats.transactionFifoSize, Labels("fifo", "transaction"));
+         writer.gauge(stats.tuFifoSize, Labels("fifo", "tu"));
+         writer.gauge(stats.transportFifoSizeSum, Labels("fifo", "transport"));
+         writer.family("repro_sip_transactions", OpenMetricsWriter::Gauge, "Active SIP transactions");
+         writer.gauge(stats.activeClientTransactions, Labels("role", "client"));
+         writer.gauge(stats.activeServerTransactions, Labels("role", "server"));
+         writer.family("repro_timers", OpenMetricsWriter::Gauge, "Active transaction timers");
+         writer.gauge(stats.activeTimers);
+         writer.family("repro_connections", OpenMetricsWriter::Gauge, "Open connections on all stream (TCP, TLS and WebSocket) transports");
+         writer.gauge(stats.openTcpConnections);
+      }
+
+      if (!fifos.empty())
+      {
+         writer.family("repro_congestion_fifo_messages", OpenMetricsWriter::Gauge, "Messages waiting in each fifo monitored by the congestion manager");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge((double)i->size, Labels("fifo", i->description));
+         }
+         writer.family("repro_congestion_fifo_time_depth_seconds", OpenMetricsWriter::Gauge, "Age of the oldest message in each monitored fifo", "seconds");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge((double)i->timeDepthSecs, Labels("fifo", i->description));
+         }
+         writer.family("repro_congestion_fifo_expected_wait_seconds", OpenMetricsWriter::Gauge, "Expected wait for a new message in each monitored fifo", "seconds");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge(toSeconds(i->expectedWaitMilliSec, 1000.0), Labels("fifo", i->description));
+         }
+         writer.family("repro_congestion_fifo_service_time_seconds", OpenMetricsWriter::Gauge, "Average time to service a message from each monitored fifo", "seconds");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge(toSeconds(i->averageServiceTimeMicroSec, 1000000.0), Labels("fifo", i->description));
+         }
+         writer.family("repro_congestion_percent", OpenMetricsWriter::Gauge, "Percent of its maximum tolerance each monitored fifo is at");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge(i->congestionPercent, Labels("fifo", i->description));
+         }
+         writer.family("repro_congestion_rejection_behavior", OpenMetricsWriter::Gauge,
+                       "Rejection behavior of each monitored fifo: 0 normal, 1 rejecting new work, 2 rejecting non-essential work");
+         for (std::vector<CongestionManager::FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+         {
+            writer.gauge(i->behavior, Labels("fifo", i->description));
+         }
+      }
+
+      // these count from stack start, and are not reset with the statistics
+      writer.family("repro_dns_cache_hits", OpenMetricsWriter::Counter, "DNS queries answered from the cache");
+      writer.counter(dns.cacheHits);
+      writer.family("repro_dns_cache_misses", OpenMetricsWriter::Counter, "DNS queries that had to be sent to a server");
+      writer.counter(dns.cacheMisses);
+      writer.family("repro_dns_coalesced_queries", OpenMetricsWriter::Counter, "DNS queries that joined an identical query already in flight");
+      writer.counter(dns.coalescedQueries);
+      writer.family("repro_dns_prefetches", OpenMetricsWriter::Counter, "DNS cache entries refreshed ahead of expiry");
+      writer.counter(dns.prefetches);
+      writer.family("repro_dns_cache_entries", OpenMetricsWriter::Gauge, "Record sets in the DNS cache");
+      writer.gauge((double)dns.cacheEntries);
+      writer.family("repro_dns_lookups", OpenMetricsWriter::Gauge, "DNS queries awaiting an answer");
+      writer.gauge((double)dns.outstandingLookups);
+
+      writer.finish();
+   }
+
+   setPage(page, pageNumber, 200, Mime("application", "openmetrics-text"));
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
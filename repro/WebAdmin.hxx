@@ -67,6 +67,16 @@ class WebAdmin : public HttpBase,
       // statusCode is the HTTP status (e.g. 200, 400, 404, 500).
       void setApiResponse(int pageNumber, int statusCode, const resip::Data& jsonBody);
 
+      // Asks the stack for fresh statistics and waits (up to 10 seconds) for
+      // handleStatisticsMessage to deliver them into payload.
+      enum StatisticsResult
+      {
+         StatisticsReady,
+         StatisticsDisabled, // no StatisticsManager (StatisticsLogInterval)
+         StatisticsTimedOut
+      };
+      StatisticsResult getStatistics(resip::StatisticsMessage::Payload& payload);
+
    protected:
       friend class CommandServer;
       virtual void buildPage( const resip::Data& method,
@@ -105,6 +115,9 @@ class WebAdmin : public HttpBase,
       void buildReloadCertsSubPage(resip::DataStream& s);
 
       resip::Data buildCertPage(const resip::Data& domain);
+      // /metrics: the stack statistics last published, congestion state and
+      // DNS cache statistics in the OpenMetrics text format
+      void buildMetricsPage(const resip::Data& method, int pageNumber);
 
       Proxy& mProxy;
       Store& mStore;
@@ -117,10 +130,13 @@ class WebAdmin : public HttpBase,
 
       // Statistics manager results delivered asynchronously via
       // handleStatisticsMessage. mStatsReady is set to true by that handler
-      // once mStatsPayload is filled in; RestAdmin::handleStats waits on the
-      // condition with a timeout.
+      // once mStatsPayload is filled in; getStatistics waits on the
+      // condition with a timeout.  mStatsPublishedAt is when the last
+      // payload arrived, 0 before the first; /metrics renders that payload
+      // as it is rather than asking for a fresh one.
       resip::StatisticsMessage::Payload mStatsPayload;
       bool mStatsReady;
+      time_t mStatsPublishedAt;
       resip::Mutex mStatsMutex;
       resip::Condition mStatsCondition;
       
@@ -242,8 +242,10 @@ XmlRpcServerBase::process(FdSet& fdset)
       bool ok = it->second->process(fdset);
       if (!ok)
       {
+         unsigned int connectionId = it->first;
          delete it->second;
          mConnections.erase(it++);
+         mHandler.onConnectionClosed(connectionId);
       }
       else
       {
@@ -309,6 +311,12 @@ XmlRpcServerBase::sendEvent(unsigned int connectionId,
    mSelectInterruptor.interrupt();
 }
 
+void
+XmlRpcServerBase::wakeup()
+{
+   mSelectInterruptor.interrupt();
+}
+
 bool
 XmlRpcServerBase::isSane()
 {
@@ -321,7 +329,7 @@ XmlRpcSocketServer::closeOldestConnection()
    if(mConnections.empty()) return;
 
    // Oldest Connection is the one with the lowest Id
-   ConnectionMap::iterator lowestConnectionIdIt = mConnections.end();
+   ConnectionMap::iterator lowestConnectionIdIt = mConnections.begin();
    ConnectionMap::iterator it = mConnections.begin();
    for(; it != mConnections.end(); it++)
    {
@@ -330,8 +338,10 @@ XmlRpcSocketServer::closeOldestConnection()
          lowestConnectionIdIt = it;
       }
    }
+   unsigned int connectionId = lowestConnectionIdIt->first;
    delete lowestConnectionIdIt->second;
    mConnections.erase(lowestConnectionIdIt);
+   mHandler.onConnectionClosed(connectionId);
 }
 
 void
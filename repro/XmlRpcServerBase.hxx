@@ -60,6 +60,8 @@ public:
    virtual void handleRequest(unsigned int connectionId,
                               unsigned int requestId,
                               const resip::Data& request) = 0;
+   // called from the server's thread once a connection has gone away
+   virtual void onConnectionClosed(unsigned int connectionId) {}
    virtual void buildFdSet(resip::FdSet& fdset);
    void process(resip::FdSet& fdset);
    bool isSane();
@@ -94,6 +96,9 @@ public:
    virtual void sendEvent(unsigned int connectionId,
                   const resip::Data& eventData);
 
+   // thread safe - makes the thread calling process() return from select
+   void wakeup();
+
    virtual void handleRequest(unsigned int connectionId,
                               unsigned int requestId,
                               const resip::Data& request) { mHandler.handleRequest(connectionId, requestId, request); };
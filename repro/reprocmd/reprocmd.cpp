@@ -43,6 +43,8 @@ main(int argc, char** argv)
       cerr << "  /ClearDnsCache - empties the stacks DNS cache" << endl;
       cerr << "  /GetDnsCache - retrieves the DNS cache contents" << endl;
       cerr << "  /GetCongestionStats - retrieves the stacks congestion manager stats and state" << endl;
+      cerr << "  /GetAuthCacheStats - retrieves the user credential cache hit/miss counters" << endl;
+      cerr << "  /ClearAuthCache - empties the user credential cache" << endl;
       cerr << "  /SetCongestionTolerance metric=<SIZE|WAIT_TIME|TIME_DEPTH> maxTolerance=<value>" << endl;
       cerr << "                          [fifoDescription=<desc>] - sets congestion tolerances" << endl;
       cerr << "  /Shutdown - signal the proxy to shut down." << endl;
@@ -0,0 +1,316 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+
+#include "cajun/json/reader.h"
+#include "repro/FilterStore.hxx"
+#include "repro/RestAdmin.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Logger.hxx"
+
+#include "MemoryDb.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+namespace
+{
+
+const short RejectAction = FilterStore::Reject;
+
+// A regular expression, the literal requiredLiteral() should find in it, and
+// values it does and does not match.  The matching values must contain the
+// literal, or the prefilter would wrongly skip them.
+const struct
+{
+   const char* regex;
+   const char* literal;
+   const char* matches[3];
+   const char* misses[3];
+} literalCases[] =
+{
+   { "abc", "abc", { "xabcx" }, { "ab", "acb" } },
+   { "example\\.com", "example.com", { "sip:a@example.com" }, { "sip:a@exampleXcom" } },
+   { "sip:\\+1", "sip:+1", { "sip:+1555" }, { "sip:1555" } },
+   { "f\\(x\\)", "f(x)", { "f(x)" }, { "fx" } },
+   { "^sip:.*@example\\.com$", "@example.com", { "sip:bob@example.com" }, { "sip:bob@example.comx" } },
+   // alternation
+   { "foo|bar", "", { "foo", "bar" }, { "baz" } },
+   { "abc|", "", { "abc", "x" } },
+   { "(foo|bar)baz", "baz", { "foobaz", "barbaz" }, { "quxbaz" } },
+   { "(a(b)c)+xyz", "xyz", { "abcxyz", "abcabcxyz" }, { "acxyz" } },
+   { "(?:ab)cd", "cd", { "abcd" }, { "cd" } },
+   { "a(?=bc)", "a", { "abc" }, { "ab" } },
+   // classes
+   { "[abc]def", "def", { "adef", "cdef" }, { "ddef" } },
+   { "[\\]x]yz", "yz", { "]yz", "xyz" }, { "ayz" } },
+   { "[^|(]+ab", "ab", { "xab" }, { "(ab" } },
+   { "a.b", "a", { "axb" }, { "ab" } },
+   // quantifiers
+   { "ab?cd", "cd", { "acd", "abcd" }, { "abd" } },
+   { "abc*de", "ab", { "abde", "abcccde" }, { "abcd" } },
+   { "ab+c", "a", { "abc", "abbbc" }, { "ac" } },
+   { "x{0,3}yz", "yz", { "yz", "xxxyz" }, { "xyy" } },
+   { "ab{2}c", "a", { "abbc" }, { "abc" } },
+   // escapes
+   { "\\d+abc", "abc", { "1abc", "123abc" }, { "abc" } },
+   { "ab\\sc", "ab", { "ab c" }, { "abc" } },
+   { "\\bword\\b", "word", { "a word here" }, { "swordfish" } },
+   { "\\x41bc", "bc", { "Abc" }, { "abc" } },
+   { "\\u0041bcd", "bcd", { "Abcd" }, { "abcd" } },
+   { "\\tab", "ab", { "\tab" }, { "ab" } },
+   { "(ab)\\1c", "c", { "ababc" }, { "abc" } },
+   // inline flags give up; std::regex does not support them, RE2 does
+   { "(?i)abc", "", { }, { } },
+   { "x(?i)abc", "", { }, { } },
+   { "", "", { }, { } },
+};
+
+bool
+filterMatches(FilterStore& store, const Data& value)
+{
+   short action = -1;
+   Data actionData;
+   return store.test(value, Data::Empty, action, actionData);
+}
+
+void
+testRequiredLiteral()
+{
+   for (size_t i = 0; i < sizeof(literalCases) / sizeof(literalCases[0]); i++)
+   {
+      const Data regex(literalCases[i].regex);
+      Data literal = FilterStore::requiredLiteral(regex);
+      if (literal != literalCases[i].literal)
+      {
+         cerr << "requiredLiteral(" << regex << ") gave " << literal << endl;
+         assert(false);
+      }
+      if (!literalCases[i].matches[0])
+      {
+         continue;
+      }
+
+      // The prefilter must not change what the filter matches
+      MemoryDb db;
+      FilterStore store(db);
+      assert(store.addFilter("From", regex, "", "", "", "", RejectAction, "", 0));
+      const std::regex expected(regex.c_str(), std::regex_constants::ECMAScript);
+      for (int m = 0; m < 3 && literalCases[i].matches[m]; m++)
+      {
+         const Data value(literalCases[i].matches[m]);
+         assert(std::regex_search(value.c_str(), expected));
+         assert(literal.empty() || value.find(literal) != Data::npos);
+         assert(filterMatches(store, value));
+      }
+      for (int m = 0; m < 3 && literalCases[i].misses[m]; m++)
+      {
+         const Data value(literalCases[i].misses[m]);
+         assert(!std::regex_search(value.c_str(), expected));
+         assert(!filterMatches(store, value));
+      }
+   }
+}
+
+void
+testPrefilter()
+{
+   MemoryDb db;
+   FilterStore store(db);
+   assert(store.addFilter("From", "^sip:(.*)@spam\\.example", "", "", "", "", RejectAction, "blocked $11", 0));
+
+   short action = -1;
+   Data actionData;
+   // Values without the literal are skipped, whatever else they contain
+   assert(!store.test("sip:bob@example.com", Data::Empty, action, actionData));
+   assert(!store.test("sip:bob@spam.exampl", Data::Empty, action, actionData));
+   // Values with it still have to match the whole expression
+   assert(!store.test("<sip:bob>@spam.example", Data::Empty, action, actionData));
+   assert(store.test("sip:bob@spam.example", Data::Empty, action, actionData));
+   assert(action == RejectAction);
+   assert(actionData == "blocked bob");
+}
+
+// Expressions RE2 rejects are run with std::regex instead, when built with
+// USE_RE2; otherwise std::regex runs them all
+void
+testRegexFallback()
+{
+   MemoryDb db;
+   FilterStore store(db);
+   assert(store.addFilter("From", "(ab)\\1-(\\d+)", "", "", "", "", RejectAction, "$11 $12", 0));
+
+   short action = -1;
+   Data actionData;
+   assert(store.test("xabab-42", Data::Empty, action, actionData));
+   assert(actionData == "ab 42");
+   assert(!store.test("xabac-42", Data::Empty, action, actionData));
+
+   MemoryDb db2;
+   FilterStore lookahead(db2);
+   assert(lookahead.addFilter("To", "sip:(\\w+)(?=@example)", "", "", "", "", RejectAction, "to $11", 0));
+   assert(lookahead.test("sip:carol@example.com", Data::Empty, action, actionData));
+   assert(actionData == "to carol");
+   assert(!lookahead.test("sip:carol@elsewhere.com", Data::Empty, action, actionData));
+
+   MemoryDb db3;
+   FilterStore plain(db3);
+   assert(plain.addFilter("Subject", "user-(\\d+)", "", "", "", "", RejectAction, "$11", 0));
+   assert(plain.test("hello user-1234", Data::Empty, action, actionData));
+   assert(actionData == "1234");
+   assert(!plain.test("hello user-", Data::Empty, action, actionData));
+}
+
+std::unique_ptr<SipMessage>
+makeRequest(const char* method, const char* from, const char* extraHeaders = "")
+{
+   Data text;
+   {
+      DataStream strm(text);
+      strm << method << " sip:bob@example.com SIP/2.0\r\n"
+           << "To: <sip:bob@example.com>\r\n"
+           << "From: <" << from << ">;tag=1\r\n"
+           << "Call-ID: 1\r\n"
+           << "CSeq: 1 " << method << "\r\n"
+           << "Via: SIP/2.0/UDP 192.0.2.1;branch=z9hG4bK1\r\n"
+           << "Max-Forwards: 70\r\n"
+           << extraHeaders
+           << "Content-Length: 0\r\n\r\n";
+   }
+   return std::unique_ptr<SipMessage>(SipMessage::make(text));
+}
+
+bool
+process(FilterStore& store, const SipMessage& request, Data& actionData)
+{
+   short action = -1;
+   return store.process(request, action, actionData);
+}
+
+void
+testProcessAndStats()
+{
+   MemoryDb db;
+   FilterStore store(db);
+   assert(store.addFilter("X-Tag", "evil", "", "", "", "", RejectAction, "tagged", 0));
+   assert(store.addFilter("From", "@spam\\.example", "X-Tag", "", "", "", RejectAction, "spam", 1));
+   assert(store.addFilter("request-line", "sip:bob@", "From", "alice", "MESSAGE", "", RejectAction, "bob", 2));
+
+   Data actionData;
+   assert(process(store, *makeRequest("INVITE", "sip:x@spam.example", "X-Tag: evil\r\n"), actionData));
+   assert(actionData == "tagged");
+   // Headers extracted for the last request are not seen by this one
+   assert(process(store, *makeRequest("INVITE", "sip:x@spam.example"), actionData));
+   assert(actionData == "spam");
+   assert(!process(store, *makeRequest("INVITE", "sip:alice@example.org"), actionData));
+   assert(process(store, *makeRequest("MESSAGE", "sip:alice@example.org"), actionData));
+   assert(actionData == "bob");
+   assert(!process(store, *makeRequest("MESSAGE", "sip:carol@example.org", "X-Tag: good\r\nX-Tag: fine\r\n"), actionData));
+
+   FilterStore::Stats stats = store.getStats();
+   assert(stats.requests == 5);
+   assert(stats.filters.size() == 3);
+   assert(stats.filters[0].evaluations == 5 && stats.filters[0].hits == 1);
+   assert(stats.filters[1].evaluations == 4 && stats.filters[1].hits == 1);
+   assert(stats.filters[2].evaluations == 2 && stats.filters[2].hits == 1);
+
+   // As served on GET /api/v1/filters/stats
+   {
+      Data body = RestAdmin::filterStatsJson(store);
+      std::istringstream in(body.c_str());
+      json::Object envelope;
+      json::Reader::Read(envelope, in);
+      const json::Object& data = envelope["data"];
+      assert((double)(const json::Number&)data["requests"] == 5);
+      const json::Array& filters = data["filters"];
+      assert(filters.Size() == 3);
+      const json::Object& second = filters[1];
+      assert(Data(((const json::String&)second["key"]).Value()) == stats.filters[1].key);
+      assert((double)(const json::Number&)second["evaluations"] == 4);
+      assert((double)(const json::Number&)second["hits"] == 1);
+   }
+
+   // As done by POST /api/v1/filters/stats/reset
+   store.resetStats();
+   stats = store.getStats();
+   assert(stats.requests == 0 && stats.evaluationTimeUs == 0);
+   for (size_t i = 0; i < stats.filters.size(); i++)
+   {
+      assert(stats.filters[i].evaluations == 0 && stats.filters[i].hits == 0);
+   }
+   {
+      Data body = RestAdmin::filterStatsJson(store);
+      std::istringstream in(body.c_str());
+      json::Object envelope;
+      json::Reader::Read(envelope, in);
+      const json::Object& data = envelope["data"];
+      assert((double)(const json::Number&)data["requests"] == 0);
+      const json::Array& filters = data["filters"];
+      assert(filters.Size() == 3);
+      const json::Object& first = filters[0];
+      assert((double)(const json::Number&)first["hits"] == 0);
+   }
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testRequiredLiteral();
+   testPrefilter();
+   testRegexFallback();
+   testProcessAndStats();
+
+   cout << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
@@ -0,0 +1,482 @@
+#include <cassert>
+#include <iostream>
+
+#include "repro/RegSyncBinary.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseException.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+namespace
+{
+
+Data
+bytes(const unsigned char* data, size_t size)
+{
+   return Data((const char*)data, (Data::size_type)size);
+}
+
+bool
+varintFails(const Data& encoded)
+{
+   ParseBuffer pb(encoded);
+   try
+   {
+      RegSyncBinary::decodeVarint(pb);
+   }
+   catch (ParseException&)
+   {
+      return true;
+   }
+   return false;
+}
+
+void
+testVarint()
+{
+   static const struct
+   {
+      uint64_t value;
+      unsigned int size;
+   } cases[] =
+   {
+      { 0, 1 },
+      { 1, 1 },
+      { 127, 1 },
+      { 128, 2 },
+      { 300, 2 },
+      { 16383, 2 },
+      { 16384, 3 },
+      { 0xFFFFFFFFULL, 5 },
+      { 0x8000000000000000ULL, 10 },
+      { 0xFFFFFFFFFFFFFFFFULL, 10 },
+   };
+   Data all;
+   for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+   {
+      Data encoded;
+      RegSyncBinary::encodeVarint(encoded, cases[i].value);
+      assert(encoded.size() == cases[i].size);
+      ParseBuffer pb(encoded);
+      assert(RegSyncBinary::decodeVarint(pb) == cases[i].value);
+      assert(pb.eof());
+      all += encoded;
+   }
+
+   // Back to back, as in a record
+   ParseBuffer pb(all);
+   for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+   {
+      assert(RegSyncBinary::decodeVarint(pb) == cases[i].value);
+   }
+   assert(pb.eof());
+
+   static const unsigned char le300[] = { 0xAC, 0x02 };
+   Data encoded;
+   RegSyncBinary::encodeVarint(encoded, 300);
+   assert(encoded == bytes(le300, sizeof(le300)));
+
+   // Truncated
+   assert(varintFails(Data::Empty));
+   static const unsigned char truncated[] = { 0xAC };
+   assert(varintFails(bytes(truncated, sizeof(truncated))));
+   static const unsigned char truncatedLong[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+   assert(varintFails(bytes(truncatedLong, sizeof(truncatedLong))));
+
+   // More than 64 bits
+   static const unsigned char tooLong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+   assert(varintFails(bytes(tooLong, sizeof(tooLong))));
+   static const unsigned char tooLarge[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 };
+   assert(varintFails(bytes(tooLarge, sizeof(tooLarge))));
+}
+
+void
+testUInt64()
+{
+   Data encoded;
+   RegSyncBinary::encodeUInt64(encoded, 0x0102030405060708ULL);
+   static const unsigned char expected[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   assert(encoded == bytes(expected, sizeof(expected)));
+   ParseBuffer pb(encoded);
+   assert(RegSyncBinary::decodeUInt64(pb) == 0x0102030405060708ULL);
+   assert(pb.eof());
+
+   ParseBuffer truncated(encoded.data(), 7);
+   bool failed = false;
+   try
+   {
+      RegSyncBinary::decodeUInt64(truncated);
+   }
+   catch (ParseException&)
+   {
+      failed = true;
+   }
+   assert(failed);
+}
+
+void
+testFrame()
+{
+   Data payload("records");
+   Data frame = RegSyncBinary::frame(RegSyncBinary::Updates, payload);
+   assert(frame.size() == RegSyncBinary::HeaderSize + payload.size());
+   assert((unsigned char)frame[0] == RegSyncBinary::FrameMarker);
+
+   unsigned char type = 0;
+   uint32_t payloadSize = 0;
+   RegSyncBinary::decodeHeader(frame.data(), type, payloadSize);
+   assert(type == RegSyncBinary::Updates);
+   assert(payloadSize == payload.size());
+   assert(frame.substr(RegSyncBinary::HeaderSize) == payload);
+
+   // Sizes are in network byte order
+   static const unsigned char header[] = { RegSyncBinary::FrameMarker, 7, 0x01, 0x02, 0x03, 0x04 };
+   RegSyncBinary::decodeHeader((const char*)header, type, payloadSize);
+   assert(type == 7);
+   assert(payloadSize == 0x01020304);
+   assert(payloadSize > RegSyncBinary::MaxPayloadSize);
+}
+
+ContactList
+makeContacts(uint64_t now)
+{
+   ContactList contacts;
+
+   ContactInstanceRecord active;
+   active.mContact = NameAddr("<sip:alice@192.0.2.10:5060;transport=tcp>;+sip.instance=\"<urn:uuid:1>\"");
+   active.mRegExpires = now + 3600;
+   active.mLastUpdated = now - 10;
+   active.mReceivedFrom = Tuple("192.0.2.10", 40000, TCP);
+   active.mPublicAddress = Tuple("198.51.100.1", 5060, UDP);
+   active.mSipPath.push_back(NameAddr("<sip:edge1.example.com;lr>"));
+   active.mSipPath.push_back(NameAddr("<sip:edge2.example.com;lr>"));
+   active.mInstance = "<urn:uuid:1>";
+   active.mRegId = 2;
+   active.mUserAgent = "phone/1.0";
+   contacts.push_back(active);
+
+   ContactInstanceRecord removed;
+   removed.mContact = NameAddr("<sip:alice@192.0.2.11>");
+   removed.mRegExpires = 0;
+   removed.mLastUpdated = now;
+   contacts.push_back(removed);
+
+   // Static registrations are not synced
+   ContactInstanceRecord fixed;
+   fixed.mContact = NameAddr("<sip:alice@192.0.2.12>");
+   fixed.mRegExpires = NeverExpire;
+   contacts.push_back(fixed);
+
+   return contacts;
+}
+
+void
+testAor()
+{
+   const Uri aor("sip:alice@example.com");
+   Data record;
+   assert(RegSyncBinary::encodeAor(record, aor, makeContacts(1000), 1000));
+
+   // Times are relative, so decoding later moves them on
+   Uri decodedAor;
+   ContactList contacts;
+   ParseBuffer pb(record);
+   RegSyncBinary::decodeAor(pb, decodedAor, contacts, 5000);
+   assert(pb.eof());
+   assert(decodedAor == aor);
+   assert(contacts.size() == 2);
+
+   const ContactInstanceRecord& active = contacts.front();
+   assert(active.mContact.uri() == Uri("sip:alice@192.0.2.10:5060;transport=tcp"));
+   assert(active.mRegExpires == 5000 + 3600);
+   assert(active.mLastUpdated == 5000 - 10);
+   assert(active.mReceivedFrom == Tuple("192.0.2.10", 40000, TCP));
+   assert(active.mPublicAddress == Tuple("198.51.100.1", 5060, UDP));
+   assert(active.mSipPath.size() == 2);
+   assert(active.mSipPath.back().uri() == Uri("sip:edge2.example.com;lr"));
+   assert(active.mInstance == "<urn:uuid:1>");
+   assert(active.mRegId == 2);
+   assert(active.mUserAgent == "phone/1.0");
+   assert(active.mSyncContact);
+
+   const ContactInstanceRecord& removed = contacts.back();
+   assert(removed.mRegExpires == 0);
+   assert(removed.mReceivedFrom.getType() == UNKNOWN_TRANSPORT);
+   assert(removed.mSipPath.empty());
+
+   // Nothing to sync
+   ContactList onlyStatic;
+   onlyStatic.push_back(makeContacts(1000).back());
+   Data empty("x");
+   assert(!RegSyncBinary::encodeAor(empty, aor, onlyStatic, 1000));
+   assert(empty == "x");
+}
+
+void
+appendString(Data& record, const Data& value)
+{
+   RegSyncBinary::encodeVarint(record, value.size());
+   record += value;
+}
+
+bool
+aorFails(const Data& record)
+{
+   ParseBuffer pb(record);
+   Uri aor;
+   ContactList contacts;
+   try
+   {
+      RegSyncBinary::decodeAor(pb, aor, contacts, 1000);
+   }
+   catch (ParseException&)
+   {
+      return true;
+   }
+   return false;
+}
+
+void
+testHostileAor()
+{
+   Data record;
+   assert(RegSyncBinary::encodeAor(record, Uri("sip:alice@example.com"), makeContacts(1000), 1000));
+
+   // Every field takes at least a byte, so cutting the record short anywhere fails
+   for (Data::size_type size = 0; size < record.size(); size++)
+   {
+      assert(aorFails(Data(record.data(), size)));
+   }
+
+   // Lengths and counts that run past the end are not trusted
+   Data hugeString;
+   RegSyncBinary::encodeVarint(hugeString, 1ULL << 40);
+   hugeString += "sip:alice@example.com";
+   assert(aorFails(hugeString));
+
+   Data manyContacts;
+   appendString(manyContacts, "sip:alice@example.com");
+   RegSyncBinary::encodeVarint(manyContacts, 0xFFFFFFFFFFFFFFFFULL);
+   assert(aorFails(manyContacts));
+
+   Data manyPaths;
+   appendString(manyPaths, "sip:alice@example.com");
+   RegSyncBinary::encodeVarint(manyPaths, 1);
+   appendString(manyPaths, "sip:alice@192.0.2.1:1");
+   RegSyncBinary::encodeVarint(manyPaths, 60);   // expires
+   RegSyncBinary::encodeVarint(manyPaths, 0);    // last updated
+   RegSyncBinary::encodeVarint(manyPaths, 0);    // received from
+   RegSyncBinary::encodeVarint(manyPaths, 0);    // public address
+   RegSyncBinary::encodeVarint(manyPaths, 1ULL << 32);
+   assert(aorFails(manyPaths));
+
+   // A flow token of the wrong size is ignored rather than read past
+   Data badToken;
+   appendString(badToken, "sip:alice@example.com");
+   RegSyncBinary::encodeVarint(badToken, 1);
+   appendString(badToken, "sip:alice@192.0.2.1:1");
+   RegSyncBinary::encodeVarint(badToken, 60);
+   RegSyncBinary::encodeVarint(badToken, 0);
+   appendString(badToken, "abc");                // received from
+   RegSyncBinary::encodeVarint(badToken, 0);     // public address
+   RegSyncBinary::encodeVarint(badToken, 0);     // paths
+   RegSyncBinary::encodeVarint(badToken, 0);     // instance
+   RegSyncBinary::encodeVarint(badToken, 0);     // reg-id
+   RegSyncBinary::encodeVarint(badToken, 0);     // User-Agent
+   ParseBuffer pb(badToken);
+   Uri aor;
+   ContactList contacts;
+   RegSyncBinary::decodeAor(pb, aor, contacts, 1000);
+   assert(pb.eof());
+   assert(contacts.size() == 1);
+   assert(contacts.front().mReceivedFrom.getType() == UNKNOWN_TRANSPORT);
+}
+
+// A change journaled at 1000 and sent at 1600, to a client resuming from
+// before it, decoded as RegSyncClient does
+void
+testResumeAfterDelay()
+{
+   const uint64_t changed = 1000;
+   const uint64_t resumed = 1600;
+   ContactList contacts = makeContacts(changed);
+   ContactInstanceRecord shortLived;
+   shortLived.mContact = NameAddr("<sip:alice@192.0.2.13>");
+   shortLived.mRegExpires = changed + 300;
+   shortLived.mLastUpdated = changed - 5;
+   contacts.push_back(shortLived);
+
+   Data record;
+   assert(RegSyncBinary::encodeAor(record, Uri("sip:alice@example.com"), contacts, changed));
+
+   Data payload;
+   RegSyncBinary::encodeUpdate(payload, 7, record, changed, resumed);
+   ParseBuffer pb(payload);
+   assert(RegSyncBinary::decodeVarint(pb) == 7);
+   Uri aor;
+   ContactList decoded;
+   RegSyncBinary::decodeAor(pb, aor, decoded, resumed);
+   assert(pb.eof());
+   assert(decoded.size() == 3);
+
+   // The client ends up with the server's times, not ones moved on by the delay
+   ContactList::const_iterator it = decoded.begin();
+   assert(it->mRegExpires == changed + 3600);
+   assert(it->mLastUpdated == changed - 10);
+   assert(it->mReceivedFrom == Tuple("192.0.2.10", 40000, TCP));
+   assert(it->mSipPath.size() == 2);
+   assert(it->mUserAgent == "phone/1.0");
+   ++it;
+   assert(it->mRegExpires == 0);
+   assert(it->mLastUpdated == changed);
+   // Expired while the change waited
+   ++it;
+   assert(it->mRegExpires == 0);
+   assert(it->mLastUpdated == changed - 5);
+
+   // Sent straight away, or by a clock that went back, the record is as built
+   Data immediate;
+   RegSyncBinary::encodeUpdate(immediate, 7, record, changed, changed);
+   Data expected;
+   RegSyncBinary::encodeVarint(expected, 7);
+   expected += record;
+   assert(immediate == expected);
+   immediate.clear();
+   RegSyncBinary::encodeUpdate(immediate, 7, record, changed, changed - 1);
+   assert(immediate == expected);
+}
+
+void
+testSnapshot()
+{
+   Data records;
+   for (int i = 0; i < 50; i++)
+   {
+      RegSyncBinary::encodeAor(records, Uri("sip:user" + Data(i) + "@example.com"), makeContacts(1000), 1000);
+   }
+
+   Data payload = RegSyncBinary::encodeSnapshot(records, false);
+   assert(payload[0] == RegSyncBinary::None);
+   Data decoded;
+   assert(RegSyncBinary::decodeSnapshot(payload, decoded));
+   assert(decoded == records);
+
+   payload = RegSyncBinary::encodeSnapshot(records, true);
+   decoded.clear();
+   assert(RegSyncBinary::decodeSnapshot(payload, decoded));
+   assert(decoded == records);
+   if (RegSyncBinary::compressionSupported())
+   {
+      assert(payload[0] == RegSyncBinary::Deflate);
+      assert(payload.size() < records.size() / 4);
+
+      // Truncated, with a wrong inflated size, an oversized one, or garbage
+      assert(!RegSyncBinary::decodeSnapshot(payload.substr(0, payload.size() - 1), decoded));
+      assert(!RegSyncBinary::decodeSnapshot(payload.substr(0, 1), decoded));
+
+      ParseBuffer pb(payload.data() + 1, payload.size() - 1);
+      uint64_t size = RegSyncBinary::decodeVarint(pb);
+      Data compressed(pb.position(), pb.lengthRemaining());
+
+      Data wrongSize(1, Data::Preallocate);
+      wrongSize += (char)RegSyncBinary::Deflate;
+      RegSyncBinary::encodeVarint(wrongSize, size + 1);
+      wrongSize += compressed;
+      assert(!RegSyncBinary::decodeSnapshot(wrongSize, decoded));
+
+      Data tooLarge(1, Data::Preallocate);
+      tooLarge += (char)RegSyncBinary::Deflate;
+      RegSyncBinary::encodeVarint(tooLarge, 1ULL << 40);
+      tooLarge += compressed;
+      assert(!RegSyncBinary::decodeSnapshot(tooLarge, decoded));
+
+      Data garbage(1, Data::Preallocate);
+      garbage += (char)RegSyncBinary::Deflate;
+      RegSyncBinary::encodeVarint(garbage, size);
+      garbage += Data(compressed.size(), Data::Preallocate);
+      garbage.append(records.data(), compressed.size());
+      assert(!RegSyncBinary::decodeSnapshot(garbage, decoded));
+   }
+   else
+   {
+      assert(payload[0] == RegSyncBinary::None);
+      Data deflated(1, Data::Preallocate);
+      deflated += (char)RegSyncBinary::Deflate;
+      deflated += records;
+      assert(!RegSyncBinary::decodeSnapshot(deflated, decoded));
+   }
+
+   // An empty payload, and an unknown compression
+   assert(!RegSyncBinary::decodeSnapshot(Data::Empty, decoded));
+   assert(!RegSyncBinary::decodeSnapshot(Data("\x07" "abc"), decoded));
+
+   // An empty snapshot
+   payload = RegSyncBinary::encodeSnapshot(Data::Empty, false);
+   assert(RegSyncBinary::decodeSnapshot(payload, decoded));
+   assert(decoded.empty());
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testVarint();
+   testUInt64();
+   testFrame();
+   testAor();
+   testHostileAor();
+   testResumeAfterDelay();
+   testSnapshot();
+
+   cout << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
@@ -0,0 +1,117 @@
+#include <cassert>
+#include <iostream>
+
+#include "repro/RouteStore.hxx"
+#include "rutil/Logger.hxx"
+
+#include "MemoryDb.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+namespace
+{
+
+void
+testLiteralPrefix()
+{
+   static const struct
+   {
+      const char* pattern;
+      const char* prefix;
+      bool literalOnly;
+   } cases[] =
+   {
+      { "^sip:1800", "sip:1800", true },
+      { "^sip:1\\.2", "sip:1.2", true },
+      { "^sip:1800.*", "sip:1800", false },
+      { "^sip:9(.*)@", "sip:9", false },
+      { "^sip:1234$", "sip:1234", false },
+      { "^sip:\\d+", "sip:", false },
+      { "^sip:[abc]", "sip:", false },
+      { "^sip:ab?", "sip:a", false },
+      { "^sip:ab*", "sip:a", false },
+      { "^sip:ab+", "sip:ab", false },
+      { "^sip:ab{2}", "sip:a", false },
+      { "^(sip|tel):1", "", false },
+      { "^sip:1|^tel:1", "", false },
+      { "^sip:(1|2)|x", "", false },
+      { "^sip:[|]1", "sip:", false },
+      { "sip:1800", "", false },
+      { "", "", false },
+   };
+   for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+   {
+      Data prefix("junk");
+      bool literalOnly = RouteStore::getLiteralPrefix(cases[i].pattern, prefix);
+      if (prefix != cases[i].prefix || literalOnly != cases[i].literalOnly)
+      {
+         cerr << "getLiteralPrefix(" << cases[i].pattern << ") gave " << prefix << " " << literalOnly << endl;
+         assert(false);
+      }
+   }
+}
+
+Data
+targets(RouteStore& store, const char* ruri, const char* method)
+{
+   RouteStore::UriList list = store.process(Uri(ruri), method, Data::Empty);
+   Data result;
+   for (RouteStore::UriList::const_iterator it = list.begin(); it != list.end(); it++)
+   {
+      if (!result.empty())
+      {
+         result += " ";
+      }
+      result += it->user();
+   }
+   return result;
+}
+
+void
+testProcess()
+{
+   MemoryDb db;
+   RouteStore store(db);
+
+   // Overlapping prefixes, added out of order
+   store.addRoute("", "", "^sip:1", "sip:r3@example.net", 3);
+   store.addRoute("", "", "^sip:123(.*)@", "sip:r2-$1@example.net", 2);
+   store.addRoute("INVITE", "", "^sip:1234", "sip:r5@example.net", 5);
+   store.addRoute("", "", "1234", "sip:r4@example.net", 4);
+   store.addRoute("", "", "^sip:12", "sip:r1@example.net", 1);
+   store.addRoute("", "", "^sip:1234$", "sip:r6@example.net", 6);
+   store.addRoute("", "", "^sip:2", "sip:r0@example.net", 0);
+
+   assert(targets(store, "sip:1234@example.com", "INVITE") == "r1 r2-4 r3 r4 r5");
+   assert(targets(store, "sip:1234@example.com", "invite") == "r1 r2-4 r3 r4 r5");
+   assert(targets(store, "sip:1234@example.com", "MESSAGE") == "r1 r2-4 r3 r4");
+   assert(targets(store, "sip:13@example.com", "INVITE") == "r3");
+   assert(targets(store, "sip:21234@example.com", "INVITE") == "r0 r4");
+   assert(targets(store, "sip:9@example.com", "INVITE") == "");
+
+   // A rule added for a method seen before, and one for any method after it
+   store.addRoute("MESSAGE", "", "^sip:13", "sip:r7@example.net", 7);
+   store.addRoute("", "", "^sip:", "sip:r8@example.net", 8);
+   assert(targets(store, "sip:13@example.com", "MESSAGE") == "r3 r7 r8");
+   assert(targets(store, "sip:13@example.com", "INVITE") == "r3 r8");
+
+   store.eraseRoute("", "", "^sip:1", 3);
+   assert(targets(store, "sip:13@example.com", "INVITE") == "r8");
+   assert(targets(store, "sip:1234@example.com", "INVITE") == "r1 r2-4 r4 r5 r8");
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testLiteralPrefix();
+   testProcess();
+
+   cout << "All OK" << endl;
+   return 0;
+}
@@ -0,0 +1,187 @@
+#include <cassert>
+#include <iostream>
+
+#include "repro/UserStore.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Time.hxx"
+
+#include "MemoryDb.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+namespace
+{
+
+// Counts the auth lookups that reach the database
+class CountingDb : public MemoryDb
+{
+   public:
+      CountingDb() : mAuthLookups(0), mDuringLookup(0) {}
+
+      virtual Data getUserAuthInfo(const Key& key) const
+      {
+         mAuthLookups++;
+         Data a1 = AbstractDb::getUserAuthInfo(key);
+         if (mDuringLookup)
+         {
+            // Run once: a change that lands after the read, before the fill
+            void (*hook)(void*) = mDuringLookup;
+            mDuringLookup = 0;
+            hook(mHookArg);
+         }
+         return a1;
+      }
+
+      mutable int mAuthLookups;
+      mutable void (*mDuringLookup)(void*);
+      void* mHookArg;
+};
+
+void
+addAlice(UserStore& store, const Data& password)
+{
+   store.addUser("alice", "example.com", "example.com", password, true, "Alice", "alice@example.com");
+}
+
+void
+changeAlicePassword(void* arg)
+{
+   addAlice(*static_cast<UserStore*>(arg), "newsecret");
+}
+
+void
+eraseAlice(void* arg)
+{
+   static_cast<UserStore*>(arg)->eraseUser(UserStore::buildKey("alice", "example.com"));
+}
+
+void
+testHitAndMiss()
+{
+   CountingDb db;
+   UserStore store(db);
+   store.setAuthCache(10, 60, 60);
+   addAlice(store, "secret");
+
+   Data a1 = store.getUserAuthInfo("alice", "example.com");
+   assert(!a1.empty());
+   assert(db.mAuthLookups == 1);
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mAuthLookups == 1);
+
+   // "no such user" is cached too
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(db.mAuthLookups == 2);
+
+   UserStore::AuthCacheStats stats = store.getAuthCacheStats();
+   assert(stats.hits == 1);
+   assert(stats.negativeHits == 1);
+   assert(stats.misses == 2);
+   assert(stats.size == 2);
+
+   // Changes made through the store are seen at once
+   addAlice(store, "newsecret");
+   Data changed = store.getUserAuthInfo("alice", "example.com");
+   assert(changed != a1);
+   assert(db.mAuthLookups == 3);
+
+   // Disabled, every lookup goes to the database
+   store.setAuthCache(0, 60, 60);
+   store.getUserAuthInfo("alice", "example.com");
+   store.getUserAuthInfo("alice", "example.com");
+   assert(db.mAuthLookups == 5);
+}
+
+void
+testExpiry()
+{
+   CountingDb db;
+   UserStore store(db);
+   store.setAuthCache(10, 1, 0);
+   addAlice(store, "secret");
+
+   store.getUserAuthInfo("alice", "example.com");
+   store.getUserAuthInfo("alice", "example.com");
+   assert(db.mAuthLookups == 1);
+   // Negative results are not cached with a negative TTL of 0
+   store.getUserAuthInfo("bob", "example.com");
+   store.getUserAuthInfo("bob", "example.com");
+   assert(db.mAuthLookups == 3);
+
+   sleepMs(1100);
+   store.getUserAuthInfo("alice", "example.com");
+   assert(db.mAuthLookups == 4);
+   assert(store.getAuthCacheStats().misses == 4);
+}
+
+void
+testEviction()
+{
+   CountingDb db;
+   UserStore store(db);
+   store.setAuthCache(2, 60, 60);
+
+   store.getUserAuthInfo("a", "example.com");
+   store.getUserAuthInfo("b", "example.com");
+   store.getUserAuthInfo("a", "example.com");   // b is now least recently used
+   store.getUserAuthInfo("c", "example.com");
+   assert(store.getAuthCacheStats().evictions == 1);
+   assert(db.mAuthLookups == 3);
+   store.getUserAuthInfo("a", "example.com");
+   assert(db.mAuthLookups == 3);
+   store.getUserAuthInfo("b", "example.com");
+   assert(db.mAuthLookups == 4);
+}
+
+void
+testInvalidateDuringFill()
+{
+   CountingDb db;
+   UserStore store(db);
+   store.setAuthCache(10, 60, 60);
+   addAlice(store, "secret");
+   db.mHookArg = &store;
+
+   // The password changes while the lookup is reading the old one
+   db.mDuringLookup = changeAlicePassword;
+   Data stale = store.getUserAuthInfo("alice", "example.com");
+   Data fresh = store.getUserAuthInfo("alice", "example.com");
+   assert(fresh != stale);
+   assert(db.mAuthLookups == 2);
+   // and once read without interference, it is cached again
+   assert(store.getUserAuthInfo("alice", "example.com") == fresh);
+   assert(db.mAuthLookups == 2);
+
+   // The user is erased while the lookup is reading it
+   store.clearAuthCache();
+   db.mDuringLookup = eraseAlice;
+   assert(store.getUserAuthInfo("alice", "example.com") == fresh);
+   assert(store.getUserAuthInfo("alice", "example.com").empty());
+   assert(db.mAuthLookups == 4);
+
+   // A user added while a "no such user" is being read
+   store.clearAuthCache();
+   db.mDuringLookup = changeAlicePassword;
+   assert(store.getUserAuthInfo("alice", "example.com").empty());
+   assert(store.getUserAuthInfo("alice", "example.com") == fresh);
+   assert(db.mAuthLookups == 6);
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testHitAndMiss();
+   testExpiry();
+   testEviction();
+   testInvalidateDuringFill();
+
+   cout << "All OK" << endl;
+   return 0;
+}
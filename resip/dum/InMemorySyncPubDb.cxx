@@ -65,7 +65,7 @@ InMemorySyncPubDb::shouldEraseDocument(PubDocument& document, uint64_t now)
 }
 
 void
-InMemorySyncPubDb::initialSync(unsigned int connectionId)
+InMemorySyncPubDb::initialSync(InMemorySyncPubDbHandler& handler, unsigned int connectionId)
 {
    uint64_t now = Timer::getTimeSecs();
 
@@ -85,7 +85,7 @@ InMemorySyncPubDb::initialSync(unsigned int connectionId)
          }
          else
          {
-            invokeOnInitialSyncDocument(connectionId, eTagIt->second.mEventType, eTagIt->second.mDocumentKey, eTagIt->second.mETag, eTagIt->second.mExpirationTime, eTagIt->second.mLastUpdated, eTagIt->second.mContents.get(), eTagIt->second.mSecurityAttributes.get());
+            handler.onInitialSyncDocument(connectionId, eTagIt->second.mEventType, eTagIt->second.mDocumentKey, eTagIt->second.mETag, eTagIt->second.mExpirationTime, eTagIt->second.mLastUpdated, eTagIt->second.mContents.get(), eTagIt->second.mSecurityAttributes.get());
             eTagIt++;
          }
       }
@@ -381,21 +381,6 @@ InMemorySyncPubDb::invokeOnDocumentRemoved(bool sync, const Data& eventType, con
    }
 }
 
-void 
-InMemorySyncPubDb::invokeOnInitialSyncDocument(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, uint64_t expirationTime, uint64_t lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
-{
-   Lock lock(mHandlerMutex);
-   for (HandlerList::iterator it = mHandlers.begin(); it != mHandlers.end(); it++)
-   {
-      // If handler mode is all, then send notification, otherwise handler mode is sync and we check the passed
-      // in sync flag
-      if ((*it)->getMode() == InMemorySyncPubDbHandler::SyncServer)
-      {
-         (*it)->onInitialSyncDocument(connectionId, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
-      }
-   }
-}
-
 
 /* ====================================================================
 *
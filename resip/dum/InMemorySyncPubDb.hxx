@@ -48,7 +48,9 @@ public:
 
    virtual void addHandler(InMemorySyncPubDbHandler* handler);
    virtual void removeHandler(InMemorySyncPubDbHandler* handler);
-   virtual void initialSync(unsigned int connectionId);
+   // Calls onInitialSyncDocument() for every document on the given handler
+   // only; connection ids are only unique to the server that handed them out
+   virtual void initialSync(InMemorySyncPubDbHandler& handler, unsigned int connectionId);
 
    // PublicationPersistenceManager Methods
    virtual void addUpdateDocument(const PubDocument& document);
@@ -64,7 +66,6 @@ protected:
 
    void invokeOnDocumentModified(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, uint64_t expirationTime, uint64_t lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes);
    void invokeOnDocumentRemoved(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, uint64_t lastUpdated);
-   void invokeOnInitialSyncDocument(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, uint64_t expirationTime, uint64_t lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes);
    bool shouldEraseDocument(PubDocument& document, uint64_t now);
    bool mSyncEnabled;
    typedef std::list<InMemorySyncPubDbHandler*> HandlerList;
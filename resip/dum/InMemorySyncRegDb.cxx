@@ -1,4 +1,12 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/stack/Symbols.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/ParseBuffer.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -53,19 +61,188 @@ contactsRemoveIfRequired(ContactList& contacts, uint64_t& now,
 #endif
 }
 
-InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs) : 
+// due contacts purged by each write operation, to keep its latency bounded
+static const unsigned int PurgeBatch = 16;
+
+InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs, unsigned int shards) : 
+   mShardCount(shards ? shards : 1),
+   mShards(new Shard[mShardCount]),
    mRemoveLingerSecs(removeLingerSecs)
 {
 }
 
 InMemorySyncRegDb::~InMemorySyncRegDb()
 {
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+}
+
+Data
+InMemorySyncRegDb::aorKey(const Uri& aor)
+{
+   // user;userparams@host:port;params.  The host is canonicalised, and the
+   // parameters lower cased and sorted, so that AORs that differ only in
+   // parameter order or case share a record.
+   std::vector<Data> params;
+   if (aor.numKnownParams() || aor.numUnknownParams())
+   {
+      Data encoded;
+      {
+         DataStream ds(encoded);
+         aor.encodeParameters(ds);
+      }
+      ParseBuffer pb(encoded);
+      while (!pb.eof())
+      {
+         pb.skipChar(Symbols::SEMI_COLON[0]);
+         const char* start = pb.position();
+         pb.skipToChar(Symbols::SEMI_COLON[0]);
+         if (pb.position() != start)
+         {
+            params.push_back(pb.data(start).lowercase());
+         }
+      }
+      std::sort(params.begin(), params.end());
+   }
+
+   Data key;
+   {
+      DataStream ds(key);
+      ds << aor.user() << Symbols::SEMI_COLON << aor.userParameters() << Symbols::AT_SIGN;
+      if (DnsUtil::isIpV6Address(aor.host()))
+      {
+         ds << DnsUtil::canonicalizeIpV6Address(aor.host());
+      }
+      else
+      {
+         ds << Data(aor.host()).lowercase();
+      }
+      ds << Symbols::COLON << aor.port();
+      for (std::vector<Data>::const_iterator it = params.begin(); it != params.end(); ++it)
+      {
+         ds << Symbols::SEMI_COLON << *it;
+      }
+   }
+   return key;
+}
+
+InMemorySyncRegDb::Shard&
+InMemorySyncRegDb::shardFor(const Data& key)
+{
+   return mShards[key.hash() % mShardCount];
+}
+
+InMemorySyncRegDb::AorRecord&
+InMemorySyncRegDb::findOrCreate(Shard& shard, const Data& key, const Uri& aor)
+{
+   RecordMap::iterator it = shard.mRecords.find(key);
+   if (it == shard.mRecords.end())
+   {
+      it = shard.mRecords.insert(std::make_pair(key, AorRecord(aor))).first;
+   }
+   return it->second;
+}
+
+InMemorySyncRegDb::AorRecord*
+InMemorySyncRegDb::find(Shard& shard, const Data& key)
+{
+   RecordMap::iterator it = shard.mRecords.find(key);
+   if (it == shard.mRecords.end() || !it->second.mActive)
    {
-      delete it->second;
+      return 0;
+   }
+   return &it->second;
+}
+
+void
+InMemorySyncRegDb::deactivate(Shard& shard, RecordMap::iterator it)
+{
+   AorRecord& record = it->second;
+   record.mContacts.clear();
+   record.mActive = false;
+   ContactList emptyList;
+   invokeOnAorModified(true /* sync? */, record.mAor, emptyList);
+   if (!record.mLocked)
+   {
+      shard.mRecords.erase(it);
+   }
+   // else removed when the AOR is unlocked
+}
+
+uint64_t
+InMemorySyncRegDb::purgeTime(const ContactList& contacts) const
+{
+   // The earliest time contactsRemoveIfRequired() would remove one of them
+   uint64_t earliest = 0;
+   for (ContactList::const_iterator it = contacts.begin(); it != contacts.end(); ++it)
+   {
+      uint64_t t = resipMax(it->mRegExpires, it->mLastUpdated + mRemoveLingerSecs + 1);
+      if (earliest == 0 || t < earliest)
+      {
+         earliest = t;
+      }
+   }
+   return earliest;
+}
+
+void
+InMemorySyncRegDb::contactsChanged(Shard& shard, const Data& key, AorRecord& record)
+{
+   // A later purge time leaves the existing (earlier) entry in place; it is
+   // recomputed when that entry comes due.
+   uint64_t t = purgeTime(record.mContacts);
+   if (t != 0 && (record.mPurgeAt == 0 || t < record.mPurgeAt))
+   {
+      record.mPurgeAt = t;
+      shard.mExpiry.insert(std::make_pair(t, key));
+   }
+}
+
+void
+InMemorySyncRegDb::purgeDue(Shard& shard, uint64_t now, unsigned int limit)
+{
+   for (unsigned int n = 0; n < limit && !shard.mExpiry.empty(); ++n)
+   {
+      ExpiryIndex::iterator due = shard.mExpiry.begin();
+      if (due->first > now)
+      {
+         break;
+      }
+      uint64_t t = due->first;
+      Data key(due->second);
+      shard.mExpiry.erase(due);
+
+      RecordMap::iterator it = shard.mRecords.find(key);
+      if (it == shard.mRecords.end() || it->second.mPurgeAt != t)
+      {
+         continue;  // stale
+      }
+      AorRecord& record = it->second;
+      record.mPurgeAt = 0;
+      if (record.mLocked)
+      {
+         continue;  // being worked on; unlockRecord() indexes it again
+      }
+      contactsRemoveIfRequired(record.mContacts, now, mRemoveLingerSecs);
+      if (record.mContacts.empty())
+      {
+         DebugLog(<< "InMemorySyncRegDb: purged " << record.mAor);
+         shard.mRecords.erase(it);
+      }
+      else
+      {
+         contactsChanged(shard, key, record);
+      }
+   }
+}
+
+void
+InMemorySyncRegDb::purgeExpired()
+{
+   uint64_t now = Timer::getTimeSecs();
+   for (unsigned int i = 0; i < mShardCount; ++i)
+   {
+      Lock g(mShards[i].mMutex);
+      purgeDue(mShards[i], now, std::numeric_limits<unsigned int>::max());
    }
-   mDatabase.clear();
 }
 
 void 
@@ -104,34 +281,25 @@ InMemorySyncRegDb::invokeOnAorModified(bool sync, const resip::Uri& aor, const C
    }
 }
 
-void
-InMemorySyncRegDb::invokeOnInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
-{
-   Lock lock(mHandlerMutex);
-   for (HandlerList::iterator it = mHandlers.begin(); it != mHandlers.end(); it++)
-   {
-      if ((*it)->getMode() == InMemorySyncRegDbHandler::SyncServer)
-      {
-         (*it)->onInitialSyncAor(connectionId, aor, contacts);
-      }
-   }
-}
-
 void 
-InMemorySyncRegDb::initialSync(unsigned int connectionId)
+InMemorySyncRegDb::initialSync(InMemorySyncRegDbHandler& handler, unsigned int connectionId)
 {
    uint64_t now = Timer::getTimeSecs();
-   Lock g(mDatabaseMutex);
-   for(database_map_t::iterator it = mDatabase.begin(); it != mDatabase.end(); it++)
+   for (unsigned int i = 0; i < mShardCount; ++i)
    {
-      if(it->second)
+      Shard& shard = mShards[i];
+      Lock g(shard.mMutex);
+      for(RecordMap::iterator it = shard.mRecords.begin(); it != shard.mRecords.end(); it++)
       {
-         ContactList& contacts = *(it->second);
-         if(mRemoveLingerSecs > 0) 
+         if(it->second.mActive)
          {
-            contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+            ContactList& contacts = it->second.mContacts;
+            if(mRemoveLingerSecs > 0) 
+            {
+               contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+            }
+            handler.onInitialSyncAor(connectionId, it->second.mAor, contacts);
          }
-         invokeOnInitialSyncAor(connectionId, it->first, contacts);
       }
    }
 }
@@ -140,71 +308,60 @@ void
 InMemorySyncRegDb::addAor(const Uri& aor,
                           const ContactList& contacts)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator it = mDatabase.find(aor);
-   if(it != mDatabase.end())
-   {
-       if(it->second)
-       {
-           *(it->second) = contacts;
-       }
-       else
-       {
-           it->second = new ContactList(contacts);
-       }
-   }
-   else
-   {
-       mDatabase[aor] = new ContactList(contacts);
-   }
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   purgeDue(shard, Timer::getTimeSecs(), PurgeBatch);
+
+   AorRecord& record = findOrCreate(shard, key, aor);
+   record.mContacts = contacts;
+   record.mActive = true;
+   contactsChanged(shard, key, record);
    invokeOnAorModified(true /* sync? */, aor, contacts);
 }
 
 void 
 InMemorySyncRegDb::removeAor(const Uri& aor)
 {
-  database_map_t::iterator i;
-
-  Lock g(mDatabaseMutex);
-  i = mDatabase.find(aor);
-  //DebugLog (<< "Removing registration bindings " << aor);
-  if (i != mDatabase.end())
-  {
-     if (i->second)
-     {
-        if(mRemoveLingerSecs > 0)
-        {
-           ContactList& contacts = *(i->second);
-           uint64_t now = Timer::getTimeSecs();
-           for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
-           {
-              // Don't delete record - set expires to 0
-              it->mRegExpires = 0;
-              it->mLastUpdated = now;
-           }
-           invokeOnAorModified(true /* sync? */, aor, contacts);
-        }
-        else
-        {
-           delete i->second;
-           // Setting this to 0 causes it to be removed when we unlock the AOR.
-           i->second = 0;
-           ContactList emptyList;
-           invokeOnAorModified(true /* sync? */, aor, emptyList);
-        }
-     }
-  }
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   //DebugLog (<< "Removing registration bindings " << aor);
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i != shard.mRecords.end() && i->second.mActive)
+   {
+      if(mRemoveLingerSecs > 0)
+      {
+         ContactList& contacts = i->second.mContacts;
+         uint64_t now = Timer::getTimeSecs();
+         for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
+         {
+            // Don't delete record - set expires to 0
+            it->mRegExpires = 0;
+            it->mLastUpdated = now;
+         }
+         contactsChanged(shard, key, i->second);
+         invokeOnAorModified(true /* sync? */, aor, contacts);
+      }
+      else
+      {
+         deactivate(shard, i);
+      }
+   }
 }
 
 void
 InMemorySyncRegDb::getAors(InMemorySyncRegDb::UriList& container)
 {
    container.clear();
-   Lock g(mDatabaseMutex);
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+   for (unsigned int i = 0; i < mShardCount; ++i)
    {
-      container.push_back(it->first);
+      Lock g(mShards[i].mMutex);
+      for(RecordMap::const_iterator it = mShards[i].mRecords.begin();
+          it != mShards[i].mRecords.end(); it++)
+      {
+         container.push_back(it->second.mAor);
+      }
    }
 }
 
@@ -219,13 +376,15 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor, uint64_t* maxExpires)
 {
    bool registered = false;
 
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i != mDatabase.end() && i->second != 0)
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   AorRecord* record = find(shard, key);
+   if (record)
    {
       if (mRemoveLingerSecs > 0 || maxExpires)
       {
-         ContactList& contacts = *(i->second);
+         ContactList& contacts = record->mContacts;
          uint64_t now = Timer::getTimeSecs();
          for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
          {
@@ -254,70 +413,68 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor, uint64_t* maxExpires)
 void
 InMemorySyncRegDb::lockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
    DebugLog(<< "InMemorySyncRegDb::lockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
+   for (;;)
    {
-      Lock g1(mDatabaseMutex);
-      // This forces insertion if the record does not yet exist.
-      mDatabase[aor];
-   }
-
-   while (mLockedRecords.find(aor) != mLockedRecords.end())
-   {
-      mRecordUnlocked.wait(g2);
+      // This forces insertion if the record does not yet exist.  Look it up
+      // again after every wait, the previous holder may have dropped it.
+      AorRecord& record = findOrCreate(shard, key, aor);
+      if (!record.mLocked)
+      {
+         record.mLocked = true;
+         break;
+      }
+      shard.mRecordUnlocked.wait(g);
    }
-
-   mLockedRecords.insert(aor);
 }
 
 void
 InMemorySyncRegDb::unlockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
    DebugLog(<< "InMemorySyncRegDb::unlockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
-   {
-      Lock g1(mDatabaseMutex);
-      // If the pointer is null, we remove the record from the map.
-      database_map_t::iterator i = mDatabase.find(aor);
+   RecordMap::iterator i = shard.mRecords.find(key);
 
-      // The record must have been inserted when we locked it in the first place
-      resip_assert (i != mDatabase.end());
+   // The record must have been inserted when we locked it in the first place
+   resip_assert (i != shard.mRecords.end());
 
-      if (i->second == 0)
-      {
-         mDatabase.erase(i);
-      }
+   // If the AOR has no contacts (any more), we remove the record from the map.
+   if (!i->second.mActive)
+   {
+      shard.mRecords.erase(i);
+   }
+   else
+   {
+      i->second.mLocked = false;
+      contactsChanged(shard, key, i->second);
    }
 
-   mLockedRecords.erase(aor);
-   mRecordUnlocked.notify_all();
+   shard.mRecordUnlocked.notify_all();
 }
 
 RegistrationPersistenceManager::update_status_t 
 InMemorySyncRegDb::updateContact(const resip::Uri& aor, 
                                  const ContactInstanceRecord& rec) 
 {
-   ContactList *contactList = 0;
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   purgeDue(shard, Timer::getTimeSecs(), PurgeBatch);
 
+   AorRecord& record = findOrCreate(shard, key, aor);
+   if (!record.mActive)
    {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
-      {
-         contactList = new ContactList();
-         mDatabase[aor] = contactList;
-      }
-      else
-      {
-         contactList = i->second;
-      }
+      record.mContacts.clear();
+      record.mActive = true;
    }
-   
-   resip_assert(contactList);
+   ContactList* contactList = &record.mContacts;
 
    ContactList::iterator j;
 
@@ -336,6 +493,7 @@ InMemorySyncRegDb::updateContact(const resip::Uri& aor,
             status = CONTACT_CREATED;
          }
          *j=rec;
+         contactsChanged(shard, key, record);
          // Only pass sync as true if this update didn't just come from an inbound sync operation
          invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
          return status;
@@ -344,6 +502,7 @@ InMemorySyncRegDb::updateContact(const resip::Uri& aor,
 
    // This is a new contact, so we add it to the list.
    contactList->push_back(rec);
+   contactsChanged(shard, key, record);
    // Only pass sync as true if this update didn't just come from an inbound sync operation
    invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
    return CONTACT_CREATED;
@@ -353,19 +512,17 @@ void
 InMemorySyncRegDb::removeContact(const Uri& aor, 
                                  const ContactInstanceRecord& rec)
 {
-   ContactList *contactList = 0;
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   purgeDue(shard, Timer::getTimeSecs(), PurgeBatch);
 
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i == shard.mRecords.end() || !i->second.mActive)
    {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
-      {
-         return;
-      }
-      contactList = i->second;
+      return;
    }
+   ContactList* contactList = &i->second.mContacts;
 
    ContactList::iterator j;
 
@@ -378,6 +535,7 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
          {
             j->mRegExpires = 0;
             j->mLastUpdated = Timer::getTimeSecs();
+            contactsChanged(shard, key, i->second);
             // Only pass sync as true if this update didn't just come from an inbound sync operation
             invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
          }
@@ -386,7 +544,7 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
             contactList->erase(j);
             if (contactList->empty())
             {
-               removeAor(aor);
+               deactivate(shard, i);
             }
             else
             {
@@ -402,16 +560,18 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
 void
 InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   AorRecord* record = find(shard, key);
+   if (!record)
    {
       container.clear();
       return;
    }
    if(mRemoveLingerSecs > 0)
    {
-      ContactList& contacts = *(i->second);
+      ContactList& contacts = record->mContacts;
       uint64_t now = Timer::getTimeSecs();
       contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
       container.clear();
@@ -425,21 +585,23 @@ InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
    }
    else
    {
-      container = *(i->second);
+      container = record->mContacts;
    }
 }
 
 void
 InMemorySyncRegDb::getContactsFull(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   AorRecord* record = find(shard, key);
+   if (!record)
    {
       container.clear();
       return;
    }
-   ContactList& contacts = *(i->second);
+   ContactList& contacts = record->mContacts;
    if(mRemoveLingerSecs > 0)
    {
       uint64_t now = Timer::getTimeSecs();
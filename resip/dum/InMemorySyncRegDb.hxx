@@ -2,10 +2,12 @@
 #define RESIP_INMEMORYSYNCREGDB_HXX
 
 #include <map>
-#include <set>
 #include <list>
+#include <memory>
 
 #include "resip/dum/RegistrationPersistenceManager.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/Condition.hxx"
 #include "rutil/Lock.hxx"
@@ -44,6 +46,20 @@ protected:
   memory immediately and this class behaves very similar to the 
   InMemoryRegistrationDatabase class.
 
+  AORs are spread over a fixed number of shards by a hash of their
+  normalized form (user, user parameters, canonical host, port and any
+  URI parameters), so that registrations and lookups for different AORs
+  only contend when they land on the same shard.  Each shard has its own
+  mutex, its own condition for lockRecord(), and an index of the times at
+  which contacts become eligible for removal (expired and past the linger
+  time).  Write operations purge a few due contacts from their shard as
+  they go; purgeExpired() drains everything that is due.  Purged contacts
+  are not reported to the handlers, and an AOR left without contacts is
+  dropped unless it is locked.
+
+  Handlers are called with the shard of the affected AOR locked; they
+  must not call back into the database.
+
   The InMemorySyncRegDbHandler can be used by an external mechanism to 
   transport registration bindings to a remote peer for replication.
   See the RegSyncClient and RegSyncServer implementations in the repro
@@ -53,13 +69,18 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
 {
    public:
 
-      InMemorySyncRegDb(unsigned int removeLingerSecs = 0);
+      static const unsigned int DefaultShards = 32;
+
+      InMemorySyncRegDb(unsigned int removeLingerSecs = 0, unsigned int shards = DefaultShards);
       virtual ~InMemorySyncRegDb();
       
       virtual void addHandler(InMemorySyncRegDbHandler* handler);
       virtual void removeHandler(InMemorySyncRegDbHandler* handler);
 
-      virtual void initialSync(unsigned int connectionId);
+      /// Calls onInitialSyncAor() for every AOR on the given handler only;
+      /// connection ids are only unique to the server that handed them out,
+      /// and several servers may share the database.
+      virtual void initialSync(InMemorySyncRegDbHandler& handler, unsigned int connectionId);
 
       virtual void addAor(const Uri& aor, const ContactList& contacts);
       virtual void removeAor(const Uri& aor);
@@ -79,18 +100,55 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
    
       /// return all the AOR in the DB 
       virtual void getAors(UriList& container);
+
+      /// removes every contact that has expired and lingered long enough
+      virtual void purgeExpired();
+
+      /// the key AORs are hashed and compared by
+      static Data aorKey(const Uri& aor);
       
    protected:
-      typedef std::map<Uri,ContactList *> database_map_t;
-      database_map_t mDatabase;
-      Mutex mDatabaseMutex;
-
-      std::set<Uri> mLockedRecords;
-      Mutex mLockedRecordsMutex;
-      Condition mRecordUnlocked;
+      class AorRecord
+      {
+         public:
+            AorRecord(const Uri& aor) : mAor(aor), mActive(false), mLocked(false), mPurgeAt(0) {}
+
+            Uri mAor;
+            ContactList mContacts;
+            // false until contacts are stored, and again once the AOR is
+            // removed (without linger); inactive records go away on unlock
+            bool mActive;
+            bool mLocked;
+            // time of the live entry for this record in the expiry index,
+            // or 0 if there is none
+            uint64_t mPurgeAt;
+      };
+      typedef HashMap<Data, AorRecord> RecordMap;
+      // purge time -> AOR key; entries whose time no longer matches the
+      // record's mPurgeAt are stale and skipped
+      typedef std::multimap<uint64_t, Data> ExpiryIndex;
+
+      class Shard
+      {
+         public:
+            Mutex mMutex;
+            Condition mRecordUnlocked;
+            RecordMap mRecords;
+            ExpiryIndex mExpiry;
+      };
+
+      Shard& shardFor(const Data& key);
+      AorRecord& findOrCreate(Shard& shard, const Data& key, const Uri& aor);
+      AorRecord* find(Shard& shard, const Data& key);
+      void deactivate(Shard& shard, RecordMap::iterator it);
+      void contactsChanged(Shard& shard, const Data& key, AorRecord& record);
+      void purgeDue(Shard& shard, uint64_t now, unsigned int limit);
+      uint64_t purgeTime(const ContactList& contacts) const;
+
+      const unsigned int mShardCount;
+      std::unique_ptr<Shard[]> mShards;
 
       void invokeOnAorModified(bool sync, const resip::Uri& aor, const ContactList& contacts);
-      void invokeOnInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts);
       unsigned int mRemoveLingerSecs;
       typedef std::list<InMemorySyncRegDbHandler*> HandlerList;
       HandlerList mHandlers;  // use list over set to preserve add order
@@ -0,0 +1,419 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/stack/NameAddr.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+class CountingHandler : public InMemorySyncRegDbHandler
+{
+   public:
+      CountingHandler() : InMemorySyncRegDbHandler(AllChanges), mModified(0) {}
+      virtual void onAorModified(const Uri& aor, const ContactList& contacts)
+      {
+         ++mModified;
+         mLastSize = contacts.size();
+      }
+      int mModified;
+      size_t mLastSize;
+};
+
+// Stands in for one of several RegSyncServers sharing the database, each
+// numbering its connections from 1
+class SyncServerHandler : public InMemorySyncRegDbHandler
+{
+   public:
+      SyncServerHandler() : InMemorySyncRegDbHandler(SyncServer), mSynced(0) {}
+      virtual void onAorModified(const Uri& aor, const ContactList& contacts) {}
+      virtual void onInitialSyncAor(unsigned int connectionId, const Uri& aor, const ContactList& contacts)
+      {
+         assert(connectionId == 1);
+         ++mSynced;
+      }
+      int mSynced;
+};
+
+ContactInstanceRecord
+makeContact(const Data& contact, uint64_t expires, uint64_t lastUpdated)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(contact);
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = lastUpdated;
+   return rec;
+}
+
+size_t
+aorCount(InMemorySyncRegDb& db)
+{
+   RegistrationPersistenceManager::UriList aors;
+   db.getAors(aors);
+   return aors.size();
+}
+
+void
+testKeys()
+{
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@EXAMPLE.com")) ==
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:Alice@example.com")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com:5080")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@[::1]")) ==
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@[0:0::1]")));
+
+   // user parameters are kept apart from the user
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice;x@example.com")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alicex@example.com")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice;x@example.com")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;ab=1")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;a;b=1")));
+
+   // parameter order and case do not matter, their values do
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;a=1;b=2")) ==
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;b=2;a=1")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;transport=tcp;user=phone")) ==
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;user=phone;transport=TCP")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;a=1")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;a=2")));
+   assert(InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com;a=1")) !=
+          InMemorySyncRegDb::aorKey(Uri("sip:alice@example.com")));
+
+   // and equal AORs share one record
+   InMemorySyncRegDb db;
+   uint64_t now = Timer::getTimeSecs();
+   db.updateContact(Uri("sip:alice@example.com;a=1;b=2"), makeContact("sip:alice@1.2.3.4", now + 3600, now));
+   assert(db.updateContact(Uri("sip:alice@example.com;B=2;a=1"), makeContact("sip:alice@1.2.3.4", now + 3600, now)) ==
+          RegistrationPersistenceManager::CONTACT_UPDATED);
+   db.updateContact(Uri("sip:alice;a=1;b=2@example.com"), makeContact("sip:alice@1.2.3.4", now + 3600, now));
+   assert(aorCount(db) == 2);
+}
+
+void
+testBasic()
+{
+   InMemorySyncRegDb db;
+   CountingHandler handler;
+   db.addHandler(&handler);
+   uint64_t now = Timer::getTimeSecs();
+   Uri aor("sip:alice@example.com");
+
+   assert(!db.aorIsRegistered(aor));
+   db.lockRecord(aor);
+   assert(db.updateContact(aor, makeContact("sip:alice@1.2.3.4", now + 3600, now)) ==
+          RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.updateContact(Uri("sip:alice@Example.COM"), makeContact("sip:alice@1.2.3.4", now + 7200, now)) ==
+          RegistrationPersistenceManager::CONTACT_UPDATED);
+   assert(db.updateContact(aor, makeContact("sip:alice@5.6.7.8", now + 3600, now)) ==
+          RegistrationPersistenceManager::CONTACT_CREATED);
+   db.unlockRecord(aor);
+   assert(handler.mModified == 3 && handler.mLastSize == 2);
+
+   uint64_t maxExpires = 0;
+   assert(db.aorIsRegistered(aor, &maxExpires));
+   assert(maxExpires == now + 7200);
+   ContactList contacts;
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 2);
+   assert(aorCount(db) == 1);
+
+   // without linger, removing the last contact drops the AOR
+   db.lockRecord(aor);
+   db.removeContact(aor, makeContact("sip:alice@1.2.3.4", 0, 0));
+   db.removeContact(aor, makeContact("sip:alice@5.6.7.8", 0, 0));
+   assert(aorCount(db) == 1);  // still locked
+   db.unlockRecord(aor);
+   assert(aorCount(db) == 0);
+   assert(!db.aorIsRegistered(aor));
+   assert(handler.mModified == 5 && handler.mLastSize == 0);
+
+   // a lock on its own leaves nothing behind
+   db.lockRecord(Uri("sip:bob@example.com"));
+   db.unlockRecord(Uri("sip:bob@example.com"));
+   assert(aorCount(db) == 0);
+   db.removeHandler(&handler);
+}
+
+void
+testLinger()
+{
+   InMemorySyncRegDb db(60);
+   uint64_t now = Timer::getTimeSecs();
+   Uri aor("sip:carol@example.com");
+
+   db.updateContact(aor, makeContact("sip:carol@1.2.3.4", now + 3600, now));
+   db.removeContact(aor, makeContact("sip:carol@1.2.3.4", 0, 0));
+   ContactList contacts;
+   db.getContacts(aor, contacts);
+   assert(contacts.empty());
+   db.getContactsFull(aor, contacts);
+   assert(contacts.size() == 1 && contacts.front().mRegExpires == 0);
+
+   // lingering contacts are kept; updating one counts as a new contact
+   db.purgeExpired();
+   assert(aorCount(db) == 1);
+   assert(db.updateContact(aor, makeContact("sip:carol@1.2.3.4", now + 3600, now)) ==
+          RegistrationPersistenceManager::CONTACT_CREATED);
+}
+
+void
+testInitialSync()
+{
+   InMemorySyncRegDb db;
+   SyncServerHandler v4;
+   SyncServerHandler v6;
+   db.addHandler(&v4);
+   db.addHandler(&v6);
+   uint64_t now = Timer::getTimeSecs();
+   db.updateContact(Uri("sip:alice@example.com"), makeContact("sip:alice@1.2.3.4", now + 3600, now));
+   db.updateContact(Uri("sip:bob@example.com"), makeContact("sip:bob@1.2.3.4", now + 3600, now));
+
+   // Only the server that asked is called
+   db.initialSync(v4, 1);
+   assert(v4.mSynced == 2);
+   assert(v6.mSynced == 0);
+   db.initialSync(v6, 1);
+   assert(v4.mSynced == 2);
+   assert(v6.mSynced == 2);
+
+   db.removeHandler(&v6);
+   db.removeHandler(&v4);
+}
+
+void
+testPurge()
+{
+   uint64_t now = Timer::getTimeSecs();
+   {
+      InMemorySyncRegDb db(60);
+      ContactList contacts;
+      contacts.push_back(makeContact("sip:dave@1.2.3.4", now - 100, now - 200));  // lingered out
+      contacts.push_back(makeContact("sip:dave@5.6.7.8", 0, now - 30));           // still lingering
+      db.addAor(Uri("sip:dave@example.com"), contacts);
+      contacts.clear();
+      contacts.push_back(makeContact("sip:erin@1.2.3.4", 0, now - 61));
+      db.addAor(Uri("sip:erin@example.com"), contacts);
+      assert(aorCount(db) == 2);
+
+      db.purgeExpired();
+      assert(aorCount(db) == 1);
+      db.getContactsFull(Uri("sip:dave@example.com"), contacts);
+      assert(contacts.size() == 1 && contacts.front().mContact.uri().host() == "5.6.7.8");
+   }
+   {
+      // Without linger, expired contacts go once they are a second old.
+      // A locked AOR is left alone until it is unlocked.
+      InMemorySyncRegDb db(0, 4);
+      Uri locked("sip:frank@example.com");
+      db.lockRecord(locked);
+      db.updateContact(locked, makeContact("sip:frank@1.2.3.4", now - 1, now - 10));
+      for (int i = 0; i < 100; ++i)
+      {
+         Data user("user" + Data(i));
+         db.updateContact(Uri("sip:" + user + "@example.com"),
+                          makeContact("sip:" + user + "@1.2.3.4", i % 2 ? now + 3600 : now - 1, now - 10));
+      }
+      // the updates themselves purge what has come due on their shard
+      assert(aorCount(db) < 101 && aorCount(db) >= 51);
+      db.purgeExpired();
+      assert(aorCount(db) == 51);
+      db.unlockRecord(locked);
+      db.purgeExpired();
+      assert(aorCount(db) == 50);
+   }
+}
+
+class Waiter : public ThreadIf
+{
+   public:
+      Waiter(InMemorySyncRegDb& db, const Uri& aor) : mDb(db), mAor(aor), mLocked(false) {}
+      virtual void thread()
+      {
+         mDb.lockRecord(mAor);
+         mLocked = true;
+         mDb.unlockRecord(mAor);
+      }
+      InMemorySyncRegDb& mDb;
+      Uri mAor;
+      volatile bool mLocked;
+};
+
+void
+testLockRecord()
+{
+   InMemorySyncRegDb db;
+   Uri aor("sip:grace@example.com");
+   db.lockRecord(aor);
+   Waiter waiter(db, aor);
+   waiter.run();
+   sleepMs(100);
+   assert(!waiter.mLocked);
+   db.unlockRecord(aor);
+   waiter.join();
+   assert(waiter.mLocked);
+}
+
+// Each worker refreshes a contact of one of its AORs and then looks up
+// another AOR, as a registrar and the location server would.
+class Worker : public ThreadIf
+{
+   public:
+      Worker(InMemorySyncRegDb& db, const vector<Uri>& aors, unsigned int seed, unsigned int ops) :
+         mDb(db), mAors(aors), mSeed(seed), mOps(ops) {}
+      virtual void thread()
+      {
+         uint64_t now = Timer::getTimeSecs();
+         ContactList contacts;
+         for (unsigned int i = 0; i < mOps; ++i)
+         {
+            mSeed = mSeed * 1103515245 + 12345;
+            const Uri& aor = mAors[(mSeed >> 8) % mAors.size()];
+            ContactInstanceRecord rec;
+            rec.mContact.uri() = aor;
+            rec.mContact.uri().host() = "10.0.0.1";
+            rec.mRegExpires = now + 3600;
+            rec.mLastUpdated = now;
+            mDb.lockRecord(aor);
+            mDb.updateContact(aor, rec);
+            mDb.unlockRecord(aor);
+            mDb.getContacts(mAors[(mSeed >> 4) % mAors.size()], contacts);
+         }
+      }
+      InMemorySyncRegDb& mDb;
+      const vector<Uri>& mAors;
+      unsigned int mSeed;
+      unsigned int mOps;
+};
+
+void
+benchmark(unsigned int shards, unsigned int aorCount, unsigned int threads, unsigned int ops)
+{
+   InMemorySyncRegDb db(0, shards);
+   vector<Uri> aors;
+   aors.reserve(aorCount);
+   for (unsigned int i = 0; i < aorCount; ++i)
+   {
+      aors.push_back(Uri("sip:user" + Data(i) + "@example.com"));
+   }
+
+   uint64_t start = Timer::getTimeMs();
+   ContactList contacts;
+   uint64_t now = Timer::getTimeSecs();
+   for (unsigned int i = 0; i < aorCount; ++i)
+   {
+      contacts.clear();
+      ContactInstanceRecord rec;
+      rec.mContact.uri() = aors[i];
+      rec.mRegExpires = now + 3600;
+      rec.mLastUpdated = now;
+      contacts.push_back(rec);
+      db.addAor(aors[i], contacts);
+   }
+   uint64_t loaded = Timer::getTimeMs();
+
+   vector<Worker*> workers;
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      workers.push_back(new Worker(db, aors, t + 1, ops));
+   }
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      workers[t]->run();
+   }
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      workers[t]->join();
+      delete workers[t];
+   }
+   uint64_t done = Timer::getTimeMs();
+
+   uint64_t elapsed = resipMax(done - loaded, uint64_t(1));
+   cerr << shards << " shard(s): loaded " << aorCount << " AORs in " << (loaded - start) << "ms, "
+        << threads << " threads did " << threads * ops << " register+lookup pairs in "
+        << elapsed << "ms (" << (uint64_t(threads) * ops * 1000 / elapsed) << "/s)" << endl;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testKeys();
+   testBasic();
+   testLinger();
+   testInitialSync();
+   testPurge();
+   testLockRecord();
+
+   unsigned int aors = argc > 1 ? atoi(argv[1]) : 20000;
+   unsigned int threads = argc > 2 ? atoi(argv[2]) : 4;
+   unsigned int ops = argc > 3 ? atoi(argv[3]) : 10000;
+   benchmark(1, aors, threads, ops);
+   benchmark(InMemorySyncRegDb::DefaultShards, aors, threads, ops);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,411 @@
+#if !defined(RESIP_BRANCHINDEX_HXX)
+#define RESIP_BRANCHINDEX_HXX
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @internal
+
+   @brief Open addressing hash index of objects keyed by a branch or
+   transaction id; the storage behind TransactionMap.  ConnectionManager
+   uses it too, keyed by Tuple.
+
+   The index holds pointers and does not own the objects.  Traits supplies
+   @code
+      static const Key& key(const T&);
+      static size_t hash(const T&);  // key(t).caseInsensitiveTokenHash()
+   @endcode
+   where the hash is meant to be computed once, when the object is created.
+   Data keys compare case insensitively, other keys with operator==.
+
+   Each slot holds the object pointer next to its hash, so probing only
+   dereferences objects whose full hash matches.  The slots form a
+   power-of-two array with linear probing, kept at most half full, and
+   erase() shifts later entries back rather than leaving tombstones.
+
+   Resizing is incremental.  When the array needs to grow (or can shrink)
+   a new one is allocated and every following insert() and erase() moves a
+   few slots of the old array over, so no single call pays for rehashing a
+   large map.  Until the old array is drained find() looks in both.  New
+   entries only ever go into the new array, and entries leaving the old
+   one are replaced by tombstones: shifting them back would move entries
+   behind the migration cursor.  Arrays come zeroed from calloc, which for
+   large sizes maps fresh pages lazily, so allocating one does not touch it
+   all at once either.
+*/
+template <class T, class Traits, class Key = Data>
+class BranchIndex
+{
+   public:
+      enum
+      {
+         MinCapacity = 64,
+         MigrateSlots = 64 // old slots moved per insert()/erase()
+      };
+
+      BranchIndex() :
+         mSize(0),
+         mOldSize(0),
+         mMigrateCursor(0)
+      {
+         mTable.allocate(MinCapacity);
+      }
+
+      ~BranchIndex()
+      {
+         mTable.release();
+         mOld.release();
+      }
+
+      size_t size() const
+      {
+         return mSize + mOldSize;
+      }
+
+      bool empty() const
+      {
+         return size() == 0;
+      }
+
+      /// slots allocated, including an array still being drained
+      size_t capacity() const
+      {
+         return mTable.size + mOld.size;
+      }
+
+      bool isRehashing() const
+      {
+         return mOld.size != 0;
+      }
+
+      T* find(const Key& key, size_t hash) const
+      {
+         T* entry = lookup(mTable, key, hash);
+         if (entry == 0 && mOld.size != 0)
+         {
+            entry = lookup(mOld, key, hash);
+         }
+         return entry;
+      }
+
+      /// entry's key must not be in the index already
+      void insert(T* entry)
+      {
+         resip_assert(entry);
+         migrate();
+         if ((mSize + 1) * 2 > mTable.size)
+         {
+            // only reachable while draining under a burst of inserts;
+            // finish the job before starting another
+            while (mOld.size != 0)
+            {
+               migrate();
+            }
+            startRehash(mTable.size * 2);
+         }
+         place(mTable, entry, Traits::hash(*entry));
+         ++mSize;
+      }
+
+      /// returns the entry that was removed, or 0 if key was not there
+      T* erase(const Key& key, size_t hash)
+      {
+         T* entry = remove(key, hash);
+         if (entry)
+         {
+            --mSize;
+         }
+         else if (mOld.size != 0)
+         {
+            entry = removeFromOld(key, hash);
+            if (entry)
+            {
+               --mOldSize;
+            }
+         }
+
+         if (entry)
+         {
+            migrate();
+            if (mOld.size == 0 && mTable.size > MinCapacity && mSize * 8 < mTable.size)
+            {
+               startRehash(mTable.size / 2);
+            }
+         }
+         return entry;
+      }
+
+      /// appends every entry to entries, in no particular order
+      void getAll(std::vector<T*>& entries) const
+      {
+         collect(mTable, entries);
+         collect(mOld, entries);
+      }
+
+   private:
+      // An empty slot has entry 0 and hash 0, i.e. all zero bytes.  A
+      // tombstone, which only occurs in the array being drained, has entry 0
+      // and hash 1.
+      struct Slot
+      {
+         T* entry;
+         size_t hash;
+      };
+
+      struct Table
+      {
+         Table() : slots(0), size(0) {}
+         void allocate(size_t n)
+         {
+            resip_assert(slots == 0);
+            slots = static_cast<Slot*>(calloc(n, sizeof(Slot)));
+            if (slots == 0)
+            {
+               throw std::bad_alloc();
+            }
+            size = n;
+         }
+         void release()
+         {
+            free(slots);
+            slots = 0;
+            size = 0;
+         }
+         Slot& operator[](size_t i) { return slots[i]; }
+         const Slot& operator[](size_t i) const { return slots[i]; }
+
+         Slot* slots;
+         size_t size;
+      };
+
+      static bool keyEquals(const Data& k1, const Data& k2)
+      {
+         return isEqualNoCase(k1, k2);
+      }
+
+      template <class K>
+      static bool keyEquals(const K& k1, const K& k2)
+      {
+         return k1 == k2;
+      }
+
+      static size_t home(size_t hash, size_t mask)
+      {
+         return (hash ^ (hash >> 15)) & mask;
+      }
+
+      static T* lookup(const Table& table, const Key& key, size_t hash)
+      {
+         const size_t mask = table.size - 1;
+         for (size_t i = home(hash, mask);; i = (i + 1) & mask)
+         {
+            const Slot& slot = table[i];
+            if (slot.entry)
+            {
+               if (slot.hash == hash && keyEquals(Traits::key(*slot.entry), key))
+               {
+                  return slot.entry;
+               }
+            }
+            else if (slot.hash == 0)
+            {
+               return 0;
+            }
+         }
+      }
+
+      static void place(Table& table, T* entry, size_t hash)
+      {
+         const size_t mask = table.size - 1;
+         size_t i = home(hash, mask);
+         while (table[i].entry)
+         {
+            i = (i + 1) & mask;
+         }
+         table[i].entry = entry;
+         table[i].hash = hash;
+      }
+
+      static void collect(const Table& table, std::vector<T*>& entries)
+      {
+         for (size_t i = 0; i < table.size; ++i)
+         {
+            if (table[i].entry)
+            {
+               entries.push_back(table[i].entry);
+            }
+         }
+      }
+
+      T* remove(const Key& key, size_t hash)
+      {
+         const size_t mask = mTable.size - 1;
+         size_t i = home(hash, mask);
+         for (;; i = (i + 1) & mask)
+         {
+            const Slot& slot = mTable[i];
+            if (slot.entry == 0)
+            {
+               return 0;
+            }
+            if (slot.hash == hash && keyEquals(Traits::key(*slot.entry), key))
+            {
+               break;
+            }
+         }
+
+         T* entry = mTable[i].entry;
+         // move back any following entry whose home is not in (i, j], so
+         // that no probe sequence crosses the slot being emptied
+         for (size_t j = (i + 1) & mask; mTable[j].entry; j = (j + 1) & mask)
+         {
+            size_t h = home(mTable[j].hash, mask);
+            bool movable = (i <= j) ? (h <= i || h > j) : (h <= i && h > j);
+            if (movable)
+            {
+               mTable[i] = mTable[j];
+               i = j;
+            }
+         }
+         mTable[i].entry = 0;
+         mTable[i].hash = 0;
+         return entry;
+      }
+
+      T* removeFromOld(const Key& key, size_t hash)
+      {
+         const size_t mask = mOld.size - 1;
+         for (size_t i = home(hash, mask);; i = (i + 1) & mask)
+         {
+            Slot& slot = mOld[i];
+            if (slot.entry)
+            {
+               if (slot.hash == hash && keyEquals(Traits::key(*slot.entry), key))
+               {
+                  T* entry = slot.entry;
+                  slot.entry = 0;
+                  slot.hash = 1;
+                  return entry;
+               }
+            }
+            else if (slot.hash == 0)
+            {
+               return 0;
+            }
+         }
+      }
+
+      void startRehash(size_t capacity)
+      {
+         resip_assert(mOld.size == 0);
+         mOld = mTable;
+         mOldSize = mSize;
+         mSize = 0;
+         mTable = Table();
+         mTable.allocate(capacity);
+         mMigrateCursor = 0;
+      }
+
+      void migrate()
+      {
+         if (mOld.size == 0)
+         {
+            return;
+         }
+         size_t end = mMigrateCursor + MigrateSlots;
+         if (end > mOld.size)
+         {
+            end = mOld.size;
+         }
+         for (; mMigrateCursor < end && mOldSize > 0; ++mMigrateCursor)
+         {
+            Slot& slot = mOld[mMigrateCursor];
+            if (slot.entry)
+            {
+               place(mTable, slot.entry, slot.hash);
+               ++mSize;
+               --mOldSize;
+               slot.entry = 0;
+               slot.hash = 1;
+            }
+         }
+         if (mOldSize == 0)
+         {
+            mOld.release();
+            mMigrateCursor = 0;
+         }
+      }
+
+      Table mTable;
+      Table mOld; // being drained into mTable; empty if not resizing
+      size_t mSize;
+      size_t mOldSize;
+      size_t mMigrateCursor;
+
+      // disabled
+      BranchIndex(const BranchIndex&);
+      BranchIndex& operator=(const BranchIndex&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
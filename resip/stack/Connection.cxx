@@ -28,9 +28,44 @@
 using namespace resip;
 
 volatile bool Connection::mEnablePostConnectSocketFuncCall = false;
+unsigned int Connection::MaxWriteBatchBytes = 65536;
+std::atomic<uint64_t> Connection::mWriteCount(0);
+std::atomic<uint64_t> Connection::mWriteMessageCount(0);
+std::atomic<uint64_t> Connection::mWriteByteCount(0);
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
+namespace
+{
+
+// Writes the RFC 6455 header of an unmasked, final, binary frame carrying
+// size bytes; returns its length.
+Data::size_type
+encodeWsFrameHeader(uint64_t size, unsigned char* header)
+{
+   header[0] = 0x82;
+   if(size <= 0x7D)
+   {
+      header[1] = (unsigned char)size;
+      return 2;
+   }
+   else if(size <= 0xFFFF)
+   {
+      header[1] = 0x7E;
+      header[2] = (unsigned char)((size >> 8) & 0xFF);
+      header[3] = (unsigned char)(size & 0xFF);
+      return 4;
+   }
+   header[1] = 0x7F;
+   for(int i = 0; i < 8; ++i)
+   {
+      header[2 + i] = (unsigned char)((size >> (56 - 8 * i)) & 0xFF);
+   }
+   return 10;
+}
+
+}
+
 Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
                        Compression &compression,
                        bool isServer)
@@ -38,6 +73,7 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
      mFirstWriteAfterConnectedPending(false),
      mInWritable(false),
      mFlowTimerEnabled(false),
+     mWhoHash(0),
      mPollItemHandle(0),
      mIsServer(isServer)
 {
@@ -153,68 +189,8 @@ Connection::performWrite()
          mSendingTransmissionFormat = Uncompressed;
       }
    }
-   else if(mSendingTransmissionFormat == WebSocketHandshake)
-   {
-      mSendingTransmissionFormat = WebSocketData;
-   }
-   else if(mSendingTransmissionFormat == WebSocketData)
-   {
-      SendData *dataWs, *oldSd;
-      const Data& dataRaw = mOutstandingSends.front()->data;
-      uint64_t dataSize = 1 + 1 + dataRaw.size();
-      uint64_t lSize = (uint64_t)dataRaw.size();
-      uint8_t* uBuffer;
-
-      if(lSize > 0x7D && lSize <= 0xFFFF)
-      {
-         dataSize += 2;
-      }
-      else if(lSize > 0xFFFF)
-      {
-         dataSize += 8;
-      }
-
-      oldSd = mOutstandingSends.front();
-      dataWs = new SendData(oldSd->destination,
-            Data(Data::Take, new char[(int)dataSize], (Data::size_type)dataSize),
-            oldSd->transactionId,
-            oldSd->sigcompId,
-            false);
-      resip_assert(dataWs && dataWs->data.data());
-      uBuffer = (uint8_t*)dataWs->data.data();
-
-      uBuffer[0] = 0x82;
-      if(lSize <= 0x7D)
-      {
-         uBuffer[1] = (uint8_t)lSize;
-         uBuffer = &uBuffer[2];
-      }
-      else if(lSize <= 0xFFFF)
-      {
-         uBuffer[1] = 0x7E;
-         uBuffer[2] = (uint8_t)((lSize >> 8) & 0xFF);
-         uBuffer[3] = (uint8_t)(lSize & 0xFF);
-         uBuffer = &uBuffer[4];
-      }
-      else
-      {
-         uBuffer[1] = 0x7F;
-         uBuffer[2] = (uint8_t)((lSize >> 56) & 0xFF);
-         uBuffer[3] = (uint8_t)((lSize >> 48) & 0xFF);
-         uBuffer[4] = (uint8_t)((lSize >> 40) & 0xFF);
-         uBuffer[5] = (uint8_t)((lSize >> 32) & 0xFF);
-         uBuffer[6] = (uint8_t)((lSize >> 24) & 0xFF);
-         uBuffer[7] = (uint8_t)((lSize >> 16) & 0xFF);
-         uBuffer[8] = (uint8_t)((lSize >> 8) & 0xFF);
-         uBuffer[9] = (uint8_t)(lSize & 0xFF);
-         uBuffer = &uBuffer[10];
-      }
-
-      memcpy(uBuffer, dataRaw.data(), dataRaw.size());
-      mOutstandingSends.front() = dataWs;
-      dataWs = 0;
-      delete oldSd;
-   }
+   // .WebSocket. The handshake response goes out raw; every message after it
+   // is framed as it is written (see gatherOutstandingSends()).
 
 #ifdef USE_SIGCOMP
    // Perform compression here, if appropriate
@@ -259,10 +235,13 @@ Connection::performWrite()
       }
    }
 
-   const Data& data = mOutstandingSends.front()->data;
-   int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
+   WriteBuffer buffers[MaxWriteBatchBuffers];
+   unsigned char wsHeaders[MaxWriteBatchBuffers][10];
+   int messages = 0;
+   int count = gatherOutstandingSends(buffers, wsHeaders, messages);
+   int nBytes = writeBuffers(buffers, count);
 
-   //DebugLog (<< "Tried to send " << data.size() - mSendPos << " bytes, sent " << nBytes << " bytes");
+   //DebugLog (<< "Tried to send " << messages << " messages in " << count << " buffers, sent " << nBytes << " bytes");
 
    if (nBytes < 0)
    {
@@ -280,16 +259,126 @@ Connection::performWrite()
    {
       // Safe because of the conditional above ( < 0 ).
       Data::size_type bytesWritten = static_cast<Data::size_type>(nBytes);
-      mSendPos += bytesWritten;
-      if (mSendPos == data.size())
+      mWriteCount.fetch_add(1, std::memory_order_relaxed);
+      mWriteByteCount.fetch_add(bytesWritten, std::memory_order_relaxed);
+      consumeOutstandingSends(bytesWritten);
+      return (int)bytesWritten;
+   }
+}
+
+int
+Connection::gatherOutstandingSends(WriteBuffer* buffers, unsigned char (*wsHeaders)[10], int& messages)
+{
+   // Only plain and WebSocket framed streams are gathered; the WebSocket
+   // handshake response and SigComp messages go out one at a time.
+   const bool gather = mSendingTransmissionFormat == Uncompressed ||
+                       mSendingTransmissionFormat == WebSocketData;
+   const bool framed = mSendingTransmissionFormat == WebSocketData;
+
+   int count = 0;
+   Data::size_type total = 0;
+   Data::size_type skip = mSendPos;
+   messages = 0;
+   for (std::list<SendData*>::const_iterator it = mOutstandingSends.begin();
+        it != mOutstandingSends.end() && count < MaxWriteBatchBuffers; ++it)
+   {
+      const SendData& sd = **it;
+      Data::size_type headerSize = framed ? encodeWsFrameHeader(sd.data.size(), wsHeaders[messages]) : 0;
+      if (messages > 0)
       {
-         mSendPos = 0;
-         removeFrontOutstandingSend();
+         // the front message is always written, after that stop at commands,
+         // the byte budget and the buffer limit
+         if (!gather || sd.command != SendData::NoCommand ||
+             total + headerSize + sd.data.size() > MaxWriteBatchBytes ||
+             count + (headerSize ? 2 : 1) > MaxWriteBatchBuffers)
+         {
+            break;
+         }
       }
-      return (int)bytesWritten;
+
+      total += headerSize + sd.data.size() - skip;
+      if (skip < headerSize)
+      {
+         buffers[count].data = (const char*)wsHeaders[messages] + skip;
+         buffers[count].size = int(headerSize - skip);
+         ++count;
+         skip = 0;
+      }
+      else
+      {
+         skip -= headerSize;
+      }
+      if (skip < sd.data.size())
+      {
+         buffers[count].data = sd.data.data() + skip;
+         buffers[count].size = int(sd.data.size() - skip);
+         ++count;
+      }
+      skip = 0;
+      ++messages;
+   }
+   resip_assert(count > 0);
+   return count;
+}
+
+void
+Connection::consumeOutstandingSends(Data::size_type bytesWritten)
+{
+   unsigned char header[10];
+   while (bytesWritten > 0)
+   {
+      const Data& data = mOutstandingSends.front()->data;
+      Data::size_type size = data.size();
+      if (mSendingTransmissionFormat == WebSocketData)
+      {
+         size += encodeWsFrameHeader(data.size(), header);
+      }
+
+      if (bytesWritten < size - mSendPos)
+      {
+         mSendPos += bytesWritten;
+         return;
+      }
+      bytesWritten -= size - mSendPos;
+      mSendPos = 0;
+      if (mSendingTransmissionFormat == WebSocketHandshake)
+      {
+         mSendingTransmissionFormat = WebSocketData;
+      }
+      mWriteMessageCount.fetch_add(1, std::memory_order_relaxed);
+      removeFrontOutstandingSend();
    }
 }
 
+int
+Connection::writeBuffers(const WriteBuffer* buffers, int count)
+{
+   if (count == 1)
+   {
+      return write(buffers[0].data, buffers[0].size);
+   }
+
+   // Rebuilt from the send queue on every attempt, so nothing needs to
+   // survive between writes; one buffer per thread serves all of its
+   // connections, rather than each idle connection holding on to a batch.
+   static thread_local Data batch;
+   batch.clear();
+   for (int i = 0; i < count; ++i)
+   {
+      batch.append(buffers[i].data, buffers[i].size);
+   }
+   return write(batch.data(), int(batch.size()));
+}
+
+Connection::WriteStats
+Connection::getWriteStats()
+{
+   WriteStats stats;
+   stats.writes = mWriteCount.load(std::memory_order_relaxed);
+   stats.messages = mWriteMessageCount.load(std::memory_order_relaxed);
+   stats.bytes = mWriteByteCount.load(std::memory_order_relaxed);
+   return stats;
+}
 
 bool 
 Connection::performWrites(unsigned int max)
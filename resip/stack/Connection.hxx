@@ -1,6 +1,7 @@
 #ifndef RESIP_Connection_hxx
 #define RESIP_Connection_hxx
 
+#include <atomic>
 #include <list>
 
 #include "resip/stack/ConnectionBase.hxx"
@@ -66,7 +67,9 @@ class Connection : public ConnectionBase,
       /// queue data to write and add this to writable list
       void requestWrite(SendData* sendData);
 
-      /// send some or all of a queued data; remove from writable if completely written
+      /** send some or all of the queued data; remove from writable if
+          completely written.  Consecutive queued messages are gathered into
+          one write of up to MaxWriteBatchBytes. */
       int performWrite();
 
       /** Call performWrite() repeatedly, until either the send queue is 
@@ -104,11 +107,40 @@ class Connection : public ConnectionBase,
       static volatile bool mEnablePostConnectSocketFuncCall;
       static void setEnablePostConnectSocketFuncCall(bool enabled = true) { mEnablePostConnectSocketFuncCall = enabled; }
       bool isServer()const;
+
+      /// Upper bound on the bytes gathered into one write; the message at
+      /// the front of the queue is always written whole, whatever its size.
+      static unsigned int MaxWriteBatchBytes;
+      static void setMaxWriteBatchBytes(unsigned int bytes) { MaxWriteBatchBytes = bytes; }
+
+      /// Totals over all connections since startup
+      struct WriteStats
+      {
+            uint64_t writes;    // writes that sent at least one byte
+            uint64_t messages;  // messages completely written
+            uint64_t bytes;     // bytes written
+      };
+      static WriteStats getWriteStats();
+
+      /// One piece of a gathered write
+      struct WriteBuffer
+      {
+            const char* data;
+            int size;
+      };
+      /// Most pieces performWrite() gathers into one write
+      static const int MaxWriteBatchBuffers = 64;
+
    protected:
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+      /** write the buffers in order as one stream, returning the number of
+          bytes written, 0 if the write would block, or -1 on error. The
+          default copies them into one buffer for write(); a retry after a
+          blocked write starts with the same bytes, but the buffer may move. */
+      virtual int writeBuffers(const WriteBuffer* buffers, int count);
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
@@ -120,8 +152,16 @@ class Connection : public ConnectionBase,
    private:
       ConnectionManager& getConnectionManager() const;
       void removeFrontOutstandingSend();
+      int gatherOutstandingSends(WriteBuffer* buffers, unsigned char (*wsHeaders)[10], int& messages);
+      void consumeOutstandingSends(Data::size_type bytesWritten);
+
+      static std::atomic<uint64_t> mWriteCount;
+      static std::atomic<uint64_t> mWriteMessageCount;
+      static std::atomic<uint64_t> mWriteByteCount;
       bool mInWritable;
       bool mFlowTimerEnabled;
+      /// hash of mWho, set by ConnectionManager::addConnection()
+      size_t mWhoHash;
       FdPollItemHandle mPollItemHandle;
       
       /// no default c'tor
@@ -29,7 +29,8 @@ ConnectionManager::ConnectionManager() :
    mReadHead(ConnectionReadList::makeList(&mHead)),
    mLRUHead(ConnectionLruList::makeList(&mHead)),
    mFlowTimerLRUHead(FlowTimerLruList::makeList(&mHead)),
-   mPollGrp(0)
+   mPollGrp(0),
+   mConnectionCount(0)
 {
    DebugLog(<<"ConnectionManager::ConnectionManager() called ");
 }
@@ -46,9 +47,60 @@ ConnectionManager::~ConnectionManager()
 void 
 ConnectionManager::closeConnections()
 {
-   while (!mAddrMap.empty())
+   std::vector<Connection*> connections;
+   mAddrMap.getAll(connections);
+   for (std::vector<Connection*>::iterator i = connections.begin(); i != connections.end(); ++i)
    {
-      delete mAddrMap.begin()->second;
+      delete *i;
+   }
+   resip_assert(mAddrMap.empty());
+}
+
+size_t
+ConnectionManager::hashTuple(const Tuple& tuple)
+{
+   uint64_t hash = tuple.hash() * 0x9E3779B97F4A7C15ULL;
+   return size_t(hash ^ (hash >> 32));
+}
+
+Connection*
+ConnectionManager::findById(Socket socket) const
+{
+#ifdef WIN32
+   IdMap::const_iterator i = mIdMap.find(socket);
+   return i == mIdMap.end() ? 0 : i->second;
+#else
+   return (socket >= 0 && size_t(socket) < mIdMap.size()) ? mIdMap[socket] : 0;
+#endif
+}
+
+void
+ConnectionManager::addId(Connection* connection)
+{
+   Socket socket = connection->getSocket();
+#ifdef WIN32
+   mIdMap[socket] = connection;
+#else
+   resip_assert(socket >= 0);
+   if (size_t(socket) >= mIdMap.size())
+   {
+      mIdMap.resize(resipMax(size_t(socket) + 1, mIdMap.size() * 2), 0);
+   }
+   mIdMap[socket] = connection;
+#endif
+}
+
+void
+ConnectionManager::removeId(Connection* connection)
+{
+   Socket socket = connection->getSocket();
+   if (findById(socket) == connection)
+   {
+#ifdef WIN32
+      mIdMap.erase(socket);
+#else
+      mIdMap[socket] = 0;
+#endif
    }
 }
 
@@ -57,19 +109,19 @@ ConnectionManager::findConnection(const Tuple& addr)
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = findById((Socket)addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who() == addr)
+         if(conn->who() == addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -83,11 +135,11 @@ ConnectionManager::findConnection(const Tuple& addr)
       }
    }
    
-   AddrMap::iterator i = mAddrMap.find(addr);
-   if (i != mAddrMap.end())
+   Connection* conn = mAddrMap.find(addr, hashTuple(addr));
+   if (conn)
    {
       DebugLog(<<"Found connection for tuple "<< addr );
-      return i->second;
+      return conn;
    }
 
    DebugLog(<<"Could not find a connection for " << addr);
@@ -99,19 +151,19 @@ ConnectionManager::findConnection(const Tuple& addr) const
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::const_iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = findById((Socket)addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who()==addr)
+         if(conn->who()==addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -120,11 +172,11 @@ ConnectionManager::findConnection(const Tuple& addr) const
       }
    }
    
-   AddrMap::const_iterator i = mAddrMap.find(addr);
-   if (i != mAddrMap.end())
+   const Connection* conn = mAddrMap.find(addr, hashTuple(addr));
+   if (conn)
    {
       DebugLog(<<"Found connection for tuple "<< addr );
-      return i->second;
+      return conn;
    }
 
    DebugLog(<<"Could not find a connection for " << addr);
@@ -182,12 +234,16 @@ ConnectionManager::removeFromWritable(Connection* conn)
 void
 ConnectionManager::addConnection(Connection* connection)
 {
-   resip_assert(mAddrMap.find(connection->who())==mAddrMap.end());
+   connection->mWhoHash = hashTuple(connection->who());
+   resip_assert(mAddrMap.find(connection->who(), connection->mWhoHash)==0);
 
-   DebugLog (<< "ConnectionManager::addConnection() " << connection->mWho.mFlowKey  << ":" << connection->who() << ", totalConnections=" << mIdMap.size());
-   
-   mAddrMap[connection->who()] = connection;
-   mIdMap[connection->who().mFlowKey] = connection;
+   DebugLog (<< "ConnectionManager::addConnection() " << connection->mWho.mFlowKey  << ":" << connection->who() << ", totalConnections=" << mAddrMap.size());
+
+   // a connection to the same peer is replaced, as it was when this was a
+   // std::map; it stays open and is still removed by removeConnection()
+   mAddrMap.erase(connection->who(), connection->mWhoHash);
+   mAddrMap.insert(connection);
+   addId(connection);
 
    if ( mPollGrp ) 
    {
@@ -199,6 +255,7 @@ ConnectionManager::addConnection(Connection* connection)
       mReadHead->push_back(connection);
    }
    mLRUHead->push_back(connection);
+   mConnectionCount.store(mConnectionCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
    // Garbage collect old connections if agressive is enabled
    if(EnableAgressiveGc)
@@ -206,9 +263,7 @@ ConnectionManager::addConnection(Connection* connection)
       gc(MinimumGcAge, 0);  // cleanup all connections that haven't seen data in last x ms
    }
 
-   //DebugLog (<< "count=" << mAddrMap.count(connection->who()) << "who=" << connection->who() << " mAddrMap=" << Inserter(mAddrMap));
-   //assert(mAddrMap.begin()->first == connection->who());
-   resip_assert(mAddrMap.count(connection->who()) == 1);
+   resip_assert(mAddrMap.find(connection->who(), connection->mWhoHash) == connection);
 }
 
 void
@@ -216,8 +271,12 @@ ConnectionManager::removeConnection(Connection* connection)
 {
    DebugLog (<< "ConnectionManager::removeConnection()");
 
-   mIdMap.erase(connection->mWho.mFlowKey);
-   mAddrMap.erase(connection->mWho);
+   mConnectionCount.store(mConnectionCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+   removeId(connection);
+   if (mAddrMap.find(connection->mWho, connection->mWhoHash) == connection)
+   {
+      mAddrMap.erase(connection->mWho, connection->mWhoHash);
+   }
 
    if ( mPollGrp ) 
    {
@@ -308,13 +367,13 @@ ConnectionManager::gc(uint64_t relThreshold, unsigned int maxToRemove)
       else
       {
          rlim_t& soft_limit = rlim.rlim_cur;
-         AddrMap::size_type conn_count = mAddrMap.size();
-         AddrMap::size_type headroom = soft_limit - conn_count;
+         size_t conn_count = mAddrMap.size();
+         size_t headroom = soft_limit - conn_count;
          DebugLog(<< "GC headroom check: soft_limit = " << soft_limit << ", managed connection count = " << conn_count << ", headroom = " << headroom << ", minimum headroom = " << MinimumGcHeadroom);
          if(headroom < MinimumGcHeadroom)
          {
             WarningLog(<< "actual headroom = " << headroom << ", MinimumGcHeadroom = " << MinimumGcHeadroom << ", garbage collector making extra effort to reclaim file descriptors");
-            AddrMap::size_type mustRemove = MinimumGcHeadroom - headroom;
+            size_t mustRemove = MinimumGcHeadroom - headroom;
             unsigned int remainder = gcWithTarget(mustRemove);
             numRemoved += (mustRemove - remainder);
             if(remainder > 0)
@@ -470,9 +529,11 @@ ConnectionManager::setPollGrp(FdPollGrp *grp)
 void 
 ConnectionManager::invokeAfterSocketCreationFunc() const
 {
-    for (AddrMap::const_iterator it = mAddrMap.begin(); it != mAddrMap.end(); it++)
+    std::vector<Connection*> connections;
+    mAddrMap.getAll(connections);
+    for (std::vector<Connection*>::const_iterator it = connections.begin(); it != connections.end(); it++)
     {
-        it->second->invokeAfterSocketCreationFunc();
+        (*it)->invokeAfterSocketCreationFunc();
     }
 }
 
@@ -1,8 +1,10 @@
 #ifndef RESIP_ConnectionMgr_hxx
 #define RESIP_ConnectionMgr_hxx 
 
-#include <map>
+#include <atomic>
+#include <vector>
 #include "rutil/HashMap.hxx"
+#include "resip/stack/BranchIndex.hxx"
 #include "resip/stack/Connection.hxx"
 
 namespace resip
@@ -14,7 +16,9 @@ class FdPollGrp;
    orders for read and write.  Maintains least-recently-used connections list
    for garbage collection.
 
-   Maintains mapping from Tuple to Connection.
+   Maintains mapping from Tuple to Connection, in an open addressing hash
+   index, and from socket to Connection, in a vector indexed by descriptor
+   (a hash map on Windows, where sockets are handles).
  */
 class ConnectionManager
 {
@@ -49,12 +53,35 @@ class ConnectionManager
 
       virtual void invokeAfterSocketCreationFunc() const;
 
+      /// number of open connections; safe to call from any thread
+      unsigned int getConnectionCount() const { return mConnectionCount.load(std::memory_order_relaxed); }
+
    private:
       void addToWritable(Connection* conn); // add the specified conn to end
       void removeFromWritable(Connection* conn); // remove the current mWriteMark
 
-      typedef std::map<Tuple, Connection*> AddrMap;
-      typedef std::map<Socket, Connection*> IdMap;
+      /**
+         @internal
+      */
+      class ConnectionTraits
+      {
+         public:
+            static const Tuple& key(const Connection& connection) { return connection.mWho; }
+            static size_t hash(const Connection& connection) { return connection.mWhoHash; }
+      };
+      typedef BranchIndex<Connection, ConnectionTraits, Tuple> AddrMap;
+#ifdef WIN32
+      typedef HashMap<Socket, Connection*> IdMap;
+#else
+      typedef std::vector<Connection*> IdMap;
+#endif
+
+      /// Tuple::hash() is a plain sum of address, port and transport;
+      /// spread it over all the bits used to pick a slot
+      static size_t hashTuple(const Tuple& tuple);
+      Connection* findById(Socket socket) const;
+      void addId(Connection* connection);
+      void removeId(Connection* connection);
 
       void addConnection(Connection* connection);
       void removeConnection(Connection* connection);
@@ -86,6 +113,9 @@ class ConnectionManager
 
       /// collection for epoll
       FdPollGrp* mPollGrp;
+
+      /// only written by the transport's thread
+      std::atomic<unsigned int> mConnectionCount;
       //<<---------------------------------
 
       friend class TcpBaseTransport;
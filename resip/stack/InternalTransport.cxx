@@ -42,7 +42,9 @@ InternalTransport::InternalTransport(Fifo<TransactionMessage>& rxFifo,
    mTxFifoOutBuffer(mTxFifo),
    mPollGrp(NULL),
    mPollItemHandle(NULL)
-{}
+{
+   mTxFifo.enableWaitTimeSampling();
+}
 
 InternalTransport::~InternalTransport()
 {
@@ -167,6 +169,23 @@ InternalTransport::bind()
    DebugLog (<< "Binding to " << Tuple::inet_ntop(mTuple)); 
 #endif
 
+   if (mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT)
+   {
+#if defined(SO_REUSEPORT)
+      int on = 1;
+      if ( ::setsockopt(mFd, SOL_SOCKET, SO_REUSEPORT, (const char*)&on, sizeof(on)) )
+      {
+         int e = getErrno();
+         error(e);
+         ErrLog (<< "Couldn't set sockoptions SO_REUSEPORT: " << strError(e));
+         throw Transport::Exception("Failed setsockopt SO_REUSEPORT", __FILE__,__LINE__);
+      }
+#else
+      ErrLog (<< "SO_REUSEPORT is not supported on this platform");
+      throw Transport::Exception("SO_REUSEPORT not supported", __FILE__,__LINE__);
+#endif
+   }
+
    if ( ::bind( mFd, &mTuple.getMutableSockaddr(), mTuple.length()) == SOCKET_ERROR )
    {
       int e = getErrno();
@@ -215,6 +234,18 @@ InternalTransport::getFifoSize() const
    return mTxFifo.size();
 }
 
+void
+InternalTransport::addFifoWaitTimes(LatencyHistogram& histogram) const
+{
+   mTxFifo.addWaitTimes(histogram);
+}
+
+void
+InternalTransport::zeroOutFifoWaitTimes()
+{
+   mTxFifo.zeroOutWaitTimes();
+}
+
 bool
 InternalTransport::hasDataToSend() const
 {
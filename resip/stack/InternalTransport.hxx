@@ -63,6 +63,8 @@ class InternalTransport : public Transport
 
       // used for statistics
       virtual unsigned int getFifoSize() const;
+      virtual void addFifoWaitTimes(LatencyHistogram& histogram) const;
+      virtual void zeroOutFifoWaitTimes();
       virtual void send(std::unique_ptr<SendData> data);
       virtual void poke();
       
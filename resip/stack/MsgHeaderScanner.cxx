@@ -8,9 +8,16 @@
 #include "resip/stack/HeaderTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
+#include "rutil/RecyclingPool.hxx"
+#include "rutil/ResipAssert.h"
 #include "rutil/WinLeakCheck.hxx"
 #include "rutil/Logger.hxx"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESIP_MSG_HEADER_SCANNER_X86
+#include <immintrin.h>
+#endif
+
 #define RESIPROCATE_SUBSYSTEM Subsystem::SIP
 
 namespace resip 
@@ -48,6 +55,31 @@ MsgHeaderScanner::allocateBuffer(size_t size)
    return new char[size + MaxNumCharsChunkOverflow];
 }
 
+namespace
+{
+struct RecycledBufferTag {};
+typedef RecyclingPool<RecycledBufferTag, MsgHeaderScanner::RecycledBufferSize> RecycledBufferPool;
+}
+
+char*
+MsgHeaderScanner::allocateRecycledBuffer(size_t size)
+{
+   resip_assert(size + MaxNumCharsChunkOverflow <= RecycledBufferSize);
+   return static_cast<char*>(RecycledBufferPool::allocate());
+}
+
+void
+MsgHeaderScanner::freeRecycledBuffer(char* buffer)
+{
+   RecycledBufferPool::deallocate(buffer);
+}
+
+void
+MsgHeaderScanner::setRecycledBufferCacheSize(unsigned int buffersPerThread)
+{
+   RecycledBufferPool::setCacheSize(buffersPerThread);
+}
+
 struct CharInfo
 {
       CharCategory category;
@@ -415,6 +447,272 @@ static void initStateMachine()
                   sMsgStart); // Arbitrary but possibly handy.
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//   Most of a message header is scanned in a few states that loop on all but a
+//   handful of characters: the status line, values, and the quoted and angle
+//   bracketed parts of multi-values.  Where the CPU allows, the scanner skips
+//   through such a run 16 or 32 characters at a time up to the next character
+//   that could leave the state, folding the text properties of the skipped
+//   characters into the text's bit mask as the per-character loop would.
+//
+//   The run states and their stop characters are derived from the state
+//   machine.  Carriage return, line feed and the chunk terminating sentinel
+//   always stop a run; "stopChars" holds up to three more (padded with
+//   carriage returns).  Stopping early is always safe since the
+//   per-character loop takes over from there.
+
+struct RunInfo
+{
+      bool isRun;
+      char stopChars[3];
+};
+
+static RunInfo runInfoArray[numStates];
+
+static void initRunInfoArray()
+{
+   for (int state = 0; state < numStates; ++state)
+   {
+      RunInfo& runInfo = runInfoArray[state];
+      runInfo.isRun = false;
+      const TransitionInfo& otherTransition = stateMachine[state][ccOther];
+      if (otherTransition.action != taNone || otherTransition.nextState != state)
+      {
+         continue;
+      }
+      int numStopChars = 0;
+      bool fits = true;
+      for (unsigned int charIndex = 0; charIndex <= UCHAR_MAX; ++charIndex)
+      {
+         if (charIndex == '\r' || charIndex == '\n' ||
+             charIndex == (unsigned char)chunkTermSentinelChar)
+         {
+            continue;
+         }
+         const TransitionInfo& transition =
+            stateMachine[state][c2i(charInfoArray[charIndex].category)];
+         if (transition.action == taNone && transition.nextState == state)
+         {
+            continue;
+         }
+         if (numStopChars == sizeof(runInfo.stopChars))
+         {
+            fits = false;
+            break;
+         }
+         runInfo.stopChars[numStopChars++] = (char)charIndex;
+      }
+      while (numStopChars < (int)sizeof(runInfo.stopChars))
+      {
+         runInfo.stopChars[numStopChars++] = '\r';
+      }
+      runInfo.isRun = fits;
+   }
+}
+
+// Returns the first stop character at or after "charPtr", or the character
+// from which fewer than a full vector remains before "endPtr".
+typedef char* (*SkipRunFunction)(char* charPtr,
+                                 const char* endPtr,
+                                 const char* stopChars,
+                                 MsgHeaderScanner::TextPropBitMask* textPropBitMask);
+
+#if defined(RESIP_MSG_HEADER_SCANNER_X86)
+
+// Loaded at (prefixMaskBytes + 32 - n), the first n bytes are all ones.
+alignas(32) static const unsigned char prefixMaskBytes[64] =
+{
+   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+__attribute__((target("sse2")))
+static char* skipRunSse2(char* charPtr,
+                         const char* endPtr,
+                         const char* stopChars,
+                         MsgHeaderScanner::TextPropBitMask* textPropBitMask)
+{
+   const __m128i carriageReturn = _mm_set1_epi8('\r');
+   const __m128i lineFeed = _mm_set1_epi8('\n');
+   const __m128i sentinel = _mm_set1_epi8(chunkTermSentinelChar);
+   const __m128i stop0 = _mm_set1_epi8(stopChars[0]);
+   const __m128i stop1 = _mm_set1_epi8(stopChars[1]);
+   const __m128i stop2 = _mm_set1_epi8(stopChars[2]);
+   __m128i whitespace = _mm_setzero_si128();
+   __m128i backslash = _mm_setzero_si128();
+   __m128i percent = _mm_setzero_si128();
+   __m128i semicolon = _mm_setzero_si128();
+   __m128i paren = _mm_setzero_si128();
+   while (endPtr - charPtr >= 16)
+   {
+      __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(charPtr));
+      __m128i stops =
+         _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, carriageReturn),
+                                   _mm_cmpeq_epi8(chars, lineFeed)),
+                      _mm_or_si128(_mm_cmpeq_epi8(chars, sentinel),
+                                   _mm_or_si128(_mm_cmpeq_epi8(chars, stop0),
+                                                _mm_or_si128(_mm_cmpeq_epi8(chars, stop1),
+                                                             _mm_cmpeq_epi8(chars, stop2)))));
+      unsigned int stopBits = (unsigned int)_mm_movemask_epi8(stops);
+      __m128i skipped = _mm_set1_epi8(-1);
+      if (stopBits)
+      {
+         skipped = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                      prefixMaskBytes + 32 - __builtin_ctz(stopBits)));
+      }
+      whitespace = _mm_or_si128(whitespace,
+                                _mm_and_si128(skipped,
+                                              _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                                           _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')))));
+      backslash = _mm_or_si128(backslash,
+                               _mm_and_si128(skipped, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))));
+      percent = _mm_or_si128(percent,
+                             _mm_and_si128(skipped, _mm_cmpeq_epi8(chars, _mm_set1_epi8('%'))));
+      semicolon = _mm_or_si128(semicolon,
+                               _mm_and_si128(skipped, _mm_cmpeq_epi8(chars, _mm_set1_epi8(';'))));
+      paren = _mm_or_si128(paren,
+                           _mm_and_si128(skipped,
+                                         _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('(')),
+                                                      _mm_cmpeq_epi8(chars, _mm_set1_epi8(')')))));
+      if (stopBits)
+      {
+         charPtr += __builtin_ctz(stopBits);
+         break;
+      }
+      charPtr += 16;
+   }
+   MsgHeaderScanner::TextPropBitMask mask = *textPropBitMask;
+   if (_mm_movemask_epi8(whitespace)) mask |= MsgHeaderScanner::tpbmContainsWhitespace;
+   if (_mm_movemask_epi8(backslash)) mask |= MsgHeaderScanner::tpbmContainsBackslash;
+   if (_mm_movemask_epi8(percent)) mask |= MsgHeaderScanner::tpbmContainsPercent;
+   if (_mm_movemask_epi8(semicolon)) mask |= MsgHeaderScanner::tpbmContainsSemicolon;
+   if (_mm_movemask_epi8(paren)) mask |= MsgHeaderScanner::tpbmContainsParen;
+   *textPropBitMask = mask;
+   return charPtr;
+}
+
+__attribute__((target("avx2")))
+static char* skipRunAvx2(char* charPtr,
+                         const char* endPtr,
+                         const char* stopChars,
+                         MsgHeaderScanner::TextPropBitMask* textPropBitMask)
+{
+   const __m256i carriageReturn = _mm256_set1_epi8('\r');
+   const __m256i lineFeed = _mm256_set1_epi8('\n');
+   const __m256i sentinel = _mm256_set1_epi8(chunkTermSentinelChar);
+   const __m256i stop0 = _mm256_set1_epi8(stopChars[0]);
+   const __m256i stop1 = _mm256_set1_epi8(stopChars[1]);
+   const __m256i stop2 = _mm256_set1_epi8(stopChars[2]);
+   __m256i whitespace = _mm256_setzero_si256();
+   __m256i backslash = _mm256_setzero_si256();
+   __m256i percent = _mm256_setzero_si256();
+   __m256i semicolon = _mm256_setzero_si256();
+   __m256i paren = _mm256_setzero_si256();
+   bool stopped = false;
+   while (endPtr - charPtr >= 32)
+   {
+      __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(charPtr));
+      __m256i stops =
+         _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, carriageReturn),
+                                         _mm256_cmpeq_epi8(chars, lineFeed)),
+                         _mm256_or_si256(_mm256_cmpeq_epi8(chars, sentinel),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(chars, stop0),
+                                                         _mm256_or_si256(_mm256_cmpeq_epi8(chars, stop1),
+                                                                         _mm256_cmpeq_epi8(chars, stop2)))));
+      unsigned int stopBits = (unsigned int)_mm256_movemask_epi8(stops);
+      __m256i skipped = _mm256_set1_epi8(-1);
+      if (stopBits)
+      {
+         skipped = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                                         prefixMaskBytes + 32 - __builtin_ctz(stopBits)));
+      }
+      whitespace = _mm256_or_si256(whitespace,
+                                   _mm256_and_si256(skipped,
+                                                    _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                                                                    _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t')))));
+      backslash = _mm256_or_si256(backslash,
+                                  _mm256_and_si256(skipped, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\\'))));
+      percent = _mm256_or_si256(percent,
+                                _mm256_and_si256(skipped, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('%'))));
+      semicolon = _mm256_or_si256(semicolon,
+                                  _mm256_and_si256(skipped, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(';'))));
+      paren = _mm256_or_si256(paren,
+                              _mm256_and_si256(skipped,
+                                               _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('(')),
+                                                               _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(')')))));
+      if (stopBits)
+      {
+         charPtr += __builtin_ctz(stopBits);
+         stopped = true;
+         break;
+      }
+      charPtr += 32;
+   }
+   MsgHeaderScanner::TextPropBitMask mask = *textPropBitMask;
+   if (_mm256_movemask_epi8(whitespace)) mask |= MsgHeaderScanner::tpbmContainsWhitespace;
+   if (_mm256_movemask_epi8(backslash)) mask |= MsgHeaderScanner::tpbmContainsBackslash;
+   if (_mm256_movemask_epi8(percent)) mask |= MsgHeaderScanner::tpbmContainsPercent;
+   if (_mm256_movemask_epi8(semicolon)) mask |= MsgHeaderScanner::tpbmContainsSemicolon;
+   if (_mm256_movemask_epi8(paren)) mask |= MsgHeaderScanner::tpbmContainsParen;
+   *textPropBitMask = mask;
+   // Finish a run that ends within the last 32 characters 16 at a time.
+   return stopped ? charPtr : skipRunSse2(charPtr, endPtr, stopChars, textPropBitMask);
+}
+
+#endif // defined(RESIP_MSG_HEADER_SCANNER_X86)
+
+static bool isScanImplementationSupported(MsgHeaderScanner::ScanImplementation impl)
+{
+   switch (impl)
+   {
+      case MsgHeaderScanner::siScalar:
+         return true;
+#if defined(RESIP_MSG_HEADER_SCANNER_X86)
+      case MsgHeaderScanner::siSse2:
+         __builtin_cpu_init();
+         return __builtin_cpu_supports("sse2");
+      case MsgHeaderScanner::siAvx2:
+         __builtin_cpu_init();
+         return __builtin_cpu_supports("avx2");
+#endif
+      default:
+         return false;
+   }
+}
+
+static MsgHeaderScanner::ScanImplementation bestScanImplementation()
+{
+   if (isScanImplementationSupported(MsgHeaderScanner::siAvx2))
+   {
+      return MsgHeaderScanner::siAvx2;
+   }
+   if (isScanImplementationSupported(MsgHeaderScanner::siSse2))
+   {
+      return MsgHeaderScanner::siSse2;
+   }
+   return MsgHeaderScanner::siScalar;
+}
+
+static SkipRunFunction skipRunFunction(MsgHeaderScanner::ScanImplementation impl)
+{
+   switch (impl)
+   {
+#if defined(RESIP_MSG_HEADER_SCANNER_X86)
+      case MsgHeaderScanner::siSse2:
+         return skipRunSse2;
+      case MsgHeaderScanner::siAvx2:
+         return skipRunAvx2;
+#endif
+      default:
+         return 0;
+   }
+}
+
+static MsgHeaderScanner::ScanImplementation scanImplementation = bestScanImplementation();
+static SkipRunFunction skipRun = skipRunFunction(scanImplementation);
+
 // Debug follows
 #if defined(RESIP_MSG_HEADER_SCANNER_DEBUG)  
 
@@ -920,11 +1218,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
    MsgHeaderScanner::ScanChunkResult result;
    CharInfo* localCharInfoArray = charInfoArray;
    TransitionInfo (*localStateMachine)[numCharCategories] = stateMachine;
+   SkipRunFunction localSkipRun = skipRun;
    State localState = mState;
    char *charPtr = chunk + mPrevScanChunkNumSavedTextChars;
    char *termCharPtr = chunk + chunkLength;
    char saveChunkTermChar = *termCharPtr;
    *termCharPtr = chunkTermSentinelChar;
+   const char *skipRunEndPtr = termCharPtr + 1;
    char *textStartCharPtr;
    MsgHeaderScanner::TextPropBitMask localTextPropBitMask = mTextPropBitMask;
    if (mPrevScanChunkNumSavedTextChars == 0)
@@ -953,7 +1253,17 @@ MsgHeaderScanner::scanChunk(char * chunk,
       printStateTransition(localState, *charPtr, transitionAction);
 #endif
       localState = transitionInfo->nextState;
-      if (transitionAction == taNone) continue;
+      if (transitionAction == taNone)
+      {
+         if (localSkipRun && runInfoArray[(unsigned)localState].isRun)
+         {
+            charPtr = localSkipRun(charPtr + 1,
+                                   skipRunEndPtr,
+                                   runInfoArray[(unsigned)localState].stopChars,
+                                   &localTextPropBitMask) - 1;
+         }
+         continue;
+      }
       // END message header character scan block END
       // The loop remainder is executed about 4-5 times per message header line.
       switch (transitionAction)
@@ -1144,9 +1454,43 @@ MsgHeaderScanner::initialize()
 {
    initCharInfoArray();
    initStateMachine();
+   initRunInfoArray();
+   return true;
+}
+
+bool
+MsgHeaderScanner::setScanImplementation(ScanImplementation impl)
+{
+   if (!isScanImplementationSupported(impl))
+   {
+      return false;
+   }
+   scanImplementation = impl;
+   skipRun = skipRunFunction(impl);
    return true;
 }
 
+MsgHeaderScanner::ScanImplementation
+MsgHeaderScanner::getScanImplementation()
+{
+   return scanImplementation;
+}
+
+const char*
+MsgHeaderScanner::scanImplementationName(ScanImplementation impl)
+{
+   switch (impl)
+   {
+      case siScalar:
+         return "scalar";
+      case siSse2:
+         return "sse2";
+      case siAvx2:
+         return "avx2";
+   }
+   return "unknown";
+}
+
 
 } //namespace resip
 
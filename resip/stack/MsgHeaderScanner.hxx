@@ -57,6 +57,14 @@ class MsgHeaderScanner
    public:
       enum { MaxNumCharsChunkOverflow = 5 };
       static char* allocateBuffer(size_t size);
+
+      // Fixed size buffers that are recycled rather than freed, for
+      // datagrams; size must not exceed RecycledBufferSize less the overflow.
+      // Free with freeRecycledBuffer() (SipMessage::addRecycledBuffer() does).
+      enum { RecycledBufferSize = 4096 };
+      static char* allocateRecycledBuffer(size_t size);
+      static void freeRecycledBuffer(char* buffer);
+      static void setRecycledBufferCacheSize(unsigned int buffersPerThread);
       
       enum TextPropBitMaskEnum 
       {
@@ -71,6 +79,20 @@ class MsgHeaderScanner
     
       inline unsigned int getHeaderCount() const { return mNumHeaders;} 
 
+      // Long runs of ordinary characters are skipped with SSE2 or AVX2 where
+      // the CPU supports it; the default is the fastest available.  All
+      // implementations give the same results, selecting one is for tests
+      // and benchmarks.  Returns false if the CPU does not support "impl".
+      enum ScanImplementation
+      {
+         siScalar,
+         siSse2,
+         siAvx2
+      };
+      static bool setScanImplementation(ScanImplementation impl);
+      static ScanImplementation getScanImplementation();
+      static const char* scanImplementationName(ScanImplementation impl);
+
    private:
     
       // Fields:
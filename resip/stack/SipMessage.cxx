@@ -10,6 +10,7 @@
 #include "resip/stack/ExtensionHeader.hxx"
 #include "rutil/Coders.hxx"
 #include "rutil/CountStream.hxx"
+#include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/DigestStream.hxx"
 #include "rutil/compat.hxx"
@@ -17,7 +18,10 @@
 #include "rutil/Random.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
+#include "rutil/RecyclingPool.hxx"
 //#include "rutil/WinLeakCheck.hxx"  // not compatible with placement new used below
+#include <atomic>
+#include <mutex>
 #include <utility>
 
 using namespace resip;
@@ -122,6 +126,64 @@ SipMessage::KnownHeaders::find(Headers::Type type) noexcept
 
 bool SipMessage::checkContentLength=true;
 
+namespace
+{
+typedef RecyclingPool<SipMessage, sizeof(SipMessage)> MessagePool;
+
+// DinkyPool usage totals, updated as messages are destroyed
+std::atomic<uint64_t> poolMessages(0);
+std::atomic<uint64_t> poolOverflowed(0);
+std::atomic<uint64_t> poolOverflowBytes(0);
+std::atomic<uint64_t> poolMaxOverflowBytes(0);
+std::atomic<uint64_t> poolBytesUsed(0);
+}
+
+#ifndef RESIP_HEAP_COUNT
+void*
+SipMessage::operator new(size_t size)
+{
+   // subclasses that add members are not pooled
+   if (size == sizeof(SipMessage))
+   {
+      return MessagePool::allocate();
+   }
+   return ::operator new(size);
+}
+
+void
+SipMessage::operator delete(void* p, size_t size)
+{
+   if (size == sizeof(SipMessage))
+   {
+      MessagePool::deallocate(p);
+   }
+   else
+   {
+      ::operator delete(p);
+   }
+}
+#endif
+
+void
+SipMessage::setRecyclingCacheSize(unsigned int messagesPerThread)
+{
+   MessagePool::setCacheSize(messagesPerThread);
+   MsgHeaderScanner::setRecycledBufferCacheSize(messagesPerThread);
+}
+
+SipMessage::PoolStats
+SipMessage::getPoolStats()
+{
+   PoolStats stats;
+   stats.messages = poolMessages.load(std::memory_order_relaxed);
+   stats.overflowed = poolOverflowed.load(std::memory_order_relaxed);
+   stats.overflowBytes = poolOverflowBytes.load(std::memory_order_relaxed);
+   stats.maxOverflowBytes = poolMaxOverflowBytes.load(std::memory_order_relaxed);
+   stats.poolBytesUsed = poolBytesUsed.load(std::memory_order_relaxed);
+   stats.poolSize = RESIP_SIPMESSAGE_POOL_SIZE;
+   return stats;
+}
+
 SipMessage::SipMessage(const Tuple *receivedTransportTuple)
    : mIsDecorated(false),
      mIsBadAck200(false),
@@ -191,6 +253,19 @@ SipMessage::~SipMessage()
            << std::endl << *this);
    }
 #endif
+   poolMessages.fetch_add(1, std::memory_order_relaxed);
+   poolBytesUsed.fetch_add(mPool.getPoolBytes(), std::memory_order_relaxed);
+   const uint64_t heapBytes = mPool.getHeapBytes();
+   if (heapBytes > 0)
+   {
+      poolOverflowed.fetch_add(1, std::memory_order_relaxed);
+      poolOverflowBytes.fetch_add(heapBytes, std::memory_order_relaxed);
+      uint64_t max = poolMaxOverflowBytes.load(std::memory_order_relaxed);
+      while (heapBytes > max &&
+             !poolMaxOverflowBytes.compare_exchange_weak(max, heapBytes, std::memory_order_relaxed))
+      {
+      }
+   }
    freeMem();
 }
 
@@ -200,8 +275,11 @@ SipMessage::clear(bool leaveResponseStuff)
    if(!leaveResponseStuff)
    {
       clearHeaders();
+      mEncodedHeaders.reset();
+      mModifiedHeaders.reset();
 
       mBufferList.clear();
+      mRecycledBufferList.clear();
    }
 
    mUnknownHeaders.clear();
@@ -254,6 +332,13 @@ SipMessage::init(const SipMessage& rhs)
                                    i->first,
                                    getCopyHfvl(*i->second)));
    }
+   if (!rhs.mEncodedHeaders && rhs.mIsExternal)
+   {
+      rhs.mEncodedHeaders = std::make_shared<EncodedHeaders>();
+   }
+   mEncodedHeaders = rhs.mEncodedHeaders;
+   mModifiedHeaders = rhs.mModifiedHeaders;
+
    if (rhs.mStartLine != 0)
    {
       mStartLine = rhs.mStartLine->clone(mStartLineMem);
@@ -315,6 +400,11 @@ SipMessage::freeMem(bool leaveResponseStuff)
       {
          delete [] *i;
       }
+      for (vector<char*>::iterator i = mRecycledBufferList.begin();
+           i != mRecycledBufferList.end(); i++)
+      {
+         MsgHeaderScanner::freeRecycledBuffer(*i);
+      }
    }
 
    if(mStartLine)
@@ -791,6 +881,66 @@ SipMessage::encodeSipFrag(EncodeStream& str) const
    return encode(str, true);
 }
 
+// Headers of a message from the wire as they were encoded the first time it,
+// or any copy of it, was sent. Built from whichever of them is encoded first;
+// only the headers that one had not modified are kept, and the content of
+// those is the same in every message sharing this. Read-only once built.
+class SipMessage::EncodedHeaders
+{
+   public:
+      // slot Headers::MAX_HEADERS holds the unknown headers
+      enum { Slots = Headers::MAX_HEADERS + 1 };
+
+      void build(const SipMessage& msg);
+
+      bool has(int slot) const { return mHas[slot]; }
+      Data::size_type begin(int slot) const { return mOffsets[slot]; }
+      Data::size_type end(int slot) const { return mOffsets[slot + 1]; }
+      const char* data() const { return mBuffer.data(); }
+
+      std::once_flag mBuilt;
+
+   private:
+      Data mBuffer;
+      Data::size_type mOffsets[Slots + 1];
+      std::bitset<Slots> mHas;
+};
+
+void
+SipMessage::EncodedHeaders::build(const SipMessage& msg)
+{
+   DataStream str(mBuffer);
+   for (int t = 0; t < Headers::MAX_HEADERS; ++t)
+   {
+      mOffsets[t] = mBuffer.size();
+      const Headers::Type type = static_cast<Headers::Type>(t);
+      if (type == Headers::ContentLength || msg.mModifiedHeaders[t])
+      {
+         continue;
+      }
+      auto it = msg.mKnownHeaders.find(type);
+      if (it != msg.mKnownHeaders.end())
+      {
+         it->getValues()->encode(type, str);
+         str.flush();
+      }
+      mHas.set(t);
+   }
+
+   mOffsets[Headers::MAX_HEADERS] = mBuffer.size();
+   if (!msg.mModifiedHeaders[Headers::MAX_HEADERS])
+   {
+      for (UnknownHeaders::const_iterator i = msg.mUnknownHeaders.begin();
+           i != msg.mUnknownHeaders.end(); i++)
+      {
+         i->second->encode(i->first, str);
+      }
+      str.flush();
+      mHas.set(Headers::MAX_HEADERS);
+   }
+   mOffsets[Slots] = mBuffer.size();
+}
+
 // dynamic_cast &str to DataStream* to avoid CountStream?
 
 EncodeStream&
@@ -820,6 +970,35 @@ SipMessage::encode(EncodeStream& str, bool isSipFrag) const
 #endif
    }
 
+   // Headers that are unchanged since this message came off the wire are
+   // copied out of the shared encoded form; adjacent ones go out as a single
+   // write. The rest are encoded as usual.
+   const EncodedHeaders* encoded = 0;
+   if (mEncodedHeaders)
+   {
+      std::call_once(mEncodedHeaders->mBuilt, [this] { mEncodedHeaders->build(*this); });
+      encoded = mEncodedHeaders.get();
+   }
+   Data::size_type runBegin = 0;
+   Data::size_type runEnd = 0;
+   auto writeRun = [&]()
+   {
+      if (runEnd != runBegin)
+      {
+         str.write(encoded->data() + runBegin, runEnd - runBegin);
+         runBegin = runEnd;
+      }
+   };
+   auto extendRun = [&](int slot)
+   {
+      if (encoded->begin(slot) != runEnd)
+      {
+         writeRun();
+         runBegin = encoded->begin(slot);
+      }
+      runEnd = encoded->end(slot);
+   };
+
    // Iterate by header type enum value (not insertion order) so that headers
    // are encoded in the deterministic, enum-declared order. See the comment in
    // HeaderTypes.hxx: "The Type enum controls the order of output". find() is
@@ -831,17 +1010,41 @@ SipMessage::encode(EncodeStream& str, bool isSipFrag) const
       {
          continue;
       }
+      if (encoded && encoded->has(t) && !mModifiedHeaders[t])
+      {
+         extendRun(t);
+         continue;
+      }
       auto it = mKnownHeaders.find(type);
       if (it != mKnownHeaders.end())
       {
+         if (encoded)
+         {
+            writeRun();
+         }
          it->getValues()->encode(type, str);
       }
    }
 
-   for (UnknownHeaders::const_iterator i = mUnknownHeaders.begin(); 
-        i != mUnknownHeaders.end(); i++)
+   if (encoded && encoded->has(Headers::MAX_HEADERS) && !mModifiedHeaders[Headers::MAX_HEADERS])
    {
-      i->second->encode(i->first, str);
+      extendRun(Headers::MAX_HEADERS);
+   }
+   else
+   {
+      if (encoded)
+      {
+         writeRun();
+      }
+      for (UnknownHeaders::const_iterator i = mUnknownHeaders.begin(); 
+           i != mUnknownHeaders.end(); i++)
+      {
+         i->second->encode(i->first, str);
+      }
+   }
+   if (encoded)
+   {
+      writeRun();
    }
 
    if(!isSipFrag || !contents.empty())
@@ -951,6 +1154,12 @@ SipMessage::addBuffer(char* buf)
    mBufferList.push_back(buf);
 }
 
+void
+SipMessage::addRecycledBuffer(char* buf)
+{
+   mRecycledBufferList.push_back(buf);
+}
+
 void 
 SipMessage::setStartLine(const char* st, int len)
 {
@@ -1232,6 +1441,7 @@ SipMessage::header(const ExtensionHeader& headerName) const
 StringCategories& 
 SipMessage::header(const ExtensionHeader& headerName)
 {
+   mModifiedHeaders.set(Headers::MAX_HEADERS);
    for (UnknownHeaders::iterator i = mUnknownHeaders.begin();
         i != mUnknownHeaders.end(); i++)
    {
@@ -1270,6 +1480,7 @@ SipMessage::exists(const ExtensionHeader& symbol) const
 void
 SipMessage::remove(const ExtensionHeader& headerName)
 {
+   mModifiedHeaders.set(Headers::MAX_HEADERS);
    for (UnknownHeaders::iterator i = mUnknownHeaders.begin();
         i != mUnknownHeaders.end(); i++)
    {
@@ -1286,6 +1497,13 @@ void
 SipMessage::addHeader(Headers::Type header, const char* headerName, int headerLen, 
                       const char* start, int len)
 {
+   // Until the message is first copied there is nothing to invalidate; this is
+   // how it gets its headers from the wire.
+   if (mEncodedHeaders)
+   {
+      mModifiedHeaders.set(header != Headers::UNKNOWN ? header : Headers::MAX_HEADERS);
+   }
+
    if (header != Headers::UNKNOWN)
    {
       resip_assert(header > Headers::UNKNOWN && header < Headers::MAX_HEADERS);
@@ -1466,6 +1684,7 @@ SipMessage::empty(const HeaderBase& headerType) const
 void
 SipMessage::remove(Headers::Type type)
 {
+   mModifiedHeaders.set(type);
    auto it = mKnownHeaders.find(type);
    if (it != mKnownHeaders.end())
       mKnownHeaders.erase(it);
@@ -1490,6 +1709,7 @@ SipMessage::header(const H_##_header& headerType) const
 H_##_header::Type&                                                                                      \
 SipMessage::header(const H_##_header& headerType)                                                       \
 {                                                                                                       \
+   mModifiedHeaders.set(headerType.getTypeNum());                                                       \
    HeaderFieldValueList* hfvs = ensureHeader(headerType.getTypeNum());                           \
    if (hfvs->getParserContainer() == 0)                                                                 \
    {                                                                                                    \
@@ -1515,6 +1735,7 @@ SipMessage::header(const H_##_header##s& headerType) const
 H_##_header##s::Type&                                                                           \
 SipMessage::header(const H_##_header##s& headerType)                                            \
 {                                                                                               \
+   mModifiedHeaders.set(headerType.getTypeNum());                                               \
    HeaderFieldValueList* hfvs = ensureHeaders(headerType.getTypeNum());                  \
    if (hfvs->getParserContainer() == 0)                                                         \
    {                                                                                            \
@@ -1650,6 +1871,7 @@ SipMessage::getRawHeader(Headers::Type headerType) const
 void
 SipMessage::setRawHeader(const HeaderFieldValueList* hfvs, Headers::Type headerType)
 {
+   mModifiedHeaders.set(headerType);
    auto it = mKnownHeaders.find(headerType);
    if (it != mKnownHeaders.end())
    {
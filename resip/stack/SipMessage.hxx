@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 
+#include <bitset>
 #include <list>
 #include <vector>
 #include <utility>
@@ -28,6 +29,12 @@
 #include "rutil/Timer.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 
+// Bytes of header storage embedded in each SipMessage before parsing falls
+// back to the heap; SipMessage::getPoolStats() shows how well this fits.
+#ifndef RESIP_SIPMESSAGE_POOL_SIZE
+#define RESIP_SIPMESSAGE_POOL_SIZE 3732
+#endif
+
 namespace resip
 {
 
@@ -419,6 +426,34 @@ class SipMessage : public TransactionMessage
       
       static bool checkContentLength;
 
+#ifndef RESIP_HEAP_COUNT
+      // SipMessages (and subclasses of the same size) come from a
+      // RecyclingPool; see setRecyclingCacheSize()
+      static void* operator new(size_t size);
+      static void* operator new(size_t size, void* p) { return p; }
+      static void operator delete(void* p, size_t size);
+#endif
+
+      /**
+         @brief Lets each thread keep up to messagesPerThread freed
+         SipMessages, and as many datagram receive buffers, for reuse
+         instead of returning them to the heap.  0 (the default) turns
+         recycling off.
+      */
+      static void setRecyclingCacheSize(unsigned int messagesPerThread);
+
+      /// Usage of the per message DinkyPool, over all messages destroyed so far
+      struct PoolStats
+      {
+            uint64_t messages;         // messages destroyed
+            uint64_t overflowed;       // messages that spilled onto the heap
+            uint64_t overflowBytes;    // total heap bytes used by those
+            uint64_t maxOverflowBytes; // largest spill by a single message
+            uint64_t poolBytesUsed;    // total pool bytes used
+            size_t poolSize;           // RESIP_SIPMESSAGE_POOL_SIZE
+      };
+      static PoolStats getPoolStats();
+
       /**
       @brief Base exception for SipMessage related exceptions
       */
@@ -760,6 +795,8 @@ class SipMessage : public TransactionMessage
       Tuple& getDestination() { return mDestination; }
 
       void addBuffer(char* buf);
+      /// as addBuffer(), for a buffer from MsgHeaderScanner::allocateRecycledBuffer()
+      void addRecycledBuffer(char* buf);
 
       uint64_t getCreatedTimeMicroSec() const {return mCreatedTime;}
 
@@ -821,6 +858,8 @@ class SipMessage : public TransactionMessage
       EncodeStream& 
       encode(EncodeStream& str, bool isSipFrag) const;      
 
+      class EncodedHeaders;
+
       void copyFrom(const SipMessage& message);
 
       HeaderFieldValueList* ensureHeaders(Headers::Type type);
@@ -875,8 +914,9 @@ class SipMessage : public TransactionMessage
       // Sizing so that average SipMessages don't need to allocate heap memory
       // To profile current sizing, enable DINKYPOOL_PROFILING in SipMessage.cxx 
       // and look for DebugLog message in SipMessage destructor to know when heap
-      // allocations are occuring and how much of the pool is used.
-      DinkyPool<3732> mPool;
+      // allocations are occuring and how much of the pool is used, or see
+      // getPoolStats() (reported in SipStack::dump) for totals from live traffic.
+      DinkyPool<RESIP_SIPMESSAGE_POOL_SIZE> mPool;
 
       // raw text corresponding to each typed header (not yet parsed)
       KnownHeaders mKnownHeaders;
@@ -884,6 +924,17 @@ class SipMessage : public TransactionMessage
       // raw text corresponding to each unknown header
       UnknownHeaders mUnknownHeaders;
 
+      // Encoded form of the headers of a message that came from the wire,
+      // shared with every copy made of it so that a proxy forking a request
+      // does not re-encode the headers none of the branches touch. See encode().
+      mutable std::shared_ptr<EncodedHeaders> mEncodedHeaders;
+
+      // Headers that may no longer match mEncodedHeaders: those accessed for
+      // modification, added after the first copy or removed, here or in the
+      // message this one was copied from. Bit MAX_HEADERS covers the unknown
+      // headers.
+      std::bitset<Headers::MAX_HEADERS + 1> mModifiedHeaders;
+
       // For messages received from the wire, this indicates information about 
       // the transport the message was received on
       Tuple mReceivedTransportTuple;
@@ -897,6 +948,7 @@ class SipMessage : public TransactionMessage
       
       // Raw buffers coming from the Transport. message manages the memory
       std::vector<char*> mBufferList;
+      std::vector<char*> mRecycledBufferList;
 
       // special case for the first line of message
       StartLine* mStartLine;
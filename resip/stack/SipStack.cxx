@@ -20,6 +20,7 @@
 #include "rutil/FdPoll.hxx"
 
 #include "rutil/dns/DnsThread.hxx"
+#include "resip/stack/Connection.hxx"
 #include "resip/stack/Message.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -65,6 +66,7 @@ SipStack::SipStack(const SipStackOptions& options) :
    // WARNING - don't forget to add new member initialization to the init() method
    init(options);
    mTUFifo.setDescription("SipStack::mTUFifo");
+   mTUFifo.enableWaitTimeSampling();
 }
 
 
@@ -125,6 +127,7 @@ SipStack::SipStack(Security* pSecurity,
    }
    
    mTUFifo.setDescription("SipStack::mTUFifo");
+   mTUFifo.enableWaitTimeSampling();
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
 
 #if 0
@@ -206,6 +209,12 @@ SipStack::init(const SipStackOptions& options)
    // grab the security, DnsStub, compression and statsManager
    mTransactionController = new TransactionController(*this, mAsyncProcessHandler, options.mUseDnsVip);
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
+   mTransactionController->setShardCount(options.mTransactionShards);
+   if (options.mLockFreeFifoCapacity)
+   {
+      mTUFifo.setLockFree(options.mLockFreeFifoCapacity);
+      mTransactionController->setLockFreeFifo(options.mLockFreeFifoCapacity);
+   }
    mTransactionControllerThread = 0;
    mTransportSelectorThread = 0;
 
@@ -230,6 +239,11 @@ SipStack::~SipStack()
    mDnsThread=0;
    delete mTransactionControllerThread;
    mTransactionControllerThread=0;
+   for(size_t i = 0; i < mTransactionShardThreads.size(); ++i)
+   {
+      delete mTransactionShardThreads[i];
+   }
+   mTransactionShardThreads.clear();
    delete mTransportSelectorThread;
    mTransportSelectorThread=0;
 
@@ -271,6 +285,18 @@ SipStack::run()
    mTransactionControllerThread=new TransactionControllerThread(*mTransactionController);
    mTransactionControllerThread->run();
 
+   for(size_t i = 0; i < mTransactionShardThreads.size(); ++i)
+   {
+      delete mTransactionShardThreads[i];
+   }
+   mTransactionShardThreads.clear();
+   for(unsigned int i = 1; i < mTransactionController->getShardCount(); ++i)
+   {
+      TransactionControllerThread* thread = new TransactionControllerThread(mTransactionController->getShard(i));
+      mTransactionShardThreads.push_back(thread);
+      thread->run();
+   }
+
    delete mTransportSelectorThread;
    mTransportSelectorThread=new TransportSelectorThread(mTransactionController->transportSelector());
    mTransportSelectorThread->run();
@@ -305,6 +331,15 @@ SipStack::shutdownAndJoinThreads()
       mTransactionControllerThread->join();
    }
 
+   for(size_t i = 0; i < mTransactionShardThreads.size(); ++i)
+   {
+      mTransactionShardThreads[i]->shutdown();
+   }
+   for(size_t i = 0; i < mTransactionShardThreads.size(); ++i)
+   {
+      mTransactionShardThreads[i]->join();
+   }
+
    if(mTransportSelectorThread)
    {
       mTransportSelectorThread->shutdown();
@@ -373,10 +408,23 @@ SipStack::addTransport( TransportType protocol,
                         bool useEmailAsSIP,
                         std::shared_ptr<WsConnectionValidator> wsConnectionValidator,
                         std::shared_ptr<WsCookieContextFactory> wsCookieContextFactory,
-                        const Data& netNs)
+                        const Data& netNs,
+                        unsigned int numShards)
 {
    resip_assert(!mShuttingDown);
 
+   if(numShards > 1)
+   {
+      if(protocol != UDP)
+      {
+         ErrLog(<< "Failed to create transport, sharding is only supported for UDP: "
+                << Tuple::toData(protocol) << " " << port);
+         throw Transport::Exception("Transport sharding is only supported for UDP", __FILE__,__LINE__);
+      }
+      // Each shard needs its own thread and shares the port with its siblings
+      transportFlags |= RESIP_TRANSPORT_FLAG_REUSEPORT | RESIP_TRANSPORT_FLAG_OWNTHREAD;
+   }
+
    // If address is specified, ensure it is valid
    if(!ipInterface.empty())
    {
@@ -516,6 +564,19 @@ SipStack::addTransport( TransportType protocol,
       throw;
    }
    addTransport(std::unique_ptr<Transport>(transport));
+
+   for(unsigned int shard = 1; shard < numShards; ++shard)
+   {
+      // Bind to the port the primary ended up on, in case port 0 was requested
+      std::unique_ptr<UdpTransport> udp(new UdpTransport(stateMacFifo, transport->port(), version, stun, ipInterface, mSocketFunc, *mCompression, transportFlags));
+      udp->setShardGroupKey(transport->getKey());
+      static_cast<UdpTransport*>(transport)->addShard(udp.get());
+      addTransport(std::unique_ptr<Transport>(std::move(udp)));
+   }
+   if(numShards > 1)
+   {
+      InfoLog(<< "Added " << numShards << " SO_REUSEPORT shards for " << transport->getTuple());
+   }
    return transport;
 }
 
@@ -529,7 +590,13 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
                transport->ipVersion(), transport->transport(),
                Data::Empty, // target domain
                transport->netNs());
-   if(!isSecure(transport->transport()))
+   if(transport->isSecondaryShard())
+   {
+      // Secondary shards intentionally share the tuple of their primary, which
+      // is the one registered here (and which owns the aliases and port refcount)
+      transport->setKey(mNextTransportKey++);
+   }
+   else if(!isSecure(transport->transport()))
    {
       if(mNonSecureTransports.find(tuple) == mNonSecureTransports.end())
       {
@@ -566,7 +633,11 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
       }
    }
 
-   if (!transport->interfaceName().empty())
+   if (transport->isSecondaryShard())
+   {
+      // aliases and port already registered by the primary shard
+   }
+   else if (!transport->interfaceName().empty())
    {
       addAlias(transport->interfaceName(), transport->port());
    }
@@ -587,6 +658,7 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
          ipIfs.pop_back();
       }
    }
+   if (!transport->isSecondaryShard())
    { 
       Lock lock(mPortsMutex);
       mPorts[transport->port()]++;  // add port / increment reference count
@@ -1118,7 +1190,10 @@ SipStack::processTimers()
 {
    if(!mTransactionControllerThread)
    {
-      mTransactionController->process();
+      for(unsigned int i = 0; i < mTransactionController->getShardCount(); ++i)
+      {
+         mTransactionController->getShard(i).process();
+      }
    }
 
    if(!mDnsThread)
@@ -1164,8 +1239,14 @@ SipStack::getTimeTillNextProcessMS()
 
    unsigned int dnsNextProcess = (mDnsThread ? 
                            INT_MAX : mDnsStub->getTimeTillNextProcessMS());
-   unsigned int tcNextProcess = mTransactionControllerThread ? INT_MAX : 
-                           mTransactionController->getTimeTillNextProcessMS();
+   unsigned int tcNextProcess = INT_MAX;
+   if(!mTransactionControllerThread)
+   {
+      for(unsigned int i = 0; i < mTransactionController->getShardCount(); ++i)
+      {
+         tcNextProcess = resipMin(tcNextProcess, mTransactionController->getShard(i).getTimeTillNextProcessMS());
+      }
+   }
    unsigned int tsNextProcess = mTransportSelectorThread ? INT_MAX : mTransactionController->transportSelector().getTimeTillNextProcessMS();
 
    return resipMin(Timer::getMaxSystemTimeWaitMs(),
@@ -1308,19 +1389,32 @@ SipStack::dump(EncodeStream& strm)  const
       strm << "domains: " << Inserter(this->mDomains) << std::endl;
    }
    strm << " TUFifo size=" << this->mTUFifo.size() << std::endl
-        << " Timers size=" << this->mTransactionController->mTimers.size() << std::endl;
+        << " Timers size=" << this->mTransactionController->getTimerQueueSize() << std::endl;
    {
       Lock lock(mAppTimerMutex);
       strm << " AppTimers size=" << this->mAppTimers.size() << std::endl;
    }
-   strm << " ServerTransactionMap size=" << this->mTransactionController->mServerTransactionMap.size() << std::endl
-        << " ClientTransactionMap size=" << this->mTransactionController->mClientTransactionMap.size() << std::endl
+   strm << " Transaction shards=" << this->mTransactionController->getShardCount() << std::endl
+        << " ServerTransactionMap size=" << this->mTransactionController->getNumServerTransactions() << std::endl
+        << " ClientTransactionMap size=" << this->mTransactionController->getNumClientTransactions() << std::endl
         // !slg! TODO - There is technically a threading concern with the following three lines and the runtime addTransport or removeTransport call
         << " Exact interface / Specific port=" << Inserter(this->mTransactionController->mTransportSelector.mExactTransports) << std::endl
         << " Any interface / Specific port=" << Inserter(this->mTransactionController->mTransportSelector.mAnyInterfaceTransports) << std::endl
         << " Exact interface / Any port =" << Inserter(this->mTransactionController->mTransportSelector.mAnyPortTransports) << std::endl
         << " Any interface / Any port=" << Inserter(this->mTransactionController->mTransportSelector.mAnyPortAnyInterfaceTransports) << std::endl
         << " TLS Transports=" << Inserter(this->mTransactionController->mTransportSelector.mTlsTransports) << std::endl;
+   SipMessage::PoolStats pool = SipMessage::getPoolStats();
+   strm << " SipMessage pool: size=" << pool.poolSize
+        << " messages=" << pool.messages
+        << " avgUsed=" << (pool.messages ? pool.poolBytesUsed / pool.messages : 0)
+        << " overflowed=" << pool.overflowed
+        << " avgOverflow=" << (pool.overflowed ? pool.overflowBytes / pool.overflowed : 0)
+        << " maxOverflow=" << pool.maxOverflowBytes << std::endl;
+   Connection::WriteStats writes = Connection::getWriteStats();
+   strm << " Connection writes=" << writes.writes
+        << " messages=" << writes.messages
+        << " bytes=" << writes.bytes
+        << " messagesPerWrite=" << (writes.writes ? double(writes.messages) / writes.writes : 0.0) << std::endl;
    return strm;
 }
 
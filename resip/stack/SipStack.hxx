@@ -7,6 +7,7 @@
 
 #include <set>
 #include <iosfwd>
+#include <vector>
 
 #include "rutil/CongestionManager.hxx"
 #include "rutil/FdSetIOObserver.hxx"
@@ -103,6 +104,23 @@ class FdPollGrp;
            Set to true to enable Whitelisting of DNS entries.  A feature
            that usually desired by UA's that want to stick to a known
            good server / dns result.
+
+        mLockFreeFifoCapacity
+           If non-zero, the transaction state machine fifo and the TU fifo
+           are switched to their lock-free mode, with a ring of this many
+           slots (rounded up to a power of two) in front of each.  Producers
+           then no longer contend on the fifo mutex.  Each fifo must have a
+           single consumer thread, which is how the stack and DUM use them.
+           Default 0 (off).
+
+        mTransactionShards
+           Number of TransactionController shards to split the transaction
+           layer into.  Each shard has its own transaction maps, timers and
+           state machine fifo, and gets its own thread from run(); messages
+           are assigned to a shard by a hash of their transaction id (the
+           Via branch), so each transaction is still processed in order by
+           a single thread.  When the stack is driven through process()
+           instead, all shards are processed in turn.  Default 1.
 **/
 class SipStackOptions
 {
@@ -111,7 +129,8 @@ class SipStackOptions
          : mSecurity(0), mExtraNameserverList(0),
            mAsyncProcessHandler(0), mStateless(false),
            mSocketFunc(0), mCompression(0), mPollGrp(0),
-           mUseDnsVip(false)
+           mUseDnsVip(false), mLockFreeFifoCapacity(0),
+           mTransactionShards(1)
       {
       }
 
@@ -123,6 +142,8 @@ class SipStackOptions
       Compression *mCompression;
       FdPollGrp* mPollGrp;
       bool mUseDnsVip;
+      unsigned int mLockFreeFifoCapacity;
+      unsigned int mTransactionShards;
 };
 
 
@@ -386,6 +407,15 @@ class SipStack : public FdSetIOObserver
          @param netNs                 Set the network namespace (netns) in which the Transport is
                                       to bind the the given address and port.
 
+         @param numShards             Number of sockets to open on the same address and port
+                                      using SO_REUSEPORT, each with its own transport thread
+                                      and fifos, so the kernel spreads inbound load across
+                                      them.  The TransportSelector treats the shards as one
+                                      transport (the returned one) and spreads outbound
+                                      messages over them by destination.  Values above 1 are
+                                      only supported for UDP and imply
+                                      RESIP_TRANSPORT_FLAG_OWNTHREAD.
+
       */
       Transport* addTransport(TransportType protocol,
                               int port,
@@ -402,7 +432,8 @@ class SipStack : public FdSetIOObserver
                               bool useEmailAsSIP = false,
                               std::shared_ptr<WsConnectionValidator> = nullptr,
                               std::shared_ptr<WsCookieContextFactory> = nullptr,
-                              const Data& netNs = Data::Empty
+                              const Data& netNs = Data::Empty,
+                              unsigned int numShards = 1
                              );
 
       /**
@@ -1016,6 +1047,21 @@ class SipStack : public FdSetIOObserver
          return mTransactionController->mFixBadDialogIdentifiers;
       }
 
+      /**
+         Splits the transaction layer into the given number of shards, as
+         SipStackOptions::mTransactionShards does for stacks built from
+         SipStackOptions.  Must be called before run() or the first call to
+         process(), and at most once.
+
+         @param shards Number of TransactionController shards (1 = unsharded)
+         @ingroup resip_config
+      */
+      void setTransactionShards(unsigned int shards)
+      {
+         resip_assert(!mProcessingHasStarted && !mInternalThreadsRunning);
+         mTransactionController->setShardCount(shards);
+      }
+
       /**
          Specify whether the stack should fix corrupted/changed dialog 
          identifiers (ie, Call-Id and tags) in responses from the wire. This is
@@ -1031,7 +1077,7 @@ class SipStack : public FdSetIOObserver
       */
       void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
-         mTransactionController->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         mTransactionController->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
       }
 
       inline bool getFixBadCSeqNumbers() const
@@ -1224,6 +1270,8 @@ class SipStack : public FdSetIOObserver
       TransactionController* mTransactionController;
 
       TransactionControllerThread* mTransactionControllerThread;
+      // threads for transaction shards 1 and up (see mTransactionShards)
+      std::vector<TransactionControllerThread*> mTransactionShardThreads;
       TransportSelectorThread* mTransportSelectorThread;
       bool mInternalThreadsRunning;
       bool mProcessingHasStarted; 
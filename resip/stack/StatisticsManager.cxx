@@ -19,7 +19,8 @@ StatisticsManager::StatisticsManager(SipStack& stack, unsigned long intervalSecs
      mInterval(intervalSecs*1000),
      mNextPoll(Timer::getTimeMs() + mInterval),
      mExternalHandler(NULL),
-     mPublicPayload(NULL)
+     mPublicPayload(NULL),
+     mSharded(false)
 {}
 
 StatisticsManager::~StatisticsManager()
@@ -45,6 +46,11 @@ StatisticsManager::poll()
    activeTimers = mStack.mTransactionController->getTimerQueueSize();
    activeClientTransactions = mStack.mTransactionController->getNumClientTransactions();
    activeServerTransactions = mStack.mTransactionController->getNumServerTransactions();
+   openTcpConnections = mStack.mTransactionController->sumConnectionCounts();
+   pendingDnsQueries = (unsigned int)mStack.getDnsStub().getStatistics().outstandingLookups;
+   // the histograms are rebuilt from the recorders each time
+   zeroOutLatencies();
+   mStack.mTransactionController->addLatencies(*this);
 
    // .kw. At last check payload was > 146kB, which seems too large
    // to alloc on stack. Also, the post'd message has reference
@@ -55,7 +61,10 @@ StatisticsManager::poll()
        mPublicPayload = new StatisticsMessage::AtomicPayload;
        // re-used each time, free'd in destructor
    }
-   mPublicPayload->loadIn(*this);
+   {
+      CounterLock lock(*this);
+      mPublicPayload->loadIn(*this);
+   }
 
    bool postToStack = true;
    StatisticsMessage msg(*mPublicPayload);
@@ -81,6 +90,14 @@ StatisticsManager::poll()
    }
 }
 
+void
+StatisticsManager::zeroOut()
+{
+   CounterLock lock(*this);
+   StatisticsMessage::Payload::zeroOut();
+   mStack.mTransactionController->zeroOutLatencies();
+}
+
 void 
 StatisticsManager::process()
 {
@@ -95,6 +112,7 @@ bool
 StatisticsManager::sent(SipMessage* msg)
 {
    MethodTypes met = msg->method();
+   CounterLock lock(*this);
 
    if (msg->isRequest())
    {
@@ -122,6 +140,7 @@ StatisticsManager::retransmitted(MethodTypes met,
                                  bool request, 
                                  unsigned int code)
 {
+   CounterLock lock(*this);
    if(request)
    {
       ++requestsRetransmitted;
@@ -140,6 +159,7 @@ bool
 StatisticsManager::received(SipMessage* msg)
 {
    MethodTypes met = msg->header(h_CSeq).method();
+   CounterLock lock(*this);
 
    if (msg->isRequest())
    {
@@ -161,6 +181,50 @@ StatisticsManager::received(SipMessage* msg)
    return false;
 }
 
+void
+StatisticsManager::clientTransactionCompleted(TransactionController& controller,
+                                              MethodTypes method,
+                                              uint64_t startMicroSec)
+{
+   controller.mLatencies.clientTransactions[method].record(Timer::getTimeMicroSec() - startMicroSec);
+}
+
+void
+StatisticsManager::serverTransactionCompleted(TransactionController& controller,
+                                              MethodTypes method,
+                                              uint64_t startMicroSec)
+{
+   controller.mLatencies.serverTransactions[method].record(Timer::getTimeMicroSec() - startMicroSec);
+}
+
+void
+StatisticsManager::dnsResolved(TransactionController& controller, uint64_t startMicroSec)
+{
+   controller.mLatencies.dnsResolution.record(Timer::getTimeMicroSec() - startMicroSec);
+}
+
+void
+TransactionLatencyRecorders::addTo(StatisticsMessage::Payload& stats) const
+{
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      clientTransactions[i].addTo(stats.clientTransactionLatencyByMethod[i]);
+      serverTransactions[i].addTo(stats.serverTransactionLatencyByMethod[i]);
+   }
+   dnsResolution.addTo(stats.dnsLatency);
+}
+
+void
+TransactionLatencyRecorders::zeroOut()
+{
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      clientTransactions[i].zeroOut();
+      serverTransactions[i].zeroOut();
+   }
+   dnsResolution.zeroOut();
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
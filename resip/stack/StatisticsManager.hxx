@@ -3,6 +3,7 @@
 
 #include "rutil/Timer.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StatisticsHandler.hxx"
 
@@ -12,6 +13,22 @@ class SipStack;
 class SipMessage;
 class TransactionController;
 
+/**
+   @brief The latency recorders of one TransactionController shard.
+
+   Only the thread that runs the shard records into them, so recording never
+   contends; StatisticsManager::poll() merges every shard's recorders.
+*/
+struct TransactionLatencyRecorders
+{
+      LatencyRecorder clientTransactions[MAX_METHODS];
+      LatencyRecorder serverTransactions[MAX_METHODS];
+      LatencyRecorder dnsResolution;
+
+      void addTo(StatisticsMessage::Payload& stats) const;
+      void zeroOut();
+};
+
 /**
    @brief Keeps track of various statistics on the stack's operation, and 
       periodically issues a StatisticsMessage to the TransactionUser (or, if the
@@ -52,11 +69,20 @@ class StatisticsManager : public StatisticsMessage::Payload
 
    private:
       friend class TransactionState;
+      friend class TransactionController;
       bool sent(SipMessage* msg);
       bool retransmitted(MethodTypes type, bool request, unsigned int code);
       bool received(SipMessage* msg);
+      // startMicroSec is a Timer::getTimeMicroSec() value
+      void clientTransactionCompleted(TransactionController& controller, MethodTypes method, uint64_t startMicroSec);
+      void serverTransactionCompleted(TransactionController& controller, MethodTypes method, uint64_t startMicroSec);
+      void dnsResolved(TransactionController& controller, uint64_t startMicroSec);
 
       void poll(); // force an update
+      void zeroOut();
+      // Called when the transaction layer is split into shards, before the
+      // stack runs; from then on the counters are updated under mMutex
+      void setSharded(bool sharded) { mSharded = sharded; }
 
       SipStack& mStack;
       uint64_t mInterval;
@@ -69,6 +95,33 @@ class StatisticsManager : public StatisticsMessage::Payload
       // published thru both ExternalHandler and posted to stack as message.
       // This payload is mutex protected.
       StatisticsMessage::AtomicPayload *mPublicPayload;
+
+      // Held while updating or reading the counters when several
+      // TransactionController shards update them; an unsharded stack only
+      // touches them from its one transaction thread, and takes no lock.
+      class CounterLock
+      {
+         public:
+            explicit CounterLock(StatisticsManager& manager) :
+               mMutex(manager.mSharded ? &manager.mMutex : 0)
+            {
+               if (mMutex)
+               {
+                  mMutex->lock();
+               }
+            }
+            ~CounterLock()
+            {
+               if (mMutex)
+               {
+                  mMutex->unlock();
+               }
+            }
+         private:
+            Mutex* mMutex;
+      };
+      bool mSharded;
+      Mutex mMutex;
 };
 
 }
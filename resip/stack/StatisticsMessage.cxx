@@ -4,6 +4,7 @@
 #include "rutil/WinLeakCheck.hxx"
 
 #include <string.h>
+#include <time.h>
 
 using namespace resip;
 
@@ -121,6 +122,7 @@ StatisticsMessage::Payload::zeroOut()
    activeClientTransactions = 0;
    activeServerTransactions = 0;
    pendingDnsQueries = 0;
+   zeroedOutAt = (uint64_t)time(0);
    requestsSent = 0;
    responsesSent = 0;
    requestsRetransmitted = 0;
@@ -137,6 +139,21 @@ StatisticsMessage::Payload::zeroOut()
    memset(responsesSentByMethodByCode, 0, sizeof(responsesSentByMethodByCode));
    memset(responsesRetransmittedByMethodByCode, 0, sizeof(responsesRetransmittedByMethodByCode));
    memset(responsesReceivedByMethodByCode, 0, sizeof(responsesReceivedByMethodByCode));
+   zeroOutLatencies();
+}
+
+void
+StatisticsMessage::Payload::zeroOutLatencies()
+{
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      clientTransactionLatencyByMethod[i].zeroOut();
+      serverTransactionLatencyByMethod[i].zeroOut();
+   }
+   transactionFifoWait.zeroOut();
+   tuFifoWait.zeroOut();
+   transportFifoWait.zeroOut();
+   dnsLatency.zeroOut();
 }
 
 StatisticsMessage::Payload&
@@ -154,6 +171,7 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       activeServerTransactions = rhs.activeServerTransactions;
       pendingDnsQueries = rhs.pendingDnsQueries;
 
+      zeroedOutAt = rhs.zeroedOutAt;
       requestsSent = rhs.requestsSent;
       responsesSent = rhs.responsesSent;
       requestsRetransmitted = rhs.requestsRetransmitted;
@@ -171,6 +189,16 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       memcpy(responsesSentByMethodByCode, rhs.responsesSentByMethodByCode, sizeof(responsesSentByMethodByCode));
       memcpy(responsesRetransmittedByMethodByCode, rhs.responsesRetransmittedByMethodByCode, sizeof(responsesRetransmittedByMethodByCode));
       memcpy(responsesReceivedByMethodByCode, rhs.responsesReceivedByMethodByCode, sizeof(responsesReceivedByMethodByCode));
+
+      for (int i = 0; i < MAX_METHODS; ++i)
+      {
+         clientTransactionLatencyByMethod[i] = rhs.clientTransactionLatencyByMethod[i];
+         serverTransactionLatencyByMethod[i] = rhs.serverTransactionLatencyByMethod[i];
+      }
+      transactionFifoWait = rhs.transactionFifoWait;
+      tuFifoWait = rhs.tuFifoWait;
+      transportFifoWait = rhs.transportFifoWait;
+      dnsLatency = rhs.dnsLatency;
    }
 
    return *this;
@@ -272,7 +300,25 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " INFx " << stats.requestsRetransmittedByMethod[INFO]
         << " PRAx " << stats.requestsRetransmittedByMethod[PRACK]
         << " SERx " << stats.requestsRetransmittedByMethod[SERVICE]
-        << " UPDx " << stats.requestsRetransmittedByMethod[UPDATE];
+        << " UPDx " << stats.requestsRetransmittedByMethod[UPDATE]
+        << std::endl
+        << "Fifo waits: TU " << stats.tuFifoWait
+        << " TRANSPORT " << stats.transportFifoWait
+        << " TRANSACTION " << stats.transactionFifoWait
+        << std::endl
+        << "DNS: " << stats.dnsLatency;
+   for (int met = 0; met < MAX_METHODS; ++met)
+   {
+      const LatencyHistogram& in = stats.serverTransactionLatencyByMethod[met];
+      const LatencyHistogram& out = stats.clientTransactionLatencyByMethod[met];
+      if (in.count() || out.count())
+      {
+         strm << std::endl
+              << "Latency " << getMethodName((MethodTypes)met)
+              << ": in " << in
+              << " out " << out;
+      }
+   }
    strm.flush();
    return strm;
 }
@@ -6,6 +6,7 @@
 #include "resip/stack/MethodTypes.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/LatencyHistogram.hxx"
 
 namespace resip
 {
@@ -31,10 +32,14 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int transportFifoSizeSum;
             unsigned int transactionFifoSize;
             unsigned int activeTimers;
-            unsigned int openTcpConnections; // .dlb. not implemented
+            unsigned int openTcpConnections; // on all stream transports
             unsigned int activeClientTransactions;
             unsigned int activeServerTransactions;
-            unsigned int pendingDnsQueries; // .dlb. not implemented
+            unsigned int pendingDnsQueries;
+
+            // when the counters below were zeroed out, in seconds since the
+            // epoch; they only count up until zeroOut() is called again
+            uint64_t zeroedOutAt;
 
             unsigned int requestsSent; // includes retransmissions
             unsigned int responsesSent; // includes retransmissions
@@ -56,11 +61,27 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int responsesRetransmittedByMethodByCode[MAX_METHODS][MaxCode];
             unsigned int responsesReceivedByMethodByCode[MAX_METHODS][MaxCode];
 
+            // Latencies in micro-seconds, since the statistics were last
+            // zeroed out. Client transactions run from the request being
+            // handed to the stack to the first final response reaching the
+            // TU, server transactions from the request arriving to the first
+            // final response being sent.
+            LatencyHistogram clientTransactionLatencyByMethod[MAX_METHODS];
+            LatencyHistogram serverTransactionLatencyByMethod[MAX_METHODS];
+            // sampled time spent waiting in the fifos counted by
+            // transactionFifoSize, tuFifoSize and transportFifoSizeSum
+            LatencyHistogram transactionFifoWait;
+            LatencyHistogram tuFifoWait;
+            LatencyHistogram transportFifoWait;
+            // from a client transaction starting DNS to its first result
+            LatencyHistogram dnsLatency;
+
             unsigned int sum2xxIn(MethodTypes method) const;
             unsigned int sumErrIn(MethodTypes method) const;
             unsigned int sum2xxOut(MethodTypes method) const;
             unsigned int sumErrOut(MethodTypes method) const;
             void zeroOut();
+            void zeroOutLatencies();
 
             Payload& operator=(const Payload& payload);
       };
@@ -34,6 +34,7 @@ class TcpBaseTransport : public InternalTransport, public FdPollItemIf
 
       ConnectionManager& getConnectionManager() {return mConnectionManager;}
       const ConnectionManager& getConnectionManager() const {return mConnectionManager;}
+      virtual unsigned int getConnectionCount() const {return mConnectionManager.getConnectionCount();}
 
       virtual void invokeAfterSocketCreationFunc() const;
 
@@ -7,6 +7,10 @@
 #include "resip/stack/TcpConnection.hxx"
 #include "resip/stack/Tuple.hxx"
 
+#if !defined(WIN32)
+#include <sys/uio.h>
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -112,6 +116,41 @@ TcpConnection::write( const char* buf, const int count )
    return bytesWritten;
 }
 
+#if !defined(WIN32)
+int
+TcpConnection::writeBuffers( const WriteBuffer* buffers, int count )
+{
+   resip_assert(count > 0 && count <= MaxWriteBatchBuffers);
+   if (count == 1)
+   {
+      return write(buffers[0].data, buffers[0].size);
+   }
+
+   struct iovec iov[MaxWriteBatchBuffers];
+   for (int i = 0; i < count; ++i)
+   {
+      iov[i].iov_base = const_cast<char*>(buffers[i].data);
+      iov[i].iov_len = buffers[i].size;
+   }
+
+   ssize_t bytesWritten = ::writev(getSocket(), iov, count);
+   if (bytesWritten < 0)
+   {
+      int e = getErrno();
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+         // TCP buffers are backed up - nothing was written, which is not an error
+         return 0;
+      }
+      InfoLog (<< "Failed writev on " << getSocket() << " " << strError(e));
+      Transport::error(e);
+      return -1;
+   }
+
+   return (int)bytesWritten;
+}
+#endif
+
 bool 
 TcpConnection::hasDataToRead()
 {
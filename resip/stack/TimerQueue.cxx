@@ -19,6 +19,20 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
+TimerQueueBase::Implementation TimerQueueBase::sDefaultImplementation = TimerQueueBase::Wheel;
+
+void
+TimerQueueBase::setDefaultImplementation(Implementation impl)
+{
+   sDefaultImplementation = impl;
+}
+
+TimerQueueBase::Implementation
+TimerQueueBase::getDefaultImplementation()
+{
+   return sDefaultImplementation;
+}
+
 TransactionTimerQueue::TransactionTimerQueue(Fifo<TimerMessage>& fifo)
    : mFifo(fifo)
 {
@@ -33,22 +47,17 @@ DtlsTimerQueue::DtlsTimerQueue( Fifo<DtlsMessage>& fifo )
 
 DtlsTimerQueue::~DtlsTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear([](const TimerWithPayload& timer) { delete timer.getMessage(); });
 }
 
 #endif
 
-uint64_t
+TimerQueueBase::Handle
 TransactionTimerQueue::add(Timer::Type type, const Data& transactionId, unsigned long msOffset)
 {
    TransactionTimer t(msOffset, type, transactionId);
-   mTimers.push(t);
    DebugLog (<< "Adding timer: " << Timer::toData(type) << " tid=" << transactionId << " ms=" << msOffset);
-   return mTimers.top().getWhen();
+   return addTimer(t);
 }
 
 #ifdef USE_DTLS
@@ -57,19 +66,15 @@ uint64_t
 DtlsTimerQueue::add( SSL *ssl, unsigned long msOffset )
 {
    TimerWithPayload t( msOffset, new DtlsMessage( ssl ) ) ;
-   mTimers.push( t ) ;
-   return mTimers.top().getWhen();
+   addTimer( t ) ;
+   return nextWhen();
 }
 
 #endif
 
 BaseTimeLimitTimerQueue::~BaseTimeLimitTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear([](const TimerWithPayload& timer) { delete timer.getMessage(); });
 }
 
 uint64_t
@@ -77,8 +82,8 @@ BaseTimeLimitTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   addTimer(TimerWithPayload(timeMs,payload));
+   return nextWhen();
 }
 
 void
@@ -110,11 +115,7 @@ TuSelectorTimerQueue::TuSelectorTimerQueue(TuSelector& sel) : mFifoSelector(sel)
 
 TuSelectorTimerQueue::~TuSelectorTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear([](const TimerWithPayload& timer) { delete timer.getMessage(); });
 }
 
 uint64_t
@@ -122,8 +123,8 @@ TuSelectorTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   addTimer(TimerWithPayload(timeMs,payload));
+   return nextWhen();
 }
 
 void
@@ -14,10 +14,8 @@
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Timer.hxx"
-
-// .dlb. 
-// to do: timer wheel for transaction-bound timers and a heap for
-// everything longer.
+#include "rutil/TimingWheel.hxx"
+#include <memory>
 
 namespace resip
 {
@@ -26,19 +24,58 @@ class Message;
 class TransactionMessage;
 class TuSelector;
 
+/**
+  * @internal
+  * @brief Selects how TimerQueue stores its timers; shared by all
+  * TimerQueue<T> instantiations.
+  */
+class TimerQueueBase
+{
+   public:
+      enum Implementation
+      {
+         /// binary heap (std::priority_queue); O(log n) insert, no cancel
+         Heap,
+         /// hierarchical timing wheel (TimingWheel); O(1) insert and cancel
+         Wheel
+      };
+
+      /// identifies a timer for cancellation; 0 never refers to a timer
+      typedef uint64_t Handle;
+
+      /// @brief sets the implementation used by timer queues constructed
+      /// afterwards. Defaults to Wheel. Not threadsafe; call before creating
+      /// the SipStack.
+      static void setDefaultImplementation(Implementation impl);
+      static Implementation getDefaultImplementation();
+
+   protected:
+      static Implementation sDefaultImplementation;
+};
+
 /**
   * @internal
   * @brief This class takes a fifo as a place to where you can write your stuff.
   * When using this in the main loop, call process() on this.
   * During Transaction processing, TimerMessages and SIP messages are generated.
-  * 
-    @todo .dlb. timer wheel for transaction-bound timers and a heap for 
-      everything longer.
+  *
+  * Timers are held either in a heap or in a hierarchical timing wheel, see
+  * TimerQueueBase::setDefaultImplementation(). Only the wheel can cancel
+  * timers; with the heap, cancel() is a no-op and the timer still fires.
   */
 template <class T>
-class TimerQueue
+class TimerQueue : public TimerQueueBase
 {
    public:
+      TimerQueue() :
+         mImplementation(sDefaultImplementation)
+      {
+         if (mImplementation == Wheel)
+         {
+            mWheel.reset(new TimingWheel<T>(Timer::getTimeMs()));
+         }
+      }
+
       // This is the logic that runs when a timer goes off. This is the only
       // thing subclasses must implement.
       virtual void processTimer(const T& timer)=0;
@@ -54,6 +91,11 @@ class TimerQueue
          }
       }
 
+      Implementation getImplementation() const
+      {
+         return mImplementation;
+      }
+
       /// @brief provides the time in milliseconds before the next timer will fire
       ///  @retval milliseconds time until the next timer will fire
       ///  @retval 0 implies that timers occur in the past
@@ -61,9 +103,9 @@ class TimerQueue
       ///
       unsigned int msTillNextTimer()
       {
-         if (!mTimers.empty())
+         if (!empty())
          {
-            uint64_t next = mTimers.top().getWhen();
+            uint64_t next = nextWhen();
             uint64_t now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -93,6 +135,17 @@ class TimerQueue
       /// machine fifo and application messages into the TU fifo
       virtual uint64_t process()
       {
+         if (mWheel.get())
+         {
+            if (!mWheel->empty())
+            {
+               auto fire = [this](const T& timer) { processTimer(timer); };
+               mWheel->expire(Timer::getTimeMs(), fire);
+               return mWheel->nextExpiry();
+            }
+            return 0;
+         }
+
          if (!mTimers.empty())
          {
             uint64_t now=Timer::getTimeMs();
@@ -112,30 +165,85 @@ class TimerQueue
 
       int size() const
       {
-         return (int)mTimers.size();
+         return mWheel.get() ? (int)mWheel->size() : (int)mTimers.size();
       }
 
       bool empty() const
       {
-         return mTimers.empty();
+         return mWheel.get() ? mWheel->empty() : mTimers.empty();
       }
 
       std::ostream& encode(std::ostream& str) const
       {
-         if(mTimers.size() > 0)
+         return encodeImpl(str);
+      }
+
+#ifndef RESIP_USE_STL_STREAMS
+      EncodeStream& encode(EncodeStream& str) const
+      {
+         return encodeImpl(str);
+      }
+#endif
+
+   protected:
+      /// @brief queues a timer; returns a handle that can be passed to
+      /// cancel(), or 0 if the heap implementation is in use
+      Handle addTimer(const T& timer)
+      {
+         if (mWheel.get())
          {
-            return str << "TimerQueue[ size =" << mTimers.size() 
-                       << " top=" << mTimers.top() << "]" ;
+            return mWheel->add(timer, timer.getWhen());
          }
-         else
+         mTimers.push(timer);
+         return 0;
+      }
+
+      /// @brief removes a pending timer without firing it
+      /// @retval true if the timer was pending and has been removed
+      bool cancelTimer(Handle handle)
+      {
+         return mWheel.get() && mWheel->cancel(handle);
+      }
+
+      bool isPendingTimer(Handle handle) const
+      {
+         return mWheel.get() && mWheel->isPending(handle);
+      }
+
+      /// @brief expiry of the earliest timer; the queue must not be empty
+      uint64_t nextWhen() const
+      {
+         return mWheel.get() ? mWheel->nextExpiry() : mTimers.top().getWhen();
+      }
+
+      /// @brief calls fn for every pending timer and removes them all; used by
+      /// subclasses whose timers own a payload
+      template <class Fn>
+      void clear(Fn fn)
+      {
+         if (mWheel.get())
          {
-            return str << "TimerQueue[ size = 0 ]";
+            mWheel->clear(fn);
+         }
+         while (!mTimers.empty())
+         {
+            fn(mTimers.top());
+            mTimers.pop();
          }
       }
 
-#ifndef RESIP_USE_STL_STREAMS
-      EncodeStream& encode(EncodeStream& str) const
+      template <class S>
+      S& encodeImpl(S& str) const
       {
+         if (mWheel.get())
+         {
+            str << "TimerQueue[ wheel size =" << mWheel->size();
+            if (!mWheel->empty())
+            {
+               str << " next=" << mWheel->nextExpiry();
+            }
+            return str << "]";
+         }
          if(mTimers.size() > 0)
          {
             return str << "TimerQueue[ size =" << mTimers.size() 
@@ -146,11 +254,11 @@ class TimerQueue
             return str << "TimerQueue[ size = 0 ]";
          }
       }
-#endif
 
-   protected:
       typedef std::vector<T, std::allocator<T> > TimerVector;
       std::priority_queue<T, TimerVector, std::greater<T> > mTimers;
+      const Implementation mImplementation;
+      std::unique_ptr<TimingWheel<T> > mWheel;
 };
 
 /**
@@ -203,7 +311,13 @@ class TransactionTimerQueue : public TimerQueue<TransactionTimer>
 {
    public:
       TransactionTimerQueue(Fifo<TimerMessage>& fifo);
-      uint64_t add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
+      /// @brief returns a handle for cancel(), or 0 if cancellation is not
+      /// supported by the queue's implementation
+      Handle add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
+      /// @brief drops a pending timer, e.g. because its transaction has
+      /// terminated; harmless if it has already fired
+      bool cancel(Handle handle) { return cancelTimer(handle); }
+      bool isPending(Handle handle) const { return isPendingTimer(handle); }
       virtual void processTimer(const TransactionTimer& timer);
    private:
       Fifo<TimerMessage>& mFifo;
@@ -48,17 +48,53 @@ TransactionController::TransactionController(SipStack& stack,
    mStateMacFifoOutBuffer(mStateMacFifo),
    mCongestionManager(0),
    mTuSelector(stack.mTuSelector),
-   mTransportSelector(mStateMacFifo,
-                      stack.getSecurity(),
-                      stack.getDnsStub(),
-                      stack.getCompression(),
-                      useDnsVip),
+   mOwnTransportSelector(new TransportSelector(mStateMacFifo,
+                                               stack.getSecurity(),
+                                               stack.getDnsStub(),
+                                               stack.getCompression(),
+                                               useDnsVip)),
+   mTransportSelector(*mOwnTransportSelector),
    mTimers(mTimerFifo),
    mShuttingDown(false),
    mStatsManager(stack.mStatsManager),
-   mHostname(DnsUtil::getLocalHostName())
+   mHostname(DnsUtil::getLocalHostName()),
+   mPrimary(0),
+   mShardIndex(0),
+   mHandler(handler),
+   mRouter(0),
+   mClientTransactionCount(0),
+   mServerTransactionCount(0),
+   mTimerCount(0)
 {
    mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
+   mStateMacFifo.enableWaitTimeSampling();
+}
+
+TransactionController::TransactionController(TransactionController& primary,
+                                             unsigned int index) :
+   mStack(primary.mStack),
+   mDiscardStrayResponses(primary.mDiscardStrayResponses),
+   mFixBadDialogIdentifiers(primary.mFixBadDialogIdentifiers),
+   mFixBadCSeqNumbers(primary.mFixBadCSeqNumbers),
+   mStateMacFifo(primary.mHandler),
+   mStateMacFifoOutBuffer(mStateMacFifo),
+   mCongestionManager(0),
+   mTuSelector(primary.mTuSelector),
+   mTransportSelector(primary.mTransportSelector),
+   mTimers(mTimerFifo),
+   mShuttingDown(false),
+   mStatsManager(primary.mStatsManager),
+   mHostname(primary.mHostname),
+   mPrimary(&primary),
+   mShardIndex(index),
+   mHandler(primary.mHandler),
+   mRouter(&primary.mShardRouter),
+   mClientTransactionCount(0),
+   mServerTransactionCount(0),
+   mTimerCount(0)
+{
+   mStateMacFifo.setDescription("TransactionController::mStateMacFifo[" + Data(index) + "]");
+   mStateMacFifo.enableWaitTimeSampling();
 }
 
 #if defined(WIN32) && !defined(__GNUC__)
@@ -67,6 +103,12 @@ TransactionController::TransactionController(SipStack& stack,
 
 TransactionController::~TransactionController()
 {
+   // the shards share our TransportSelector
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      delete mShards[i];
+   }
+
    if(mClientTransactionMap.size())
    {
       WarningLog(<< "On shutdown, there are Client TransactionStates remaining!");
@@ -95,9 +137,16 @@ TransactionController::shutdown()
 void
 TransactionController::process(int timeout)
 {
+   bool shardsIdle = true;
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      shardsIdle = shardsIdle && mShards[i]->mStateMacFifo.empty();
+   }
+
    if (mShuttingDown && 
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
+       shardsIdle &&
        !mStack.mTUFifo.messageAvailable() &&
        mTransportSelector.isFinished())
 // !dcm! -- why would one wait for the Tu's fifo to be empty before delivering a
@@ -118,7 +167,7 @@ TransactionController::process(int timeout)
 
       // Check if Statistics Manager needs to be polled - note:  all statistic manager polls should happen from the 
       // TransactionController thread / process loop
-      if(mStack.mStatisticsManagerEnabled)
+      if(mStack.mStatisticsManagerEnabled && !mPrimary)
       {
          mStatsManager.process();
       }
@@ -160,6 +209,11 @@ TransactionController::process(int timeout)
 
          mTransportSelector.poke();
       }
+
+      if(mRouter)
+      {
+         publishSizes();
+      }
    }
 }
 
@@ -176,19 +230,32 @@ TransactionController::getTimeTillNextProcessMS()
 void
 TransactionController::send(SipMessage* msg)
 {
+   TransactionController* shard = this;
+   if(mRouter)
+   {
+      try
+      {
+         shard = &getShard(mRouter->shardFor(msg->getTransactionId()));
+      }
+      catch(BaseException&)
+      {
+         // shard 0 will discard it
+      }
+   }
+
    if(msg->isRequest() && 
       msg->method() != ACK && 
-      getRejectionBehavior()!=CongestionManager::NORMAL)
+      shard->getRejectionBehavior()!=CongestionManager::NORMAL)
    {
       // Need to 503 this.
       SipMessage* resp(Helper::makeResponse(*msg, 503));
-      resp->header(h_RetryAfter).value()=(uint32_t)mStateMacFifo.expectedWaitTimeMilliSec()/1000;
+      resp->header(h_RetryAfter).value()=(uint32_t)shard->mStateMacFifo.expectedWaitTimeMilliSec()/1000;
       resp->setTransactionUser(msg->getTransactionUser());
       mTuSelector.add(resp, TimeLimitFifo<Message>::InternalElement);
       delete msg;
       return;
    }
-   mStateMacFifo.add(msg);
+   shard->mStateMacFifo.add(msg);
 }
 
 
@@ -204,30 +271,56 @@ TransactionController::sumTransportFifoSizes() const
    return mTransportSelector.sumTransportFifoSizes();
 }
 
+unsigned int 
+TransactionController::sumConnectionCounts() const
+{
+   return mTransportSelector.sumConnectionCounts();
+}
+
 unsigned int 
 TransactionController::getTransactionFifoSize() const
 {
    // Should we include the stuff in mStateMacFifoOutBuffer here too? This is
    // likely to be called from other threads...
-   return mStateMacFifo.size();
+   unsigned int size = mStateMacFifo.size();
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      size += mShards[i]->mStateMacFifo.size();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumClientTransactions() const
 {
-   return mClientTransactionMap.size();
+   unsigned int count = mClientTransactionMap.size();
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      count += mShards[i]->mClientTransactionCount.load(std::memory_order_relaxed);
+   }
+   return count;
 }
 
 unsigned int 
 TransactionController::getNumServerTransactions() const
 {
-   return mServerTransactionMap.size();
+   unsigned int count = mServerTransactionMap.size();
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      count += mShards[i]->mServerTransactionCount.load(std::memory_order_relaxed);
+   }
+   return count;
 }
 
 unsigned int 
 TransactionController::getTimerQueueSize() const
 {
-   return mTimers.size();
+   unsigned int count = mTimers.size();
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      count += mShards[i]->mTimerCount.load(std::memory_order_relaxed);
+   }
+   return count;
 }
 
 void 
@@ -242,6 +335,34 @@ TransactionController::pollStatistics()
    mStateMacFifo.add(new PollStatistics());
 }
 
+void
+TransactionController::addLatencies(StatisticsMessage::Payload& stats) const
+{
+   mLatencies.addTo(stats);
+   mStateMacFifo.addWaitTimes(stats.transactionFifoWait);
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      mShards[i]->mLatencies.addTo(stats);
+      mShards[i]->mStateMacFifo.addWaitTimes(stats.transactionFifoWait);
+   }
+   mTuSelector.addFifoWaitTimes(stats.tuFifoWait);
+   mTransportSelector.addTransportFifoWaitTimes(stats.transportFifoWait);
+}
+
+void
+TransactionController::zeroOutLatencies()
+{
+   mLatencies.zeroOut();
+   mStateMacFifo.zeroOutWaitTimes();
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      mShards[i]->mLatencies.zeroOut();
+      mShards[i]->mStateMacFifo.zeroOutWaitTimes();
+   }
+   mTuSelector.zeroOutFifoWaitTimes();
+   mTransportSelector.zeroOutTransportFifoWaitTimes();
+}
+
 void
 TransactionController::registerMarkListener(MarkListener* listener)
 {
@@ -256,13 +377,13 @@ void TransactionController::unregisterMarkListener(MarkListener* listener)
 void 
 TransactionController::abandonServerTransaction(const Data& tid)
 {
-   mStateMacFifo.add(new AbandonServerTransaction(tid));
+   fifoFor(tid).add(new AbandonServerTransaction(tid));
 }
 
 void 
 TransactionController::cancelClientInviteTransaction(const Data& tid, const resip::Tokens* reasons)
 {
-   mStateMacFifo.add(new CancelClientInviteTransaction(tid, reasons));
+   fifoFor(tid).add(new CancelClientInviteTransaction(tid, reasons));
 }
 
 void 
@@ -292,7 +413,22 @@ TransactionController::enableFlowTimer(const resip::Tuple& flow)
 void 
 TransactionController::setInterruptor(AsyncProcessHandler* handler)
 {
+   mHandler = handler;
    mStateMacFifo.setInterruptor(handler);
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      mShards[i]->setInterruptor(handler);
+   }
+}
+
+void
+TransactionController::setLockFreeFifo(unsigned int capacity)
+{
+   mStateMacFifo.setLockFree(capacity);
+   for(size_t i = 0; i < mShards.size(); ++i)
+   {
+      mShards[i]->setLockFreeFifo(capacity);
+   }
 }
 
 void
@@ -301,6 +437,63 @@ TransactionController::invokeAfterSocketCreationFunc(TransportType type)
     mStateMacFifo.add(new InvokeAfterSocketCreationFunc(type));
 }
 
+void
+TransactionController::setShardCount(unsigned int count)
+{
+   resip_assert(!mPrimary && mShards.empty());
+   if(count <= 1)
+   {
+      return;
+   }
+
+   mShardRouter.addShard(mStateMacFifo);
+   for(unsigned int i = 1; i < count; ++i)
+   {
+      TransactionController* shard = new TransactionController(*this, i);
+      mShards.push_back(shard);
+      mShardRouter.addShard(shard->mStateMacFifo);
+      if(mCongestionManager)
+      {
+         shard->setCongestionManager(mCongestionManager);
+      }
+   }
+   mRouter = &mShardRouter;
+   mTransportSelector.setTransactionRouter(&mShardRouter);
+   mStatsManager.setSharded(true);
+   InfoLog(<< "Transaction layer split into " << count << " shards");
+}
+
+TransactionController&
+TransactionController::getShard(unsigned int index)
+{
+   if(index == 0)
+   {
+      return *this;
+   }
+   resip_assert(index <= mShards.size());
+   return *mShards[index - 1];
+}
+
+bool
+TransactionController::ownsTransaction(const Data& tid) const
+{
+   return !mRouter || mRouter->shardFor(tid) == mShardIndex;
+}
+
+Fifo<TransactionMessage>&
+TransactionController::fifoFor(const Data& tid)
+{
+   return mRouter ? mRouter->fifoFor(tid) : mStateMacFifo;
+}
+
+void
+TransactionController::publishSizes()
+{
+   mClientTransactionCount.store(mClientTransactionMap.size(), std::memory_order_relaxed);
+   mServerTransactionCount.store(mServerTransactionMap.size(), std::memory_order_relaxed);
+   mTimerCount.store((unsigned int)mTimers.size(), std::memory_order_relaxed);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -5,8 +5,14 @@
 #include "resip/stack/TransactionMap.hxx"
 #include "resip/stack/TransportSelector.hxx"
 #include "resip/stack/TimerQueue.hxx"
+#include "resip/stack/TransactionShardRouter.hxx"
+#include "resip/stack/StatisticsManager.hxx"
 #include "rutil/CongestionManager.hxx"
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "rutil/ConsumerFifoBuffer.hxx"
 
 namespace resip
@@ -45,12 +51,17 @@ class TransactionController
 
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
+      unsigned int sumConnectionCounts() const;
       unsigned int getTransactionFifoSize() const;
       unsigned int getNumClientTransactions() const;
       unsigned int getNumServerTransactions() const;
       unsigned int getTimerQueueSize() const;
       void zeroOutStatistics();
       void pollStatistics();
+      /// merges the latencies recorded by every shard, and the sampled
+      /// fifo wait times, into stats
+      void addLatencies(StatisticsMessage::Payload& stats) const;
+      void zeroOutLatencies();
       
       void setCongestionManager( CongestionManager *manager ) 
       { 
@@ -64,6 +75,10 @@ class TransactionController
          {
             mCongestionManager->registerFifo(&mStateMacFifo);
          }
+         for(size_t i = 0; i < mShards.size(); ++i)
+         {
+            mShards[i]->setCongestionManager(manager);
+         }
       }
 
       CongestionManager::RejectionBehavior getRejectionBehavior() const
@@ -86,12 +101,20 @@ class TransactionController
       inline void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
          mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         for(size_t i = 0; i < mShards.size(); ++i)
+         {
+            mShards[i]->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
+         }
       }
 
       inline bool getFixBadCSeqNumbers() const { return mFixBadCSeqNumbers;} 
       inline void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
       {
          mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+         for(size_t i = 0; i < mShards.size(); ++i)
+         {
+            mShards[i]->setFixBadCSeqNumbers(pFixBadCSeqNumbers);
+         }
       }
 
       void abandonServerTransaction(const Data& tid);
@@ -101,13 +124,42 @@ class TransactionController
       void terminateFlow(const resip::Tuple& flow);
       void enableFlowTimer(const resip::Tuple& flow);
 
+      /// also applies to the shards, which are driven by the same thread
+      /// unless SipStack::run() gives them threads of their own
       void setInterruptor(AsyncProcessHandler* handler);
 
+      /// switches the state machine fifo to its lock-free mode (see
+      /// AbstractFifo::setLockFree); must be called before the stack runs
+      void setLockFreeFifo(unsigned int capacity);
+
       void invokeAfterSocketCreationFunc(TransportType type);
 
+      /**
+         Splits the transaction layer into count shards, each with its own
+         transaction maps, timer queue and state machine fifo, so that they
+         can be driven from separate threads (SipStack::run() starts one per
+         shard). Each transaction is owned by the shard its id hashes to (see
+         TransactionShardRouter); transports and send() post straight to
+         that shard, so messages for one transaction are still handled in
+         order, by one thread. This controller is shard 0; it also handles
+         the transport and statistics commands. Must be called before any
+         transport is added and before the stack runs.
+      */
+      void setShardCount(unsigned int count);
+      unsigned int getShardCount() const { return (unsigned int)mShards.size() + 1; }
+      /// shard 0 is this controller
+      TransactionController& getShard(unsigned int index);
+      /// true if tid belongs on this shard
+      bool ownsTransaction(const Data& tid) const;
+
    private:
       TransactionController(const TransactionController& rhs);
       TransactionController& operator=(const TransactionController& rhs);
+      // constructs shard index of primary
+      TransactionController(TransactionController& primary, unsigned int index);
+      void publishSizes();
+      Fifo<TransactionMessage>& fifoFor(const Data& tid);
+
       SipStack& mStack;
       
       // If true, indicate to the Transaction to ignore responses for which
@@ -139,25 +191,48 @@ class TransactionController
       // from the sipstack (for convenience)
       TuSelector& mTuSelector;
 
-      // Used to decide which transport to send a sip message on. 
-      TransportSelector mTransportSelector;
+      // Used to decide which transport to send a sip message on. Owned by
+      // shard 0 and shared with the other shards.
+      std::unique_ptr<TransportSelector> mOwnTransportSelector;
+      TransportSelector& mTransportSelector;
+
+      // timers associated with the transactions. When a timer fires, it is
+      // placed in the mStateMacFifo. Declared before the transaction maps so
+      // that it outlives them; TransactionStates cancel their timers when
+      // they are destroyed.
+      TransactionTimerQueue  mTimers;
 
       // stores all of the transactions that are currently active in this stack 
       TransactionMap mClientTransactionMap;
       TransactionMap mServerTransactionMap;
 
-      // timers associated with the transactions. When a timer fires, it is
-      // placed in the mStateMacFifo
-      TransactionTimerQueue  mTimers;
-
       bool mShuttingDown;
       
       StatisticsManager& mStatsManager;
       
       Data mHostname;
+
+      // Sharding (see setShardCount()). mShards and mShardRouter are only
+      // used on shard 0; mPrimary is 0 there.
+      TransactionController* mPrimary;
+      unsigned int mShardIndex;
+      AsyncProcessHandler* mHandler;
+      std::vector<TransactionController*> mShards;
+      TransactionShardRouter mShardRouter;
+      const TransactionShardRouter* mRouter;
+
+      // Sizes of this shard's maps and timer queue as of its last process()
+      // call, for statistics gathered on another thread
+      std::atomic<unsigned int> mClientTransactionCount;
+      std::atomic<unsigned int> mServerTransactionCount;
+      std::atomic<unsigned int> mTimerCount;
+
+      // written by this shard's transactions (see StatisticsManager)
+      TransactionLatencyRecorders mLatencies;
       
       friend class SipStack; // for debug only
       friend class StatelessHandler;
+      friend class StatisticsManager;
       friend class TransactionState;
       friend class TransportSelector;
 
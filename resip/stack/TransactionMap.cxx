@@ -10,63 +10,66 @@ using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
+const Data&
+TransactionMap::StateTraits::key(const TransactionState& state)
+{
+   return state.mId;
+}
+
+size_t
+TransactionMap::StateTraits::hash(const TransactionState& state)
+{
+   return state.mIdHash;
+}
+
 TransactionMap::~TransactionMap()
 {
-   //DebugLog (<< "Deleting TransactionMap: " << this << " " << mMap.size() << " entries");
-   while (!mMap.empty())
+   //DebugLog (<< "Deleting TransactionMap: " << this << " " << mIndex.size() << " entries");
+   std::vector<TransactionState*> states;
+   mIndex.getAll(states);
+   for (std::vector<TransactionState*>::iterator i = states.begin(); i != states.end(); ++i)
    {
-      DebugLog (<< mMap.begin()->first << " -> " << mMap.begin()->second << ": " << *mMap.begin()->second);
-      delete mMap.begin()->second;
+      DebugLog (<< (*i)->mId << " -> " << *i << ": " << **i);
+      // ~TransactionState removes itself from the map
+      delete *i;
    }
+   resip_assert(mIndex.empty());
 }
 
 TransactionState* 
 TransactionMap::find( const Data& tid ) const
 {
-   auto i = mMap.find(tid);
-   if (i != mMap.end())
-   {
-      return i->second;
-   }
-   else
-   {
-      return 0;
-   }
+   return mIndex.find(tid, tid.caseInsensitiveTokenHash());
 }
  
 void 
 TransactionMap::add(const Data& tid, TransactionState* state  )
 {
-   auto i = mMap.find(tid);
-   if (i != mMap.end())
+   resip_assert(isEqualNoCase(tid, state->mId));
+   TransactionState* existing = mIndex.find(tid, state->mIdHash);
+   if (existing)
    {
-      if (i->second != state)
+      if (existing != state)
       {
          // .bwc. ~TransactionState will remove itself from the map.
-         delete i->second;
+         delete existing;
          //DebugLog (<< "Replacing TMAP[" << tid << "] = " << state << " : " << *state);
-         mMap[tid] = state;
+         mIndex.insert(state);
       }
    }
    else
    {
       //DebugLog (<< "Inserting TMAP[" << tid << "] = " << state << " : " << *state);
-      mMap[tid] = state;
+      mIndex.insert(state);
    }
 }
  
 void 
 TransactionMap::erase(const Data& tid )
 {
-   auto i = mMap.find(tid);
-   if (i != mMap.end())
-   {
-      // don't delete it here, the TransactionState deletes itself and removes
-      // itself from the map
-      //DebugLog (<< "Erasing " << tid << "(" << i->second << ")");
-      mMap.erase(i);
-   }
-   else
+   // don't delete it here, the TransactionState deletes itself and removes
+   // itself from the map
+   if (mIndex.erase(tid, tid.caseInsensitiveTokenHash()) == 0)
    {
       InfoLog (<< "Couldn't find " << tid << " to remove");
       resip_assert(0);
@@ -76,7 +79,7 @@ TransactionMap::erase(const Data& tid )
 int
 TransactionMap::size() const
 {
-   return (int)mMap.size();
+   return (int)mIndex.size();
 }
 
 
@@ -1,8 +1,8 @@
 #if !defined(RESIP_TRANSACTIONMAP_HXX)
 #define RESIP_TRANSACTIONMAP_HXX
 
-#include <unordered_map>
 #include "rutil/Data.hxx"
+#include "resip/stack/BranchIndex.hxx"
 
 namespace resip
 {
@@ -17,6 +17,7 @@ class TransactionMap
      ~TransactionMap();
      
      TransactionState* find( const Data& transactionId ) const;
+     /// transactionId must be the id the state was created with
      void add( const Data& transactionId, TransactionState* state  );
      void erase( const Data& transactionId );
      int size() const;
@@ -32,32 +33,21 @@ class TransactionMap
      //    values are case-insensitive.Tokens are always case-insensitive.
      //    Unless specified otherwise, values expressed as quoted strings are
      //    case-sensitive.
+     // BranchIndex compares keys with isEqualNoCase and expects
+     // caseInsensitiveTokenHash values, which TransactionState computes once
+     // for its id.
 
       /**
          @internal
       */
-      class BranchHasher
+      class StateTraits
       {
          public:
-            inline size_t operator()(const Data& branch) const
-            {
-               return branch.caseInsensitiveTokenHash();
-            }
+            static const Data& key(const TransactionState& state);
+            static size_t hash(const TransactionState& state);
       };
 
-      /**
-         @internal
-      */
-      class BranchEqual
-      {
-         public:
-            inline bool operator()(const Data& branch1, const Data& branch2) const
-            {
-               return isEqualNoCase(branch1,branch2);
-            }
-      };
-
-     std::unordered_map<Data, TransactionState*, BranchHasher, BranchEqual> mMap;
+     BranchIndex<TransactionState, StateTraits> mIndex;
 };
 }
 
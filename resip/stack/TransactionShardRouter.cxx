@@ -0,0 +1,105 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/TransactionShardRouter.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/BaseException.hxx"
+#include "rutil/compat.hxx"
+#include "rutil/ResipAssert.h"
+
+using namespace resip;
+
+TransactionShardRouter::TransactionShardRouter()
+{
+}
+
+void
+TransactionShardRouter::addShard(Fifo<TransactionMessage>& fifo)
+{
+   mFifos.push_back(&fifo);
+}
+
+unsigned int
+TransactionShardRouter::shardFor(const Data& tid) const
+{
+   resip_assert(!mFifos.empty());
+   if (mFifos.size() == 1)
+   {
+      return 0;
+   }
+
+   static const Data cancel("cancel");
+   Data::size_type len = tid.size();
+   while (len >= cancel.size() &&
+          strncasecmp(tid.data() + len - cancel.size(), cancel.data(), cancel.size()) == 0)
+   {
+      len -= cancel.size();
+   }
+   size_t hash = Data::rawCaseInsensitiveTokenHash(reinterpret_cast<const unsigned char*>(tid.data()), len);
+   hash ^= hash >> 16;
+   return (unsigned int)(hash % mFifos.size());
+}
+
+void
+TransactionShardRouter::post(SipMessage* msg) const
+{
+   unsigned int shard = 0;
+   try
+   {
+      shard = shardFor(msg->getTransactionId());
+   }
+   catch (BaseException&)
+   {
+   }
+   mFifos[shard]->add(msg);
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,103 @@
+#if !defined(RESIP_TRANSACTIONSHARDROUTER_HXX)
+#define RESIP_TRANSACTIONSHARDROUTER_HXX
+
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+
+namespace resip
+{
+
+class TransactionMessage;
+class SipMessage;
+
+/**
+   @internal
+   @brief Maps transaction ids to the state machine fifo of the
+   TransactionController shard that owns them.
+
+   Anything that posts a message for a particular transaction (transports,
+   the TransportSelector, the TU side of the stack) goes through this, so
+   that all messages for one transaction reach the same shard in the order
+   they were posted.  The hash ignores case, like TransactionMap, and
+   ignores any trailing "cancel": TransactionState keys a CANCEL's
+   transaction as the INVITE's id with "cancel" appended, and the two must
+   live on the same shard.
+
+   The set of shards is fixed before the stack runs; lookups are lock free.
+*/
+class TransactionShardRouter
+{
+   public:
+      TransactionShardRouter();
+
+      void addShard(Fifo<TransactionMessage>& fifo);
+      unsigned int size() const { return (unsigned int)mFifos.size(); }
+
+      unsigned int shardFor(const Data& tid) const;
+      Fifo<TransactionMessage>& fifoFor(const Data& tid) const
+      {
+         return *mFifos[shardFor(tid)];
+      }
+
+      /// Posts msg to the shard owning its transaction.  Messages without a
+      /// usable transaction id go to the first shard, which discards them.
+      void post(SipMessage* msg) const;
+
+   private:
+      std::vector<Fifo<TransactionMessage>*> mFifos;
+};
+
+}
+
+#endif
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
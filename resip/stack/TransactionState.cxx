@@ -46,7 +46,7 @@ using namespace resip;
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
 uint64_t TransactionState::DnsGreylistDurationMs = 32000;  // default to 32 seconds, application can override
-uint32_t TransactionState::StatelessIdCounter = 0;
+std::atomic<uint32_t> TransactionState::StatelessIdCounter(0);
 
 TransactionState::TransactionState(TransactionController& controller, Machine m, 
                                    State s, const Data& id, MethodTypes method, const Data& methodText, TransactionUser* tu) : 
@@ -59,6 +59,7 @@ TransactionState::TransactionState(TransactionController& controller, Machine m,
    mNextTransmission(0),
    mDnsResult(0),
    mId(id),
+   mIdHash(id.caseInsensitiveTokenHash()),
    mMethod(method),
    mMethodText(method==UNKNOWN ? new Data(methodText) : 0),
    mCurrentMethodType(UNKNOWN),
@@ -68,8 +69,18 @@ TransactionState::TransactionState(TransactionController& controller, Machine m,
    mTransactionUser(tu),
    mFailureReason(TransportFailure::None),
    mFailureSubCode(0),
-   mTcpConnectTimerStarted(false)
+   mTcpConnectTimerStarted(false),
+   mStartTimeMicroSec(0),
+   mDnsStartTimeMicroSec(0)
 {
+   for (int i = 0; i < MaxTrackedTimers; ++i)
+   {
+      mTimerHandles[i] = 0;
+   }
+   if (m != Stateless && controller.mStack.statisticsManagerEnabled())
+   {
+      mStartTimeMicroSec = Timer::getTimeMicroSec();
+   }
    StackLog (<< "Creating new TransactionState: " << *this);
 }
 
@@ -107,7 +118,7 @@ TransactionState::handleInternalCancel(SipMessage* cancel,
    cancel->header(h_Vias).front().param(p_branch) = clientInvite.mNextTransmission->const_header(h_Vias).front().param(p_branch);
    state->processClientNonInvite(cancel);
    // for the INVITE in case we never get a 487
-   clientInvite.mController.mTimers.add(Timer::TimerCleanUp, clientInvite.mId, 128*Timer::T1);
+   clientInvite.startTimer(Timer::TimerCleanUp, 128*Timer::T1);
 }
 
 bool
@@ -157,6 +168,16 @@ TransactionState::~TransactionState()
 
    //StackLog (<< "Deleting TransactionState " << mId << " : " << this);
    erase(mId);
+
+   // Drop any timers that would otherwise fire for a transaction that no
+   // longer exists.
+   for (int i = 0; i < MaxTrackedTimers; ++i)
+   {
+      if (mTimerHandles[i])
+      {
+         mController.mTimers.cancel(mTimerHandles[i]);
+      }
+   }
    
    delete mNextTransmission;
    delete mMethodText;
@@ -241,7 +262,7 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
             else
             {
                //StackLog(<<" adding T100 timer (INV)");
-               controller.mTimers.add(Timer::TimerTrying, tid, Timer::T100);
+               state->startTimer(Timer::TimerTrying, Timer::T100);
             }
             state->sendToTU(sip);
             return true;
@@ -320,7 +341,7 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
                                                             Data::Empty,
                                                             tu);
             state->add(state->mId);
-            state->mController.mTimers.add(Timer::TimerStateless, state->mId, Timer::TS );
+            state->startTimer(Timer::TimerStateless, Timer::TS );
             state->processStateless(sip);
          }
          else if (method == CANCEL)
@@ -383,16 +404,22 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
       else
       {
          StackLog (<< "forwarding stateless response: " << sip->brief());
+         // transport failures for this id must find their way back here
+         Data id(StatelessIdCounter++);
+         while (!controller.ownsTransaction(id))
+         {
+            id = Data(StatelessIdCounter++);
+         }
          TransactionState* state = 
             new TransactionState(controller, 
                                  Stateless, 
                                  Calling, 
-                                 Data(StatelessIdCounter++), 
+                                 id, 
                                  method,
                                  sip->methodStr(),
                                  tu);
          state->add(state->mId);
-         state->mController.mTimers.add(Timer::TimerStateless, state->mId, Timer::TS );
+         state->startTimer(Timer::TimerStateless, Timer::TS );
          state->processStateless(sip);
       }
    }
@@ -838,31 +865,34 @@ TransactionState::processTimer(TransactionController& controller,
 {
    Data tid = message->getTransactionId();
 
-   if(controller.getRejectionBehavior()==CongestionManager::REJECTING_NON_ESSENTIAL)
+   TransactionState* state = 0;
+   if (message->isClientTransaction()) state = controller.mClientTransactionMap.find(tid);
+   else state = controller.mServerTransactionMap.find(tid);
+
+   if(state && controller.getRejectionBehavior()==CongestionManager::REJECTING_NON_ESSENTIAL)
    {
       // .bwc. State machine fifo is backed up; we probably should not be 
       // retransmitting anything right now. If we have a retransmit timer, 
-      // reschedule for later, but don't retransmit.
+      // reschedule for later, but don't retransmit.  The new timers go
+      // through startTimer(), so that they are cancelled with the
+      // transaction.
       switch(message->getType())
       {
          case Timer::TimerA: // doubling
-            controller.mTimers.add(Timer::TimerA, 
-                                    tid, 
-                                    message->getDuration()*2);
+            state->startTimer(Timer::TimerA, 
+                              message->getDuration()*2);
             delete message;
             return;
          case Timer::TimerE1:// doubling, until T2
          case Timer::TimerG: // doubling, until T2
-            controller.mTimers.add(message->getType(), 
-                                    tid, 
-                                    resipMin(message->getDuration()*2,
-                                             Timer::T2));
+            state->startTimer(message->getType(), 
+                              resipMin(message->getDuration()*2,
+                                       Timer::T2));
             delete message;
             return;
          case Timer::TimerE2:// just reset
-            controller.mTimers.add(Timer::TimerE2, 
-                                    tid, 
-                                    Timer::T2);
+            state->startTimer(Timer::TimerE2, 
+                              Timer::T2);
             delete message;
             return;
          default:
@@ -870,10 +900,6 @@ TransactionState::processTimer(TransactionController& controller,
       }
    }
 
-   TransactionState* state = 0;
-   if (message->isClientTransaction()) state = controller.mClientTransactionMap.find(tid);
-   else state = controller.mServerTransactionMap.find(tid);
-   
    if (state) // found transaction for timer
    {
       StackLog (<< "Found matching transaction for " << message->brief() << " -> " << *state);
@@ -914,6 +940,28 @@ TransactionState::processTimer(TransactionController& controller,
 
 }
 
+void
+TransactionState::startTimer(Timer::Type type, unsigned long msOffset)
+{
+   TimerQueueBase::Handle handle = mController.mTimers.add(type, mId, msOffset);
+   if (handle == 0)
+   {
+      return;  // timer queue does not support cancellation
+   }
+
+   // Reuse a slot whose timer has already fired or been cancelled. If every
+   // slot is still pending, this timer goes untracked and is simply ignored
+   // if it fires after we are gone.
+   for (int i = 0; i < MaxTrackedTimers; ++i)
+   {
+      if (mTimerHandles[i] == 0 || !mController.mTimers.isPending(mTimerHandles[i]))
+      {
+         mTimerHandles[i] = handle;
+         return;
+      }
+   }
+}
+
 void
 TransactionState::startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid)
 {
@@ -925,7 +973,7 @@ TransactionState::startServerNonInviteTimerTrying(SipMessage& sip, const Data& t
       while(duration*2<Timer::T2) duration = duration * 2;
    }
    resetNextTransmission(make100(&sip));  // Store for use when timer expires
-   mController.mTimers.add(Timer::TimerTrying, tid, duration );  // Start trying timer so that we can send 100 to NITs as recommened in RFC4320
+   startTimer(Timer::TimerTrying, duration);  // Start trying timer so that we can send 100 to NITs as recommened in RFC4320
 }
 
 void
@@ -1031,7 +1079,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
       SipMessage* sip = dynamic_cast<SipMessage*>(msg);
       resetNextTransmission(sip);
       saveOriginalContactAndVia(*sip);
-      mController.mTimers.add(Timer::TimerF, mId, Timer::TF);
+      startTimer(Timer::TimerF, Timer::TF);
       sendCurrentToWire();
    }
    else if (isResponse(msg) && isFromWire(msg)) // from the wire
@@ -1048,7 +1096,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
             // Should we restart the E2 timer though?  If so, we need to use somekind of timer sequence number so that previous E2 timers get discarded.
             if (!mIsReliable && mState == Trying)
             {
-               mController.mTimers.add(Timer::TimerE2, mId, Timer::T2 );
+               startTimer(Timer::TimerE2, Timer::T2 );
             }
             mState = Proceeding;
             sendToTU(msg); // don't delete            
@@ -1084,7 +1132,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
          else if (mState != Completed) // prevent TimerK reproduced
          {
             mState = Completed;
-            mController.mTimers.add(Timer::TimerK, mId, Timer::T4 );
+            startTimer(Timer::TimerK, Timer::T4 );
             // !bwc! Got final response in NIT. We don't need to do anything
             // except quietly absorb retransmissions. Dump all state.
             if(mDnsResult)
@@ -1114,7 +1162,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
             {
                unsigned long d = timer->getDuration();
                if (d < Timer::T2) d *= 2;
-               mController.mTimers.add(Timer::TimerE1, mId, d);
+               startTimer(Timer::TimerE1, d);
                StackLog (<< "Transmitting current message");
                sendCurrentToWire();
                delete timer;
@@ -1129,7 +1177,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
          case Timer::TimerE2:
             if (mState == Proceeding)
             {
-               mController.mTimers.add(Timer::TimerE2, mId, Timer::T2);
+               startTimer(Timer::TimerE2, Timer::T2);
                StackLog (<< "Transmitting current message");
                sendCurrentToWire();
                delete timer;
@@ -1229,7 +1277,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
             {
                resetNextTransmission(sip);
                saveOriginalContactAndVia(*sip);
-               mController.mTimers.add(Timer::TimerB, mId, Timer::TB );
+               startTimer(Timer::TimerB, Timer::TB );
                sendCurrentToWire();
             }
             else
@@ -1321,7 +1369,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                }
                StackLog (<< "Received 2xx on client invite transaction");
                StackLog (<< *this);
-               mController.mTimers.add(Timer::TimerStaleClient, mId, Timer::TS );
+               startTimer(Timer::TimerStaleClient, Timer::TS );
             }
             else if (code >= 300)
             {
@@ -1359,7 +1407,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                      // reliable, if transport is Unreliable then Fire the Timer D which 
                      // take care of re-Transmission of ACK 
                      mState = Completed;
-                     mController.mTimers.add(Timer::TimerD, mId, Timer::TD );
+                     startTimer(Timer::TimerD, Timer::TD );
                      SipMessage* ack = Helper::makeFailureAck(*mNextTransmission, *sip);
                      mNextTransmission->copyOutboundDecoratorsToStackFailureAck(*ack);
                      resetNextTransmission(ack);
@@ -1426,7 +1474,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                unsigned long d = timer->getDuration()*2;
                // TimerA is supposed to double with each retransmit RFC3261 17.1.1          
 
-               mController.mTimers.add(Timer::TimerA, mId, d);
+               startTimer(Timer::TimerA, d);
                DebugLog (<< "Retransmitting INVITE ");
                sendCurrentToWire();
             }
@@ -1629,7 +1677,7 @@ TransactionState::processServerNonInvite(TransactionMessage* msg)
             if (mState == Trying || mState == Proceeding)
             {
                mState = Completed;
-               mController.mTimers.add(Timer::TimerJ, mId, 64*Timer::T1 );
+               startTimer(Timer::TimerJ, 64*Timer::T1 );
                resetNextTransmission(sip);
                sendCurrentToWire();
             }
@@ -1719,7 +1767,7 @@ TransactionState::processServerNonInvite(TransactionMessage* msg)
             // retransmission comes in. In the meantime, set up timers for
             // transaction termination.
             mState = Completed;
-            mController.mTimers.add(Timer::TimerJ, mId, 64*Timer::T1 );
+            startTimer(Timer::TimerJ, 64*Timer::T1 );
          }
       }
       delete msg;
@@ -1754,10 +1802,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                mAckIsValid=true;
                resetNextTransmission(Helper::makeResponse(*sip, 500));
                mState = Completed;
-               mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+               startTimer(Timer::TimerH, Timer::TH );
                if (!mIsReliable)
                {
-                  mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+                  startTimer(Timer::TimerG, Timer::T1 );
                }
                sendCurrentToWire();
                delete msg;
@@ -1808,7 +1856,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                {
                   //StackLog (<< "Received ACK in Completed (unreliable) - confirmed, start Timer I");
                   mState = Confirmed;
-                  mController.mTimers.add(Timer::TimerI, mId, Timer::T4 );
+                  startTimer(Timer::TimerI, Timer::T4 );
                   // !bwc! Got an ACK/failure; we can stop retransmitting
                   // our failure response now.
                   resetNextTransmission(0);
@@ -1883,7 +1931,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                   // source Tuple that the request was received on. 
                   //terminateServerTransaction(mId);
                   mMachine = ServerStale;
-                  mController.mTimers.add(Timer::TimerStaleServer, mId, Timer::TS );
+                  startTimer(Timer::TimerStaleServer, Timer::TS );
                }
                else
                {
@@ -1909,10 +1957,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                   StackLog (<< "Received failed response in Trying or Proceeding. Start Timer H, move to completed." << *this);
                   resetNextTransmission(sip);
                   mState = Completed;
-                  mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+                  startTimer(Timer::TimerH, Timer::TH );
                   if (!mIsReliable)
                   {
-                     mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+                     startTimer(Timer::TimerG, Timer::T1 );
                   }
                   sendCurrentToWire(); // don't delete msg
                }
@@ -1950,7 +1998,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
             {
                StackLog (<< "TimerG fired. retransmit, and re-add TimerG");
                sendCurrentToWire();
-               mController.mTimers.add(Timer::TimerG, mId, resipMin(Timer::T2, timer->getDuration()*2) );  //  TimerG is supposed to double - up until a max of T2 RFC3261 17.2.1
+               startTimer(Timer::TimerG, resipMin(Timer::T2, timer->getDuration()*2) );  //  TimerG is supposed to double - up until a max of T2 RFC3261 17.2.1
             }
             break;
 
@@ -2019,10 +2067,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
             mAckIsValid=true;
             StackLog (<< "Received failed response in Trying or Proceeding. Start Timer H, move to completed." << *this);
             mState = Completed;
-            mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+            startTimer(Timer::TimerH, Timer::TH );
             if (!mIsReliable)
             {
-               mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+               startTimer(Timer::TimerG, Timer::T1 );
             }
          }
          else
@@ -2429,7 +2477,7 @@ TransactionState::processTcpConnectState(TransactionMessage* msg)
        (mState == Trying || mState == Calling))
    {
       // Start Timer
-      mController.mTimers.add(Timer::TcpConnectTimer, mId, Timer::TcpConnectTimeout);
+      startTimer(Timer::TcpConnectTimer, Timer::TcpConnectTimeout);
       mTcpConnectTimerStarted = true;
    }
    else if (tcpConnectState->getState() == TcpConnectState::Connected &&
@@ -2479,7 +2527,13 @@ TransactionState::handleSync(DnsResult* result)  // !slg! it is strange that we
    if (mPendingOperation == Dns)
    {
       resip_assert(mDnsResult);
-      switch (mDnsResult->available())
+      DnsResult::Type available = mDnsResult->available();
+      if(mDnsStartTimeMicroSec && available != DnsResult::Pending)
+      {
+         mController.mStatsManager.dnsResolved(mController, mDnsStartTimeMicroSec);
+         mDnsStartTimeMicroSec = 0;
+      }
+      switch (available)
       {
          case DnsResult::Available:
             mPendingOperation=None;
@@ -2521,11 +2575,11 @@ TransactionState::processReliability(TransportType type)
             switch (mMachine)
             {
                case ClientNonInvite:
-                  mController.mTimers.add(Timer::TimerE1, mId, Timer::T1 );
+                  startTimer(Timer::TimerE1, Timer::T1 );
                   break;
                   
                case ClientInvite:
-                  mController.mTimers.add(Timer::TimerA, mId, Timer::T1 );
+                  startTimer(Timer::TimerA, Timer::T1 );
                   break;
 
                default:
@@ -2638,6 +2692,10 @@ TransactionState::sendCurrentToWire()
                   resip_assert(mMethod!=CANCEL); // .bwc. mTarget should be set in this case.
                   mDnsResult = mController.mTransportSelector.createDnsResult(this);
                   mPendingOperation=Dns;
+                  if(mStartTimeMicroSec)
+                  {
+                     mDnsStartTimeMicroSec = Timer::getTimeMicroSec();
+                  }
                   mController.mTransportSelector.dnsResolve(mDnsResult, sip);
                }
                else // ... but our DNS query isn't done yet.
@@ -2725,6 +2783,11 @@ TransactionState::onSendSuccess()
    if(sip->isResponse())
    {
       mCurrentResponseCode = sip->const_header(h_StatusLine).statusCode();
+      if(mStartTimeMicroSec && mCurrentResponseCode >= 200 && !isClient())
+      {
+         mController.mStatsManager.serverTransactionCompleted(mController, mMethod, mStartTimeMicroSec);
+         mStartTimeMicroSec = 0;
+      }
    }
 
    // !bwc! If mNextTransmission is a non-ACK request, we need to save the
@@ -2741,6 +2804,13 @@ void
 TransactionState::sendToTU(TransactionMessage* msg)
 {
    SipMessage* sipMsg = dynamic_cast<SipMessage*>(msg);
+   if (mStartTimeMicroSec && sipMsg && sipMsg->isResponse() && isClient() &&
+       sipMsg->const_header(h_StatusLine).statusCode() >= 200)
+   {
+      mController.mStatsManager.clientTransactionCompleted(mController, mMethod, mStartTimeMicroSec);
+      mStartTimeMicroSec = 0;
+   }
+
    if (sipMsg && sipMsg->isResponse() && mDnsResult)
    {
       // whitelisting rules.
@@ -1,6 +1,7 @@
 #if !defined(RESIP_TRANSACTIONSTATE_HXX)
 #define RESIP_TRANSACTIONSTATE_HXX
 
+#include <atomic>
 #include <iosfwd>
 #include <memory>
 #include "rutil/dns/DnsHandler.hxx"
@@ -8,6 +9,7 @@
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Transport.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/Timer.hxx"
 
 namespace resip
 {
@@ -121,6 +123,9 @@ class TransactionState : public DnsHandler
       const Data& tid(SipMessage* sip) const;
 
       void startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid);
+      // Starts a timer for this transaction, remembering it so it can be
+      // cancelled when the transaction is destroyed.
+      void startTimer(Timer::Type type, unsigned long msOffset);
 
       static TransactionState* makeCancelTransaction(TransactionState* tran, Machine machine, const Data& tid);
       static void handleInternalCancel(SipMessage* cancel,
@@ -180,6 +185,7 @@ class TransactionState : public DnsHandler
       std::unique_ptr<Via> mOriginalVia;
 
       const Data mId;
+      const size_t mIdHash; // mId.caseInsensitiveTokenHash(), for TransactionMap
       const MethodTypes mMethod;
       Data* mMethodText;
 
@@ -194,10 +200,23 @@ class TransactionState : public DnsHandler
       int mFailureSubCode;
       bool mTcpConnectTimerStarted;
 
-      static uint32_t StatelessIdCounter;
+      // For the latency statistics: when the transaction started (0 if
+      // statistics are disabled, or once its first final response has been
+      // counted), and when the DNS lookup started (0 if none is pending).
+      uint64_t mStartTimeMicroSec;
+      uint64_t mDnsStartTimeMicroSec;
+
+      // Handles of the timers started through startTimer() that may still be
+      // pending; 0 marks an unused slot.
+      static const int MaxTrackedTimers = 6;
+      uint64_t mTimerHandles[MaxTrackedTimers];
+
+      // shared by all transaction shards
+      static std::atomic<uint32_t> StatelessIdCounter;
       
       friend EncodeStream& operator<<(EncodeStream& strm, const TransactionState& state);
       friend class TransactionController;
+      friend class TransactionMap;
 };
 
 EncodeStream& operator<<(EncodeStream& strm, const TransactionState& state);
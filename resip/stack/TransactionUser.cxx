@@ -28,6 +28,7 @@ TransactionUser::TransactionUser(TransactionTermination t,
   // Set a default Fifo description - should be modified by override class to be
   // more desriptive
    mFifo.setDescription("TransactionUser::mFifo");
+   mFifo.enableWaitTimeSampling();
 }
 
 TransactionUser::TransactionUser(MessageFilterRuleList &mfrl, 
@@ -45,6 +46,7 @@ TransactionUser::TransactionUser(MessageFilterRuleList &mfrl,
   // Set a default Fifo description - should be modified by override class to be
   // more desriptive
    mFifo.setDescription("TransactionUser::mFifo");
+   mFifo.enableWaitTimeSampling();
 }
 
 TransactionUser::~TransactionUser()
@@ -18,6 +18,7 @@
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransportFailure.hxx"
+#include "resip/stack/TransactionShardRouter.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SendData.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -80,6 +81,8 @@ Transport::Transport(Fifo<TransactionMessage>& rxFifo,
    mStateMachineFifo(rxFifo, 8),
    mShuttingDown(false),
    mTlsDomain(tlsDomain),
+   mShardGroupKey(0),
+   mTransactionRouter(0),
    mSocketFunc(socketFunc),
    mCompression(compression),
    mTransportFlags(0)
@@ -106,6 +109,8 @@ Transport::Transport(Fifo<TransactionMessage>& rxFifo,
    mStateMachineFifo(rxFifo,8),
    mShuttingDown(false),
    mTlsDomain(tlsDomain),
+   mShardGroupKey(0),
+   mTransactionRouter(0),
    mSocketFunc(socketFunc),
    mCompression(compression),
    mTransportFlags(transportFlags)
@@ -275,7 +280,14 @@ Transport::fail(const Data& tid, TransportFailure::FailureReason reason, int sub
 {
    if (!tid.empty())
    {
-      mStateMachineFifo.add(new TransportFailure(tid, reason, subCode));
+      if (mTransactionRouter)
+      {
+         mTransactionRouter->fifoFor(tid).add(new TransportFailure(tid, reason, subCode));
+      }
+      else
+      {
+         mStateMachineFifo.add(new TransportFailure(tid, reason, subCode));
+      }
    }
 }
 
@@ -284,7 +296,14 @@ Transport::setTcpConnectState(const Data& tid, TcpConnectState::State state)
 {
     if (!tid.empty())
     {
-        mStateMachineFifo.add(new TcpConnectState(tid, state));
+        if (mTransactionRouter)
+        {
+            mTransactionRouter->fifoFor(tid).add(new TcpConnectState(tid, state));
+        }
+        else
+        {
+            mStateMachineFifo.add(new TcpConnectState(tid, state));
+        }
     }
 }
 
@@ -503,7 +522,14 @@ Transport::pushRxMsgUp(SipMessage* message)
        handler->inboundMessage(message->getSource(), message->getReceivedTransportTuple(), *message);
    }
 
-   mStateMachineFifo.add(message);
+   if (mTransactionRouter)
+   {
+      mTransactionRouter->post(message);
+   }
+   else
+   {
+      mStateMachineFifo.add(message);
+   }
 }
 
 bool
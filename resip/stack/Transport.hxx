@@ -20,6 +20,7 @@ namespace resip
 {
 
 class TransactionMessage;
+class TransactionShardRouter;
 class SipMessage;
 class Connection;
 class Compression;
@@ -59,6 +60,11 @@ class FdPollGrp;
  *    prevents multiple simultaneous connections to different destinations
  *    from the same transport. Suitable for client applications but may not
  *    be appropriate for server applications like repro.
+ * REUSEPORT:
+ *    Set SO_REUSEPORT on the socket before binding so that several
+ *    transports can listen on the same address and port, letting the
+ *    kernel spread inbound traffic between them. Used by
+ *    SipStack::addTransport() when asked for more than one shard.
  */
 #define RESIP_TRANSPORT_FLAG_NOBIND                (1<<0)
 #define RESIP_TRANSPORT_FLAG_RXALL                 (1<<1)
@@ -66,6 +72,7 @@ class FdPollGrp;
 #define RESIP_TRANSPORT_FLAG_TXNOW                 (1<<4)
 #define RESIP_TRANSPORT_FLAG_OWNTHREAD             (1<<5)
 #define RESIP_TRANSPORT_FLAG_SYMMETRIC_CONNECTIONS (1<<6)
+#define RESIP_TRANSPORT_FLAG_REUSEPORT             (1<<7)
 
 /**
    @brief The base class for Transport classes.
@@ -369,6 +376,11 @@ class Transport : public FdSetIOObserver
 
       //# queued messages on this transport
       virtual unsigned int getFifoSize() const=0;
+      // wait times sampled in the fifo counted by getFifoSize(), if any
+      virtual void addFifoWaitTimes(LatencyHistogram& histogram) const {}
+      virtual void zeroOutFifoWaitTimes() {}
+      //# open connections, for stream transports
+      virtual unsigned int getConnectionCount() const { return 0; }
 
       void callSocketFunc(Socket sock);
       virtual void invokeAfterSocketCreationFunc() const = 0;  //used to invoke the after socket creation func immediately for all existing sockets - can be used to modify QOS settings at runtime
@@ -406,6 +418,19 @@ class Transport : public FdSetIOObserver
       inline unsigned int getKey() const {return mTuple.mTransportKey;} 
       inline void setKey(unsigned int pKey) { mTuple.mTransportKey = pKey;} // should only be called once after creation
 
+      // Transports sharing one address through SO_REUSEPORT form a shard group,
+      // represented in the TransportSelector by its primary shard. Secondary
+      // shards carry the key of the primary; it is 0 for the primary itself
+      // and for transports that are not sharded.
+      inline unsigned int getShardGroupKey() const { return mShardGroupKey; }
+      inline void setShardGroupKey(unsigned int primaryKey) { mShardGroupKey = primaryKey; }
+      inline bool isSecondaryShard() const { return mShardGroupKey != 0; }
+
+      // When the transaction layer is split over several TransactionController
+      // shards, messages and failures for a transaction are posted straight
+      // to the owning shard's fifo rather than to the rxFifo.
+      inline void setTransactionRouter(const TransactionShardRouter* router) { mTransactionRouter = router; }
+
    protected:
 
       Data mInterface;
@@ -422,6 +447,8 @@ class Transport : public FdSetIOObserver
 
       Data mTlsDomain;
       SipMessageLoggingHandlerList mSipMessageLoggingHandlers;
+      unsigned int mShardGroupKey;
+      const TransactionShardRouter* mTransactionRouter;
 
    protected:
       AfterSocketCreationFuncPtr mSocketFunc;
@@ -13,6 +13,8 @@
 #include <netdb.h>
 #endif
 
+#include <algorithm>
+
 #include "resip/stack/NameAddr.hxx"
 #include "resip/stack/Uri.hxx"
 
@@ -20,6 +22,7 @@
 #include "resip/stack/Compression.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionState.hxx"
+#include "resip/stack/TransactionShardRouter.hxx"
 #include "resip/stack/TransportFailure.hxx"
 #include "resip/stack/TransportSelector.hxx"
 #include "resip/stack/InternalTransport.hxx"
@@ -97,7 +100,9 @@ TransportSelector::TransportSelector(Fifo<TransactionMessage>& fifo, Security* s
    mSigcompStack (0),
    mPollGrp(0),
    mAvgBufferSize(1024),
-   mInterruptorHandle(0)
+   mInterruptorHandle(0),
+   mTransactionRouter(0),
+   mTransactionRouterLocking(false)
 {
    memset(&mUnspecified.v4Address, 0, sizeof(sockaddr_in));
    mUnspecified.v4Address.sin_family = AF_UNSPEC;
@@ -189,7 +194,9 @@ TransportSelector::isFinished() const
 void
 TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool isStackRunning)
 {
+   TransactionLock lock(*this);
    Transport* transport = autoTransport.release();
+   transport->setTransactionRouter(mTransactionRouter);
 
    // !bwc! This is a multimap from TransportType/IpVersion to Transport*.
    // Make _extra_ sure that no garbage goes in here.
@@ -236,7 +243,28 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
                transport->netNs());
    tuple.mTransportKey = transport->getKey();
 
-   if(!isSecure(transport->transport()))
+   if(transport->isSecondaryShard())
+   {
+      // Secondary SO_REUSEPORT shards share the tuple of their group's primary,
+      // which stands for the whole group in the lookup maps.  Outbound messages
+      // are spread over the group in selectShard().
+      TransportKeyMap::iterator primary = mTransports.find(transport->getShardGroupKey());
+      if(primary == mTransports.end())
+      {
+         WarningLog (<< "Can't add transport shard, no primary transport with key " << transport->getShardGroupKey());
+         resip_assert(false); // should never get here - primary is added first by SipStack
+         delete transport;
+         return;
+      }
+      std::vector<Transport*>& shards = mShardGroups[transport->getShardGroupKey()];
+      if(shards.empty())
+      {
+         shards.push_back(primary->second);
+      }
+      shards.push_back(transport);
+      DebugLog (<< "Adding transport shard " << shards.size() << ": " << tuple);
+   }
+   else if(!isSecure(transport->transport()))
    {
       if(mExactTransports.find(tuple) == mExactTransports.end() &&
          mAnyInterfaceTransports.find(tuple) == mAnyInterfaceTransports.end())
@@ -309,8 +337,11 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
       mHasOwnProcessTransports.back()->startOwnProcessing();
    }
 
-   mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
-   mDns.addTransportType(transport->transport(), transport->ipVersion());
+   if(!transport->isSecondaryShard())
+   {
+      mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
+      mDns.addTransportType(transport->transport(), transport->ipVersion());
+   }
    mTransports[transport->getKey()] = transport;
 
    InfoLog(<< "TransportSelector::addTransport:  added transport for tuple=" << tuple << ", key=" << transport->getKey());
@@ -319,6 +350,7 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
 void
 TransportSelector::removeTransport(unsigned int transportKey)
 {
+   TransactionLock lock(*this);
    Transport* transportToRemove = 0;
 
    // Find transport in global map and remove it
@@ -337,7 +369,31 @@ TransportSelector::removeTransport(unsigned int transportKey)
       // notify transport to shutdown
       transportToRemove->shutdown();
 
-      if(!isSecure(transportToRemove->transport()))
+      if(transportToRemove->isSecondaryShard())
+      {
+         // Secondary shards are not in the lookup maps - just leave the group,
+         // and stop the primary applying its settings to the deleted shard
+         TransportKeyMap::iterator primary = mTransports.find(transportToRemove->getShardGroupKey());
+         if(primary != mTransports.end())
+         {
+            UdpTransport* udpPrimary = dynamic_cast<UdpTransport*>(primary->second);
+            UdpTransport* udpShard = dynamic_cast<UdpTransport*>(transportToRemove);
+            if(udpPrimary && udpShard)
+            {
+               udpPrimary->removeShard(udpShard);
+            }
+         }
+         ShardGroupMap::iterator group = mShardGroups.find(transportToRemove->getShardGroupKey());
+         if(group != mShardGroups.end())
+         {
+            group->second.erase(std::remove(group->second.begin(), group->second.end(), transportToRemove), group->second.end());
+            if(group->second.size() <= 1)
+            {
+               mShardGroups.erase(group);
+            }
+         }
+      }
+      else if(!isSecure(transportToRemove->transport()))
       {
          // Ensure transport is removed from all containers
          mExactTransports.erase(transportToRemove->getTuple());
@@ -366,7 +422,10 @@ TransportSelector::removeTransport(unsigned int transportKey)
 
       // Remove transport types from Dns list of supported protocols
       // Note:  DNS tracks use counts so that we will only remove this transport type if this is the last of the type to be removed
-      mDns.removeTransportType(transportToRemove->transport(), transportToRemove->ipVersion());
+      if(!transportToRemove->isSecondaryShard())
+      {
+         mDns.removeTransportType(transportToRemove->transport(), transportToRemove->ipVersion());
+      }
 
       if (transportToRemove->shareStackProcessAndSelect())
       {
@@ -389,7 +448,40 @@ TransportSelector::removeTransport(unsigned int transportKey)
          // Delete transport
          delete transportToRemove;
       }
+
+      // Removing the primary of a shard group takes the rest of the group with it
+      ShardGroupMap::iterator group = mShardGroups.find(transportKey);
+      if(group != mShardGroups.end())
+      {
+         std::vector<Transport*> shards;
+         shards.swap(group->second);
+         mShardGroups.erase(group);
+         for(std::vector<Transport*>::iterator it = shards.begin(); it != shards.end(); ++it)
+         {
+            if((*it)->getKey() != transportKey)
+            {
+               removeTransport((*it)->getKey());
+            }
+         }
+      }
+   }
+}
+
+Transport*
+TransportSelector::selectShard(Transport* transport, const Tuple& target) const
+{
+   if(mShardGroups.empty())
+   {
+      return transport;
+   }
+   ShardGroupMap::const_iterator group = mShardGroups.find(transport->getKey());
+   if(group == mShardGroups.end())
+   {
+      return transport;
    }
+   // Pin each destination to one shard so messages to a peer stay in order
+   const std::vector<Transport*>& shards = group->second;
+   return shards[target.hash() % shards.size()];
 }
 
 void
@@ -553,6 +645,7 @@ TransportSelector::checkTransportAddRemoveQueue()
 void 
 TransportSelector::poke()
 {
+   TransactionLock lock(*this);
    for(TransportList::iterator it = mHasOwnProcessTransports.begin(); it != mHasOwnProcessTransports.end(); it++)
    {
       try
@@ -591,6 +684,7 @@ TransportSelector::hasDataToSend() const
 DnsResult*
 TransportSelector::createDnsResult(DnsHandler* handler)
 {
+   TransactionLock lock(*this);
    return mDns.createDnsResult(handler);
 }
 
@@ -598,6 +692,7 @@ void
 TransportSelector::dnsResolve(DnsResult* result,
                               SipMessage* msg)
 {
+   TransactionLock lock(*this);
    // Picking the target destination:
    //   - for request, use forced target if set
    //     otherwise use loose routing behaviour (route or, if none, request-uri)
@@ -779,8 +874,8 @@ Tuple
 TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target) const
 {
    resip_assert(msg->exists(h_Vias));
-   resip_assert(!msg->header(h_Vias).empty());
-   const Via& via = msg->header(h_Vias).front();
+   resip_assert(!msg->const_header(h_Vias).empty());
+   const Via& via = msg->const_header(h_Vias).front();
 
    // this case should be handled already for UDP and TCP targets
    resip_assert((!(msg->isRequest() && !via.sentHost().empty())) || isSecure(target.getType()));
@@ -957,6 +1052,7 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
 TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
+   TransactionLock lock(*this);
    resip_assert(msg);
 
    // Rollback outbound decorators if needed
@@ -1207,53 +1303,51 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // we should allow this code to be turned off through configuration.
          // There are plenty of cases where this stuff is not at all necessary.)
          // There is a contact header and it contains exactly one entry
-         if (msg->exists(h_Contacts) && msg->header(h_Contacts).size()==1)
+         if (msg->exists(h_Contacts) && msg->const_header(h_Contacts).size()==1)
          {
-            for (NameAddrs::iterator i=msg->header(h_Contacts).begin(); i != msg->header(h_Contacts).end(); i++)
+            // Only ask for the Contact for modification when there is
+            // something to fill in, so that an untouched one keeps its
+            // received encoding (see SipMessage::encode()).
+            const NameAddr& c_contact = msg->const_header(h_Contacts).front();
+            // No host specified, so use the ip address and port of the
+            // transport used. Otherwise, leave it as is.
+            if (c_contact.uri().host().empty())
             {
-               const NameAddr& c_contact = *i;
-               NameAddr& contact = *i;
-               // No host specified, so use the ip address and port of the
-               // transport used. Otherwise, leave it as is.
-               if (c_contact.uri().host().empty())
+               NameAddr& contact = msg->header(h_Contacts).front();
+               contact.uri().host() = (transport->hasSpecificContact() ? 
+                                       transport->interfaceName() : 
+                                       sourceAddress);
+               contact.uri().port() = transport->port();
+
+               if (transport->transport() != UDP && !contact.uri().exists(p_gr))
                {
-                  contact.uri().host() = (transport->hasSpecificContact() ? 
-                                          transport->interfaceName() : 
-                                          sourceAddress);
-                  contact.uri().port() = transport->port();
+                  contact.uri().param(p_transport) = Tuple::toDataLower(transport->transport());
+               }
 
-                  if (transport->transport() != UDP && !contact.uri().exists(p_gr))
+               // Add comp=sigcomp to contact URI
+               // Also, If no +sip.instance on contact HEADER,
+               // add sigcomp-id="<urn>" to contact URI.
+               if (mCompression.isEnabled())
+               {
+                  if (!contact.uri().exists(p_comp))
                   {
-                     contact.uri().param(p_transport) = Tuple::toDataLower(transport->transport());
+                     contact.uri().param(p_comp) = "sigcomp";
                   }
-
-                  // Add comp=sigcomp to contact URI
-                  // Also, If no +sip.instance on contact HEADER,
-                  // add sigcomp-id="<urn>" to contact URI.
-                  if (mCompression.isEnabled())
+                  if (!contact.exists(p_Instance) &&
+                      !contact.uri().exists(p_sigcompId))
                   {
-                     if (!contact.uri().exists(p_comp))
-                     {
-                        contact.uri().param(p_comp) = "sigcomp";
-                     }
-                     if (!contact.exists(p_Instance) &&
-                         !contact.uri().exists(p_sigcompId))
-                     {
-                        contact.uri().param(p_sigcompId) = mCompression.getSigcompId();
-                     }
+                     contact.uri().param(p_sigcompId) = mCompression.getSigcompId();
                   }
                }
-               else
+            }
+            else if (c_contact.uri().exists(p_addTransport))
+            {
+               NameAddr& contact = msg->header(h_Contacts).front();
+               if (target.getType() != UDP)
                {
-                  if (c_contact.uri().exists(p_addTransport))
-                  {
-                     if (target.getType() != UDP)
-                     {
-                        contact.uri().param(p_transport) = Tuple::toDataLower(target.getType());
-                     }
-                     contact.uri().remove(p_addTransport);
-                  }
+                  contact.uri().param(p_transport) = Tuple::toDataLower(target.getType());
                }
+               contact.uri().remove(p_addTransport);
             }
          }
 
@@ -1282,9 +1376,9 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
                && msg->const_header(h_RecordRoutes).front().isWellFormed())
          {
             const NameAddr& c_rr = msg->const_header(h_RecordRoutes).front();
-            NameAddr& rr = msg->header(h_RecordRoutes).front();
             if (c_rr.uri().host().empty())
             {
+               NameAddr& rr = msg->header(h_RecordRoutes).front();
                rr.uri().host() = sourceAddress;
                rr.uri().port() = transport->port();
                if (target.getType() != UDP && !rr.uri().exists(p_transport))
@@ -1313,7 +1407,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // See draft-ietf-sip-identity
          // TODO !SLG!  RFC4474 has been deprecated by RFC8224 (Authenticated Identity Management).  We should remove/adjust this code.
          if (mSecurity && msg->exists(h_Identities) &&
-             msg->header(h_Identities).size() > 0 && msg->const_header(h_Identities).front().value().empty())
+             msg->const_header(h_Identities).size() > 0 && msg->const_header(h_Identities).front().value().empty())
          {
             DateCategory now;
             msg->header(h_Date) = now;
@@ -1373,27 +1467,52 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
             *sendData = *send;
          }
 
-         transport->send(std::move(send));
+         selectShard(transport, target)->send(std::move(send));
          return Sent;
       }
       else
       {
          InfoLog (<< "tid=" << msg->getTransactionId() << " failed to find a transport to " << target);
-         mStateMacFifo.add(new TransportFailure(msg->getTransactionId(), transportFailureReason));
+         postTransportFailure(msg->getTransactionId(), transportFailureReason);
          return Unsent;
       }
    }
    catch (Transport::Exception& )
    {
       InfoLog (<< "tid=" << msg->getTransactionId() << " no route to target: " << target);
-      mStateMacFifo.add(new TransportFailure(msg->getTransactionId(), TransportFailure::NoRoute));
+      postTransportFailure(msg->getTransactionId(), TransportFailure::NoRoute);
       return Unsent;
    }
 }
 
+void
+TransportSelector::postTransportFailure(const Data& tid, TransportFailure::FailureReason reason)
+{
+   if (mTransactionRouter)
+   {
+      mTransactionRouter->fifoFor(tid).add(new TransportFailure(tid, reason));
+   }
+   else
+   {
+      mStateMacFifo.add(new TransportFailure(tid, reason));
+   }
+}
+
+void
+TransportSelector::setTransactionRouter(const TransactionShardRouter* router)
+{
+   mTransactionRouter = router;
+   mTransactionRouterLocking = router && router->size() > 1;
+   for (TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); ++it)
+   {
+      it->second->setTransactionRouter(router);
+   }
+}
+
 void
 TransportSelector::retransmit(const SendData& data)
 {
+   TransactionLock lock(*this);
    resip_assert(data.destination.mTransportKey);
    Transport* transport = findTransportByDest(data.destination);
 
@@ -1428,13 +1547,14 @@ TransportSelector::retransmit(const SendData& data)
          handler->outboundRetransmit(transport->getTuple(), data.destination, data);
       }
        
-      transport->send(std::unique_ptr<SendData>(data.clone()));
+      selectShard(transport, data.destination)->send(std::unique_ptr<SendData>(data.clone()));
    }
 }
 
 void 
 TransportSelector::closeConnection(const Tuple& peer)
 {
+   TransactionLock lock(*this);
    Transport* t = findTransportByDest(peer);
    if(t)
    {
@@ -1458,6 +1578,35 @@ TransportSelector::sumTransportFifoSizes() const
    return sum;
 }
 
+unsigned int
+TransportSelector::sumConnectionCounts() const
+{
+   unsigned int sum = 0;
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      sum += it->second->getConnectionCount();
+   }
+   return sum;
+}
+
+void
+TransportSelector::addTransportFifoWaitTimes(LatencyHistogram& histogram) const
+{
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      it->second->addFifoWaitTimes(histogram);
+   }
+}
+
+void
+TransportSelector::zeroOutTransportFifoWaitTimes()
+{
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      it->second->zeroOutFifoWaitTimes();
+   }
+}
+
 void 
 TransportSelector::terminateFlow(const resip::Tuple& flow)
 {
@@ -1467,6 +1616,7 @@ TransportSelector::terminateFlow(const resip::Tuple& flow)
 void 
 TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 {
+   TransactionLock lock(*this);
    Transport* t = findTransportByDest(flow);
    if(t)
    {
@@ -1482,6 +1632,7 @@ TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 void 
 TransportSelector::invokeAfterSocketCreationFunc(TransportType type)
 {
+   TransactionLock lock(*this);
     for (TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); it++)
     {
         if (type == UNKNOWN_TRANSPORT || type == it->second->transport())
@@ -12,6 +12,7 @@
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/SelectInterruptor.hxx"
@@ -33,6 +34,7 @@ class Message;
 class TransactionMessage;
 class SipMessage;
 class TransactionController;
+class TransactionShardRouter;
 class Security;
 class Compression;
 class FdPollGrp;
@@ -54,7 +56,10 @@ the TransactionController Thread.  The TransportSelectorThread itself is used
 to provide cycles to the actual transports for sending data in their Fifo's and
 receiving data from the wire.  The mSharedProcessTransports list is one member that
 is expected to be accessed from TransportSelector processing loop only , all other 
-members are accessed from the TransactionController processing loop.
+members are accessed from the TransactionController processing loop.  When the
+transaction layer is split over several TransactionController shards (see
+setTransactionRouter()), the methods the shards call serialize on an internal
+mutex.
 */
 class TransportSelector
 {
@@ -122,10 +127,21 @@ class TransportSelector
       void closeConnection(const Tuple& peer);
 
       unsigned int sumTransportFifoSizes() const;
+      unsigned int sumConnectionCounts() const;
+      void addTransportFifoWaitTimes(LatencyHistogram& histogram) const;
+      void zeroOutTransportFifoWaitTimes();
 
       unsigned int getTimeTillNextProcessMS();
       Fifo<TransactionMessage>& stateMacFifo() { return mStateMacFifo; }
 
+      /**
+         Routes transport failures, and everything the transports receive,
+         to the TransactionController shard owning the transaction; with
+         more than one shard this also turns on locking of the methods used
+         by the transaction layer.  Must be called before the stack runs.
+      */
+      void setTransactionRouter(const TransactionShardRouter* router);
+
       void registerMarkListener(MarkListener* listener);
       void unregisterMarkListener(MarkListener* listener);
       void setEnumSuffixes(const std::vector<Data>& suffixes);
@@ -178,6 +194,7 @@ class TransportSelector
    protected:  // for unit tests (testTransportSelector)
       Transport* findTransportBySource(Tuple& src, const SipMessage* msg) const;
       Transport* findTransportByDest(const Tuple& dest);
+      Transport* selectShard(Transport* transport, const Tuple& target) const;
 
    private:
       void checkTransportAddRemoveQueue();
@@ -187,6 +204,31 @@ class TransportSelector
       Transport* findTlsTransport(const Data& domain, const Tuple& search) const;
       Tuple determineSourceInterface(SipMessage* msg, const Tuple& dest) const;
       void rebuildAnyPortTransportMaps(void);
+      void postTransportFailure(const Data& tid, TransportFailure::FailureReason reason);
+
+      // Held by the entry points used by the transaction layer, when it runs
+      // more than one shard. Recursive since some of these call each other.
+      class TransactionLock
+      {
+         public:
+            explicit TransactionLock(const TransportSelector& selector) :
+               mMutex(selector.mTransactionRouterLocking ? &selector.mTransactionMutex : 0)
+            {
+               if (mMutex)
+               {
+                  mMutex->lock();
+               }
+            }
+            ~TransactionLock()
+            {
+               if (mMutex)
+               {
+                  mMutex->unlock();
+               }
+            }
+         private:
+            RecursiveMutex* mMutex;
+      };
 
       DnsInterface mDns;
       Fifo<TransactionMessage>& mStateMacFifo;
@@ -214,6 +256,11 @@ class TransportSelector
       typedef std::map<TlsTransportKey, Transport*> TlsTransportMap ;
       TlsTransportMap mTlsTransports;
 
+      // SO_REUSEPORT shard groups, by key of the group's primary transport
+      // (which is always the first element)
+      typedef std::map<unsigned int, std::vector<Transport*> > ShardGroupMap;
+      ShardGroupMap mShardGroups;
+
       typedef std::list<Transport*> TransportList;
       TransportList mSharedProcessTransports;  // Warning - only access this from the TransportSelector process loop / thread
       TransportList mHasOwnProcessTransports;
@@ -241,6 +288,10 @@ class TransportSelector
       std::unique_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
+      const TransactionShardRouter* mTransactionRouter;
+      bool mTransactionRouterLocking;
+      mutable RecursiveMutex mTransactionMutex;
+
       friend class TestTransportSelector;
       friend class SipStack; // for debug only
 };
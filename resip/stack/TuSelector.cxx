@@ -162,6 +162,38 @@ TuSelector::size() const
    }
 }
 
+void
+TuSelector::addFifoWaitTimes(LatencyHistogram& histogram) const
+{
+   if (mTuSelectorMode)
+   {
+      for(TuList::const_iterator it = mTuList.begin(); it != mTuList.end(); it++)
+      {
+         it->tu->mFifo.addWaitTimes(histogram);
+      }
+   }
+   else
+   {
+      mFallBackFifo.addWaitTimes(histogram);
+   }
+}
+
+void
+TuSelector::zeroOutFifoWaitTimes()
+{
+   if (mTuSelectorMode)
+   {
+      for(TuList::const_iterator it = mTuList.begin(); it != mTuList.end(); it++)
+      {
+         it->tu->mFifo.zeroOutWaitTimes();
+      }
+   }
+   else
+   {
+      mFallBackFifo.zeroOutWaitTimes();
+   }
+}
+
 void 
 TuSelector::registerTransactionUser(TransactionUser& tu, const bool front)
 {
@@ -27,6 +27,9 @@ class TuSelector
       void add(KeepAlivePong* pong);
       
       unsigned int size() const;      
+      /// merges the wait times sampled in the fifos counted by size()
+      void addFifoWaitTimes(LatencyHistogram& histogram) const;
+      void zeroOutFifoWaitTimes();
       bool wouldAccept(TimeLimitFifo<Message>::DepthUsage usage) const;
   
       TransactionUser* selectTransactionUser(const SipMessage& msg);
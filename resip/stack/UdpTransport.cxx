@@ -2,8 +2,15 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
 #include <memory>
 #include <utility>
+#include <vector>
+
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SendData.hxx"
@@ -11,6 +18,7 @@
 #include "resip/stack/UdpTransport.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -28,6 +36,32 @@
 using namespace std;
 using namespace resip;
 
+struct UdpTransport::BatchState
+{
+   explicit BatchState(unsigned depth)
+      : rxBuffers(static_cast<size_t>(depth) * MaxMessageSize)
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+      , iovs(depth)
+      , msgs(depth)
+#endif
+   {
+      senders.reserve(depth);
+      pending.reserve(depth);
+   }
+
+   char* rxSlot(unsigned i) { return &rxBuffers[static_cast<size_t>(i) * MaxMessageSize]; }
+
+   // ring of receive slots, one datagram each
+   std::vector<char> rxBuffers;
+   std::vector<Tuple> senders;
+   // SendData taken from the tx fifo for the current sendmmsg call
+   std::vector<SendData*> pending;
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+   std::vector<iovec> iovs;
+   std::vector<mmsghdr> msgs;
+#endif
+};
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -38,6 +72,8 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            unsigned transportFlags)
    : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags),  
      mSigcompStack(nullptr),
+     mBatchDepth(0),
+     mRequestedBatchDepth(0),
      mStunSetting(stun),
      mExternalUnknownDatagramHandler(nullptr),
      mInWritable(false)
@@ -45,6 +81,7 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    mPollEventCnt = 0;
    mTxTryCnt = mTxMsgCnt = mTxFailCnt = 0;
    mRxTryCnt = mRxMsgCnt = mRxKeepaliveCnt = mRxTransactionCnt = 0;
+   mRxBatchCnt = mRxBatchMsgCnt = mTxBatchCnt = mTxBatchMsgCnt = 0;
    mStunTxIdValid = false;
    mStunTxId.fill(0);
    mTuple.setType(UDP);
@@ -86,6 +123,9 @@ UdpTransport::~UdpTransport()
            <<" rxmsg="<<mRxMsgCnt
            <<" rxka="<<mRxKeepaliveCnt
            <<" rxtr="<<mRxTransactionCnt
+           <<" batch="<<mBatchDepth
+           <<" rxbatch="<<getMeanRxBatchSize()
+           <<" txbatch="<<getMeanTxBatchSize()
            );
 #ifdef USE_SIGCOMP
    delete mSigcompStack;
@@ -93,6 +133,60 @@ UdpTransport::~UdpTransport()
    setPollGrp(nullptr);
 }
 
+void
+UdpTransport::setBatchDepth(unsigned depth)
+{
+   if (depth > MaxBatchDepth)
+   {
+      WarningLog(<< "UDP batch depth " << depth << " clamped to " << MaxBatchDepth);
+      depth = MaxBatchDepth;
+   }
+#if !defined(HAVE_RECVMMSG) && !defined(HAVE_SENDMMSG)
+   if (depth > 1)
+   {
+      WarningLog(<< "Batched UDP I/O (recvmmsg/sendmmsg) not available on this platform, ignoring batch depth " << depth);
+      depth = 0;
+   }
+#endif
+   mRequestedBatchDepth = depth > 1 ? depth : 0;
+   Lock lock(mShardsMutex);
+   for (std::vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setBatchDepth(depth);
+   }
+}
+
+/**
+ * Called from the transport thread whenever the requested batch depth
+ * differs from the one in use; (re)allocates the receive ring.
+ */
+void
+UdpTransport::applyBatchDepth()
+{
+   mBatchDepth = mRequestedBatchDepth.load();
+   if (mBatchDepth)
+   {
+      mBatch.reset(new BatchState(mBatchDepth));
+   }
+   else
+   {
+      mBatch.reset();
+   }
+   InfoLog(<< "UDP batch depth set to " << mBatchDepth << " for " << mTuple);
+}
+
+double
+UdpTransport::getMeanRxBatchSize() const
+{
+   return mRxBatchCnt ? (double)mRxBatchMsgCnt / mRxBatchCnt : 0.0;
+}
+
+double
+UdpTransport::getMeanTxBatchSize() const
+{
+   return mTxBatchCnt ? (double)mTxBatchMsgCnt / mTxBatchCnt : 0.0;
+}
+
 void
 UdpTransport::setPollGrp(FdPollGrp *grp)
 {
@@ -223,6 +317,17 @@ UdpTransport::process(FdSet& fdset)
 void
 UdpTransport::processTxAll()
 {
+   if (mRequestedBatchDepth.load(std::memory_order_relaxed) != mBatchDepth)
+   {
+      applyBatchDepth();
+   }
+#if defined(HAVE_SENDMMSG)
+   if (mBatch)
+   {
+      processTxAllBatched();
+      return;
+   }
+#endif
    SendData *msg;
    ++mTxTryCnt;
    while ( (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != nullptr)
@@ -289,12 +394,18 @@ UdpTransport::processTxOne(SendData *data)
                       &addr, (int)sendData->destination.length());
    }
 
+   processTxResult(*sendData, count, expected);
+}
+
+void
+UdpTransport::processTxResult(SendData& data, int count, int expected)
+{
    if ( count == SOCKET_ERROR )
    {
       int e = getErrno();
       error(e);
-      InfoLog (<< "Failed (" << e << ") sending to " << sendData->destination);
-      fail(sendData->transactionId);
+      InfoLog (<< "Failed (" << e << ") sending to " << data.destination);
+      fail(data.transactionId);
       ++mTxFailCnt;
    }
    else
@@ -302,9 +413,91 @@ UdpTransport::processTxOne(SendData *data)
       if (count != expected)
       {
          ErrLog (<< "UDPTransport - send buffer full" );
-         fail(sendData->transactionId);
+         fail(data.transactionId);
+      }
+   }
+}
+
+/**
+ * Batched variant of processTxAll(): drains up to mBatchDepth messages from
+ * the tx fifo and hands them to the kernel with a single sendmmsg() call.
+ * Messages needing SigComp compression or carrying a command are handed to
+ * processTxOne() instead. With TXALL, keeps going until the fifo is empty.
+ */
+void
+UdpTransport::processTxAllBatched()
+{
+#if defined(HAVE_SENDMMSG)
+   ++mTxTryCnt;
+   std::vector<SendData*>& pending = mBatch->pending;
+   for (;;)
+   {
+      pending.clear();
+      SendData* msg;
+      while (pending.size() < mBatchDepth &&
+             (msg = mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != nullptr)
+      {
+         if (msg->command != SendData::NoCommand
+#ifdef USE_SIGCOMP
+             || (mSigcompStack && msg->sigcompId.size() > 0 && !msg->isAlreadyCompressed)
+#endif
+            )
+         {
+            processTxOne(msg);
+            continue;
+         }
+         resip_assert( msg->destination.getPort() != 0 );
+
+         const size_t i = pending.size();
+         iovec& iov = mBatch->iovs[i];
+         iov.iov_base = const_cast<char*>(msg->data.data());
+         iov.iov_len = msg->data.size();
+         mmsghdr& hdr = mBatch->msgs[i];
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_hdr.msg_name = const_cast<sockaddr*>(&msg->destination.getSockaddr());
+         hdr.msg_hdr.msg_namelen = msg->destination.length();
+         hdr.msg_hdr.msg_iov = &iov;
+         hdr.msg_hdr.msg_iovlen = 1;
+         pending.push_back(msg);
+      }
+
+      if (pending.empty())
+      {
+         break;
+      }
+
+      // sendmmsg() stops at the first datagram that fails; account for that
+      // one and carry on with the remainder.
+      unsigned done = 0;
+      while (done < pending.size())
+      {
+         int sent = sendmmsg(mFd, &mBatch->msgs[done], (unsigned)(pending.size() - done), 0);
+         if (sent == SOCKET_ERROR || sent == 0)
+         {
+            std::unique_ptr<SendData> sendData(pending[done]);
+            ++mTxMsgCnt;
+            processTxResult(*sendData, SOCKET_ERROR, (int)sendData->data.size());
+            ++done;
+            continue;
+         }
+         ++mTxBatchCnt;
+         mTxBatchMsgCnt += sent;
+         for (int j = 0; j < sent; ++j, ++done)
+         {
+            std::unique_ptr<SendData> sendData(pending[done]);
+            ++mTxMsgCnt;
+            processTxResult(*sendData, (int)mBatch->msgs[done].msg_len, (int)sendData->data.size());
+         }
+      }
+
+      if ( pending.size() < mBatchDepth ||
+           (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 )
+      {
+         break;
       }
    }
+   pending.clear();
+#endif
 }
 
 /**
@@ -316,6 +509,17 @@ UdpTransport::processTxOne(SendData *data)
 void
 UdpTransport::processRxAll()
 {
+   if (mRequestedBatchDepth.load(std::memory_order_relaxed) != mBatchDepth)
+   {
+      applyBatchDepth();
+   }
+#if defined(HAVE_RECVMMSG)
+   if (mBatch)
+   {
+      processRxAllBatched();
+      return;
+   }
+#endif
    ++mRxTryCnt;
    for (;;)
    {
@@ -327,7 +531,7 @@ UdpTransport::processRxAll()
          break;
       }
       ++mRxMsgCnt;
-      processRxParse(len, sender);
+      processRxParse(mRxBuffer.data(), len, sender);
       if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
       {
          break;
@@ -335,6 +539,76 @@ UdpTransport::processRxAll()
    }
 }
 
+/**
+ * Batched variant of processRxAll(): a single recvmmsg() call fills up to
+ * mBatchDepth receive slots, each of which is then parsed in order.  A full
+ * batch suggests more data is queued, so with RXALL we go round again.
+ */
+void
+UdpTransport::processRxAllBatched()
+{
+#if defined(HAVE_RECVMMSG)
+   ++mRxTryCnt;
+   std::vector<Tuple>& senders = mBatch->senders;
+   for (;;)
+   {
+      senders.assign(mBatchDepth, mTuple);
+      for (unsigned i = 0; i < mBatchDepth; ++i)
+      {
+         iovec& iov = mBatch->iovs[i];
+         iov.iov_base = mBatch->rxSlot(i);
+         iov.iov_len = MaxMessageSize;
+         mmsghdr& hdr = mBatch->msgs[i];
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_hdr.msg_name = &senders[i].getMutableSockaddr();
+         hdr.msg_hdr.msg_namelen = senders[i].length();
+         hdr.msg_hdr.msg_iov = &iov;
+         hdr.msg_hdr.msg_iovlen = 1;
+      }
+
+      int count = recvmmsg(mFd, mBatch->msgs.data(), mBatchDepth, MSG_DONTWAIT, nullptr);
+      if (count == SOCKET_ERROR)
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         break;
+      }
+      if (count == 0)
+      {
+         break;
+      }
+      ++mRxBatchCnt;
+      mRxBatchMsgCnt += count;
+
+      for (int i = 0; i < count; ++i)
+      {
+         const mmsghdr& hdr = mBatch->msgs[i];
+         const int len = (int)hdr.msg_len;
+         if ((hdr.msg_hdr.msg_flags & MSG_TRUNC) || len + 1 >= MaxMessageSize)
+         {
+            InfoLog( << "Datagram exceeded max length " << MaxMessageSize);
+            continue;
+         }
+         if (len <= 0)
+         {
+            continue;
+         }
+         ++mRxMsgCnt;
+         processRxParse(mBatch->rxSlot(i), len, senders[i]);
+      }
+
+      if ( (unsigned)count < mBatchDepth ||
+           (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
+      {
+         break;
+      }
+   }
+#endif
+}
+
 /*
  * Receive from socket and store results into {buffer}. Updates
  * {sender} with who sent the packet.
@@ -376,14 +650,14 @@ UdpTransport::processRxRecv(Tuple& sender)
 
 
 /**
- * Parse the contents of {mRxBuffer} and do something with it.
+ * Parse the contents of {buffer} and do something with it.
 **/
 void
-UdpTransport::processRxParse(int len, const Tuple& sender)
+UdpTransport::processRxParse(char* buffer, int len, const Tuple& sender)
 {
    //handle incoming CRLFCRLF keep-alive packets
    if (len == 4 &&
-       strncmp(mRxBuffer.data(), Symbols::CRLFCRLF, len) == 0)
+       strncmp(buffer, Symbols::CRLFCRLF, len) == 0)
    {
       StackLog(<<"Throwing away incoming firewall keep-alive");
       ++mRxKeepaliveCnt;
@@ -391,7 +665,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
    }
 
    // this must be a STUN response (or garbage)
-   if (mRxBuffer[0] == 1 && mRxBuffer[1] == 1 && ipVersion() == V4)
+   if (buffer[0] == 1 && buffer[1] == 1 && ipVersion() == V4)
    {
       StunMessage resp;
 
@@ -416,7 +690,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
          return;
       }
 
-      if (!stunParseMessage(mRxBuffer.data(), len, resp, false))
+      if (!stunParseMessage(buffer, len, resp, false))
       {
          // Malformed response from the expected server.
          mStunResult = StunResultResponseParseFailed;
@@ -473,7 +747,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
    }
 
    // this must be a STUN request (or garbage)
-   if (mRxBuffer[0] == 0 && mRxBuffer[1] == 1 && ipVersion() == V4)
+   if (buffer[0] == 0 && buffer[1] == 1 && ipVersion() == V4)
    {
       // Drop stun requests unless StunEnabled is set and return false to indicate
       // we did not consume the buffer
@@ -501,7 +775,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
       secondary.port = 0;
       secondary.addr = 0;
 
-      bool ok = stunServerProcessMsg( mRxBuffer.data(), len, // input buffer
+      bool ok = stunServerProcessMsg( buffer, len, // input buffer
                                       from,  // packet source
                                       secondary, // not used
                                       myAddr, // address to fill into response
@@ -528,7 +802,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
       return;
    }
 
-   processRxParseSip(mRxBuffer.data(), len, sender);
+   processRxParseSip(buffer, len, sender);
 }
 
 void
@@ -571,7 +845,9 @@ UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender)
 #endif
    }
 
-   auto* const msgBuffer = MsgHeaderScanner::allocateBuffer(len);
+   // most datagrams fit a recycled buffer; larger ones get their own
+   const bool recycled = len + MsgHeaderScanner::MaxNumCharsChunkOverflow <= MsgHeaderScanner::RecycledBufferSize;
+   auto* const msgBuffer = recycled ? MsgHeaderScanner::allocateRecycledBuffer(len) : MsgHeaderScanner::allocateBuffer(len);
    memcpy(msgBuffer, buffer, len);
    msgBuffer[len] = '\0';  // null terminate the buffer string just to make debug easier and reduce errors
 
@@ -592,7 +868,14 @@ UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender)
 
    // Tell the SipMessage about this datagram buffer.
    // WATCHOUT: below here buffer is consumed by message
-   message->addBuffer(msgBuffer);
+   if (recycled)
+   {
+      message->addRecycledBuffer(msgBuffer);
+   }
+   else
+   {
+      message->addBuffer(msgBuffer);
+   }
 
    mMsgHeaderScanner.prepareForMessage(message.get());
 
@@ -773,6 +1056,26 @@ void
 UdpTransport::setRcvBufLen(int buflen)
 {
    setSocketRcvBufLen(mFd, buflen);
+   Lock lock(mShardsMutex);
+   for (std::vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setRcvBufLen(buflen);
+   }
+}
+
+void
+UdpTransport::addShard(UdpTransport* shard)
+{
+   resip_assert(shard && shard != this);
+   Lock lock(mShardsMutex);
+   mShards.push_back(shard);
+}
+
+void
+UdpTransport::removeShard(UdpTransport* shard)
+{
+   Lock lock(mShardsMutex);
+   mShards.erase(std::remove(mShards.begin(), mShards.end(), shard), mShards.end());
 }
 
 /* ====================================================================
@@ -5,9 +5,12 @@
 #include "resip/stack/InternalTransport.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Compression.hxx"
 
 #include <array>
+#include <atomic>
+#include <vector>
 
 namespace osc { class Stack; }
 
@@ -78,11 +81,36 @@ public:
    virtual void setPollGrp(FdPollGrp *grp);
    virtual void setRcvBufLen(int buflen);
 
+   /** Register a secondary SO_REUSEPORT shard of this transport (see
+       SipStack::addTransport), so that socket settings made on this
+       transport are applied to the whole group.  The shard must not outlive
+       this transport, and must be removed with removeShard() before it is
+       deleted (TransportSelector::removeTransport does this). */
+   void addShard(UdpTransport* shard);
+   void removeShard(UdpTransport* shard);
+
    // FdPollItemIf
    // virtual Socket getPollSocket() const;
    virtual void processPollEvent(FdPollEventMask mask);
 
    static constexpr int MaxMessageSize = 65535;
+   static constexpr unsigned MaxBatchDepth = 64;
+
+   /** Enable batched datagram I/O (recvmmsg/sendmmsg) on platforms that
+       support it.  Up to @p depth datagrams are received or sent per system
+       call, each received datagram landing in its own slot of a ring of
+       receive buffers.  A depth of 0 or 1 restores the one-datagram-per-call
+       behaviour.  Values above MaxBatchDepth are clamped.  Safe to call
+       from any thread; the transport picks the new depth up on its next
+       wakeup.  Also applied to any SO_REUSEPORT shards of this transport. */
+   void setBatchDepth(unsigned depth);
+   unsigned getBatchDepth() const { return mRequestedBatchDepth.load(); }
+
+   /** Mean number of datagrams handled per batched receive/send system
+       call, for tuning the batch depth. Returns 0 if no batched call has
+       completed yet. */
+   double getMeanRxBatchSize() const;
+   double getMeanTxBatchSize() const;
 
    // STUN client functionality
    enum StunResult
@@ -128,11 +156,14 @@ public:
 protected:
 
    void processRxAll();
+   void processRxAllBatched();
    int processRxRecv(Tuple& sender);
-   void processRxParse(int len, const Tuple& sender);
+   void processRxParse(char* buffer, int len, const Tuple& sender);
    void processRxParseSip(char* buffer, int len, const Tuple& sender);
    void processTxAll();
+   void processTxAllBatched();
    void processTxOne(SendData *data);
+   void processTxResult(SendData& data, int count, int expected);
    void updateEvents();
 
    osc::Stack *mSigcompStack;
@@ -146,8 +177,25 @@ protected:
    unsigned mRxMsgCnt;
    unsigned mRxKeepaliveCnt;
    unsigned mRxTransactionCnt;
+   unsigned mRxBatchCnt;      // recvmmsg calls that returned datagrams
+   unsigned mRxBatchMsgCnt;   // datagrams returned by those calls
+   unsigned mTxBatchCnt;      // sendmmsg calls that sent datagrams
+   unsigned mTxBatchMsgCnt;   // datagrams sent by those calls
    std::array<char, MaxMessageSize> mRxBuffer{};
 private:
+   // Per-slot buffers and mmsghdr vectors for batched I/O; kept opaque so
+   // that this header does not depend on the platform socket headers.
+   struct BatchState;
+   void applyBatchDepth();
+   std::unique_ptr<BatchState> mBatch;
+   unsigned mBatchDepth;                         // depth in use by the transport thread
+   std::atomic<unsigned> mRequestedBatchDepth;   // depth asked for by setBatchDepth()
+
+   // Shards can be removed by the TransportSelector while settings are being
+   // applied from another thread
+   mutable Mutex mShardsMutex;
+   std::vector<UdpTransport*> mShards;
+
 #ifdef USE_SIGCOMP
    std::array<char, MaxMessageSize> mRxUncompressedBuffer{};
 #endif
@@ -68,6 +68,10 @@ TlsConnection::TlsConnection(Transport* transport, const Tuple& tuple,
 
    mSsl = SSL_new(ctx);
    resip_assert(mSsl);
+   // Connection::performWrite() may gather more queued messages into the
+   // retry of a blocked SSL_write(), from a different buffer; the bytes
+   // already handed to OpenSSL always come first.
+   SSL_set_mode(mSsl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
    resip_assert(mSecurity);
 
@@ -0,0 +1,231 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "resip/stack/BranchIndex.hxx"
+#include "rutil/Data.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+struct Entry
+{
+      Entry(const Data& id) : mId(id), mHash(id.caseInsensitiveTokenHash()) {}
+      Data mId;
+      size_t mHash;
+};
+
+struct EntryTraits
+{
+      static const Data& key(const Entry& e) { return e.mId; }
+      static size_t hash(const Entry& e) { return e.mHash; }
+};
+
+typedef BranchIndex<Entry, EntryTraits> Index;
+
+Entry*
+lookup(const Index& index, const Data& id)
+{
+   return index.find(id, id.caseInsensitiveTokenHash());
+}
+
+void
+testBasic()
+{
+   Index index;
+   assert(index.empty());
+   assert(lookup(index, "z9hG4bK1") == 0);
+
+   Entry a("z9hG4bKabc");
+   Entry b("z9hG4bKdef");
+   index.insert(&a);
+   index.insert(&b);
+   assert(index.size() == 2);
+   assert(lookup(index, "z9hG4bKabc") == &a);
+   // branch parameters are case insensitive
+   assert(lookup(index, "Z9HG4BKABC") == &a);
+   assert(lookup(index, "z9hG4bKdef") == &b);
+   assert(lookup(index, "z9hG4bKxyz") == 0);
+
+   assert(index.erase("Z9hg4bkDEF", Data("Z9hg4bkDEF").caseInsensitiveTokenHash()) == &b);
+   assert(index.erase("z9hG4bKdef", b.mHash) == 0);
+   assert(lookup(index, "z9hG4bKdef") == 0);
+   assert(lookup(index, "z9hG4bKabc") == &a);
+   assert(index.size() == 1);
+}
+
+// Every entry colliding on the same home slot exercises the probing and
+// the backward shift in erase().
+struct CollidingTraits
+{
+      static const Data& key(const Entry& e) { return e.mId; }
+      static size_t hash(const Entry&) { return 7; }
+};
+
+void
+testCollisions()
+{
+   BranchIndex<Entry, CollidingTraits> index;
+   vector<Entry*> entries;
+   for (int i = 0; i < 20; ++i)
+   {
+      entries.push_back(new Entry(Data("branch") + Data(i)));
+      index.insert(entries.back());
+   }
+   for (int i = 0; i < 20; i += 3)
+   {
+      assert(index.erase(entries[i]->mId, 7) == entries[i]);
+   }
+   for (int i = 0; i < 20; ++i)
+   {
+      assert((index.find(entries[i]->mId, 7) == entries[i]) == (i % 3 != 0));
+   }
+   for (size_t i = 0; i < entries.size(); ++i)
+   {
+      delete entries[i];
+   }
+}
+
+// Random inserts and erases against std::map, across many grow and shrink
+// cycles, checking lookups while a resize is still in progress.
+void
+testAgainstReference()
+{
+   srand(4321);
+   Index index;
+   map<Data, Entry*> reference;
+   size_t maxCapacity = 0;
+   bool sawRehash = false;
+
+   for (int round = 0; round < 400000; ++round)
+   {
+      // alternate phases that mostly grow and mostly shrink the index
+      bool growing = (round / 50000) % 2 == 0;
+      int op = rand() % 100;
+      if (op < (growing ? 70 : 30))
+      {
+         Data id = Data("z9hG4bK-") + Data(rand() % 200000);
+         if (reference.find(id) == reference.end())
+         {
+            Entry* e = new Entry(id);
+            index.insert(e);
+            reference[id] = e;
+         }
+      }
+      else if (!reference.empty())
+      {
+         map<Data, Entry*>::iterator it = reference.lower_bound(Data("z9hG4bK-") + Data(rand() % 200000));
+         if (it == reference.end())
+         {
+            it = reference.begin();
+         }
+         Data upper(it->first);
+         upper.uppercase();
+         assert(index.erase(upper, upper.caseInsensitiveTokenHash()) == it->second);
+         delete it->second;
+         reference.erase(it);
+      }
+
+      assert(index.size() == reference.size());
+      sawRehash = sawRehash || index.isRehashing();
+      if (index.capacity() > maxCapacity)
+      {
+         maxCapacity = index.capacity();
+      }
+      if (round % 97 == 0 && !reference.empty())
+      {
+         map<Data, Entry*>::iterator it = reference.lower_bound(Data("z9hG4bK-") + Data(rand() % 200000));
+         if (it != reference.end())
+         {
+            assert(lookup(index, it->first) == it->second);
+         }
+         assert(lookup(index, Data("missing-") + Data(round)) == 0);
+      }
+   }
+
+   for (map<Data, Entry*>::iterator it = reference.begin(); it != reference.end(); ++it)
+   {
+      assert(lookup(index, it->first) == it->second);
+   }
+   vector<Entry*> all;
+   index.getAll(all);
+   assert(all.size() == reference.size());
+
+   assert(sawRehash);
+   // the shrinking phases must have given memory back
+   assert(index.capacity() < maxCapacity);
+
+   for (map<Data, Entry*>::iterator it = reference.begin(); it != reference.end(); ++it)
+   {
+      assert(index.erase(it->first, it->second->mHash) == it->second);
+      delete it->second;
+   }
+   assert(index.empty());
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   testBasic();
+   testCollisions();
+   testAgainstReference();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,314 @@
+// Benchmark for ConnectionManager at connection scale.  Opens N loopback
+// TCP connections and hands the accepted end of each to a TcpTransport's
+// ConnectionManager, the way TcpBaseTransport does for inbound clients,
+// then times:
+//  - add: creating the Connection, which registers it with the manager
+//  - find by tuple: findConnection() on the peer address, as
+//    TransportSelector does for every outbound request
+//  - find by flow: findConnection() with the flow key (fd) set, as for
+//    responses and requests routed over an existing flow
+//  - find miss: findConnection() for peers with no connection
+//  - remove: deleting every connection
+//
+// Client sockets are bound to distinct 127.0.0.x source address and port
+// pairs, so the ephemeral port range does not cap the count, and are closed once
+// accepted (with a reset, so no TIME_WAIT); the manager only ever sees the
+// accepted ends.  The count is
+// still capped by RLIMIT_NOFILE, which is raised as far as allowed.
+//
+// Usage: testConnectionManagerPerf [connections]   (default 100000)
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "resip/stack/Connection.hxx"
+#include "resip/stack/ConnectionManager.hxx"
+#include "resip/stack/TcpConnection.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+const unsigned int ClientsPerSourceAddress = 40000;
+const unsigned int FirstSourcePort = 10000;
+
+void
+report(const char* what, size_t count, uint64_t startUs)
+{
+   uint64_t elapsed = Timer::getTimeMicroSec() - startUs;
+   if (elapsed == 0)
+   {
+      elapsed = 1;
+   }
+   cout << "   " << what << ": " << count << " in " << elapsed / 1000 << "ms ("
+        << (uint64_t(count) * 1000000 / elapsed) << "/s, "
+        << (elapsed * 1000 / (count ? count : 1)) << "ns each)" << endl;
+}
+
+unsigned int
+raiseFdLimit(unsigned int wanted)
+{
+   struct rlimit rl;
+   if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+   {
+      return 1024;
+   }
+   if (rl.rlim_cur < wanted)
+   {
+      rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > wanted) ? wanted : rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+      getrlimit(RLIMIT_NOFILE, &rl);
+   }
+   return (unsigned int)rl.rlim_cur;
+}
+
+int
+makeListener(sockaddr_in& addr)
+{
+   int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   socklen_t len = sizeof(addr);
+   if (fd < 0 ||
+       ::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+       ::listen(fd, SOMAXCONN) != 0 ||
+       ::getsockname(fd, (sockaddr*)&addr, &len) != 0)
+   {
+      cerr << "cannot listen on loopback: " << strerror(errno) << endl;
+      exit(-1);
+   }
+   return fd;
+}
+
+// Opens loopback connection i, from its own source address and port, and
+// returns the accepted end, with the peer address in peer; -1 on failure.
+int
+openConnection(int listener, const sockaddr_in& server, unsigned int i, sockaddr_in& peer)
+{
+   int client = ::socket(AF_INET, SOCK_STREAM, 0);
+   if (client < 0)
+   {
+      return -1;
+   }
+   sockaddr_in source;
+   memset(&source, 0, sizeof(source));
+   source.sin_family = AF_INET;
+   source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + i / ClientsPerSourceAddress);
+   source.sin_port = htons(FirstSourcePort + i % ClientsPerSourceAddress);
+   int on = 1;
+   ::setsockopt(client, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+   if (::bind(client, (sockaddr*)&source, sizeof(source)) != 0 ||
+       ::connect(client, (const sockaddr*)&server, sizeof(server)) != 0)
+   {
+      ::close(client);
+      return -1;
+   }
+   socklen_t len = sizeof(peer);
+   int fd = ::accept(listener, (sockaddr*)&peer, &len);
+   // reset rather than close, so that the source port is not left in
+   // TIME_WAIT for the next run
+   struct linger lingerOpt;
+   lingerOpt.l_onoff = 1;
+   lingerOpt.l_linger = 0;
+   ::setsockopt(client, SOL_SOCKET, SO_LINGER, (const char*)&lingerOpt, sizeof(lingerOpt));
+   ::close(client);
+   return fd;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   unsigned int requested = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+   // the accepted end is kept open, the client end only briefly
+   unsigned int fdLimit = raiseFdLimit(requested + 256);
+   unsigned int count = requested;
+   if (count + 128 > fdLimit)
+   {
+      count = fdLimit > 256 ? fdLimit - 128 : 128;
+      cout << "RLIMIT_NOFILE is " << fdLimit << ", limiting the run to "
+           << count << " connections" << endl;
+   }
+
+   Fifo<TransactionMessage> rxFifo;
+   TcpTransport transport(rxFifo, 0, V4, "127.0.0.1");
+   ConnectionManager& manager = transport.getConnectionManager();
+
+   sockaddr_in server;
+   int listener = makeListener(server);
+
+   vector<int> fds;
+   vector<Tuple> peers;
+   fds.reserve(count);
+   peers.reserve(count);
+   uint64_t start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      sockaddr_in peer;
+      int fd = openConnection(listener, server, i, peer);
+      if (fd < 0)
+      {
+         cout << "stopped after " << i << " connections: " << strerror(errno) << endl;
+         break;
+      }
+      fds.push_back(fd);
+      peers.push_back(Tuple((const sockaddr&)peer, TCP));
+   }
+   count = (unsigned int)fds.size();
+   cout << count << " loopback connections:" << endl;
+   report("connect+accept", count, start);
+
+   vector<Connection*> connections;
+   connections.reserve(count);
+   start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      connections.push_back(new TcpConnection(&transport, peers[i], fds[i], Compression::Disabled, true));
+   }
+   report("add", count, start);
+
+   // look connections up in a random order, so the cache does not help
+   vector<unsigned int> order(count);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      order[i] = i;
+   }
+   for (unsigned int i = count; i > 1; --i)
+   {
+      swap(order[i - 1], order[Random::getRandom() % i]);
+   }
+
+   const unsigned int rounds = 4;
+   size_t found = 0;
+   start = Timer::getTimeMicroSec();
+   for (unsigned int r = 0; r < rounds; ++r)
+   {
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         found += manager.findConnection(peers[order[i]]) == connections[order[i]] ? 1 : 0;
+      }
+   }
+   report("find by tuple", size_t(count) * rounds, start);
+
+   vector<Tuple> flows(peers);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      flows[i].mFlowKey = (FlowKey)fds[i];
+   }
+   start = Timer::getTimeMicroSec();
+   for (unsigned int r = 0; r < rounds; ++r)
+   {
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         found += manager.findConnection(flows[order[i]]) == connections[order[i]] ? 1 : 0;
+      }
+   }
+   report("find by flow", size_t(count) * rounds, start);
+   if (found != size_t(count) * rounds * 2)
+   {
+      cerr << "lookup failure: " << found << " of " << size_t(count) * rounds * 2 << " found" << endl;
+      return -1;
+   }
+
+   // same addresses on a port nothing connected from
+   vector<Tuple> misses(peers);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      misses[i].setPort(1 + i % 1000);
+   }
+   start = Timer::getTimeMicroSec();
+   for (unsigned int r = 0; r < rounds; ++r)
+   {
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         found += manager.findConnection(misses[order[i]]) ? 1 : 0;
+      }
+   }
+   report("find miss", size_t(count) * rounds, start);
+   if (found != size_t(count) * rounds * 2)
+   {
+      cerr << "unexpected hit" << endl;
+      return -1;
+   }
+
+   start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      delete connections[order[i]];
+   }
+   report("remove", count, start);
+
+   ::close(listener);
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,246 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/Connection.hxx"
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "resip/stack/WsTransport.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+// A connection whose "socket" accepts a scripted number of bytes per write,
+// so that performWrite() can be driven through short writes
+class ScriptedConnection : public Connection
+{
+   public:
+      ScriptedConnection(Transport* transport, const Tuple& who) :
+         Connection(transport, who, ::socket(AF_INET, SOCK_STREAM, 0), Compression::Disabled, false),
+         mLimit(0),
+         mNext(0)
+      {
+      }
+
+      void queue(const Data& data)
+      {
+         requestWrite(new SendData(who(), data, Data::Empty, Data::Empty));
+      }
+
+      bool idle() const { return mOutstandingSends.empty(); }
+
+      // bytes accepted by each write; the last entry repeats
+      vector<int> mLimits;
+      int mLimit;
+      size_t mNext;
+      Data mWire;
+      vector<int> mBufferCounts;
+
+   protected:
+      virtual int write(const char* buffer, const int count)
+      {
+         int limit = mLimits.empty() ? count : mLimits[mNext < mLimits.size() ? mNext++ : mLimits.size() - 1];
+         int n = resipMin(limit, count);
+         mWire.append(buffer, n);
+         return n;
+      }
+
+      virtual int writeBuffers(const WriteBuffer* buffers, int count)
+      {
+         mBufferCounts.push_back(count);
+         return Connection::writeBuffers(buffers, count);
+      }
+};
+
+Tuple
+peer(TransportType type)
+{
+   return Tuple("127.0.0.1", 5099, V4, type);
+}
+
+Data
+message(char c, int size)
+{
+   Data d;
+   for (int i = 0; i < size; i++)
+   {
+      d += c;
+   }
+   return d;
+}
+
+int
+drain(ScriptedConnection& conn)
+{
+   int writes = 0;
+   while (!conn.idle())
+   {
+      int n = conn.performWrite();
+      assert(n > 0);
+      writes++;
+   }
+   return writes;
+}
+
+void
+testGather(Transport& transport)
+{
+   ScriptedConnection conn(&transport, peer(TCP));
+   Data a = message('a', 30), b = message('b', 40), c = message('c', 50);
+   conn.queue(a);
+   conn.queue(b);
+   conn.queue(c);
+
+   // all three go out in one write of three buffers
+   assert(drain(conn) == 1);
+   assert(conn.mBufferCounts.size() == 1 && conn.mBufferCounts[0] == 3);
+   assert(conn.mWire == a + b + c);
+}
+
+void
+testByteBudget(Transport& transport)
+{
+   unsigned int saved = Connection::MaxWriteBatchBytes;
+   Connection::setMaxWriteBatchBytes(70);
+
+   ScriptedConnection conn(&transport, peer(TCP));
+   Data a = message('a', 30), b = message('b', 40), c = message('c', 100), d = message('d', 10);
+   conn.queue(a);
+   conn.queue(b);
+   conn.queue(c);
+   conn.queue(d);
+
+   // a+b fit the budget; c is over it on its own but goes out whole, alone
+   assert(drain(conn) == 3);
+   assert(conn.mBufferCounts.size() == 3);
+   assert(conn.mBufferCounts[0] == 2);
+   assert(conn.mBufferCounts[1] == 1);
+   assert(conn.mBufferCounts[2] == 1);
+   assert(conn.mWire == a + b + c + d);
+
+   Connection::setMaxWriteBatchBytes(saved);
+}
+
+void
+testShortWrites(Transport& transport)
+{
+   ScriptedConnection conn(&transport, peer(TCP));
+   Data a = message('a', 10), b = message('b', 7), c = message('c', 12);
+   conn.queue(a);
+   conn.queue(b);
+   conn.queue(c);
+
+   // writes end mid-message and exactly on a message boundary
+   conn.mLimits.push_back(4);
+   conn.mLimits.push_back(6);
+   conn.mLimits.push_back(9);
+   conn.mLimits.push_back(3);
+   drain(conn);
+   assert(conn.mWire == a + b + c);
+   // the second write resumes a part way through, the third b at its start
+   assert(conn.mBufferCounts[1] == 3);
+   assert(conn.mBufferCounts[2] == 2);
+
+   // A blocked write consumes nothing
+   conn.queue(a);
+   conn.mLimits.assign(1, 0);
+   conn.mNext = 0;
+   assert(conn.performWrite() == 0);
+   assert(!conn.idle());
+   conn.mLimits.clear();
+   drain(conn);
+   assert(conn.mWire == a + b + c + a);
+}
+
+// Splits a WebSocket stream after the handshake back into frame payloads,
+// checking each header
+vector<Data>
+parseFrames(const Data& wire, Data::size_type pos)
+{
+   vector<Data> payloads;
+   const unsigned char* p = (const unsigned char*)wire.data();
+   while (pos < wire.size())
+   {
+      assert(p[pos] == 0x82);
+      uint64_t size = p[pos + 1];
+      pos += 2;
+      if (size == 0x7E)
+      {
+         size = (p[pos] << 8) | p[pos + 1];
+         pos += 2;
+      }
+      else
+      {
+         assert(size < 0x7E);
+      }
+      assert(pos + size <= wire.size());
+      payloads.push_back(Data(wire.data() + pos, (Data::size_type)size));
+      pos += (Data::size_type)size;
+   }
+   return payloads;
+}
+
+void
+testWebSocket(Transport& transport)
+{
+   static const int Limits[] = { 1, 2, 3, 5, 8, 13 };
+   for (size_t l = 0; l < sizeof(Limits) / sizeof(Limits[0]); l++)
+   {
+      ScriptedConnection conn(&transport, peer(WS));
+      Data handshake("HTTP/1.1 101 Switching Protocols\r\n\r\n");
+      Data a = message('a', 5), b = message('b', 300), c = message('c', 1);
+      conn.queue(handshake);
+      conn.queue(a);
+      conn.queue(b);
+      conn.queue(c);
+
+      // every header and payload gets split across writes somewhere
+      conn.mLimits.assign(1, Limits[l]);
+      drain(conn);
+
+      assert(conn.mWire.prefix(handshake));
+      // the handshake response is written raw, and on its own
+      assert(conn.mBufferCounts[0] == 1);
+      vector<Data> payloads = parseFrames(conn.mWire, handshake.size());
+      assert(payloads.size() == 3);
+      assert(payloads[0] == a);
+      assert(payloads[1] == b);
+      assert(payloads[2] == c);
+   }
+
+   // Unlimited, the three frames go out in one write of six buffers
+   ScriptedConnection conn(&transport, peer(WS));
+   conn.queue("HTTP/1.1 101 Switching Protocols\r\n\r\n");
+   conn.queue("one");
+   conn.queue("two");
+   conn.queue("three");
+   assert(drain(conn) == 2);
+   assert(conn.mBufferCounts[1] == 6);
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+   initNetwork();
+
+   Fifo<TransactionMessage> fifo;
+   TcpTransport tcp(fifo, 0, V4, "127.0.0.1");
+   WsTransport ws(fifo, 0, V4, "127.0.0.1");
+
+   testGather(tcp);
+   testByteBudget(tcp);
+   testShortWrites(tcp);
+   testWebSocket(ws);
+
+   cout << "All OK" << endl;
+   return 0;
+}
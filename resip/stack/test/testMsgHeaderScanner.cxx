@@ -0,0 +1,266 @@
+// Checks that every MsgHeaderScanner implementation the CPU supports scans
+// the RFC 4475 torture corpus, and messages built to hit the edges of the
+// vectorised runs, exactly like the scalar scanner: same result, same
+// position and the same headers, however the input is split into chunks.
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseException.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+namespace
+{
+
+const char* const tortureFiles[] =
+{
+   "badaspec.dat", "badbranch.dat", "baddate.dat", "baddn.dat",
+   "badinv01.dat", "badvers.dat", "bcast.dat", "bext01.dat",
+   "bigcode.dat", "clerr.dat", "cparam01.dat", "cparam02.dat",
+   "dblreq.dat", "esc01.dat", "esc02.dat", "escnull.dat",
+   "escruri.dat", "insuf.dat", "intmeth.dat", "inv2543.dat",
+   "invut.dat", "longreq.dat", "ltgtruri.dat", "lwsdisp.dat",
+   "lwsruri.dat", "lwsstart.dat", "mcl01.dat", "mismatch01.dat",
+   "mismatch02.dat", "mpart01.dat", "multi01.dat", "ncl.dat",
+   "noreason.dat", "novelsc.dat", "quotbal.dat", "regaut01.dat",
+   "regbadct.dat", "regescrt.dat", "scalar02.dat", "scalarlg.dat",
+   "sdp01.dat", "semiuri.dat", "test.dat", "transports.dat",
+   "trws.dat", "unkscm.dat", "unksm2.dat", "unreason.dat",
+   "wsinv.dat", "zeromf.dat"
+};
+
+// whole, then the first two of these for the variations of the long message
+const unsigned int chunkSizes[] = { 0, 7, 1, 2, 3, 15, 16, 17, 31, 32, 33, 100 };
+
+Data
+readFile(const char* name)
+{
+   FILE* fid = fopen(name, "rb");
+   if (!fid)
+   {
+      cerr << "cannot open " << name << endl;
+      exit(-1);
+   }
+   Data txt;
+   char buf[1024];
+   size_t n;
+   while ((n = fread(buf, 1, sizeof(buf), fid)) > 0)
+   {
+      txt += Data(buf, n);
+   }
+   fclose(fid);
+   return txt;
+}
+
+// Scans "txt" the way a stream connection does, handing the scanner at most
+// "chunkSize" new characters at a time, and describes the outcome.
+Data
+scan(const Data& txt, unsigned int chunkSize)
+{
+   SipMessage msg;
+   MsgHeaderScanner scanner;
+   scanner.prepareForMessage(&msg);
+
+   const char* next = txt.data();
+   const char* end = txt.data() + txt.size();
+   const char* saved = 0;
+   unsigned int numSaved = 0;
+   Data description;
+   {
+      DataStream ds(description);
+      for (;;)
+      {
+         unsigned int numNew = (unsigned int)(end - next);
+         if (chunkSize && numNew > chunkSize)
+         {
+            numNew = chunkSize;
+         }
+         char* buffer = MsgHeaderScanner::allocateBuffer(numSaved + numNew);
+         msg.addBuffer(buffer);
+         memcpy(buffer, saved, numSaved);
+         memcpy(buffer + numSaved, next, numNew);
+         next += numNew;
+
+         char* unprocessed;
+         MsgHeaderScanner::ScanChunkResult result =
+            scanner.scanChunk(buffer, numSaved + numNew, &unprocessed);
+         unsigned int numLeft = (unsigned int)(buffer + numSaved + numNew - unprocessed);
+         if (result != MsgHeaderScanner::scrNextChunk || next == end)
+         {
+            ds << "result " << result
+               << " at " << (next - txt.data()) - numLeft
+               << ", " << scanner.getHeaderCount() << " headers\n";
+            break;
+         }
+         saved = unprocessed;
+         numSaved = numLeft;
+      }
+
+      try
+      {
+         msg.encode(ds);
+      }
+      catch (BaseException& e)
+      {
+         ds << "encode failed: " << e.getMessage();
+      }
+   }
+   return description;
+}
+
+bool
+compare(const char* name, const Data& txt, const vector<MsgHeaderScanner::ScanImplementation>& impls,
+        unsigned int numChunkSizes = sizeof(chunkSizes) / sizeof(chunkSizes[0]))
+{
+   bool ok = true;
+   for (unsigned int c = 0; c < numChunkSizes; ++c)
+   {
+      MsgHeaderScanner::setScanImplementation(MsgHeaderScanner::siScalar);
+      Data expected = scan(txt, chunkSizes[c]);
+      for (size_t i = 0; i < impls.size(); ++i)
+      {
+         MsgHeaderScanner::setScanImplementation(impls[i]);
+         Data actual = scan(txt, chunkSizes[c]);
+         if (actual != expected)
+         {
+            cerr << name << ", chunks of " << chunkSizes[c] << ": "
+                 << MsgHeaderScanner::scanImplementationName(impls[i])
+                 << " differs from scalar\n--- scalar\n" << expected
+                 << "\n--- " << MsgHeaderScanner::scanImplementationName(impls[i])
+                 << "\n" << actual << endl;
+            ok = false;
+         }
+      }
+   }
+   return ok;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   vector<MsgHeaderScanner::ScanImplementation> impls;
+   if (MsgHeaderScanner::setScanImplementation(MsgHeaderScanner::siSse2))
+   {
+      impls.push_back(MsgHeaderScanner::siSse2);
+   }
+   if (MsgHeaderScanner::setScanImplementation(MsgHeaderScanner::siAvx2))
+   {
+      impls.push_back(MsgHeaderScanner::siAvx2);
+   }
+   cerr << "comparing";
+   for (size_t i = 0; i < impls.size(); ++i)
+   {
+      cerr << " " << MsgHeaderScanner::scanImplementationName(impls[i]);
+   }
+   cerr << " against scalar" << endl;
+
+   bool ok = true;
+
+   for (unsigned int f = 0; f < sizeof(tortureFiles) / sizeof(tortureFiles[0]); ++f)
+   {
+      ok = compare(tortureFiles[f], readFile(tortureFiles[f]), impls) && ok;
+   }
+
+   // Values long enough for several vectors, with every character that ends
+   // or changes a run, and every text property, on and around the vector
+   // boundaries.
+   const Data base =
+      "INVITE sip:bob@example.com;transport=tcp;x=0123456789abcdef0123456789abcdef SIP/2.0\r\n"
+      "Via: SIP/2.0/TCP host.example.com:5060;branch=z9hG4bK-0123456789abcdefghijklmno;rport\r\n"
+      "Contact: \"Bob \\\"the\\\" Builder, Esq. (home)\" <sip:bob@192.0.2.1:5060;transport=tcp;ob>;+sip.instance=\"<urn:uuid:0123456789>\"\r\n"
+      "Subject: a subject with spaces\ttabs; semicolons, commas, 100% (parens) and\r\n"
+      "  a continuation line that is long enough to span several vectors\r\n"
+      "Route: <sip:p1.example.com;lr>,<sip:p2.example.com;lr>, <sip:p3.example.com;lr>\r\n"
+      "X-Empty:\r\n"
+      "Content-Length: 0\r\n"
+      "\r\n";
+   ok = compare("base", base, impls) && ok;
+
+   const char specials[] = { '\r', '\n', '\0', ',', '<', '>', '"', '\\', ' ', '\t', '%', ';', '(', ')', ':' };
+   for (Data::size_type pos = 0; pos < base.size(); ++pos)
+   {
+      for (unsigned int s = 0; s < sizeof(specials); ++s)
+      {
+         Data txt(base);
+         const_cast<char*>(txt.data())[pos] = specials[s];
+         Data name;
+         {
+            DataStream ds(name);
+            ds << "base with char " << (int)specials[s] << " at " << pos;
+         }
+         ok = compare(name.c_str(), txt, impls, 2) && ok;
+      }
+   }
+
+   if (!ok)
+   {
+      cerr << "FAILED" << endl;
+      return -1;
+   }
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
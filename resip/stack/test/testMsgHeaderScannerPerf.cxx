@@ -0,0 +1,219 @@
+// Throughput of MsgHeaderScanner in MB/s of message header text, for each
+// implementation the CPU supports.  Every scan fills a fresh SipMessage, as
+// the transports do, so the figures include adding the headers to it.
+//
+// Usage: testMsgHeaderScannerPerf [iterations] [message files ...]
+//        (default 20000 iterations over a few typical messages)
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+const char* const defaultMessages[] =
+{
+   "INVITE sip:bob@biloxi.example.com;transport=tcp SIP/2.0\r\n"
+   "Via: SIP/2.0/TCP proxy.atlanta.example.com:5060;branch=z9hG4bK-524287-1---8a2b09d2c3f1e4a7;rport\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101;rport=50312\r\n"
+   "Max-Forwards: 69\r\n"
+   "Record-Route: <sip:proxy.atlanta.example.com;transport=tcp;lr;ftag=9fxced76sl>\r\n"
+   "To: \"Bob\" <sip:bob@biloxi.example.com>\r\n"
+   "From: \"Alice\" <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:alice@client.atlanta.example.com;transport=tcp;ob>;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-AABBCCDDEEFF>\"\r\n"
+   "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO, UPDATE\r\n"
+   "Supported: replaces, outbound, gruu, timer\r\n"
+   "User-Agent: Example Softphone 5.2.1 (Linux x86_64)\r\n"
+   "Session-Expires: 1800;refresher=uac\r\n"
+   "Min-SE: 90\r\n"
+   "Content-Type: application/sdp\r\n"
+   "Content-Length: 142\r\n"
+   "\r\n",
+
+   "SIP/2.0 200 OK\r\n"
+   "Via: SIP/2.0/TCP proxy.atlanta.example.com:5060;branch=z9hG4bK-524287-1---8a2b09d2c3f1e4a7;rport=5060\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101;rport=50312\r\n"
+   "Record-Route: <sip:proxy.atlanta.example.com;transport=tcp;lr;ftag=9fxced76sl>\r\n"
+   "To: \"Bob\" <sip:bob@biloxi.example.com>;tag=314159\r\n"
+   "From: \"Alice\" <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:bob@192.0.2.4;transport=tcp>\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n",
+
+   "REGISTER sip:registrar.biloxi.example.com SIP/2.0\r\n"
+   "Via: SIP/2.0/UDP bobspc.biloxi.example.com:5060;branch=z9hG4bKnashds7;rport\r\n"
+   "Max-Forwards: 70\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>\r\n"
+   "From: Bob <sip:bob@biloxi.example.com>;tag=456248\r\n"
+   "Call-ID: 843817637684230@998sdasdh09\r\n"
+   "CSeq: 1826 REGISTER\r\n"
+   "Contact: <sip:bob@192.0.2.4>;expires=7200;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-000A95A0E128>\";reg-id=1\r\n"
+   "Authorization: Digest username=\"bob\", realm=\"biloxi.example.com\", nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+   "uri=\"sip:registrar.biloxi.example.com\", response=\"245f23415f11432b3434341c022\", algorithm=MD5, qop=auth, nc=00000001, cnonce=\"0a4f113b\"\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n"
+};
+
+Data
+readFile(const char* name)
+{
+   FILE* fid = fopen(name, "rb");
+   if (!fid)
+   {
+      cerr << "cannot open " << name << endl;
+      exit(-1);
+   }
+   Data txt;
+   char buf[1024];
+   size_t n;
+   while ((n = fread(buf, 1, sizeof(buf), fid)) > 0)
+   {
+      txt += Data(buf, n);
+   }
+   fclose(fid);
+   return txt;
+}
+
+// Returns the number of header bytes scanned.
+uint64_t
+scanAll(const vector<Data>& messages, unsigned int iterations)
+{
+   uint64_t bytes = 0;
+   MsgHeaderScanner scanner;
+   for (unsigned int i = 0; i < iterations; ++i)
+   {
+      for (size_t m = 0; m < messages.size(); ++m)
+      {
+         SipMessage msg;
+         char* buffer = MsgHeaderScanner::allocateBuffer(messages[m].size());
+         msg.addBuffer(buffer);
+         memcpy(buffer, messages[m].data(), messages[m].size());
+         scanner.prepareForMessage(&msg);
+         char* unprocessed;
+         if (scanner.scanChunk(buffer, (unsigned int)messages[m].size(), &unprocessed) != MsgHeaderScanner::scrEnd)
+         {
+            cerr << "message " << m << " does not scan" << endl;
+            exit(-1);
+         }
+         bytes += unprocessed - buffer;
+      }
+   }
+   return bytes;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+   vector<Data> messages;
+   for (int i = 2; i < argc; ++i)
+   {
+      messages.push_back(readFile(argv[i]));
+   }
+   if (messages.empty())
+   {
+      for (size_t i = 0; i < sizeof(defaultMessages) / sizeof(defaultMessages[0]); ++i)
+      {
+         messages.push_back(defaultMessages[i]);
+      }
+   }
+
+   const MsgHeaderScanner::ScanImplementation impls[] =
+      { MsgHeaderScanner::siScalar, MsgHeaderScanner::siSse2, MsgHeaderScanner::siAvx2 };
+   double scalarMBps = 0;
+   for (unsigned int i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+   {
+      if (!MsgHeaderScanner::setScanImplementation(impls[i]))
+      {
+         cout << MsgHeaderScanner::scanImplementationName(impls[i]) << ": not supported" << endl;
+         continue;
+      }
+      scanAll(messages, iterations / 10 + 1);  // warm up
+      uint64_t start = Timer::getTimeMicroSec();
+      uint64_t bytes = scanAll(messages, iterations);
+      uint64_t elapsed = Timer::getTimeMicroSec() - start;
+      if (elapsed == 0)
+      {
+         elapsed = 1;
+      }
+      double mbps = double(bytes) / double(elapsed);
+      if (impls[i] == MsgHeaderScanner::siScalar)
+      {
+         scalarMBps = mbps;
+      }
+      cout << MsgHeaderScanner::scanImplementationName(impls[i]) << ": "
+           << bytes << " bytes in " << elapsed / 1000 << "ms, " << mbps << " MB/s";
+      if (scalarMBps > 0 && impls[i] != MsgHeaderScanner::siScalar)
+      {
+         cout << " (" << mbps / scalarMBps << "x scalar)";
+      }
+      cout << endl;
+   }
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -2508,6 +2508,84 @@ main(int argc, char** argv)
       assert(constIds.getByIndex(3) == nullptr);
    }
 
+   // Copies of a message from the wire share the encoded form of the headers
+   // none of them has modified; whatever was modified must still be encoded
+   // from the copy itself.
+   {
+      Data txt =
+         "INVITE sip:bob@example.com SIP/2.0\r\n"
+         "Via: SIP/2.0/UDP client.example.com;branch=z9hG4bK-share\r\n"
+         "Max-Forwards: 70\r\n"
+         "Route: <sip:proxy.example.com;lr>\r\n"
+         "To: <sip:bob@example.com>\r\n"
+         "From: <sip:alice@example.com>;tag=a1\r\n"
+         "Call-ID: share@client.example.com\r\n"
+         "CSeq: 1 INVITE\r\n"
+         "Supported: timer\r\n"
+         "X-Unknown:  spaced\r\n"
+         "Content-Length: 0\r\n"
+         "\r\n";
+      UnknownHeaderType h_XUnknown("X-Unknown");
+
+      // what a message that never shared its encoding looks like after modify
+      auto expected = [&](void (*modify)(SipMessage&))
+      {
+         unique_ptr<SipMessage> plain(SipMessage::make(txt));
+         modify(*plain);
+         return Data::from(*plain);
+      };
+      auto branchA = [](SipMessage& msg)
+      {
+         msg.header(h_RequestLine).uri().host() = "bob.example.com";
+         msg.header(h_MaxForwards).value()--;
+         msg.header(h_Vias).push_front(Via());
+         msg.header(h_Vias).front().sentHost() = "proxy.example.com";
+         msg.header(h_Vias).front().param(p_branch).reset("z9hG4bK-a");
+      };
+      auto branchB = [](SipMessage& msg)
+      {
+         msg.header(h_Routes).pop_front();
+         msg.header(UnknownHeaderType("X-Unknown")).push_back(StringCategory("more"));
+      };
+
+      unique_ptr<SipMessage> orig(SipMessage::make(txt, true /* isExternal */));
+      SipMessage a(*orig);
+      branchA(a);
+      SipMessage b(*orig);
+      branchB(b);
+      assert(Data::from(a) == expected(branchA));
+      assert(Data::from(b) == expected(branchB));
+
+      // a copy of a copy inherits what its source modified
+      SipMessage c(b);
+      c.header(h_To).param(p_tag) = "b1";
+      assert(Data::from(c) == expected([](SipMessage& msg)
+         {
+            msg.header(h_Routes).pop_front();
+            msg.header(UnknownHeaderType("X-Unknown")).push_back(StringCategory("more"));
+            msg.header(h_To).param(p_tag) = "b1";
+         }));
+
+      // the original, and copies made after it changed
+      orig->remove(h_Supporteds);
+      SipMessage d(*orig);
+      assert(Data::from(*orig) == expected([](SipMessage& msg) { msg.remove(h_Supporteds); }));
+      assert(Data::from(d) == expected([](SipMessage& msg) { msg.remove(h_Supporteds); }));
+      assert(Data::from(a) == expected(branchA));
+
+      // a header taken for modification before the first copy may change
+      // underneath any number of them
+      unique_ptr<SipMessage> orig2(SipMessage::make(txt, true /* isExternal */));
+      Via& via = orig2->header(h_Vias).front();
+      SipMessage e(*orig2);
+      Data before = Data::from(e);
+      via.param(p_branch).reset("z9hG4bK-changed");
+      SipMessage f(*orig2);
+      assert(Data::from(e) == before);
+      assert(Data::from(f) == expected([](SipMessage& msg) { msg.header(h_Vias).front().param(p_branch).reset("z9hG4bK-changed"); }));
+      assert(Data::from(*orig2) == Data::from(f));
+   }
+
    resipCerr << "\nTEST OK" << endl;
    return 0;
 }
@@ -159,7 +159,8 @@ class SipStackAndThread
    public:
       SipStackAndThread(const char *tType,
         AsyncProcessHandler *notifyDn=0,
-        AsyncProcessHandler *notifyUp=0);
+        AsyncProcessHandler *notifyUp=0,
+        unsigned int txShards=1);
          ~SipStackAndThread() {
          destroy();
       }
@@ -207,7 +208,8 @@ class SipStackAndThread
 
 
 SipStackAndThread::SipStackAndThread(const char *tType,
- AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp)
+ AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp,
+ unsigned int txShards)
   : mStack(0), 
       mThread(0), 
       mSelIntr(0), 
@@ -253,6 +255,7 @@ SipStackAndThread::SipStackAndThread(const char *tType,
    options.mAsyncProcessHandler = mEventIntr?mEventIntr
       :(mSelIntr?mSelIntr:notifyDn);
    options.mPollGrp = mPollGrp;
+   options.mTransactionShards = txShards;
    mStack = new SipStack(options);
    
    mStack->setFallbackPostNotify(notifyUp);
@@ -629,6 +632,7 @@ main(int argc, char* argv[])
    int sendSleepMs = 0;
    int cManager=0;
    int statisticsInterval=60;
+   int txShards=1;
 
 #if defined(HAVE_POPT_H)
 
@@ -655,6 +659,7 @@ main(int argc, char* argv[])
       {"use-congestion-manager",0, POPT_ARG_NONE, &cManager ,   0, "use a CongestionManager", 0},
       {"statistics-interval",       0,   POPT_ARG_INT,    &statisticsInterval,0, "time in seconds between statistics logging", 0},
       {"domain",      'd', POPT_ARG_STRING, &domain,    0, "the SIP domain to use", nullptr},
+      {"tx-shards",   0,   POPT_ARG_INT,    &txShards,  0, "number of transaction layer shards per stack", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -693,6 +698,7 @@ main(int argc, char* argv[])
      <<" bindIf="<<bindIfAddr
      <<" listen="<<doListen
      <<" tf="<<tpFlags
+     <<" txshards="<<txShards
      <<" domain="<<sipDomain
      <<"." << endl;
 
@@ -726,8 +732,8 @@ main(int argc, char* argv[])
    {
       notifyUp = &sharedUp;
    }
-   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp);
-   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp);
+   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp, txShards);
+   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp, txShards);
    receiver.getStack().setStatisticsInterval(statisticsInterval);
    sender.getStack().setStatisticsInterval(statisticsInterval);
 
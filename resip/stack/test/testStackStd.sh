@@ -13,6 +13,10 @@ echo "Running TCP REGISTER test (threaded stack)"
 ./testStack --protocol=tcp --thread-type=multithreadedstack
 echo "Running TCP REGISTER test (threaded stack, threaded transports)"
 ./testStack --protocol=tcp --thread-type=multithreadedstack --tf=32
+echo "Running TCP REGISTER test (threaded stack, 4 transaction shards)"
+./testStack --protocol=tcp --thread-type=multithreadedstack --tx-shards=4
+echo "Running UDP INVITE test (threaded stack, 4 transaction shards)"
+./testStack --protocol=udp --thread-type=multithreadedstack --tx-shards=4 --invite
 echo "Running UDP REGISTER test"
 ./testStack --protocol=udp
 echo "Running TCP REGISTER test with 50 ports"
@@ -115,9 +115,47 @@ main()
    sleep(1);
    timer.process();
    assert(r.size() == 5);
-   timer.process();   
+   timer.process();
    assert(r.size() == 5);
 
+   // cancellation (only the timing wheel supports it)
+   {
+      TimerQueueBase::setDefaultImplementation(TimerQueueBase::Wheel);
+      Fifo<TimerMessage> fired;
+      TransactionTimerQueue wheel(fired);
+      assert(wheel.getImplementation() == TimerQueueBase::Wheel);
+
+      TimerQueueBase::Handle a = wheel.add(Timer::TimerB, "cancelled", 200);
+      TimerQueueBase::Handle b = wheel.add(Timer::TimerB, "kept", 300);
+      assert(a != 0 && b != 0 && a != b);
+      assert(wheel.size() == 2);
+      assert(wheel.isPending(a));
+      assert(wheel.cancel(a));
+      assert(!wheel.isPending(a));
+      assert(!wheel.cancel(a));
+      assert(wheel.size() == 1);
+
+      usleep(400*1000);
+      wheel.process();
+      assert(fired.size() == 1);
+      TimerMessage* msg = fired.getNext();
+      assert(msg->getTransactionId() == "kept");
+      delete msg;
+      assert(!wheel.isPending(b));
+      assert(!wheel.cancel(b));
+      assert(wheel.empty());
+
+      TimerQueueBase::setDefaultImplementation(TimerQueueBase::Heap);
+      Fifo<TimerMessage> heapFired;
+      TransactionTimerQueue heap(heapFired);
+      assert(heap.getImplementation() == TimerQueueBase::Heap);
+      TimerQueueBase::Handle c = heap.add(Timer::TimerB, "heap", 100);
+      assert(c == 0);
+      assert(!heap.cancel(c));
+      assert(heap.size() == 1);
+      TimerQueueBase::setDefaultImplementation(TimerQueueBase::Wheel);
+   }
+
    cerr << "All OK" << endl;
    return 0;
 }
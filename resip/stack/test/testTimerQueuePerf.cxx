@@ -0,0 +1,163 @@
+// Microbenchmark comparing the heap and timing wheel implementations of
+// TransactionTimerQueue under a transaction-like load:
+//  - arm: every transaction starts a retransmit timer and a 32s timeout
+//  - churn: transactions complete; the wheel cancels their timers, the heap
+//    has to keep them until they expire
+//  - fire: a batch of short timers is allowed to expire and is processed
+//
+// Usage: testTimerQueuePerf [transactions]
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/TimerQueue.hxx"
+#include "resip/stack/TimerMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Timer.hxx"
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#else
+#include <unistd.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+static void
+report(const char* what, unsigned int count, uint64_t startUs)
+{
+   uint64_t elapsed = Timer::getTimeMicroSec() - startUs;
+   if (elapsed == 0)
+   {
+      elapsed = 1;
+   }
+   cout << "   " << what << ": " << count << " in " << elapsed / 1000 << "ms ("
+        << (uint64_t(count) * 1000000 / elapsed) << "/s)" << endl;
+}
+
+static void
+run(TimerQueueBase::Implementation impl, const vector<Data>& tids)
+{
+   const unsigned int count = (unsigned int)tids.size();
+   TimerQueueBase::setDefaultImplementation(impl);
+   Fifo<TimerMessage> fifo;
+   TransactionTimerQueue queue(fifo);
+   vector<TimerQueueBase::Handle> handles;
+   handles.reserve(count * 2);
+
+   cout << (impl == TimerQueueBase::Wheel ? "wheel" : "heap") << ":" << endl;
+
+   uint64_t start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      handles.push_back(queue.add(Timer::TimerE1, tids[i], Timer::T1 + (i % 1000)));
+      handles.push_back(queue.add(Timer::TimerF, tids[i], Timer::TF));
+   }
+   report("arm", count * 2, start);
+
+   // half of the transactions finish before any of their timers fire
+   start = Timer::getTimeMicroSec();
+   unsigned int cancelled = 0;
+   for (unsigned int i = 0; i < count; i += 2)
+   {
+      cancelled += queue.cancel(handles[2*i]) ? 1 : 0;
+      cancelled += queue.cancel(handles[2*i + 1]) ? 1 : 0;
+   }
+   report("cancel", count, start);
+   cout << "   pending after cancel: " << queue.size()
+        << " (" << cancelled << " cancelled)" << endl;
+
+   // many process() calls with nothing due, as in an idle stack loop
+   start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      queue.process();
+      queue.msTillNextTimer();
+   }
+   report("idle process", count, start);
+
+   // let the retransmit timers that are still pending fire
+   usleep((Timer::T1 + 1000) * 1000);
+   start = Timer::getTimeMicroSec();
+   queue.process();
+   unsigned int fired = fifo.size();
+   report("fire", fired, start);
+   while (fifo.messageAvailable())
+   {
+      delete fifo.getNext();
+   }
+   cout << "   pending after fire: " << queue.size() << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int count = 200000;
+   if (argc > 1)
+   {
+      count = (unsigned int)atoi(argv[1]);
+   }
+
+   vector<Data> tids;
+   tids.reserve(count);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      tids.push_back(Data("z9hG4bK-") + Data(i));
+   }
+
+   run(TimerQueueBase::Heap, tids);
+   run(TimerQueueBase::Wheel, tids);
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
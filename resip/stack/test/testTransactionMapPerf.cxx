@@ -0,0 +1,276 @@
+// Microbenchmark comparing the open addressing BranchIndex behind
+// TransactionMap with the node based std::unordered_map it replaced, under
+// transaction-like load at several map sizes:
+//  - insert: a burst of new transactions, including the worst single
+//    insert (which is where a stop-the-world rehash would show up)
+//  - find hit / find miss: lookups by branch, as for every inbound message
+//    and timer; half of the hits use a differently cased branch
+//  - churn: steady state, one transaction ends and one starts per step
+//  - erase: all transactions end
+//
+// Usage: testTransactionMapPerf [entries ...]   (default 100000 1000000)
+
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "resip/stack/BranchIndex.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+struct Entry
+{
+      Entry(const Data& id) : mId(id), mHash(id.caseInsensitiveTokenHash()) {}
+      Data mId;
+      size_t mHash;
+};
+
+struct EntryTraits
+{
+      static const Data& key(const Entry& e) { return e.mId; }
+      static size_t hash(const Entry& e) { return e.mHash; }
+};
+
+struct BranchHasher
+{
+      size_t operator()(const Data& branch) const { return branch.caseInsensitiveTokenHash(); }
+};
+
+struct BranchEqual
+{
+      bool operator()(const Data& b1, const Data& b2) const { return isEqualNoCase(b1, b2); }
+};
+
+typedef unordered_map<Data, Entry*, BranchHasher, BranchEqual> NodeMap;
+typedef BranchIndex<Entry, EntryTraits> OpenIndex;
+
+// the two containers behind one interface, the way TransactionMap uses them
+struct NodeMapOps
+{
+      static const char* name() { return "unordered_map"; }
+      static void insert(NodeMap& m, Entry* e) { m[e->mId] = e; }
+      static Entry* find(const NodeMap& m, const Data& id)
+      {
+         NodeMap::const_iterator i = m.find(id);
+         return i == m.end() ? 0 : i->second;
+      }
+      static void erase(NodeMap& m, Entry* e) { m.erase(e->mId); }
+};
+
+struct OpenIndexOps
+{
+      static const char* name() { return "BranchIndex"; }
+      static void insert(OpenIndex& m, Entry* e) { m.insert(e); }
+      static Entry* find(const OpenIndex& m, const Data& id) { return m.find(id, id.caseInsensitiveTokenHash()); }
+      static void erase(OpenIndex& m, Entry* e) { m.erase(e->mId, e->mHash); }
+};
+
+void
+report(const char* what, size_t count, uint64_t startUs)
+{
+   uint64_t elapsed = Timer::getTimeMicroSec() - startUs;
+   if (elapsed == 0)
+   {
+      elapsed = 1;
+   }
+   cout << "   " << what << ": " << count << " in " << elapsed / 1000 << "ms ("
+        << (uint64_t(count) * 1000000 / elapsed) << "/s)" << endl;
+}
+
+Data
+makeBranch(unsigned int i)
+{
+   return Data("z9hG4bK-") + Data(i * 2654435761u) + "-" + Data(i);
+}
+
+template <class Map, class Ops>
+void
+run(const vector<Entry*>& entries, const vector<Data>& upperIds, const vector<Entry*>& spare)
+{
+   const size_t count = entries.size();
+   Map map;
+   cout << Ops::name() << ", " << count << " entries:" << endl;
+
+   uint64_t worst = 0;
+   uint64_t start = Timer::getTimeMicroSec();
+   for (size_t i = 0; i < count; ++i)
+   {
+      uint64_t before = Timer::getTimeMicroSec();
+      Ops::insert(map, entries[i]);
+      uint64_t took = Timer::getTimeMicroSec() - before;
+      if (took > worst)
+      {
+         worst = took;
+      }
+   }
+   report("insert", count, start);
+   cout << "   worst single insert: " << worst << "us" << endl;
+
+   start = Timer::getTimeMicroSec();
+   size_t found = 0;
+   for (size_t i = 0; i < count; ++i)
+   {
+      const Data& id = (i & 1) ? upperIds[i] : entries[i]->mId;
+      found += (Ops::find(map, id) == entries[i]) ? 1 : 0;
+   }
+   report("find hit", count, start);
+   if (found != count)
+   {
+      cerr << "lookup failure: " << found << " of " << count << " found" << endl;
+      exit(-1);
+   }
+
+   start = Timer::getTimeMicroSec();
+   found = 0;
+   for (size_t i = 0; i < spare.size(); ++i)
+   {
+      found += Ops::find(map, spare[i]->mId) ? 1 : 0;
+   }
+   report("find miss", spare.size(), start);
+   if (found != 0)
+   {
+      cerr << "unexpected hit" << endl;
+      exit(-1);
+   }
+
+   worst = 0;
+   start = Timer::getTimeMicroSec();
+   for (size_t i = 0; i < spare.size(); ++i)
+   {
+      uint64_t before = Timer::getTimeMicroSec();
+      Ops::erase(map, entries[i]);
+      Ops::insert(map, spare[i]);
+      uint64_t took = Timer::getTimeMicroSec() - before;
+      if (took > worst)
+      {
+         worst = took;
+      }
+   }
+   report("churn", spare.size(), start);
+   cout << "   worst single churn step: " << worst << "us" << endl;
+
+   start = Timer::getTimeMicroSec();
+   for (size_t i = spare.size(); i < count; ++i)
+   {
+      Ops::erase(map, entries[i]);
+   }
+   for (size_t i = 0; i < spare.size(); ++i)
+   {
+      Ops::erase(map, spare[i]);
+   }
+   report("erase", count, start);
+   if (!map.empty())
+   {
+      cerr << "map not empty after erasing everything" << endl;
+      exit(-1);
+   }
+}
+
+void
+runSize(unsigned int count)
+{
+   vector<Entry*> entries;
+   vector<Data> upperIds;
+   vector<Entry*> spare;
+   entries.reserve(count);
+   upperIds.reserve(count);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      entries.push_back(new Entry(makeBranch(i)));
+      upperIds.push_back(entries.back()->mId);
+      upperIds.back().uppercase();
+   }
+   // not in the map until the churn phase; a tenth of the map size
+   for (unsigned int i = count; i < count + count / 10; ++i)
+   {
+      spare.push_back(new Entry(makeBranch(i)));
+   }
+
+   run<NodeMap, NodeMapOps>(entries, upperIds, spare);
+   run<OpenIndex, OpenIndexOps>(entries, upperIds, spare);
+
+   for (size_t i = 0; i < entries.size(); ++i)
+   {
+      delete entries[i];
+   }
+   for (size_t i = 0; i < spare.size(); ++i)
+   {
+      delete spare[i];
+   }
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   if (argc > 1)
+   {
+      for (int i = 1; i < argc; ++i)
+      {
+         runSize((unsigned int)atoi(argv[i]));
+      }
+   }
+   else
+   {
+      runSize(100000);
+      runSize(1000000);
+   }
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
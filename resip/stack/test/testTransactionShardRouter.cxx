@@ -0,0 +1,128 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "resip/stack/TransactionShardRouter.hxx"
+#include "rutil/Logger.hxx"
+#include "TestSupport.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+void
+testSingleShard()
+{
+   Fifo<TransactionMessage> fifo;
+   TransactionShardRouter router;
+   router.addShard(fifo);
+   assert(router.size() == 1);
+   for (int i = 0; i < 100; i++)
+   {
+      assert(router.shardFor("z9hG4bK" + Data(i)) == 0);
+   }
+   assert(&router.fifoFor("anything") == &fifo);
+}
+
+void
+testHashing()
+{
+   static const unsigned int Shards = 4;
+   Fifo<TransactionMessage> fifos[Shards];
+   TransactionShardRouter router;
+   for (unsigned int i = 0; i < Shards; i++)
+   {
+      router.addShard(fifos[i]);
+   }
+   assert(router.size() == Shards);
+
+   vector<unsigned int> counts(Shards, 0);
+   for (int i = 0; i < 4000; i++)
+   {
+      Data tid("z9hG4bK-" + Data(i * 7919) + "-abc");
+      unsigned int shard = router.shardFor(tid);
+      assert(shard < Shards);
+      assert(&router.fifoFor(tid) == &fifos[shard]);
+      counts[shard]++;
+
+      // TransactionMap ignores case, so must the router
+      Data upper(tid);
+      upper.uppercase();
+      assert(router.shardFor(upper) == shard);
+
+      // A CANCEL's transaction lives with its INVITE's
+      assert(router.shardFor(tid + "cancel") == shard);
+      assert(router.shardFor(tid + "CANCEL") == shard);
+      assert(router.shardFor(tid + "cancelcancel") == shard);
+   }
+   for (unsigned int i = 0; i < Shards; i++)
+   {
+      // an even spread would be 1000 each
+      assert(counts[i] > 800);
+   }
+}
+
+void
+testPost()
+{
+   static const unsigned int Shards = 3;
+   Fifo<TransactionMessage> fifos[Shards];
+   TransactionShardRouter router;
+   for (unsigned int i = 0; i < Shards; i++)
+   {
+      router.addShard(fifos[i]);
+   }
+
+   for (int i = 0; i < 30; i++)
+   {
+      Data txt("INVITE sip:bob@example.com SIP/2.0\r\n"
+               "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK" + Data(i) + "post\r\n"
+               "To: <sip:bob@example.com>\r\n"
+               "From: <sip:alice@example.com>;tag=1\r\n"
+               "Call-ID: " + Data(i) + "@192.0.2.1\r\n"
+               "CSeq: 1 INVITE\r\n"
+               "Max-Forwards: 70\r\n"
+               "Content-Length: 0\r\n"
+               "\r\n");
+      SipMessage* msg = TestSupport::makeMessage(txt);
+      unsigned int shard = router.shardFor(msg->getTransactionId());
+      router.post(msg);
+      assert(fifos[shard].size() == 1);
+      unique_ptr<TransactionMessage> posted(fifos[shard].getNext());
+      assert(posted.get() == msg);
+   }
+
+   // Without a Via there is no transaction id; shard 0 gets it, and drops it
+   SipMessage* noVia = TestSupport::makeMessage(
+      "INVITE sip:bob@example.com SIP/2.0\r\n"
+      "To: <sip:bob@example.com>\r\n"
+      "From: <sip:alice@example.com>;tag=1\r\n"
+      "Call-ID: novia@192.0.2.1\r\n"
+      "CSeq: 1 INVITE\r\n"
+      "Max-Forwards: 70\r\n"
+      "Content-Length: 0\r\n"
+      "\r\n");
+   router.post(noVia);
+   assert(fifos[0].size() == 1);
+   delete fifos[0].getNext();
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testSingleShard();
+   testHashing();
+   testPost();
+
+   cout << "All OK" << endl;
+   return 0;
+}
@@ -1,4 +1,6 @@
 #include <memory>
+#include <map>
+#include <set>
 
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TcpTransport.hxx"
@@ -23,8 +25,10 @@ class TestUdpTransport : public UdpTransport
                        const unsigned int transportKey,
                        int portNum,
                        IpVersion version,
-                       const Data& interfaceObj) :
-         UdpTransport(rxFifo, portNum, version, StunDisabled, version == V6 ? "::1" : "127.0.0.1")
+                       const Data& interfaceObj,
+                       unsigned transportFlags = 0) :
+         UdpTransport(rxFifo, portNum, version, StunDisabled, version == V6 ? "::1" : "127.0.0.1",
+                      nullptr, Compression::Disabled, transportFlags)
       {
          // The transport is bound to localhost to avoid socket conflicts.
          // However, the real host is used in comparisons.
@@ -147,7 +151,42 @@ class TestTransportSelector : public TransportSelector
          return actualTransportKey;
       }
 
+      // Adds an SO_REUSEPORT UDP shard to the group of primaryKey
+      unsigned int addShard(unsigned int primaryKey,
+                            const Data &interfaceObj,
+                            int portNum)
+      {
+         unsigned int actualTransportKey = mNextTransportKey;
+         std::unique_ptr<TestUdpTransport> transport(new TestUdpTransport { mFifo, actualTransportKey, portNum, V4, interfaceObj, RESIP_TRANSPORT_FLAG_REUSEPORT });
+         transport->setShardGroupKey(primaryKey);
+         // Linked to the primary as SipStack::addTransport does
+         Tuple primaryTuple { interfaceObj, portNum, V4, UDP };
+         primaryTuple.mTransportKey = primaryKey;
+         static_cast<UdpTransport*>(findTransportByDest(primaryTuple))->addShard(transport.get());
+
+         TransportSelector::addTransport(std::move(transport), false);
+         mNextTransportKey++;
+
+         return actualTransportKey;
+      }
+
+      unsigned int addReusePortTransport(const Data &interfaceObj, int portNum)
+      {
+         unsigned int actualTransportKey = mNextTransportKey;
+         std::unique_ptr<Transport> transport(new TestUdpTransport { mFifo, actualTransportKey, portNum, V4, interfaceObj, RESIP_TRANSPORT_FLAG_REUSEPORT });
+
+         TransportSelector::addTransport(std::move(transport), false);
+         mNextTransportKey++;
+
+         return actualTransportKey;
+      }
+
       // Expose private methods
+      Transport* selectShard(Transport* transport, const Tuple& target) const
+      {
+         return TransportSelector::selectShard(transport, target);
+      }
+
       Transport* findTransportBySource(Tuple& src, const SipMessage* msg) const
       {
          return TransportSelector::findTransportBySource(src, msg);
@@ -973,6 +1012,73 @@ testFindTransportByDest()
    }
 }
 
+void
+testShardGroups()
+{
+#if defined(SO_REUSEPORT)
+   resipCout << "test transport selection with SO_REUSEPORT shards" << std::endl;
+
+   TestTransportSelector ts;
+   auto primaryKey = ts.addReusePortTransport("192.168.1.1", 5070);
+   auto shardKey1 = ts.addShard(primaryKey, "192.168.1.1", 5070);
+   auto shardKey2 = ts.addShard(primaryKey, "192.168.1.1", 5070);
+
+   // The group is represented by its primary in all source/destination lookups
+   Tuple source { "192.168.1.1", 5070, V4, UDP };
+   Transport *primary = ts.findTransportBySource(source, nullptr);
+   resip_assert(primary != nullptr);
+   resip_assert(primary->getKey() == primaryKey);
+
+   Tuple dest { "1.2.3.4", 6050, V4, UDP };
+   Transport *t = ts.findTransportByDest(dest);
+   resip_assert(t == primary);
+
+   // Responses go back out the shard the request came in on
+   dest.mTransportKey = shardKey2;
+   t = ts.findTransportByDest(dest);
+   resip_assert(t != nullptr);
+   resip_assert(t->getKey() == shardKey2);
+   resip_assert(ts.selectShard(t, dest) == t);
+
+   // Outbound traffic is spread across the group, pinned per destination
+   // by the hash of the destination, in the order the group was added
+   const unsigned int groupKeys[] = { primaryKey, shardKey1, shardKey2 };
+   std::map<unsigned int, int> used;
+   for (int i = 1; i <= 64; ++i)
+   {
+      Tuple target { "10.0.0." + Data(i), 5060, V4, UDP };
+      Transport* shard = ts.selectShard(primary, target);
+      resip_assert(shard == ts.selectShard(primary, target));
+      resip_assert(shard->getKey() == groupKeys[target.hash() % 3]);
+      used[shard->getKey()]++;
+   }
+   resip_assert(used.size() == 3);
+   for (std::map<unsigned int, int>::const_iterator it = used.begin(); it != used.end(); ++it)
+   {
+      // no shard is starved or takes nearly everything
+      resip_assert(it->second >= 8);
+   }
+
+   // Removing a shard takes it out of the group, and out of the primary's
+   // list of shards that socket settings are applied to
+   ts.removeTransport(shardKey1);
+   dest.mTransportKey = shardKey1;
+   resip_assert(ts.findTransportByDest(dest) == nullptr);
+   for (int i = 1; i <= 64; ++i)
+   {
+      Tuple target { "10.0.0." + Data(i), 5060, V4, UDP };
+      resip_assert(ts.selectShard(primary, target)->getKey() != shardKey1);
+   }
+   static_cast<UdpTransport*>(primary)->setRcvBufLen(64 * 1024);
+   static_cast<UdpTransport*>(primary)->setBatchDepth(8);
+
+   // Removing the primary removes the whole group
+   ts.removeTransport(primaryKey);
+   dest.mTransportKey = shardKey2;
+   resip_assert(ts.findTransportByDest(dest) == nullptr);
+#endif
+}
+
 int
 main(int argc, char** argv)
 {
@@ -983,6 +1089,7 @@ main(int argc, char** argv)
    testFindTransportBySourceTlsTransport();
 #endif // USE_SSL
    testFindTransportByDest();
+   testShardGroups();
 
    return 0;
 }
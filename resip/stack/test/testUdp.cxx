@@ -36,6 +36,7 @@ main(int argc, char* argv[])
    int runs = 100;
    int window = 10;
    int seltime = 100;
+   int batch = 0;
 
 #if defined (HAVE_POPT_H) 
    struct poptOption table[] = {
@@ -44,6 +45,7 @@ main(int argc, char* argv[])
       {"num-runs",    'r', POPT_ARG_INT,    &runs,      0, "number of calls in test", 0},
       {"window-size", 'w', POPT_ARG_INT,    &window,    0, "number of registrations in test", 0},
       {"select-time", 's', POPT_ARG_INT,    &seltime,   0, "number of runs in test", 0},
+      {"batch",       'b', POPT_ARG_INT,    &batch,     0, "datagrams per recvmmsg/sendmmsg call (0 disables)", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -67,6 +69,12 @@ main(int argc, char* argv[])
    Fifo<TransactionMessage> rxFifo;
    UdpTransport* receiver = new UdpTransport(rxFifo, 5080, V4, StunDisabled, Data::Empty);
 
+   if (batch > 1)
+   {
+      sender->setBatchDepth(batch);
+      receiver->setBatchDepth(batch);
+   }
+
    NameAddr target;
    target.uri().scheme() = "sip";
    target.uri().user() = "fluffy";
@@ -160,6 +168,11 @@ main(int argc, char* argv[])
    uint64_t elapsed = Timer::getTimeMs() - startTime;
    cout << runs << " calls performed in " << elapsed << " ms, a rate of "
         << runs / ((float) elapsed / 1000.0) << " calls per second.]" << endl;
+   if (batch > 1)
+   {
+      cout << "mean datagrams per batch: rx=" << receiver->getMeanRxBatchSize()
+           << " tx=" << sender->getMeanTxBatchSize() << endl;
+   }
 
    return 0;
 }
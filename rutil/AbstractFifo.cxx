@@ -4,7 +4,12 @@
 using namespace resip;
 
 FifoStatsInterface::FifoStatsInterface() :
-   mRole(0)
+   mRole(0),
+   mWaitSampleAdded(0),
+   mWaitSampleTaken(0),
+   mWaitSampleState(SampleIdle),
+   mWaitSampleTicket(0),
+   mWaitSampleStartMicroSec(0)
 {
 }
 
@@ -12,6 +17,64 @@ FifoStatsInterface::~FifoStatsInterface()
 {
 }
 
+void
+FifoStatsInterface::enableWaitTimeSampling()
+{
+   if (!mWaitTimes.get())
+   {
+      mWaitTimes.reset(new LatencyRecorder);
+   }
+}
+
+void
+FifoStatsInterface::addWaitTimes(LatencyHistogram& histogram) const
+{
+   if (mWaitTimes.get())
+   {
+      mWaitTimes->addTo(histogram);
+   }
+}
+
+void
+FifoStatsInterface::zeroOutWaitTimes()
+{
+   if (mWaitTimes.get())
+   {
+      mWaitTimes->zeroOut();
+   }
+}
+
+void
+FifoStatsInterface::startWaitTimeSample(unsigned int num)
+{
+   // Take the ticket before the elements are added, so the consumer cannot
+   // take the sampled one out before the sample has started. Concurrent
+   // producers may add in a different order than they take tickets, which
+   // only shifts a sample by an element or two.
+   uint64_t ticket = mWaitSampleAdded.fetch_add(num, std::memory_order_relaxed) + num;
+   int idle = SampleIdle;
+   if (num != 0 &&
+       mWaitSampleState.load(std::memory_order_relaxed) == SampleIdle &&
+       mWaitSampleState.compare_exchange_strong(idle, SampleStarting, std::memory_order_acquire))
+   {
+      mWaitSampleTicket = ticket;
+      mWaitSampleStartMicroSec = Timer::getTimeMicroSec();
+      mWaitSampleState.store(SampleStarted, std::memory_order_release);
+   }
+}
+
+void
+FifoStatsInterface::finishWaitTimeSample(unsigned int num)
+{
+   mWaitSampleTaken += num;
+   if (mWaitSampleState.load(std::memory_order_acquire) == SampleStarted &&
+       mWaitSampleTaken >= mWaitSampleTicket)
+   {
+      mWaitTimes->record(Timer::getTimeMicroSec() - mWaitSampleStartMicroSec);
+      mWaitSampleState.store(SampleIdle, std::memory_order_release);
+   }
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
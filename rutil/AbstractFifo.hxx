@@ -2,14 +2,19 @@
 #define RESIP_AbstractFifo_hxx 
 
 #include "rutil/ResipAssert.h"
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <memory>
 
 #include "rutil/Mutex.hxx"
 #include "rutil/Condition.hxx"
 #include "rutil/Lock.hxx"
 #include "rutil/CongestionManager.hxx"
+#include "rutil/MpscQueue.hxx"
 
 #include "rutil/compat.hxx"
+#include "rutil/LatencyHistogram.hxx"
 #include "rutil/Timer.hxx"
 
 namespace resip
@@ -92,9 +97,57 @@ class FifoStatsInterface
       */
       virtual const resip::Data& getDescription() const {return mDescription;}
 
+      /**
+         Starts sampling how long elements wait in this fifo. While no sample
+         is outstanding, the next element added is timed until it is taken
+         out, so this costs a clock read per sample rather than per element;
+         under load, samples are about one wait time apart.
+         @note Must be called before the fifo is shared between threads.
+      */
+      void enableWaitTimeSampling();
+
+      /**
+         Merges the wait times sampled so far into histogram (in
+         micro-seconds); leaves it untouched if sampling is not enabled.
+      */
+      void addWaitTimes(LatencyHistogram& histogram) const;
+      void zeroOutWaitTimes();
+
    protected:
+      /// Called before num elements are added
+      void sampleWaitTimeAdding(unsigned int num)
+      {
+         if (mWaitTimes.get())
+         {
+            startWaitTimeSample(num);
+         }
+      }
+
+      /// Called after num elements have been taken out
+      void sampleWaitTimeTaken(unsigned int num)
+      {
+         if (mWaitTimes.get())
+         {
+            finishWaitTimeSample(num);
+         }
+      }
+
       Data mDescription;
       uint8_t mRole;
+
+   private:
+      void startWaitTimeSample(unsigned int num);
+      void finishWaitTimeSample(unsigned int num);
+
+      enum { SampleIdle, SampleStarting, SampleStarted };
+      std::unique_ptr<LatencyRecorder> mWaitTimes;
+      // The sampled element is the mWaitSampleTicket-th ever added; it is
+      // out once that many have been taken.
+      std::atomic<uint64_t> mWaitSampleAdded;
+      uint64_t mWaitSampleTaken; // consumer side
+      std::atomic<int> mWaitSampleState;
+      uint64_t mWaitSampleTicket;
+      uint64_t mWaitSampleStartMicroSec;
 };
 
 /**
@@ -116,6 +169,15 @@ class FifoStatsInterface
    (aka template hoist) 
    AbstractFifo's get operations are all threadsafe; AbstractFifo does not 
    define any put operations (these are defined in subclasses).
+
+   By default every operation takes the fifo's mutex. setLockFree() switches
+   a fifo to a bounded lock-free multi-producer/single-consumer ring
+   (MpscQueue): producers then never take the mutex unless the consumer is
+   parked in a blocking getNext(), or the ring is full and they spill into a
+   mutex-protected overflow list (so add() never blocks or fails).  Only one
+   thread may consume from a lock-free fifo; size(), empty() and
+   messageAvailable() remain callable from anywhere but are approximate
+   while producers are active.
    @note Users of the resip stack will not need to interact with this class 
       directly in most cases. Look at Fifo and TimeLimitFifo instead.
 
@@ -134,7 +196,9 @@ class AbstractFifo : public FifoStatsInterface
             mLastSampleTakenMicroSec(0),
             mCounter(0),
             mAverageServiceTimeMicroSec(0),
-            mSize(0)
+            mSize(0),
+            mOverflowing(false),
+            mConsumerWaiting(false)
       {}
 
       virtual ~AbstractFifo()
@@ -147,6 +211,10 @@ class AbstractFifo : public FifoStatsInterface
        **/
       bool empty() const
       {
+         if (mRing.get())
+         {
+            return mSize == 0;
+         }
          Lock lock(mMutex); (void)lock;
          return mFifo.empty();
       }
@@ -160,6 +228,10 @@ class AbstractFifo : public FifoStatsInterface
        */
       virtual unsigned int size() const
       {
+         if (mRing.get())
+         {
+            return mSize;
+         }
          Lock lock(mMutex); (void)lock;
          return (unsigned int)mFifo.size();
       }
@@ -171,6 +243,10 @@ class AbstractFifo : public FifoStatsInterface
        
       bool messageAvailable() const
       {
+         if (mRing.get())
+         {
+            return mSize != 0;
+         }
          Lock lock(mMutex); (void)lock;
          return !mFifo.empty();
       }
@@ -203,6 +279,25 @@ class AbstractFifo : public FifoStatsInterface
       /// remove all elements in the queue (or not)
       virtual void clear() {};
 
+      /**
+         @brief switches this fifo to the lock-free ring
+         @param capacity number of elements the ring holds before producers
+            spill into the overflow list; rounded up to a power of two
+         @note Must be called before the fifo is shared between threads, and
+            only one thread may consume from the fifo afterwards.
+      */
+      void setLockFree(unsigned int capacity)
+      {
+         Lock lock(mMutex); (void)lock;
+         resip_assert(mFifo.empty() && !mRing.get());
+         mRing.reset(new MpscQueue<T>(capacity));
+      }
+
+      bool isLockFree() const
+      {
+         return mRing.get() != 0;
+      }
+
    protected:
       /** 
           @brief Returns the first message available.
@@ -215,6 +310,14 @@ class AbstractFifo : public FifoStatsInterface
        */
       T getNext()
       {
+         if (mRing.get())
+         {
+            T firstMessage;
+            onFifoPolled();
+            waitLockFree(firstMessage, 0);
+            return firstMessage;
+         }
+
          Lock lock(mMutex); (void)lock;
          onFifoPolled();
 
@@ -250,6 +353,17 @@ class AbstractFifo : public FifoStatsInterface
             return true;
          }
 
+         if (mRing.get())
+         {
+            onFifoPolled();
+            if (ms < 0)
+            {
+               return popLockFree(toReturn, false);
+            }
+            const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+            return waitLockFree(toReturn, &end);
+         }
+
          if(ms < 0)
          {
             Lock lock(mMutex); (void)lock;
@@ -300,6 +414,13 @@ class AbstractFifo : public FifoStatsInterface
 
       void getMultiple(Messages& other, unsigned int max)
       {
+         if (mRing.get())
+         {
+            resip_assert(other.empty());
+            getMultipleLockFree(0, other, max);
+            return;
+         }
+
          Lock lock(mMutex); (void)lock;
          onFifoPolled();
          resip_assert(other.empty());
@@ -334,6 +455,11 @@ class AbstractFifo : public FifoStatsInterface
          }
 
          resip_assert(other.empty());
+         if (mRing.get())
+         {
+            return getMultipleLockFree(ms, other, max);
+         }
+
          const auto begin = std::chrono::steady_clock::now();
          const auto end = begin + std::chrono::milliseconds(ms); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
@@ -380,6 +506,25 @@ class AbstractFifo : public FifoStatsInterface
 
       size_t add(const T& item)
       {
+         sampleWaitTimeAdding(1);
+         if (mRing.get())
+         {
+            // Counted before it is published, so that the consumer can never
+            // take it off mSize first and wrap the count below zero
+            size_t size = onMessagePushed(1);
+            try
+            {
+               pushLockFree(item);
+            }
+            catch (...)
+            {
+               mSize -= 1;
+               throw;
+            }
+            wakeConsumer();
+            return size;
+         }
+
          Lock lock(mMutex); (void)lock;
          mFifo.push_back(item);
          mCondition.notify_one();
@@ -389,6 +534,29 @@ class AbstractFifo : public FifoStatsInterface
 
       size_t addMultiple(Messages& items)
       {
+         sampleWaitTimeAdding((unsigned int)items.size());
+         if (mRing.get())
+         {
+            size_t num = items.size();
+            size_t size = onMessagePushed((int)num);   // see add()
+            size_t pushed = 0;
+            try
+            {
+               for (typename Messages::const_iterator i = items.begin(); i != items.end(); ++i, ++pushed)
+               {
+                  pushLockFree(*i);
+               }
+            }
+            catch (...)
+            {
+               mSize -= (uint32_t)(num - pushed);
+               throw;
+            }
+            items.clear();
+            wakeConsumer();
+            return size;
+         }
+
          Lock lock(mMutex); (void)lock;
          size_t size=items.size();
          if(mFifo.empty())
@@ -417,20 +585,169 @@ class AbstractFifo : public FifoStatsInterface
       /** @brief condition for waiting on new queue items */
       Condition mCondition;
 
-      mutable uint64_t mLastSampleTakenMicroSec;
+      mutable std::atomic<uint64_t> mLastSampleTakenMicroSec;
       mutable uint32_t mCounter;
       mutable uint32_t mAverageServiceTimeMicroSec;
       // std::deque has to perform some amount of traversal to calculate its 
       // size; we maintain this count so that it can be queried without locking, 
       // in situations where it being off by a small amount is ok.
-      uint32_t mSize;
+      std::atomic<uint32_t> mSize;
+
+      // Lock-free mode (see setLockFree()). mFifo then belongs to the
+      // consumer alone and holds whatever it has taken over from mOverflow.
+      std::unique_ptr<MpscQueue<T> > mRing;
+      /** @brief producers' spill list while mRing is full; guarded by mMutex */
+      Messages mOverflow;
+      std::atomic<bool> mOverflowing;
+      std::atomic<bool> mConsumerWaiting;
+
+      /**
+         Called by the consumer of a lock-free fifo after each pop, with the
+         element now at the front (or 0 if none is visible yet).
+      */
+      virtual void onFrontChanged(const T* /*front*/)
+      {
+      }
+
+      void pushLockFree(const T& item)
+      {
+         if (mOverflowing.load(std::memory_order_acquire) || !mRing->push(item))
+         {
+            // Keep spilling until the consumer has caught up, so that items
+            // from one producer are never reordered.
+            Lock lock(mMutex); (void)lock;
+            mOverflow.push_back(item);
+            mOverflowing.store(true, std::memory_order_release);
+         }
+      }
+
+      void wakeConsumer()
+      {
+         // pairs with the fence in waitLockFree(); either we see the consumer
+         // waiting or it sees our element
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (mConsumerWaiting.load(std::memory_order_relaxed))
+         {
+            Lock lock(mMutex); (void)lock;
+            mCondition.notify_one();
+         }
+      }
+
+      /// consumer only; haveLock says whether mMutex is already held
+      bool popLockFree(T& item, bool haveLock)
+      {
+         if (mFifo.empty())
+         {
+            if (!mRing->pop(item))
+            {
+               // Spilled items are newer than anything in the ring, so only
+               // take them over once the ring has completely drained.
+               if (!mOverflowing.load(std::memory_order_acquire) || !mRing->idle())
+               {
+                  return false;
+               }
+               if (haveLock)
+               {
+                  takeOverflow();
+               }
+               else
+               {
+                  Lock lock(mMutex); (void)lock;
+                  takeOverflow();
+               }
+               if (mFifo.empty())
+               {
+                  return false;
+               }
+               item = mFifo.front();
+               mFifo.pop_front();
+            }
+         }
+         else
+         {
+            item = mFifo.front();
+            mFifo.pop_front();
+         }
+         onFrontChanged(mFifo.empty() ? mRing->front() : &mFifo.front());
+         onMessagePopped();
+         return true;
+      }
+
+      bool getMultipleLockFree(int ms, Messages& other, unsigned int max)
+      {
+         T item;
+         onFifoPolled();
+         bool got;
+         if (ms < 0)
+         {
+            got = popLockFree(item, false);
+         }
+         else if (ms == 0)
+         {
+            got = waitLockFree(item, 0);
+         }
+         else
+         {
+            const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+            got = waitLockFree(item, &end);
+         }
+         if (!got)
+         {
+            return false;
+         }
+         other.push_back(item);
+         while (other.size() < max && popLockFree(item, false))
+         {
+            other.push_back(item);
+         }
+         return true;
+      }
+
+      // mMutex must be held
+      void takeOverflow()
+      {
+         std::swap(mFifo, mOverflow);
+         mOverflowing.store(false, std::memory_order_release);
+      }
+
+      /// consumer only; waits until end (forever if 0) for an element
+      bool waitLockFree(T& item, const std::chrono::steady_clock::time_point* end)
+      {
+         if (popLockFree(item, false))
+         {
+            return true;
+         }
+         Lock lock(mMutex); (void)lock;
+         bool got = false;
+         for (;;)
+         {
+            mConsumerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (popLockFree(item, true))
+            {
+               got = true;
+               break;
+            }
+            if (end == 0)
+            {
+               mCondition.wait(lock);
+            }
+            else if (mCondition.wait_until(lock, *end) == std::cv_status::timeout)
+            {
+               got = popLockFree(item, true);
+               break;
+            }
+         }
+         mConsumerWaiting.store(false, std::memory_order_relaxed);
+         return got;
+      }
 
       virtual void onFifoPolled()
       {
          // !bwc! TODO allow this sampling frequency to be tweaked
          if(mLastSampleTakenMicroSec &&
             mCounter &&
-            (mCounter >= 64 || mFifo.empty()))
+            (mCounter >= 64 || mSize == 0))
          {
             uint64_t now(Timer::getTimeMicroSec());
             uint64_t diff = now-mLastSampleTakenMicroSec;
@@ -448,7 +765,7 @@ class AbstractFifo : public FifoStatsInterface
                      4096U);
             }
             mCounter=0;
-            if(mFifo.empty())
+            if(mSize == 0)
             {
                mLastSampleTakenMicroSec=0;
             }
@@ -467,17 +784,20 @@ class AbstractFifo : public FifoStatsInterface
       {
          mCounter+=num;
          mSize-=num;
+         sampleWaitTimeTaken(num);
       }
 
-      virtual void onMessagePushed(int num)
+      /// @return the number of elements after the push
+      virtual size_t onMessagePushed(int num)
       {
-         if(mSize==0)
+         uint32_t before = mSize.fetch_add(num);
+         if(before==0)
          {
             // Fifo went from empty to non-empty. Take a timestamp, and record
             // how long it takes to process some messages.
             mLastSampleTakenMicroSec=Timer::getTimeMicroSec();
          }
-         mSize+=num;
+         return before + num;
       }
    private:
       // no value semantics
@@ -0,0 +1,471 @@
+#include <chrono>
+#include <cstring>
+
+#include "rutil/AsyncLogWriter.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Subsystem.hxx"
+
+using namespace resip;
+
+/**
+   Byte ring of length-prefixed records.  The owning thread appends at
+   mTail, the writer thread consumes from mHead.  A record never wraps; if
+   it does not fit before the end of the buffer a Skip header is written
+   and the record starts again at offset 0.
+*/
+class AsyncLogWriter::Ring
+{
+   public:
+      explicit Ring(size_t capacity) :
+         mCapacity(roundUp(capacity)),
+         mBuffer(new char[mCapacity]),
+         mHead(0),
+         mTail(0),
+         mDetached(false)
+      {}
+
+      bool push(Log::Level level, const char* data, size_t length)
+      {
+         // a single record may use at most half of the ring
+         const size_t maxLength = mCapacity / 2 - sizeof(Header);
+         if (length > maxLength)
+         {
+            length = maxLength;
+         }
+         const size_t need = align(sizeof(Header) + length);
+         size_t tail = mTail.load(std::memory_order_relaxed);
+         const size_t head = mHead.load(std::memory_order_acquire);
+         size_t offset = tail & (mCapacity - 1);
+         size_t room = mCapacity - offset;
+         size_t skip = need > room ? room : 0;
+
+         if (tail + skip + need - head > mCapacity)
+         {
+            return false;
+         }
+         if (skip)
+         {
+            header(offset)->length = Skip;
+            tail += skip;
+            offset = 0;
+         }
+         Header* h = header(offset);
+         h->length = (uint32_t)length;
+         h->level = level;
+         memcpy(h + 1, data, length);
+         mTail.store(tail + need, std::memory_order_release);
+         return true;
+      }
+
+      /// writer thread only; calls fn(level, data, length) for each record
+      template <class Fn>
+      size_t pop(Fn& fn)
+      {
+         size_t head = mHead.load(std::memory_order_relaxed);
+         const size_t tail = mTail.load(std::memory_order_acquire);
+         size_t count = 0;
+         while (head != tail)
+         {
+            const size_t offset = head & (mCapacity - 1);
+            const Header* h = header(offset);
+            if (h->length == Skip)
+            {
+               head += mCapacity - offset;
+               continue;
+            }
+            fn((Log::Level)h->level, reinterpret_cast<const char*>(h + 1), h->length);
+            head += align(sizeof(Header) + h->length);
+            ++count;
+         }
+         mHead.store(head, std::memory_order_release);
+         return count;
+      }
+
+      bool empty() const
+      {
+         return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+      }
+
+      /// the owning thread has exited; the ring goes away once drained
+      void detach() { mDetached.store(true, std::memory_order_release); }
+      bool detached() const { return mDetached.load(std::memory_order_acquire); }
+
+   private:
+      struct Header
+      {
+         uint32_t length;
+         int32_t level;
+      };
+      static const uint32_t Skip = 0xFFFFFFFF;
+
+      static size_t align(size_t n)
+      {
+         return (n + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+      }
+      static size_t roundUp(size_t n)
+      {
+         size_t c = 1024;
+         while (c < n)
+         {
+            c <<= 1;
+         }
+         return c;
+      }
+      Header* header(size_t offset)
+      {
+         return reinterpret_cast<Header*>(mBuffer.get() + offset);
+      }
+
+      const size_t mCapacity;
+      std::unique_ptr<char[]> mBuffer;
+      alignas(64) std::atomic<size_t> mHead;
+      alignas(64) std::atomic<size_t> mTail;
+      std::atomic<bool> mDetached;
+};
+
+namespace
+{
+
+// Keeps the calling thread's ring; marks it detached when the thread exits
+// so the writer can release it once everything in it has been written.
+struct ThreadRing
+{
+      ~ThreadRing()
+      {
+         if (mRing)
+         {
+            mRing->detach();
+         }
+      }
+      std::shared_ptr<AsyncLogWriter::Ring> mRing;
+};
+thread_local ThreadRing tThreadRing;
+
+}
+
+AsyncLogWriter::AsyncLogWriter() :
+   mRunning(false),
+   mBufferSize(1024*1024),
+   mOverflow(Log::AsyncDrop),
+   mSleeping(false),
+   mWakeup(false),
+   mShutdown(false),
+   mFlushRequested(0),
+   mFlushCompleted(0),
+   mDropped(0),
+   mBlocked(0),
+   mDroppedReported(0)
+{
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+   stop();
+}
+
+void
+AsyncLogWriter::start(unsigned int bufferSize, Log::AsyncOverflow overflow)
+{
+   mBufferSize = bufferSize;
+   mOverflow = overflow;
+   if (mThread)
+   {
+      return;
+   }
+   {
+      Lock lock(mMutex); (void)lock;
+      mShutdown = false;
+   }
+   mThread.reset(new std::thread([this] { thread(); }));
+   mRunning.store(true, std::memory_order_release);
+}
+
+void
+AsyncLogWriter::stop()
+{
+   if (!mThread)
+   {
+      return;
+   }
+   // new records go straight to the stream from here on; whatever is
+   // queued is written by the writer's final drain
+   mRunning.store(false, std::memory_order_release);
+   {
+      Lock lock(mMutex); (void)lock;
+      mShutdown = true;
+      mCondition.notify_one();
+   }
+   mThread->join();
+   mThread.reset();
+}
+
+AsyncLogWriter::Ring&
+AsyncLogWriter::threadRing()
+{
+   if (!tThreadRing.mRing)
+   {
+      tThreadRing.mRing = std::make_shared<Ring>(mBufferSize.load());
+      Lock lock(mRingsMutex); (void)lock;
+      mRings.push_back(tThreadRing.mRing);
+   }
+   return *tThreadRing.mRing;
+}
+
+bool
+AsyncLogWriter::write(Log::Level level, const Data& record)
+{
+   if (!isRunning())
+   {
+      return false;
+   }
+
+   Ring& ring = threadRing();
+   if (!ring.push(level, record.data(), record.size()))
+   {
+      if (mOverflow.load(std::memory_order_relaxed) == Log::AsyncDrop)
+      {
+         mDropped.fetch_add(1, std::memory_order_relaxed);
+         return true;
+      }
+
+      mBlocked.fetch_add(1, std::memory_order_relaxed);
+      do
+      {
+         if (!isRunning())
+         {
+            return false;
+         }
+         wake();
+         std::this_thread::yield();
+      } while (!ring.push(level, record.data(), record.size()));
+   }
+
+   // see thread(): either the writer sees the record before going to
+   // sleep, or we see it sleeping
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (mSleeping.load(std::memory_order_relaxed))
+   {
+      wake();
+   }
+   return true;
+}
+
+void
+AsyncLogWriter::wake()
+{
+   Lock lock(mMutex); (void)lock;
+   mWakeup = true;
+   mCondition.notify_one();
+}
+
+void
+AsyncLogWriter::flush()
+{
+   Lock lock(mMutex);
+   if (!mThread || mShutdown)
+   {
+      return;
+   }
+   const uint64_t ticket = ++mFlushRequested;
+   mWakeup = true;
+   mCondition.notify_all();
+   mCondition.wait(lock, [this, ticket] { return mFlushCompleted >= ticket || mShutdown; });
+}
+
+bool
+AsyncLogWriter::drain()
+{
+   std::vector<std::shared_ptr<Ring> > rings;
+   {
+      Lock lock(mRingsMutex); (void)lock;
+      rings = mRings;
+   }
+
+   size_t written = 0;
+   {
+      Lock lock(Log::_mutex); (void)lock;
+      Log::ThreadData& logger = Log::mDefaultLoggerData;
+      const Log::Type type = logger.type();
+      std::ostream* last = 0;
+
+      auto writeRecord = [&](Log::Level level, const char* data, size_t length)
+      {
+         // Instance() takes care of rotating log files, so ask it per record
+         std::ostream& out = logger.Instance((unsigned int)length + 2);
+         if (last && last != &out)
+         {
+            last->flush();
+         }
+         last = &out;
+         if (type == Log::Syslog)
+         {
+            // endl is magic in syslog -- one line per record
+            out << level;
+            out.write(data, length);
+            out << std::endl;
+         }
+         else
+         {
+            out.write(data, length);
+            out << '\n';
+         }
+      };
+      // the logging type was changed to one without a stream after these
+      // records were queued
+      auto discardRecord = [](Log::Level, const char*, size_t) {};
+
+      const bool hasStream = (type == Log::Cout || type == Log::Cerr ||
+                              type == Log::File || type == Log::Syslog);
+      for (size_t i = 0; i < rings.size(); ++i)
+      {
+         written += hasStream ? rings[i]->pop(writeRecord) : rings[i]->pop(discardRecord);
+      }
+
+      const uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+      if (dropped != mDroppedReported && hasStream)
+      {
+         Data line;
+         {
+            DataStream ds(line);
+            Log::tags(Log::Warning, Subsystem::NONE, __FILE__, __LINE__, "AsyncLogWriter::drain",
+                      ds, Log::Unstructured);
+            ds << Log::delim << "log buffer overflow, dropped " << (dropped - mDroppedReported)
+               << " records (" << dropped << " in total)";
+         }
+         writeRecord(Log::Warning, line.data(), line.size());
+         mDroppedReported = dropped;
+      }
+
+      if (last)
+      {
+         last->flush();
+      }
+   }
+
+   // release rings of threads that have exited, once they are empty
+   {
+      Lock lock(mRingsMutex); (void)lock;
+      for (std::vector<std::shared_ptr<Ring> >::iterator i = mRings.begin(); i != mRings.end(); )
+      {
+         if ((*i)->detached() && (*i)->empty())
+         {
+            i = mRings.erase(i);
+         }
+         else
+         {
+            ++i;
+         }
+      }
+   }
+
+   return written > 0;
+}
+
+void
+AsyncLogWriter::thread()
+{
+   for (;;)
+   {
+      uint64_t flushRequested;
+      bool shutdown;
+      {
+         Lock lock(mMutex); (void)lock;
+         flushRequested = mFlushRequested;
+         shutdown = mShutdown;
+         mWakeup = false;
+      }
+
+      bool wrote = drain();
+
+      {
+         Lock lock(mMutex); (void)lock;
+         if (flushRequested != mFlushCompleted)
+         {
+            mFlushCompleted = flushRequested;
+            mCondition.notify_all();
+         }
+      }
+
+      if (shutdown)
+      {
+         // the final drain ran after mShutdown was seen
+         Lock lock(mMutex); (void)lock;
+         mCondition.notify_all();
+         return;
+      }
+
+      if (!wrote)
+      {
+         mSleeping.store(true, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         bool idle = true;
+         {
+            Lock lock(mRingsMutex); (void)lock;
+            for (size_t i = 0; i < mRings.size() && idle; ++i)
+            {
+               idle = mRings[i]->empty();
+            }
+         }
+
+         if (idle)
+         {
+            Lock lock(mMutex);
+            mCondition.wait_for(lock, std::chrono::milliseconds(100),
+                                [this] { return mWakeup || mShutdown || mFlushRequested != mFlushCompleted; });
+         }
+         mSleeping.store(false, std::memory_order_relaxed);
+      }
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
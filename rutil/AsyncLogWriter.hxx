@@ -0,0 +1,148 @@
+#if !defined(RESIP_ASYNCLOGWRITER_HXX)
+#define RESIP_ASYNCLOGWRITER_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Mutex.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Moves the writing of log records off the logging threads.
+
+   Each thread that logs gets its own fixed-size ring of already formatted
+   records (single producer, single consumer, no locks).  A dedicated
+   writer thread drains all the rings and writes the records to the
+   default logger's stream, taking Log::_mutex once per batch instead of
+   once per record and flushing once per batch instead of once per line.
+
+   When a thread's ring is full the record is either dropped
+   (Log::AsyncDrop, the default; counted, and reported in the log by the
+   writer) or the logging thread waits for the writer to make room
+   (Log::AsyncBlock; also counted).
+
+   Only the default logger is handled here.  Threads using a local logger
+   (see Log::setThreadLocalLogger) and VSDebugWindow logging keep writing
+   synchronously.  Records are preformatted, so external loggers and
+   JSON_CEE formatting behave exactly as in synchronous mode.
+
+   Used through Log::setAsync() or the "async-" prefix on the logging type
+   (e.g. "async-file").
+*/
+class AsyncLogWriter
+{
+   public:
+      AsyncLogWriter();
+      ~AsyncLogWriter();
+
+      /// (re)starts the writer thread; bufferSize only applies to rings
+      /// created from now on
+      void start(unsigned int bufferSize, Log::AsyncOverflow overflow);
+      /// writes out everything queued so far, then stops the writer thread
+      void stop();
+      bool isRunning() const { return mRunning.load(std::memory_order_acquire); }
+
+      /// queues a record for the calling thread; false if the writer is not
+      /// running (the caller should then write the record itself)
+      bool write(Log::Level level, const Data& record);
+
+      /// waits until everything queued before the call has been written
+      void flush();
+
+      uint64_t droppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+      uint64_t blockedCount() const { return mBlocked.load(std::memory_order_relaxed); }
+
+      class Ring;
+
+   private:
+      void thread();
+      bool drain();
+      void wake();
+      Ring& threadRing();
+
+      std::atomic<bool> mRunning;
+      std::unique_ptr<std::thread> mThread;
+      std::atomic<unsigned int> mBufferSize;
+      std::atomic<int> mOverflow;
+
+      Mutex mRingsMutex;
+      std::vector<std::shared_ptr<Ring> > mRings;
+
+      // writer sleeps on mCondition when all rings are empty
+      Mutex mMutex;
+      std::condition_variable mCondition;
+      std::atomic<bool> mSleeping;
+      bool mWakeup;
+      bool mShutdown;
+      uint64_t mFlushRequested;
+      uint64_t mFlushCompleted;
+
+      std::atomic<uint64_t> mDropped;
+      std::atomic<uint64_t> mBlocked;
+      uint64_t mDroppedReported;
+
+      // disabled
+      AsyncLogWriter(const AsyncLogWriter&);
+      AsyncLogWriter& operator=(const AsyncLogWriter&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -3,6 +3,8 @@
 
 #include "rutil/Data.hxx"
 
+#include <vector>
+
 namespace resip
 {
 class FifoStatsInterface;
@@ -94,6 +96,27 @@ class CongestionManager
    */
    virtual EncodeStream& encodeCurrentState(EncodeStream& strm) const=0;
 
+   /**
+      A copy of the state of one monitored fifo.
+   */
+   struct FifoState
+   {
+      Data description;
+      size_t size;
+      time_t timeDepthSecs;
+      time_t expectedWaitMilliSec;
+      time_t averageServiceTimeMicroSec;
+      uint16_t congestionPercent;
+      RejectionBehavior behavior;
+   };
+
+   /**
+      Get a copy of the current state of all monitored fifos, for reporting
+      without holding any locks of the congestion manager. The default 
+      implementation reports nothing.
+   */
+   virtual void getCurrentState(std::vector<FifoState>& state) const {}
+
 };
 
 
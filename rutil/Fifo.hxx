@@ -88,6 +88,17 @@ template <class Msg>
 void
 Fifo<Msg>::clear()
 {
+   if (this->isLockFree())
+   {
+      // consumer side only, like getNext()
+      Msg* msg;
+      while (this->popLockFree(msg, false))
+      {
+         delete msg;
+      }
+      return;
+   }
+
    Lock lock(mMutex); (void)lock;
    while ( ! mFifo.empty() )
    {
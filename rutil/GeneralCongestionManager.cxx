@@ -134,6 +134,31 @@ GeneralCongestionManager::encodeCurrentState(EncodeStream& strm) const
    return strm;
 }
 
+void
+GeneralCongestionManager::getCurrentState(std::vector<FifoState>& state) const
+{
+   state.clear();
+   Lock lock(mFifosMutex);
+   state.reserve(mFifos.size());
+   for(std::vector<FifoInfo>::const_iterator i=mFifos.begin();
+         i!=mFifos.end();++i)
+   {
+      if(i->fifo)
+      {
+         const FifoStatsInterface& fifo=*(i->fifo);
+         FifoState fifoState;
+         fifoState.description=fifo.getDescription();
+         fifoState.size=fifo.getCountDepth();
+         fifoState.timeDepthSecs=fifo.getTimeDepth();
+         fifoState.expectedWaitMilliSec=fifo.expectedWaitTimeMilliSec();
+         fifoState.averageServiceTimeMicroSec=fifo.averageServiceTimeMicroSec();
+         fifoState.congestionPercent=getCongestionPercentInternal(&fifo);
+         fifoState.behavior=getRejectionBehaviorInternal(&fifo);
+         state.push_back(fifoState);
+      }
+   }
+}
+
 uint16_t
 GeneralCongestionManager::getCongestionPercent(const FifoStatsInterface* fifo) const
 {
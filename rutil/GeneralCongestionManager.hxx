@@ -141,6 +141,7 @@ class GeneralCongestionManager : public CongestionManager
 
       virtual void logCurrentState() const;
       virtual EncodeStream& encodeCurrentState(EncodeStream& strm) const;
+      virtual void getCurrentState(std::vector<FifoState>& state) const;
 
    private:
       virtual RejectionBehavior getRejectionBehaviorInternal(const FifoStatsInterface *fifo) const;
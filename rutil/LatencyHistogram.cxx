@@ -0,0 +1,226 @@
+#include <string.h>
+
+#include "rutil/LatencyHistogram.hxx"
+
+using namespace resip;
+
+LatencyHistogram::LatencyHistogram()
+{
+   zeroOut();
+}
+
+unsigned int
+LatencyHistogram::bucketFor(uint64_t microSec)
+{
+   if (microSec < SubBuckets)
+   {
+      return (unsigned int)microSec;
+   }
+   if (microSec >= MaxMicroSec)
+   {
+      return NumBuckets - 1;
+   }
+#if defined(__GNUC__)
+   unsigned int exponent = 63 - __builtin_clzll(microSec);
+#else
+   unsigned int exponent = SubBucketBits;
+   while ((microSec >> (exponent + 1)) != 0)
+   {
+      ++exponent;
+   }
+#endif
+   return SubBuckets + (exponent - SubBucketBits) * SubBuckets +
+      (unsigned int)((microSec >> (exponent - SubBucketBits)) & (SubBuckets - 1));
+}
+
+uint64_t
+LatencyHistogram::bucketLowerBound(unsigned int bucket)
+{
+   if (bucket < SubBuckets)
+   {
+      return bucket;
+   }
+   unsigned int exponent = SubBucketBits + (bucket - SubBuckets) / SubBuckets;
+   uint64_t subBucket = (bucket - SubBuckets) % SubBuckets;
+   return (SubBuckets + subBucket) << (exponent - SubBucketBits);
+}
+
+uint64_t
+LatencyHistogram::bucketUpperBound(unsigned int bucket)
+{
+   if (bucket + 1 >= NumBuckets)
+   {
+      return MaxMicroSec - 1;
+   }
+   return bucketLowerBound(bucket + 1) - 1;
+}
+
+void
+LatencyHistogram::record(uint64_t microSec)
+{
+   ++mCounts[bucketFor(microSec)];
+   ++mCount;
+   mSumMicroSec += microSec;
+   if (microSec > mMaxMicroSec)
+   {
+      mMaxMicroSec = microSec;
+   }
+}
+
+void
+LatencyHistogram::add(const LatencyHistogram& other)
+{
+   for (unsigned int i = 0; i < NumBuckets; ++i)
+   {
+      mCounts[i] += other.mCounts[i];
+   }
+   mCount += other.mCount;
+   mSumMicroSec += other.mSumMicroSec;
+   if (other.mMaxMicroSec > mMaxMicroSec)
+   {
+      mMaxMicroSec = other.mMaxMicroSec;
+   }
+}
+
+void
+LatencyHistogram::zeroOut()
+{
+   memset(mCounts, 0, sizeof(mCounts));
+   mCount = 0;
+   mSumMicroSec = 0;
+   mMaxMicroSec = 0;
+}
+
+uint64_t
+LatencyHistogram::percentile(double fraction) const
+{
+   if (mCount == 0)
+   {
+      return 0;
+   }
+   uint64_t rank = (uint64_t)(fraction * mCount + 0.999999);
+   if (rank < 1)
+   {
+      rank = 1;
+   }
+   uint64_t seen = 0;
+   for (unsigned int i = 0; i < NumBuckets; ++i)
+   {
+      seen += mCounts[i];
+      if (seen >= rank)
+      {
+         uint64_t upper = bucketUpperBound(i);
+         return (i + 1 == NumBuckets || upper > mMaxMicroSec) ? mMaxMicroSec : upper;
+      }
+   }
+   return mMaxMicroSec;
+}
+
+EncodeStream&
+resip::operator<<(EncodeStream& strm, const LatencyHistogram& histogram)
+{
+   strm << "n=" << histogram.count();
+   if (histogram.count())
+   {
+      strm << " p50=" << histogram.percentile(0.5)
+           << "us p90=" << histogram.percentile(0.9)
+           << "us p99=" << histogram.percentile(0.99)
+           << "us max=" << histogram.maxMicroSec() << "us";
+   }
+   return strm;
+}
+
+LatencyRecorder::LatencyRecorder()
+{
+   zeroOut();
+}
+
+void
+LatencyRecorder::record(uint64_t microSec)
+{
+   mCounts[LatencyHistogram::bucketFor(microSec)].fetch_add(1, std::memory_order_relaxed);
+   mSumMicroSec.fetch_add(microSec, std::memory_order_relaxed);
+   uint64_t max = mMaxMicroSec.load(std::memory_order_relaxed);
+   while (microSec > max &&
+          !mMaxMicroSec.compare_exchange_weak(max, microSec, std::memory_order_relaxed))
+   {
+   }
+}
+
+void
+LatencyRecorder::addTo(LatencyHistogram& histogram) const
+{
+   for (unsigned int i = 0; i < LatencyHistogram::NumBuckets; ++i)
+   {
+      uint32_t count = mCounts[i].load(std::memory_order_relaxed);
+      histogram.mCounts[i] += count;
+      histogram.mCount += count;
+   }
+   histogram.mSumMicroSec += mSumMicroSec.load(std::memory_order_relaxed);
+   uint64_t max = mMaxMicroSec.load(std::memory_order_relaxed);
+   if (max > histogram.mMaxMicroSec)
+   {
+      histogram.mMaxMicroSec = max;
+   }
+}
+
+void
+LatencyRecorder::zeroOut()
+{
+   for (unsigned int i = 0; i < LatencyHistogram::NumBuckets; ++i)
+   {
+      mCounts[i].store(0, std::memory_order_relaxed);
+   }
+   mSumMicroSec.store(0, std::memory_order_relaxed);
+   mMaxMicroSec.store(0, std::memory_order_relaxed);
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
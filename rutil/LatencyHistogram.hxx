@@ -0,0 +1,152 @@
+#if !defined(RESIP_LATENCYHISTOGRAM_HXX)
+#define RESIP_LATENCYHISTOGRAM_HXX
+
+#include <atomic>
+
+#include "rutil/compat.hxx"
+#include "rutil/resipfaststreams.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Histogram of durations in microseconds, with buckets whose width
+   grows with the value (as in HdrHistogram).
+
+   Values below 8 each have a bucket of their own; above that every power of
+   two is split into 8 buckets, so a bucket is never wider than 1/8 of the
+   values in it and percentiles are within 12.5% of the true value.  Values
+   of MaxMicroSec (about 268 seconds) and above share the last bucket.
+
+   This is the plain, copyable form, for reports and merging.  To record
+   from several threads use LatencyRecorder.
+*/
+class LatencyHistogram
+{
+   public:
+      enum
+      {
+         SubBucketBits = 3,
+         SubBuckets = 1 << SubBucketBits,
+         MaxExponent = 27,
+         NumBuckets = SubBuckets + (MaxExponent - SubBucketBits + 1) * SubBuckets
+      };
+      static const uint64_t MaxMicroSec = (uint64_t)1 << (MaxExponent + 1);
+
+      LatencyHistogram();
+
+      void record(uint64_t microSec);
+      /// Merges other into this histogram.
+      void add(const LatencyHistogram& other);
+      void zeroOut();
+
+      uint64_t count() const { return mCount; }
+      uint64_t sumMicroSec() const { return mSumMicroSec; }
+      uint64_t maxMicroSec() const { return mMaxMicroSec; }
+      uint64_t meanMicroSec() const { return mCount ? mSumMicroSec / mCount : 0; }
+      /// The value at or below which "fraction" (0 to 1) of the recorded
+      /// values lie: the top of its bucket, but no more than the largest
+      /// value recorded.  0 if nothing has been recorded.
+      uint64_t percentile(double fraction) const;
+      uint32_t bucketCount(unsigned int bucket) const { return mCounts[bucket]; }
+
+      static unsigned int bucketFor(uint64_t microSec);
+      /// Smallest and largest value that fall in "bucket".
+      static uint64_t bucketLowerBound(unsigned int bucket);
+      static uint64_t bucketUpperBound(unsigned int bucket);
+
+   private:
+      friend class LatencyRecorder;
+
+      uint32_t mCounts[NumBuckets];
+      uint64_t mCount;
+      uint64_t mSumMicroSec;
+      uint64_t mMaxMicroSec;
+};
+
+/// Prints the count, p50, p90, p99 and maximum, in microseconds.
+EncodeStream& operator<<(EncodeStream& strm, const LatencyHistogram& histogram);
+
+/**
+   @brief LatencyHistogram buckets that any number of threads can record
+   into without locking.
+
+   Each record() is a few relaxed atomic increments, so a recorder written
+   by one thread costs little more than a plain histogram; give each busy
+   thread its own recorder and merge them with addTo() when reporting.
+   addTo() and zeroOut() may run concurrently with record(), in which case
+   a value being recorded may be partly counted.
+*/
+class LatencyRecorder
+{
+   public:
+      LatencyRecorder();
+
+      void record(uint64_t microSec);
+      /// Merges what has been recorded into histogram.
+      void addTo(LatencyHistogram& histogram) const;
+      void zeroOut();
+
+   private:
+      std::atomic<uint32_t> mCounts[LatencyHistogram::NumBuckets];
+      std::atomic<uint64_t> mSumMicroSec;
+      std::atomic<uint64_t> mMaxMicroSec;
+
+      // not copyable
+      LatencyRecorder(const LatencyRecorder&);
+      LatencyRecorder& operator=(const LatencyRecorder&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "rutil/AsyncLogWriter.hxx"
 #include "rutil/Log.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
@@ -54,6 +55,9 @@ int Log::mSyslogFacility = -1;
 unsigned int Log::MaxLineCount = RESIP_LOG_MAX_LINE_COUNT_DEFAULT; // no limit by default
 unsigned int Log::MaxByteCount = RESIP_LOG_MAX_BYTE_COUNT_DEFAULT; // no limit by default
 bool Log::KeepAllLogFiles = false;  // do not keep all log files by default
+unsigned int Log::AsyncBufferSize = 1024*1024;
+Log::AsyncOverflow Log::AsyncOverflowAction = Log::AsyncDrop;
+std::atomic<AsyncLogWriter*> Log::mAsyncWriter{nullptr};
 
 std::atomic<unsigned int> Log::touchCount{0};
 
@@ -131,6 +135,14 @@ LogStaticInitializer::~LogStaticInitializer()
       delete Log::mLevelKey;
 #endif
 
+      // write out anything still queued before the streams go away
+      AsyncLogWriter* writer = Log::mAsyncWriter.exchange(nullptr);
+      if (writer)
+      {
+         writer->stop();
+         delete writer;
+      }
+
       ThreadIf::tlsKeyDelete(*Log::mLocalLoggerKey);
       delete Log::mLocalLoggerKey;
    }
@@ -149,10 +161,14 @@ Log::initialize(const Data& typed, const Data& leveld, const Data& appName,
                 const Data& messageStructure,
                 const Data& instanceName)
 {
+   // "async-<type>" selects <type>, written from the async writer thread
+   const bool async = isAsyncType(typed);
+   const Data baseType = async ? typed.substr(6) : typed;
+
    Type type = Log::Cout;
-   if (isEqualNoCase(typed, "cout")) type = Log::Cout;
-   else if (isEqualNoCase(typed, "cerr")) type = Log::Cerr;
-   else if (isEqualNoCase(typed, "file")) type = Log::File;
+   if (isEqualNoCase(baseType, "cout")) type = Log::Cout;
+   else if (isEqualNoCase(baseType, "cerr")) type = Log::Cerr;
+   else if (isEqualNoCase(baseType, "file")) type = Log::File;
 #ifndef WIN32
    else type = Log::Syslog;
 #endif
@@ -167,6 +183,7 @@ Log::initialize(const Data& typed, const Data& leveld, const Data& appName,
    }
 
    Log::initialize(type, level, appName, logFileName, externalLogger, syslogFacilityName, _messageStructure, instanceName);
+   setAsync(async);
 }
 
 int
@@ -272,6 +289,8 @@ Log::initialize(Type type, Level level, const Data& appName,
                 MessageStructure messageStructure,
                 const Data& instanceName)
 {
+   // records queued in async mode belong to the old target
+   flushAsync();
    {
       Lock lock(_mutex);
       mDefaultLoggerData.reset();   
@@ -393,6 +412,9 @@ Log::initialize(const ConfigParse& configParse, const Data& appName, ExternalLog
 
    Log::setKeepAllLogFiles(configParse.getConfigBool("KeepAllLogFiles", false));
 
+   Log::setAsyncBufferSize(configParse.getConfigUnsignedLong("LogAsyncBufferSize", 1024*1024));
+   Log::setAsyncOverflow(toAsyncOverflow(configParse.getConfigData("LogAsyncOverflow", "drop", true)));
+
    Data loggingType = configParse.getConfigData("LoggingType", "cout", true);
    Data syslogFacilityName = configParse.getConfigData("SyslogFacility", "LOG_DAEMON", true);
    // Most applications now use LogLevel
@@ -568,6 +590,100 @@ Log::setKeepAllLogFiles(bool keepAllLogFiles, Log::LocalLoggerId loggerId)
     }
 }
 
+namespace
+{
+// serializes starting and stopping the async writer; not Log::_mutex,
+// since the writer thread needs that one to finish
+Mutex&
+asyncMutex()
+{
+   static Mutex m;
+   return m;
+}
+}
+
+void
+Log::setAsync(bool enable)
+{
+   Lock lock(asyncMutex());
+   AsyncLogWriter* writer = mAsyncWriter.load();
+   if (enable)
+   {
+      if (!writer)
+      {
+         writer = new AsyncLogWriter;
+         mAsyncWriter.store(writer);
+      }
+      writer->start(AsyncBufferSize, AsyncOverflowAction);
+   }
+   else if (writer)
+   {
+      // the writer object is kept, a Guard may still be looking at it
+      writer->stop();
+   }
+}
+
+bool
+Log::isAsync()
+{
+   AsyncLogWriter* writer = mAsyncWriter.load();
+   return writer && writer->isRunning();
+}
+
+void
+Log::setAsyncBufferSize(unsigned int bufferSize)
+{
+   Lock lock(asyncMutex());
+   AsyncBufferSize = bufferSize;
+}
+
+void
+Log::setAsyncOverflow(AsyncOverflow overflow)
+{
+   Lock lock(asyncMutex());
+   AsyncOverflowAction = overflow;
+}
+
+void
+Log::flushAsync()
+{
+   AsyncLogWriter* writer = mAsyncWriter.load();
+   if (writer)
+   {
+      writer->flush();
+   }
+}
+
+uint64_t
+Log::getAsyncDroppedCount()
+{
+   AsyncLogWriter* writer = mAsyncWriter.load();
+   return writer ? writer->droppedCount() : 0;
+}
+
+uint64_t
+Log::getAsyncBlockedCount()
+{
+   AsyncLogWriter* writer = mAsyncWriter.load();
+   return writer ? writer->blockedCount() : 0;
+}
+
+Log::AsyncOverflow
+Log::toAsyncOverflow(const Data& o)
+{
+   if (isEqualNoCase(o, "block"))
+   {
+      return Log::AsyncBlock;
+   }
+   return Log::AsyncDrop;
+}
+
+bool
+Log::isAsyncType(const Data& t)
+{
+   return t.size() > 6 && isEqualNoCase(t.substr(0, 6), "async-");
+}
+
 const static Data log_("LOG_");
 
 Data
@@ -596,8 +712,9 @@ Log::toLevel(const Data& l)
 }
 
 Log::Type
-Log::toType(const Data& arg)
+Log::toType(const Data& t)
 {
+   const Data arg = isAsyncType(t) ? t.substr(6) : t;
    if (arg == "cout" || arg == "COUT")
    {
       return Log::Cout;
@@ -1179,6 +1296,18 @@ Log::Guard::~Guard()
       return;
    }
 
+   // the default logger's records can be handed to the async writer; local
+   // loggers may be removed at any time, so they are written here
+   if (logType != resip::Log::VSDebugWindow &&
+       &resip::Log::getLoggerData() == &resip::Log::mDefaultLoggerData)
+   {
+      AsyncLogWriter* writer = resip::Log::mAsyncWriter.load(std::memory_order_acquire);
+      if (writer && writer->write(mLevel, mData))
+      {
+         return;
+      }
+   }
+
    resip::Lock lock(resip::Log::_mutex);
    // !dlb! implement VSDebugWindow as an external logger
    if (logType == resip::Log::VSDebugWindow)
@@ -39,6 +39,7 @@ extern "C"
 namespace resip
 {
 
+class AsyncLogWriter;
 class ExternalLogger;
 class Subsystem;
 
@@ -94,6 +95,14 @@ class Log
          JSON_CEE
       };
 
+      /// What to do with a log record when the calling thread's async
+      /// buffer is full (see setAsync)
+      enum AsyncOverflow
+      {
+         AsyncDrop = 0,   ///< drop the record and count it
+         AsyncBlock       ///< wait for the writer thread to make room
+      };
+
       /// Thread Local logger ID type.
       typedef int LocalLoggerId;
 
@@ -228,6 +237,24 @@ class Log
       static void setMaxByteCount(unsigned int maxByteCount, LocalLoggerId loggerId);
       static void setKeepAllLogFiles(bool keepAllLogFiles);
       static void setKeepAllLogFiles(bool keepAllLogFiles, LocalLoggerId loggerId);
+
+      /** @brief Hand log records to a dedicated writer thread instead of
+      * writing them from the logging thread (see AsyncLogWriter).
+      * Disabling writes out everything still queued first.  The string
+      * forms of initialize() turn this on for a type with an "async-"
+      * prefix (e.g. "async-file") and off for any other type.
+      */
+      static void setAsync(bool enable);
+      static bool isAsync();
+      /// Size in bytes of the per-thread buffer used in async mode.
+      static void setAsyncBufferSize(unsigned int bufferSize);
+      static void setAsyncOverflow(AsyncOverflow overflow);
+      /// Wait until all records queued so far in async mode have been written.
+      static void flushAsync();
+      /// Records dropped, or calls that had to wait, because a buffer was full.
+      static uint64_t getAsyncDroppedCount();
+      static uint64_t getAsyncBlockedCount();
+      static AsyncOverflow toAsyncOverflow(const Data& o);
       static Level toLevel(const Data& l);
       static Type toType(const Data& t);
       static Data toString(Level l);
@@ -293,6 +320,10 @@ class Log
       static unsigned int MaxLineCount;
       static unsigned int MaxByteCount;
       static bool KeepAllLogFiles;
+      static unsigned int AsyncBufferSize;
+      static AsyncOverflow AsyncOverflowAction;
+      static std::atomic<AsyncLogWriter*> mAsyncWriter;
+      static bool isAsyncType(const Data& t);
 
       class ThreadData
       {
@@ -429,6 +460,7 @@ class Log
 
       friend void ::freeLocalLogger(void* pThreadData);
       friend class LogStaticInitializer;
+      friend class AsyncLogWriter;
       static LocalLoggerMap mLocalLoggerMap;
       static ThreadIf::TlsKey* mLocalLoggerKey;
 
@@ -0,0 +1,161 @@
+#if !defined(RESIP_MPSCQUEUE_HXX)
+#define RESIP_MPSCQUEUE_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @brief Bounded lock-free multi-producer/single-consumer queue.
+
+   A ring of cells, each carrying a sequence number that tells producers
+   and the consumer whose turn it is to use the cell (after D. Vyukov's
+   bounded MPMC queue, with the consumer side simplified for a single
+   thread).  Producers claim a cell with one compare-and-swap on the tail;
+   the consumer never writes shared state other than the cell it has just
+   emptied.
+
+   push() may be called from any thread and fails when the ring is full.
+   pop(), front() and idle() must only be called from the one consumer
+   thread.  Nothing here blocks; see AbstractFifo for the waiting logic.
+
+   @ingroup message_passing
+*/
+template <class T>
+class MpscQueue
+{
+   public:
+      /// capacity is rounded up to a power of two (minimum 2)
+      explicit MpscQueue(unsigned int capacity) :
+         mMask(roundUp(capacity) - 1),
+         mCells(new Cell[mMask + 1]),
+         mTail(0),
+         mHead(0)
+      {
+         for (size_t i = 0; i <= mMask; ++i)
+         {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+         }
+      }
+
+      ~MpscQueue()
+      {
+         T item;
+         while (pop(item))
+         {
+         }
+      }
+
+      /// returns false if the queue is full
+      bool push(const T& item)
+      {
+         Cell* cell;
+         size_t pos = mTail.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = ptrdiff_t(seq) - ptrdiff_t(pos);
+            if (dif == 0)
+            {
+               if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               {
+                  break;
+               }
+            }
+            else if (dif < 0)
+            {
+               return false;
+            }
+            else
+            {
+               pos = mTail.load(std::memory_order_relaxed);
+            }
+         }
+         new (cell->value()) T(item);
+         cell->sequence.store(pos + 1, std::memory_order_release);
+         return true;
+      }
+
+      /// consumer only; returns false if the next item is not (yet) there
+      bool pop(T& item)
+      {
+         Cell& cell = mCells[mHead & mMask];
+         if (cell.sequence.load(std::memory_order_acquire) != mHead + 1)
+         {
+            return false;
+         }
+         item = *cell.value();
+         cell.value()->~T();
+         cell.sequence.store(mHead + mMask + 1, std::memory_order_release);
+         ++mHead;
+         return true;
+      }
+
+      /// consumer only; the next item, or 0 if it is not (yet) there
+      const T* front()
+      {
+         Cell& cell = mCells[mHead & mMask];
+         if (cell.sequence.load(std::memory_order_acquire) != mHead + 1)
+         {
+            return 0;
+         }
+         return cell.value();
+      }
+
+      /**
+         consumer only; true if no producer has claimed a cell that the
+         consumer has not emptied yet. Unlike a failed pop(), this rules out
+         a producer that is still in the middle of a push().
+      */
+      bool idle() const
+      {
+         return mTail.load(std::memory_order_acquire) == mHead;
+      }
+
+      size_t capacity() const
+      {
+         return mMask + 1;
+      }
+
+   private:
+      struct Cell
+      {
+         std::atomic<size_t> sequence;
+         typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+         T* value() { return reinterpret_cast<T*>(&storage); }
+      };
+
+      static size_t roundUp(unsigned int capacity)
+      {
+         size_t n = 2;
+         while (n < capacity)
+         {
+            n <<= 1;
+         }
+         return n;
+      }
+
+      const size_t mMask;
+      std::unique_ptr<Cell[]> mCells;
+      // producers and the consumer work on opposite ends; keep them on
+      // separate cache lines
+      alignas(64) std::atomic<size_t> mTail;
+      alignas(64) size_t mHead;
+
+      // disabled
+      MpscQueue(const MpscQueue&);
+      MpscQueue& operator=(const MpscQueue&);
+};
+
+}
+
+#endif
+
@@ -0,0 +1,226 @@
+#include <cmath>
+#include <stdio.h>
+
+#include "rutil/OpenMetrics.hxx"
+#include "rutil/LatencyHistogram.hxx"
+#include "rutil/ResipAssert.h"
+
+using namespace resip;
+
+const char* const OpenMetricsWriter::ContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+OpenMetricsWriter::OpenMetricsWriter(EncodeStream& strm) :
+   mStrm(strm),
+   mType(Gauge)
+{
+}
+
+void
+OpenMetricsWriter::family(const char* name, MetricType type, const char* help, const char* unit)
+{
+   mFamily = name;
+   mType = type;
+   mStrm << "# TYPE " << name << (type == Counter ? " counter\n" : type == Gauge ? " gauge\n" : " histogram\n");
+   if (unit)
+   {
+      mStrm << "# UNIT " << name << ' ' << unit << '\n';
+   }
+   mStrm << "# HELP " << name << ' ';
+   writeEscaped(mStrm, help);
+   mStrm << '\n';
+}
+
+void
+OpenMetricsWriter::counter(uint64_t value, const Labels& labels, uint64_t created)
+{
+   resip_assert(mType == Counter);
+   writeName("_total", labels);
+   mStrm << value << '\n';
+   if (created)
+   {
+      writeName("_created", labels);
+      mStrm << created << '\n';
+   }
+}
+
+void
+OpenMetricsWriter::gauge(double value, const Labels& labels)
+{
+   resip_assert(mType == Gauge);
+   writeName("", labels);
+   if (std::isnan(value))
+   {
+      mStrm << "NaN";
+   }
+   else if (std::isinf(value))
+   {
+      mStrm << (value > 0 ? "+Inf" : "-Inf");
+   }
+   else if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0)
+   {
+      mStrm << (int64_t)value;
+   }
+   else
+   {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.9g", value);
+      mStrm << buffer;
+   }
+   mStrm << '\n';
+}
+
+void
+OpenMetricsWriter::histogram(const LatencyHistogram& histogram, const Labels& labels, uint64_t created)
+{
+   resip_assert(mType == Histogram);
+   // The _count is the sum of the buckets rather than histogram.count(), so
+   // that it matches the +Inf bucket even if the histogram was merged from
+   // recorders while they were being written.
+   uint64_t cumulative = 0;
+   unsigned int bucket = 0;
+   for (unsigned int exponent = MinBucketExponent; exponent <= MaxBucketExponent; ++exponent)
+   {
+      const uint64_t bound = (uint64_t)1 << exponent;
+      // Durations are truncated to whole micro-seconds when recorded, so a
+      // duration below the bound was recorded as at most bound - 1.  The
+      // last bucket also holds everything beyond it, so only +Inf has it.
+      while (bucket + 1 < LatencyHistogram::NumBuckets && LatencyHistogram::bucketUpperBound(bucket) < bound)
+      {
+         cumulative += histogram.bucketCount(bucket++);
+      }
+      writeName("_bucket", labels, "le", microSecToSeconds(bound));
+      mStrm << cumulative << '\n';
+   }
+   while (bucket < LatencyHistogram::NumBuckets)
+   {
+      cumulative += histogram.bucketCount(bucket++);
+   }
+   writeName("_bucket", labels, "le", "+Inf");
+   mStrm << cumulative << '\n';
+   writeName("_count", labels);
+   mStrm << cumulative << '\n';
+   writeName("_sum", labels);
+   mStrm << microSecToSeconds(histogram.sumMicroSec()) << '\n';
+   if (created)
+   {
+      writeName("_created", labels);
+      mStrm << created << '\n';
+   }
+}
+
+void
+OpenMetricsWriter::finish()
+{
+   mStrm << "# EOF\n";
+   mStrm.flush();
+}
+
+Data
+OpenMetricsWriter::microSecToSeconds(uint64_t microSec)
+{
+   char buffer[32];
+   int length = snprintf(buffer, sizeof(buffer), "%llu.%06llu",
+                         (unsigned long long)(microSec / 1000000),
+                         (unsigned long long)(microSec % 1000000));
+   // trailing zeros, and the point if nothing is left after it
+   while (buffer[length - 1] == '0')
+   {
+      --length;
+   }
+   if (buffer[length - 1] == '.')
+   {
+      --length;
+   }
+   return Data(buffer, length);
+}
+
+void
+OpenMetricsWriter::writeName(const char* suffix, const Labels& labels, const char* extraName, const Data& extraValue)
+{
+   mStrm << mFamily << suffix;
+   if (labels.mLabels.empty() && !extraName)
+   {
+      mStrm << ' ';
+      return;
+   }
+   char separator = '{';
+   for (std::vector<std::pair<const char*, Data> >::const_iterator i = labels.mLabels.begin(); i != labels.mLabels.end(); ++i)
+   {
+      mStrm << separator << i->first << "=\"";
+      writeEscaped(mStrm, i->second);
+      mStrm << '"';
+      separator = ',';
+   }
+   if (extraName)
+   {
+      mStrm << separator << extraName << "=\"" << extraValue << '"';
+   }
+   mStrm << "} ";
+}
+
+void
+OpenMetricsWriter::writeEscaped(EncodeStream& strm, const Data& value)
+{
+   const char* start = value.data();
+   const char* end = start + value.size();
+   for (const char* c = start; c != end; ++c)
+   {
+      if (*c == '\\' || *c == '"' || *c == '\n')
+      {
+         strm.write(start, c - start);
+         strm << '\\' << (*c == '\n' ? 'n' : *c);
+         start = c + 1;
+      }
+   }
+   strm.write(start, end - start);
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
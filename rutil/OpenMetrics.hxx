@@ -0,0 +1,150 @@
+#if !defined(RESIP_OPENMETRICS_HXX)
+#define RESIP_OPENMETRICS_HXX
+
+#include <utility>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/resipfaststreams.hxx"
+
+namespace resip
+{
+
+class LatencyHistogram;
+
+/**
+   @brief Writes metrics in the OpenMetrics text format (the format
+   Prometheus scrapes, served as ContentType).
+
+   Each metric family is started with family() and followed by its
+   samples; the exposition is ended with finish().  Names are not checked,
+   so callers must use valid metric and label names and keep the samples of
+   a family together.  Label values are escaped.
+
+   Counters should count up from the time passed as "created"; Prometheus
+   treats a counter that goes down, or whose created time changes, as
+   having been reset.
+*/
+class OpenMetricsWriter
+{
+   public:
+      enum MetricType
+      {
+         Counter,
+         Gauge,
+         Histogram
+      };
+
+      /// Latencies are exposed in buckets whose upper bounds are the powers
+      /// of two from 2^MinBucketExponent to 2^MaxBucketExponent
+      /// micro-seconds (64us to about 134s), plus +Inf.
+      enum
+      {
+         MinBucketExponent = 6,
+         MaxBucketExponent = 27
+      };
+
+      static const char* const ContentType;
+
+      class Labels
+      {
+         public:
+            Labels() {}
+            Labels(const char* name, const Data& value) { add(name, value); }
+            Labels& add(const char* name, const Data& value)
+            {
+               mLabels.push_back(std::make_pair(name, value));
+               return *this;
+            }
+
+         private:
+            friend class OpenMetricsWriter;
+            std::vector<std::pair<const char*, Data> > mLabels;
+      };
+
+      explicit OpenMetricsWriter(EncodeStream& strm);
+
+      /// Starts the family "name" (without any _total suffix).  If "unit" is
+      /// given, name must end with it, eg "_seconds".
+      void family(const char* name, MetricType type, const char* help, const char* unit = 0);
+
+      /// Adds a sample to the current Counter family.  "created" is the time,
+      /// in seconds since the epoch, the counter counts from; 0 omits it.
+      void counter(uint64_t value, const Labels& labels = Labels(), uint64_t created = 0);
+      void gauge(double value, const Labels& labels = Labels());
+      /// Adds a histogram to the current Histogram family, converted from
+      /// micro-seconds to seconds.
+      void histogram(const LatencyHistogram& histogram, const Labels& labels = Labels(), uint64_t created = 0);
+
+      /// Writes the end of the exposition; nothing may follow.
+      void finish();
+
+      /// Formats micro-seconds as decimal seconds, without rounding.
+      static Data microSecToSeconds(uint64_t microSec);
+
+   private:
+      void writeName(const char* suffix, const Labels& labels, const char* extraName = 0, const Data& extraValue = Data::Empty);
+      static void writeEscaped(EncodeStream& strm, const Data& value);
+
+      EncodeStream& mStrm;
+      Data mFamily;
+      MetricType mType;
+
+      // not copyable
+      OpenMetricsWriter(const OpenMetricsWriter&);
+      OpenMetricsWriter& operator=(const OpenMetricsWriter&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
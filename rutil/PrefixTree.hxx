@@ -0,0 +1,252 @@
+#if !defined(RESIP_PREFIXTREE_HXX)
+#define RESIP_PREFIXTREE_HXX
+
+#include <string.h>
+#include <vector>
+
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @brief Compressed binary (Patricia) trie of bit string prefixes, such as
+   IPv4 and IPv6 CIDR blocks.
+
+   Keys are byte arrays read most significant bit first, so addresses in
+   network byte order can be used as they are; one tree should hold keys of
+   one length (eg one tree per address family).  Each prefix carries any
+   number of values.  Nodes exist only where a prefix ends or two prefixes
+   diverge, so a lookup never visits more nodes than the key has bits,
+   however many prefixes are stored.
+
+   Prefixes can only be added; to remove one, build a new tree.  Lookups do
+   not modify the tree, so any number of threads may look up concurrently
+   once it is built.
+*/
+template <class T>
+class PrefixTree
+{
+   public:
+      enum { MaxKeyBytes = 16, MaxKeyBits = MaxKeyBytes * 8 };
+
+      PrefixTree() : mRoot(0), mSize(0) {}
+      ~PrefixTree() { destroy(mRoot); }
+
+      /// Adds "value" under the first "prefixLength" bits of "key".  The
+      /// prefix may already carry other values.
+      void insert(const unsigned char* key, unsigned int prefixLength, const T& value)
+      {
+         resip_assert(prefixLength <= MaxKeyBits);
+         Node** link = &mRoot;
+         for (;;)
+         {
+            Node* node = *link;
+            if (!node)
+            {
+               *link = new Node(key, prefixLength, &value);
+               break;
+            }
+            unsigned int common = commonPrefixLength(node->mKey, node->mLength, key, prefixLength);
+            if (common == node->mLength)
+            {
+               if (common == prefixLength)
+               {
+                  node->mValues.push_back(value);
+                  break;
+               }
+               link = &node->mChildren[bit(key, common)];
+               continue;
+            }
+            // The new prefix ends or diverges within this node's prefix.
+            Node* parent;
+            if (common == prefixLength)
+            {
+               parent = new Node(key, prefixLength, &value);
+            }
+            else
+            {
+               parent = new Node(key, common, 0);
+               parent->mChildren[bit(key, common)] = new Node(key, prefixLength, &value);
+            }
+            parent->mChildren[bit(node->mKey, common)] = node;
+            *link = parent;
+            break;
+         }
+         ++mSize;
+      }
+
+      /// Calls visitor(value) for each value whose prefix matches the first
+      /// "keyLength" bits of "key", longest prefix first, until the visitor
+      /// returns true.  Returns whether it did.
+      template <class Visitor>
+      bool find(const unsigned char* key, unsigned int keyLength, Visitor& visitor) const
+      {
+         resip_assert(keyLength <= MaxKeyBits);
+         const Node* path[MaxKeyBits + 1];
+         unsigned int depth = 0;
+         const Node* node = mRoot;
+         while (node && node->mLength <= keyLength && matches(node->mKey, node->mLength, key))
+         {
+            path[depth++] = node;
+            if (node->mLength == keyLength)
+            {
+               break;
+            }
+            node = node->mChildren[bit(key, node->mLength)];
+         }
+         while (depth > 0)
+         {
+            const std::vector<T>& values = path[--depth]->mValues;
+            for (typename std::vector<T>::const_iterator i = values.begin(); i != values.end(); ++i)
+            {
+               if (visitor(*i))
+               {
+                  return true;
+               }
+            }
+         }
+         return false;
+      }
+
+      /// Number of values inserted.
+      size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+   private:
+      struct Node
+      {
+            Node(const unsigned char* key, unsigned int length, const T* value) :
+               mLength(length)
+            {
+               // Bits beyond the prefix are kept zero so prefixes compare bytewise.
+               memset(mKey, 0, sizeof(mKey));
+               memcpy(mKey, key, (length + 7) / 8);
+               if (length % 8)
+               {
+                  mKey[length / 8] &= (unsigned char)(0xff << (8 - length % 8));
+               }
+               mChildren[0] = 0;
+               mChildren[1] = 0;
+               if (value)
+               {
+                  mValues.push_back(*value);
+               }
+            }
+
+            unsigned char mKey[MaxKeyBytes];
+            unsigned int mLength;
+            Node* mChildren[2];
+            std::vector<T> mValues;
+      };
+
+      static unsigned int bit(const unsigned char* key, unsigned int index)
+      {
+         return (key[index / 8] >> (7 - index % 8)) & 1;
+      }
+
+      static bool matches(const unsigned char* prefix, unsigned int length, const unsigned char* key)
+      {
+         unsigned int bytes = length / 8;
+         if (memcmp(prefix, key, bytes) != 0)
+         {
+            return false;
+         }
+         unsigned int bits = length % 8;
+         return bits == 0 ||
+            ((prefix[bytes] ^ key[bytes]) & (unsigned char)(0xff << (8 - bits))) == 0;
+      }
+
+      static unsigned int commonPrefixLength(const unsigned char* a, unsigned int aLength,
+                                             const unsigned char* b, unsigned int bLength)
+      {
+         unsigned int length = aLength < bLength ? aLength : bLength;
+         unsigned int common = 0;
+         while (common < length)
+         {
+            unsigned char diff = a[common / 8] ^ b[common / 8];
+            if (common % 8 == 0 && diff == 0)
+            {
+               common += 8;
+               continue;
+            }
+            if (diff & (0x80 >> (common % 8)))
+            {
+               break;
+            }
+            ++common;
+         }
+         return common < length ? common : length;
+      }
+
+      static void destroy(Node* node)
+      {
+         if (node)
+         {
+            destroy(node->mChildren[0]);
+            destroy(node->mChildren[1]);
+            delete node;
+         }
+      }
+
+      // not copyable
+      PrefixTree(const PrefixTree&);
+      PrefixTree& operator=(const PrefixTree&);
+
+      Node* mRoot;
+      size_t mSize;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
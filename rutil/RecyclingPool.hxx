@@ -0,0 +1,282 @@
+#if !defined(RESIP_RECYCLINGPOOL_HXX)
+#define RESIP_RECYCLINGPOOL_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Recycles fixed-size memory blocks, for objects that are allocated
+   and freed at a high rate (SipMessage, receive buffers).
+
+   Each thread keeps a small cache of free blocks, so in the common case
+   allocate() and deallocate() are a vector pop or push with no locking.
+   Objects often die on a different thread from the one that made them (a
+   transport thread allocates a message, the transaction or TU thread
+   deletes it), so caches are balanced through a shared depot: a thread
+   whose cache is full moves half of it to the depot, and a thread whose
+   cache is empty takes a batch from it.  Blocks beyond what the depot
+   holds go back to the system.
+
+   Pooling is off until setCacheSize() is given a non zero number of blocks
+   per thread.  Every block comes from, and may be returned to, plain
+   ::operator new/delete, so switching pooling on or off at any time is
+   safe, as is freeing a block on a thread that has already torn down its
+   cache.
+
+   Tag only serves to give each pool its own statics.
+*/
+template <class Tag, size_t BlockSize>
+class RecyclingPool
+{
+   public:
+      struct Stats
+      {
+            uint64_t allocated; // blocks obtained from the system
+            uint64_t recycled;  // allocations served from a cache
+            uint64_t released;  // blocks given back to the system
+      };
+
+      /// blocks each thread may keep; the depot holds up to 16 times that
+      static void setCacheSize(unsigned int blocksPerThread)
+      {
+         cacheSize().store(blocksPerThread, std::memory_order_relaxed);
+      }
+
+      static unsigned int getCacheSize()
+      {
+         return cacheSize().load(std::memory_order_relaxed);
+      }
+
+      static size_t blockSize()
+      {
+         return BlockSize;
+      }
+
+      static void* allocate()
+      {
+         const unsigned int limit = getCacheSize();
+         Cache* cache = limit ? threadCache() : 0;
+         if (cache)
+         {
+            if (cache->blocks.empty())
+            {
+               refill(*cache, limit);
+            }
+            if (!cache->blocks.empty())
+            {
+               void* block = cache->blocks.back();
+               cache->blocks.pop_back();
+               counters().recycled.fetch_add(1, std::memory_order_relaxed);
+               return block;
+            }
+         }
+         counters().allocated.fetch_add(1, std::memory_order_relaxed);
+         return ::operator new(BlockSize);
+      }
+
+      static void deallocate(void* block)
+      {
+         if (block == 0)
+         {
+            return;
+         }
+         const unsigned int limit = getCacheSize();
+         Cache* cache = limit ? threadCache() : 0;
+         if (cache)
+         {
+            if (cache->blocks.size() >= limit)
+            {
+               spill(*cache, limit);
+            }
+            cache->blocks.push_back(block);
+            return;
+         }
+         counters().released.fetch_add(1, std::memory_order_relaxed);
+         ::operator delete(block);
+      }
+
+      static Stats getStats()
+      {
+         Stats stats;
+         stats.allocated = counters().allocated.load(std::memory_order_relaxed);
+         stats.recycled = counters().recycled.load(std::memory_order_relaxed);
+         stats.released = counters().released.load(std::memory_order_relaxed);
+         return stats;
+      }
+
+   private:
+      struct Cache
+      {
+            std::vector<void*> blocks;
+      };
+
+      struct Depot
+      {
+            Mutex mutex;
+            std::vector<void*> blocks;
+      };
+
+      struct Counters
+      {
+            std::atomic<uint64_t> allocated;
+            std::atomic<uint64_t> recycled;
+            std::atomic<uint64_t> released;
+      };
+
+      // Gives the thread's cache back to the depot when the thread exits
+      struct CacheOwner
+      {
+            ~CacheOwner()
+            {
+               Cache* cache = cachePtr();
+               cachePtr() = 0;
+               exited() = true;
+               if (cache)
+               {
+                  spill(*cache, 0);
+                  delete cache;
+               }
+            }
+      };
+
+      static std::atomic<unsigned int>& cacheSize()
+      {
+         static std::atomic<unsigned int> size(0);
+         return size;
+      }
+
+      static Counters& counters()
+      {
+         static Counters c = { {0}, {0}, {0} };
+         return c;
+      }
+
+      // Never destroyed, so that messages deleted from static destructors
+      // can still be handed back
+      static Depot& depot()
+      {
+         static Depot* d = new Depot;
+         return *d;
+      }
+
+      static Cache*& cachePtr()
+      {
+         static thread_local Cache* cache = 0;
+         return cache;
+      }
+
+      static bool& exited()
+      {
+         static thread_local bool exited = false;
+         return exited;
+      }
+
+      static Cache* threadCache()
+      {
+         Cache*& cache = cachePtr();
+         if (cache == 0 && !exited())
+         {
+            static thread_local CacheOwner owner;
+            (void)owner;
+            cache = new Cache;
+         }
+         return cache;
+      }
+
+      static void refill(Cache& cache, unsigned int limit)
+      {
+         Depot& d = depot();
+         Lock lock(d.mutex); (void)lock;
+         size_t take = limit / 2 + 1;
+         while (take-- > 0 && !d.blocks.empty())
+         {
+            cache.blocks.push_back(d.blocks.back());
+            d.blocks.pop_back();
+         }
+      }
+
+      // moves blocks until the cache is down to limit / 2
+      static void spill(Cache& cache, unsigned int limit)
+      {
+         const size_t keep = limit / 2;
+         const size_t depotLimit = size_t(getCacheSize()) * 16;
+         {
+            Depot& d = depot();
+            Lock lock(d.mutex); (void)lock;
+            while (cache.blocks.size() > keep && d.blocks.size() < depotLimit)
+            {
+               d.blocks.push_back(cache.blocks.back());
+               cache.blocks.pop_back();
+            }
+         }
+         while (cache.blocks.size() > keep)
+         {
+            counters().released.fetch_add(1, std::memory_order_relaxed);
+            ::operator delete(cache.blocks.back());
+            cache.blocks.pop_back();
+         }
+      }
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
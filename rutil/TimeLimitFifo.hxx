@@ -29,6 +29,11 @@ class Timestamped
            mTime(n)
       {}
 
+      Timestamped()
+         : mMsg(),
+           mTime(0)
+      {}
+
       inline const Payload& getMsg() const { return mMsg;} 
       inline void setMsg(const Payload& pMsg) { mMsg = pMsg;}
       inline const time_t& getTime() const { return mTime;} 
@@ -105,6 +110,7 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       using AbstractFifo< Timestamped<Msg*> >::empty;
       using AbstractFifo< Timestamped<Msg*> >::size;
       using AbstractFifo< Timestamped<Msg*> >::onMessagePushed;
+      using AbstractFifo< Timestamped<Msg*> >::mSize;
 
       /// @brief Add a message to the fifo.
       /// return true iff succeeds
@@ -206,6 +212,10 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       */
       virtual void setTimeDepthTolerance(unsigned int maxSecs);
 
+   protected:
+      /// keeps mOldestTime current for a lock-free fifo
+      virtual void onFrontChanged(const Timestamped<Msg*>* front);
+
    private:
       time_t timeDepthInternal() const;
       inline bool wouldAcceptInteral(DepthUsage usage) const;
@@ -215,6 +225,10 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       time_t mMaxDurationSecs;
       unsigned int mMaxSize;
       unsigned int mUnreservedMaxSize;
+      // Lock-free mode only: timestamp of the element at the front, as last
+      // seen by the consumer (or set by the producer that made the fifo
+      // non-empty); 0 if unknown. Makes time depth approximate.
+      std::atomic<time_t> mOldestTime;
 };
 
 template <class Msg>
@@ -223,7 +237,8 @@ TimeLimitFifo<Msg>::TimeLimitFifo(unsigned int maxDurationSecs,
    : AbstractFifo< Timestamped<Msg*> >(),
      mMaxDurationSecs(maxDurationSecs),
      mMaxSize(maxSize),
-     mUnreservedMaxSize((int)((maxSize*8)/10)) // !dlb! random guess
+     mUnreservedMaxSize((int)((maxSize*8)/10)), // !dlb! random guess
+     mOldestTime(0)
 {}
 
 template <class Msg>
@@ -238,11 +253,28 @@ bool
 TimeLimitFifo<Msg>::add(Msg* msg,
                         DepthUsage usage)
 {
+   if (this->isLockFree())
+   {
+      // Admission is checked against a snapshot; concurrent producers may
+      // overshoot the limits slightly.
+      if (!wouldAcceptInteral(usage))
+      {
+         return false;
+      }
+      time_t n = time(0);
+      if (AbstractFifo< Timestamped<Msg*> >::add(Timestamped<Msg*>(msg, n)) == 1)
+      {
+         mOldestTime = n;
+      }
+      return true;
+   }
+
    Lock lock(mMutex); (void)lock;
 
    if (wouldAcceptInteral(usage))
    {
       time_t n = time(0);
+      this->sampleWaitTimeAdding(1);
       mFifo.push_back(Timestamped<Msg*>(msg, n));
       onMessagePushed(1);
       mCondition.notify_one();
@@ -258,6 +290,11 @@ template <class Msg>
 bool
 TimeLimitFifo<Msg>::wouldAccept(DepthUsage usage) const
 {
+   if (this->isLockFree())
+   {
+      return wouldAcceptInteral(usage);
+   }
+
    Lock lock(mMutex); (void)lock;
 
    return wouldAcceptInteral(usage);
@@ -287,6 +324,16 @@ template <class Msg>
 time_t
 TimeLimitFifo<Msg>::timeDepthInternal() const
 {
+   if (this->isLockFree())
+   {
+      time_t oldest = mOldestTime;
+      if (mSize == 0 || oldest == 0)
+      {
+         return 0;
+      }
+      return time(0) - oldest;
+   }
+
    if(mFifo.empty())
    {
       return 0;
@@ -300,7 +347,7 @@ bool
 TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 {
    if ((mMaxSize != 0 &&
-        mFifo.size() >= mMaxSize))
+        mSize >= mMaxSize))
    {
       return false;
    }
@@ -311,7 +358,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
    }
 
    if (mUnreservedMaxSize != 0 &&
-       mFifo.size() >= mUnreservedMaxSize)
+       mSize >= mUnreservedMaxSize)
    {
       return false;
    }
@@ -323,7 +370,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 
    resip_assert(usage == EnforceTimeDepth);
 
-   if (mFifo.size() == 0 ||
+   if (mSize == 0 ||
        mMaxDurationSecs == 0 ||
        timeDepthInternal() < mMaxDurationSecs)
    {
@@ -337,6 +384,11 @@ template <class Msg>
 time_t
 TimeLimitFifo<Msg>::timeDepth() const
 {
+   if (this->isLockFree())
+   {
+      return timeDepthInternal();
+   }
+
    Lock lock(mMutex); (void)lock;
    return timeDepthInternal();
 }
@@ -345,6 +397,17 @@ template <class Msg>
 void
 TimeLimitFifo<Msg>::clear()
 {
+   if (this->isLockFree())
+   {
+      // consumer side only, like getNext()
+      Timestamped<Msg*> tm;
+      while (this->popLockFree(tm, false))
+      {
+         delete tm.getMsg();
+      }
+      return;
+   }
+
    Lock lock(mMutex); (void)lock;
 
    while (!mFifo.empty())
@@ -354,6 +417,13 @@ TimeLimitFifo<Msg>::clear()
    }
 }
 
+template <class Msg>
+void
+TimeLimitFifo<Msg>::onFrontChanged(const Timestamped<Msg*>* front)
+{
+   mOldestTime = front ? front->getTime() : 0;
+}
+
 template <class Msg>
 size_t
 TimeLimitFifo<Msg>::getCountDepth() const
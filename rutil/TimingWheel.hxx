@@ -0,0 +1,548 @@
+#if !defined(RESIP_TIMINGWHEEL_HXX)
+#define RESIP_TIMINGWHEEL_HXX
+
+#include <deque>
+#include <new>
+#include <type_traits>
+
+#include "rutil/compat.hxx"
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @brief Hierarchical timing wheel with millisecond resolution.
+
+   Timers are kept in four levels of 256 slots each; level 0 has one slot per
+   millisecond, each level above it covers 256 times the span of the level
+   below.  Inserting and cancelling a timer are O(1); expiring walks the
+   level 0 slots between the last call and now (skipping empty runs with a
+   per-level occupancy bitmap) and, every 256ms, redistributes ("cascades")
+   one slot of the level above.  Timers further out than the top level can
+   represent (about 49 days) are parked in the top level and re-filed each
+   time they cascade.
+
+   Timer payloads live in a node slab that is recycled through a free list,
+   so steady-state operation does not allocate.  Every add() returns a
+   Handle that stays unique for the lifetime of the wheel; cancel() and
+   isPending() on a handle whose timer has already fired or been cancelled
+   are harmless no-ops.
+
+   Timers with the same expiry fire in insertion order.  Timers added with an
+   expiry in the past are kept on a separate due list and fire first on the
+   next call to expire().
+
+   This class is not threadsafe.
+*/
+template <class T>
+class TimingWheel
+{
+   public:
+      typedef uint64_t Handle;
+      static const Handle NoHandle = 0;
+
+      explicit TimingWheel(uint64_t now) :
+         mCurrent(now),
+         mSize(0),
+         mFreeList(Nil)
+      {
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            for (unsigned int w = 0; w < BitmapWords; ++w)
+            {
+               mOccupied[l][w] = 0;
+            }
+            for (unsigned int s = 0; s < Slots; ++s)
+            {
+               mSlots[l][s].head = Nil;
+               mSlots[l][s].tail = Nil;
+               mSlots[l][s].minWhen = 0;
+            }
+         }
+         mDue.head = Nil;
+         mDue.tail = Nil;
+         mDue.minWhen = 0;
+         mFiring = mDue;
+         advanceTo(now);
+      }
+
+      ~TimingWheel()
+      {
+         // Node destructors take care of any payloads still pending.
+      }
+
+      Handle add(const T& timer, uint64_t when)
+      {
+         uint32_t index = allocate();
+         Node& node = mNodes[index];
+         new (node.value()) T(timer);
+         node.when = when;
+         node.live = true;
+         file(index);
+         ++mSize;
+         return (Handle(node.generation) << 32) | (Handle(index) + 1);
+      }
+
+      /// returns true if the timer was pending and has been removed
+      bool cancel(Handle handle)
+      {
+         Node* node = find(handle);
+         if (node == 0 || node->level == Unfiled)
+         {
+            return false;
+         }
+         uint32_t index = uint32_t(handle & 0xFFFFFFFF) - 1;
+         unlink(index);
+         release(index);
+         --mSize;
+         return true;
+      }
+
+      bool isPending(Handle handle) const
+      {
+         const Node* node = const_cast<TimingWheel*>(this)->find(handle);
+         return node != 0 && node->level != Unfiled;
+      }
+
+      /**
+         Fires every timer due at or before now, in order of expiry, by
+         calling fn(const T&).  fn may add or cancel timers.
+      */
+      template <class Fn>
+      void expire(uint64_t now, Fn& fn)
+      {
+         fireAll(mDue, fn);
+
+         while (mCurrent <= now && mSize > 0)
+         {
+            int next = findNext(0, unsigned(mCurrent & SlotMask));
+            if (next < 0)
+            {
+               // nothing more in level 0 before the next cascade
+               uint64_t boundary = (mCurrent | SlotMask) + 1;
+               if (boundary > now)
+               {
+                  break;
+               }
+               advanceTo(boundary);
+               continue;
+            }
+
+            uint64_t tick = (mCurrent & ~SlotMask) + unsigned(next);
+            if (tick > now)
+            {
+               break;
+            }
+
+            // Take the slot's timers out before advancing, so that neither
+            // the cascade nor anything fn adds can land among them.
+            takeForFiring(mSlots[0][next], unsigned(next));
+            advanceTo(tick + 1);
+            fireAll(mFiring, fn);
+            fireAll(mDue, fn);
+         }
+
+         if (now >= mCurrent)
+         {
+            advanceTo(now + 1);
+         }
+      }
+
+      /**
+         Returns a lower bound on the expiry of the earliest pending timer
+         (or 0 if there is none).  The bound is exact unless the earliest
+         timer in its slot has been cancelled, in which case a caller using
+         it to schedule a wakeup will simply find nothing to do.
+      */
+      uint64_t nextExpiry() const
+      {
+         if (mDue.head != Nil)
+         {
+            return mDue.minWhen;
+         }
+         uint64_t best = 0;
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            unsigned int shift = l * SlotBits;
+            unsigned int cur = unsigned((mCurrent >> shift) & SlotMask);
+            // level 0 is still due from the current slot onwards; a higher
+            // level's current slot has already cascaded.  Slots before that
+            // belong to the next revolution, so they are searched last.
+            int s = findNext(l, l == 0 ? cur : (cur + 1) & SlotMask);
+            if (s < 0)
+            {
+               s = findNext(l, 0);
+            }
+            if (s >= 0)
+            {
+               uint64_t when = mSlots[l][s].minWhen;
+               if (best == 0 || when < best)
+               {
+                  best = when;
+               }
+            }
+         }
+         return best;
+      }
+
+      /// calls fn(const T&) for every pending timer and then removes them all
+      template <class Fn>
+      void clear(Fn& fn)
+      {
+         fireAll(mDue, fn);
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            for (unsigned int s = 0; s < Slots; ++s)
+            {
+               fireAll(mSlots[l][s], fn);
+            }
+         }
+      }
+
+      size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+   private:
+      static const unsigned int Levels = 4;
+      static const unsigned int SlotBits = 8;
+      static const unsigned int Slots = 1 << SlotBits;
+      static const uint64_t SlotMask = Slots - 1;
+      static const unsigned int BitmapWords = Slots / 64;
+      static const uint32_t Nil = 0xFFFFFFFF;
+      static const uint8_t Unfiled = 0xFF;
+      // level markers for nodes on the due list and on the list being fired
+      static const uint8_t Due = Levels;
+      static const uint8_t Firing = Levels + 1;
+
+      struct Node
+      {
+         Node() : when(0), next(Nil), prev(Nil), generation(0),
+                  level(Unfiled), slot(0), live(false)
+         {}
+         ~Node()
+         {
+            if (live)
+            {
+               value()->~T();
+            }
+         }
+         T* value() { return reinterpret_cast<T*>(&storage); }
+
+         typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+         uint64_t when;
+         uint32_t next;
+         uint32_t prev;
+         uint32_t generation;
+         uint8_t level;
+         uint8_t slot;
+         bool live;
+      };
+
+      struct Slot
+      {
+         uint32_t head;
+         uint32_t tail;
+         // lower bound on the expiry of everything in this slot
+         uint64_t minWhen;
+      };
+
+      Slot& slotOf(const Node& node)
+      {
+         if (node.level == Due)
+         {
+            return mDue;
+         }
+         if (node.level == Firing)
+         {
+            return mFiring;
+         }
+         return mSlots[node.level][node.slot];
+      }
+
+      template <class Fn>
+      void fireAll(Slot& slot, Fn& fn)
+      {
+         while (slot.head != Nil)
+         {
+            uint32_t index = slot.head;
+            unlink(index);
+            --mSize;
+            fn(*mNodes[index].value());
+            release(index);
+         }
+      }
+
+      Node* find(Handle handle)
+      {
+         uint32_t index = uint32_t(handle & 0xFFFFFFFF);
+         if (index == 0 || index > mNodes.size())
+         {
+            return 0;
+         }
+         Node& node = mNodes[index - 1];
+         if (!node.live || node.generation != uint32_t(handle >> 32))
+         {
+            return 0;
+         }
+         return &node;
+      }
+
+      uint32_t allocate()
+      {
+         if (mFreeList != Nil)
+         {
+            uint32_t index = mFreeList;
+            mFreeList = mNodes[index].next;
+            return index;
+         }
+         resip_assert(mNodes.size() < Nil - 1);
+         mNodes.emplace_back();
+         return uint32_t(mNodes.size() - 1);
+      }
+
+      void release(uint32_t index)
+      {
+         Node& node = mNodes[index];
+         node.value()->~T();
+         node.live = false;
+         ++node.generation;
+         node.next = mFreeList;
+         mFreeList = index;
+      }
+
+      // Places a node in the slot its expiry maps to relative to mCurrent.
+      void file(uint32_t index)
+      {
+         Node& node = mNodes[index];
+         uint64_t when = node.when;
+         unsigned int level = 0;
+         unsigned int slot = 0;
+         if (when < mCurrent)
+         {
+            // already due; expire() fires these before anything else
+            level = Due;
+         }
+         else
+         {
+            uint64_t delta = when - mCurrent;
+            uint64_t filedWhen = when;
+            while (level < Levels - 1 && delta >= (uint64_t(1) << ((level + 1) * SlotBits)))
+            {
+               ++level;
+            }
+            if (level == Levels - 1 && delta >= (uint64_t(1) << (Levels * SlotBits)))
+            {
+               // beyond the wheel; park it as far out as we can reach and
+               // re-file when that slot cascades
+               filedWhen = mCurrent + (uint64_t(1) << (Levels * SlotBits)) - 1;
+            }
+            slot = unsigned((filedWhen >> (level * SlotBits)) & SlotMask);
+         }
+
+         node.level = uint8_t(level);
+         node.slot = uint8_t(slot);
+         Slot& s = slotOf(node);
+         node.next = Nil;
+         node.prev = s.tail;
+         if (s.tail == Nil)
+         {
+            s.head = index;
+            s.minWhen = when;
+            if (level != Due)
+            {
+               mOccupied[level][slot / 64] |= (uint64_t(1) << (slot % 64));
+            }
+         }
+         else
+         {
+            mNodes[s.tail].next = index;
+            if (when < s.minWhen)
+            {
+               s.minWhen = when;
+            }
+         }
+         s.tail = index;
+      }
+
+      void unlink(uint32_t index)
+      {
+         Node& node = mNodes[index];
+         Slot& s = slotOf(node);
+         if (node.prev == Nil)
+         {
+            s.head = node.next;
+         }
+         else
+         {
+            mNodes[node.prev].next = node.next;
+         }
+         if (node.next == Nil)
+         {
+            s.tail = node.prev;
+         }
+         else
+         {
+            mNodes[node.next].prev = node.prev;
+         }
+         if (s.head == Nil && node.level < Levels)
+         {
+            mOccupied[node.level][node.slot / 64] &= ~(uint64_t(1) << (node.slot % 64));
+         }
+         node.level = Unfiled;
+      }
+
+      void takeForFiring(Slot& slot, unsigned int idx)
+      {
+         resip_assert(mFiring.head == Nil);
+         for (uint32_t index = slot.head; index != Nil; index = mNodes[index].next)
+         {
+            mNodes[index].level = Firing;
+         }
+         mFiring = slot;
+         slot.head = Nil;
+         slot.tail = Nil;
+         mOccupied[0][idx / 64] &= ~(uint64_t(1) << (idx % 64));
+      }
+
+      // Moves the wheel to tick t; arriving at a multiple of 256 cascades
+      // the level(s) above straight away, so that between calls every slot
+      // above level 0 only holds timers for its next revolution.
+      void advanceTo(uint64_t t)
+      {
+         mCurrent = t;
+         if ((t & SlotMask) == 0)
+         {
+            cascade(1);
+         }
+      }
+
+      // Redistributes the current slot of the given level (and, when that
+      // level has wrapped, the level above it first).
+      void cascade(unsigned int level)
+      {
+         if (level >= Levels)
+         {
+            return;
+         }
+         unsigned int idx = unsigned((mCurrent >> (level * SlotBits)) & SlotMask);
+         if (idx == 0)
+         {
+            cascade(level + 1);
+         }
+         Slot& s = mSlots[level][idx];
+         uint32_t index = s.head;
+         s.head = Nil;
+         s.tail = Nil;
+         mOccupied[level][idx / 64] &= ~(uint64_t(1) << (idx % 64));
+         while (index != Nil)
+         {
+            uint32_t next = mNodes[index].next;
+            file(index);
+            index = next;
+         }
+      }
+
+      // first occupied slot at or after 'from' in the given level, or -1
+      int findNext(unsigned int level, unsigned int from) const
+      {
+         for (unsigned int w = from / 64; w < BitmapWords; ++w)
+         {
+            uint64_t bits = mOccupied[level][w];
+            if (w == from / 64)
+            {
+               bits &= ~uint64_t(0) << (from % 64);
+            }
+            if (bits)
+            {
+               return int(w * 64 + lowestBit(bits));
+            }
+         }
+         return -1;
+      }
+
+      static unsigned int lowestBit(uint64_t bits)
+      {
+#if defined(__GNUC__)
+         return unsigned(__builtin_ctzll(bits));
+#else
+         unsigned int n = 0;
+         while ((bits & 1) == 0)
+         {
+            bits >>= 1;
+            ++n;
+         }
+         return n;
+#endif
+      }
+
+      // next tick to be processed; everything before it has fired
+      uint64_t mCurrent;
+      size_t mSize;
+      uint32_t mFreeList;
+      std::deque<Node> mNodes;
+      Slot mSlots[Levels][Slots];
+      // timers that were already due when they were added
+      Slot mDue;
+      // timers taken from a level 0 slot by expire() and not yet fired
+      Slot mFiring;
+      uint64_t mOccupied[Levels][BitmapWords];
+
+      // disabled
+      TimingWheel(const TimingWheel&);
+      TimingWheel& operator=(const TimingWheel&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -88,7 +88,13 @@ DnsStub::DnsStub(const NameserverList& additional,
    mTransform(0),
    mDnsProvider(ExternalDnsFactory::createExternalDns()),
    mPollGrp(0),
-   mAsyncProcessHandler(asyncProcessHandler)
+   mAsyncProcessHandler(asyncProcessHandler),
+   mCacheHits(0),
+   mCacheMisses(0),
+   mCoalescedQueries(0),
+   mPrefetches(0),
+   mCacheEntries(0),
+   mOutstandingLookups(0)
 {
    setPollGrp(pollGrp);
 
@@ -118,6 +124,12 @@ DnsStub::~DnsStub()
 
    setPollGrp(0);
    delete mDnsProvider;
+
+   // the provider is gone, so none of these will be answered now
+   for (PendingLookupMap::iterator it = mPendingLookups.begin(); it != mPendingLookups.end(); ++it)
+   {
+      delete it->second;
+   }
 }
 
 unsigned int
@@ -143,6 +155,7 @@ DnsStub::processFifo()
       command->execute();
       delete command;
    }
+   startPrefetches();
 }
 
 void
@@ -151,6 +164,7 @@ DnsStub::process(FdSet& fdset)
    mSelectInterruptor.process(fdset);
    processFifo();
    mDnsProvider->process(fdset.read, fdset.write);
+   publishSizes();
 }
 
 void
@@ -159,6 +173,14 @@ DnsStub::processTimers()
    // the fifo is captures as a timer within getTimeTill... above
    processFifo();
    mDnsProvider->processTimers();
+   publishSizes();
+}
+
+void
+DnsStub::publishSizes()
+{
+   mCacheEntries.store(mRRCache.size(), std::memory_order_relaxed);
+   mOutstandingLookups.store(mPendingLookups.size(), std::memory_order_relaxed);
 }
 
 void 
@@ -514,6 +536,15 @@ DnsStub::Query::go()
       cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status);
    }
 
+   if (cached)
+   {
+      ++mStub.mCacheHits;
+   }
+   else
+   {
+      ++mStub.mCacheMisses;
+   }
+
    if (!cached)
    {
       if(mStub.mDnsProvider && mStub.mDnsProvider->hostFileLookupLookupOnlyMode())
@@ -800,13 +831,82 @@ DnsStub::errorMessage(int status)
 void
 DnsStub::lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink)
 {
-   mDnsProvider->lookup(target.c_str(), type, this, sink);
+   PendingLookupMap::iterator it = mPendingLookups.find(RRCache::Key(target, type));
+   if (it != mPendingLookups.end())
+   {
+      StackLog(<< "Joining outstanding lookup for " << target << ", type=" << typeToData(type));
+      it->second->mSinks.push_back(sink);
+      ++mCoalescedQueries;
+      return;
+   }
+
+   PendingLookup* pending = new PendingLookup(target, type);
+   if (sink)
+   {
+      pending->mSinks.push_back(sink);
+   }
+   // registered before asking, since the provider may answer synchronously
+   mPendingLookups[pending->key()] = pending;
+   mDnsProvider->lookup(target.c_str(), type, this, pending);
+}
+
+void
+DnsStub::startPrefetches()
+{
+   RRCache::PrefetchList targets;
+   mRRCache.takePrefetches(targets);
+   if (targets.empty())
+   {
+      return;
+   }
+
+   for (RRCache::PrefetchList::const_iterator it = targets.begin(); it != targets.end(); ++it)
+   {
+      if (mDnsProvider->hostFileLookupLookupOnlyMode())
+      {
+         mRRCache.prefetchDone(it->first, it->second);
+      }
+      else if (mPendingLookups.find(RRCache::Key(it->first, it->second)) == mPendingLookups.end())
+      {
+         StackLog(<< "Prefetching " << it->first << ", type=" << typeToData(it->second));
+         ++mPrefetches;
+         lookupRecords(it->first, (unsigned short)it->second, 0);
+      }
+   }
 }
 
 void
 DnsStub::handleDnsRaw(ExternalDnsRawResult res)
 {
-   reinterpret_cast<DnsRawSink*>(res.userData)->onDnsRaw(res.errorCode(), res.abuf, res.alen);
+   PendingLookup* pending = reinterpret_cast<PendingLookup*>(res.userData);
+   mPendingLookups.erase(pending->key());
+
+   if (pending->mSinks.empty())
+   {
+      // a prefetch that no query joined; queries cache their own answers
+      if (res.errorCode() == 0)
+      {
+         try
+         {
+            cache(pending->mTarget, res.abuf, res.alen);
+         }
+         catch (BaseException& e)
+         {
+            InfoLog(<< "Couldn't cache prefetched answer for " << pending->mTarget << ": " << e.getMessage());
+         }
+      }
+   }
+   else
+   {
+      for (std::vector<DnsRawSink*>::iterator it = pending->mSinks.begin(); it != pending->mSinks.end(); ++it)
+      {
+         (*it)->onDnsRaw(res.errorCode(), res.abuf, res.alen);
+      }
+   }
+   // a timeout, SERVFAIL or uncacheable answer leaves the entry as it was;
+   // let it be prefetched again rather than wait for it to expire
+   mRRCache.prefetchDone(pending->mTarget, pending->mType);
+   delete pending;
    mDnsProvider->freeResult(res);
 }
 
@@ -871,6 +971,10 @@ DnsStub::logDnsCache()
 void
 DnsStub::doLogDnsCache()
 {
+   Statistics stats = getStatistics();
+   WarningLog(<< "DNS statistics: cacheHits=" << stats.cacheHits << ", cacheMisses=" << stats.cacheMisses
+              << ", coalescedQueries=" << stats.coalescedQueries << ", prefetches=" << stats.prefetches
+              << ", outstandingLookups=" << mPendingLookups.size());
    mRRCache.logCache();
 }
 
@@ -921,6 +1025,25 @@ DnsStub::setDnsCacheSize(int size)
    mRRCache.setSize(size);
 }
 
+void
+DnsStub::setDnsCachePrefetch(int secondsBeforeExpiry, unsigned int minHits)
+{
+   mRRCache.setPrefetch(secondsBeforeExpiry, minHits);
+}
+
+DnsStub::Statistics
+DnsStub::getStatistics() const
+{
+   Statistics stats;
+   stats.cacheHits = mCacheHits.load(std::memory_order_relaxed);
+   stats.cacheMisses = mCacheMisses.load(std::memory_order_relaxed);
+   stats.coalescedQueries = mCoalescedQueries.load(std::memory_order_relaxed);
+   stats.prefetches = mPrefetches.load(std::memory_order_relaxed);
+   stats.cacheEntries = mCacheEntries.load(std::memory_order_relaxed);
+   stats.outstandingLookups = mOutstandingLookups.load(std::memory_order_relaxed);
+   return stats;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
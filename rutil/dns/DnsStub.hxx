@@ -6,6 +6,7 @@
 #endif
 
 
+#include <atomic>
 #include <vector>
 #include <list>
 #include <map>
@@ -14,6 +15,7 @@
 #include "rutil/FdPoll.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/HashMap.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/SelectInterruptor.hxx"
 #include "rutil/Socket.hxx"
@@ -181,6 +183,23 @@ class DnsStub : public ExternalDnsHandler
       void getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler);
       void setDnsCacheTTL(int ttl);
       void setDnsCacheSize(int size);
+      // Refresh cached answers that have been used at least minHits times
+      // when they are used again within secondsBeforeExpiry of expiring,
+      // so that busy targets never drop out of the cache.  0 disables.
+      void setDnsCachePrefetch(int secondsBeforeExpiry, unsigned int minHits = 2);
+
+      struct Statistics
+      {
+         uint64_t cacheHits;        // queries answered from the cache
+         uint64_t cacheMisses;      // queries that had to go to the wire
+         uint64_t coalescedQueries; // wire queries avoided by joining one already in flight
+         uint64_t prefetches;       // refreshes started ahead of expiry
+         size_t cacheEntries;       // record sets in the cache
+         size_t outstandingLookups; // wire queries awaiting an answer
+      };
+      // safe to call from any thread; cacheEntries and outstandingLookups
+      // are as of the last time the stub was processed
+      Statistics getStatistics() const;
       void reloadDnsServers();
       bool changeNameServers(const NameserverList& additional);
       bool checkDnsChange();
@@ -471,7 +490,12 @@ class DnsStub : public ExternalDnsHandler
                                          std::vector<RROverlay>&,
                                          bool discard=false);
       void removeQuery(Query*);
+      // Sends the question to the DNS provider, unless the same question is
+      // already outstanding, in which case sink shares that answer.
       void lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink);
+      void startPrefetches();
+      // copies the sizes of the cache and pending lookups for getStatistics()
+      void publishSizes();
       Data errorMessage(int status);
 
       ResultTransform* mTransform;
@@ -479,6 +503,21 @@ class DnsStub : public ExternalDnsHandler
       FdPollGrp* mPollGrp;
       std::set<Query*> mQueries;
 
+      // One question on the wire and everyone waiting for its answer; no
+      // sinks means a prefetch, whose answer only refreshes the cache.
+      class PendingLookup
+      {
+         public:
+            PendingLookup(const Data& target, unsigned short type) : mTarget(target), mType(type) {}
+            RRCache::Key key() const { return RRCache::Key(mTarget, mType); }
+
+            const Data mTarget;
+            const unsigned short mType;
+            std::vector<DnsRawSink*> mSinks;
+      };
+      typedef HashMap<RRCache::Key, PendingLookup*> PendingLookupMap;
+      PendingLookupMap mPendingLookups;
+
       std::vector<Data> mEnumSuffixes; // where to do enum lookups
       std::map<Data,Data> mEnumDomains;
 
@@ -491,6 +530,13 @@ class DnsStub : public ExternalDnsHandler
 
       /// Dns Cache
       RRCache mRRCache;
+
+      std::atomic<uint64_t> mCacheHits;
+      std::atomic<uint64_t> mCacheMisses;
+      std::atomic<uint64_t> mCoalescedQueries;
+      std::atomic<uint64_t> mPrefetches;
+      std::atomic<size_t> mCacheEntries;
+      std::atomic<size_t> mOutstandingLookups;
 };
 
 typedef DnsStub::Protocol Protocol;
@@ -23,7 +23,7 @@
 #endif
 #endif
 
-#include <set>
+#include <algorithm>
 #include <vector>
 #include <list>
 #include <map>
@@ -52,11 +52,29 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
 
+bool
+RRCacheKey::operator==(const RRCacheKey& rhs) const
+{
+   return mRRType == rhs.mRRType &&
+      mSize == rhs.mSize &&
+      isEqualNoCase(Data(Data::Share, mTarget, mSize), Data(Data::Share, rhs.mTarget, rhs.mSize));
+}
+
+size_t
+RRCacheKey::hash() const
+{
+   return Data::rawCaseInsensitiveTokenHash((const unsigned char*)mTarget, mSize) ^ (size_t)mRRType;
+}
+
+HashValueImp(resip::RRCacheKey, data.hash());
+
 RRCache::RRCache() 
    : mHead(),
      mLruHead(LruListType::makeList(&mHead)),
      mUserDefinedTTL(DEFAULT_USER_DEFINED_TTL),
-     mSize(DEFAULT_SIZE)
+     mSize(DEFAULT_SIZE),
+     mPrefetchSecs(0),
+     mPrefetchMinHits(0)
 {
    mFactoryMap[T_CNAME] = &mCnameRecordFactory;
    mFactoryMap[T_NAPTR] = &mNaptrRecordFacotry;
@@ -72,20 +90,42 @@ RRCache::~RRCache()
    cleanup();
 }
 
+void
+RRCache::setPrefetch(int secondsBeforeExpiry, unsigned int minHits)
+{
+   mPrefetchSecs = secondsBeforeExpiry > 0 ? secondsBeforeExpiry : 0;
+   mPrefetchMinHits = minHits;
+}
+
+void
+RRCache::takePrefetches(PrefetchList& targets)
+{
+   targets.clear();
+   targets.swap(mPrefetches);
+}
+
+void
+RRCache::prefetchDone(const Data& target, const int rrType)
+{
+   RRMap::iterator it = mRRMap.find(Key(target, rrType));
+   if (it != mRRMap.end())
+   {
+      it->second->prefetchPending() = false;
+   }
+}
+
 void 
 RRCache::updateCacheFromHostFile(const DnsHostRecord &record)
 {
    //FactoryMap::iterator it = mFactoryMap.find(T_A);
-   RRList* key = new RRList(record, 3600);
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRMap::iterator it = mRRMap.find(Key(record.name(), T_A));
+   if (it != mRRMap.end())
    {
 #ifdef VERBOSE_DNS_STACK_LOGS
       StackLog(<< "Updating cache from hostfile: target=" << record.name() << ", host=" << record.host());
 #endif
-      (*lb)->update(record, 3600);
-      touch(*lb);
+      it->second->update(record, 3600);
+      touch(it->second);
    }
    else
    {
@@ -93,11 +133,10 @@ RRCache::updateCacheFromHostFile(const DnsHostRecord &record)
       StackLog(<< "Adding to cache from hostfile: target=" << record.name() << ", host=" << record.host());
 #endif
       RRList* val = new RRList(record, 3600);
-      mRRSet.insert(val);
+      mRRMap[Key(val->key(), val->rrType())] = val;
       mLruHead->push_back(val);
       purge();
    }
-   delete key;
 }
 
 void 
@@ -110,20 +149,19 @@ RRCache::updateCache(const Data& target,
    FactoryMap::iterator it = mFactoryMap.find(rrType);
    if (it != mFactoryMap.end())  // If we don't understand rrType - ignore it
    {
-      RRList* key = new RRList(domain, rrType);
-      RRSet::iterator lb = mRRSet.lower_bound(key);
-      if (lb != mRRSet.end() &&
-         !(mRRSet.key_comp()(key, *lb)))
+      RRMap::iterator lb = mRRMap.find(Key(domain, rrType));
+      if (lb != mRRMap.end())
       {
-         (*lb)->update(it->second, begin, end, mUserDefinedTTL);
-         if ((*lb)->numRecords() == 0)
+         RRList* list = lb->second;
+         list->update(it->second, begin, end, mUserDefinedTTL);
+         if (list->numRecords() == 0)
          {
-            // *lb might be a RRList with no records if parsing failed - remove from cache
-            (*lb)->remove();
-            delete *lb;
-            mRRSet.erase(lb);
+            // list might be a RRList with no records if parsing failed - remove from cache
+            mRRMap.erase(lb);
+            list->remove();
+            delete list;
 #ifdef VERBOSE_DNS_STACK_LOGS
-            StackLog(<< "Update cache failed to parse, removed entry: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", totalCachedEntries=" << mRRSet.size());
+            StackLog(<< "Update cache failed to parse, removed entry: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", totalCachedEntries=" << mRRMap.size());
 #endif
          }
          else
@@ -132,7 +170,7 @@ RRCache::updateCache(const Data& target,
             StackLog(<< "Updated cache: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType));
 #endif
             // update good - touch entry
-            touch(*lb);
+            touch(list);
          }
       }
       else
@@ -148,15 +186,14 @@ RRCache::updateCache(const Data& target,
          }
          else
          {
-            mRRSet.insert(val);
+            mRRMap[Key(val->key(), val->rrType())] = val;
             mLruHead->push_back(val);
             purge();
 #ifdef VERBOSE_DNS_STACK_LOGS
-            StackLog(<< "Updated cache with new entry: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", totalCachedEntries=" << mRRSet.size());
+            StackLog(<< "Updated cache with new entry: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", totalCachedEntries=" << mRRMap.size());
 #endif
          }
       }
-      delete key;
    }
 }
 
@@ -178,20 +215,22 @@ RRCache::cacheTTL(const Data& target,
       ttl = mUserDefinedTTL;
    }
 
-   RRList* val = new RRList(target, rrType, ttl, status);
-   RRSet::iterator it = mRRSet.find(val);
-   if (it != mRRSet.end())
+   RRMap::iterator it = mRRMap.find(Key(target, rrType));
+   if (it != mRRMap.end())
    {
-      (*it)->remove();
-      delete *it;
-      mRRSet.erase(it);
+      // the map key points into the list being replaced; drop it first
+      RRList* old = it->second;
+      mRRMap.erase(it);
+      old->remove();
+      delete old;
    }
-   mRRSet.insert(val);
+   RRList* val = new RRList(target, rrType, ttl, status);
+   mRRMap[Key(val->key(), val->rrType())] = val;
    mLruHead->push_back(val);
    purge();
 
 #ifdef VERBOSE_DNS_STACK_LOGS
-   StackLog(<< "Updated cache ttl: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", status=" << status << ", ttl=" << ttl << ", totalCachedEntries=" << mRRSet.size());
+   StackLog(<< "Updated cache ttl: target=" << target << ", type=" << AresDns::dnsRRTypeToString(rrType) << ", status=" << status << ", ttl=" << ttl << ", totalCachedEntries=" << mRRMap.size());
 #endif
 }
 
@@ -204,36 +243,50 @@ RRCache::lookup(const Data& target,
 {
    records.clear();
    status = 0;
-   RRList* key = new RRList(target, type);
-   RRSet::iterator it = mRRSet.find(key);
-   delete key;
-   if (it == mRRSet.end())
+   RRMap::iterator it = mRRMap.find(Key(target, type));
+   if (it == mRRMap.end())
    {
 #ifdef VERBOSE_DNS_STACK_LOGS
-      StackLog(<< "Cache lookup failed for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRSet.size());
+      StackLog(<< "Cache lookup failed for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRMap.size());
 #endif
       return false;
    }
    else
    {
-      if (Timer::getTimeSecs() >= (*it)->absoluteExpiry())
+      RRList* list = it->second;
+      uint64_t now = Timer::getTimeSecs();
+      if (now >= list->absoluteExpiry())
       {
 #ifdef VERBOSE_DNS_STACK_LOGS
-         StackLog(<< "Cache lookup found expired entry for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRSet.size());
+         StackLog(<< "Cache lookup found expired entry for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRMap.size());
 #endif
-         (*it)->remove();
-         delete *it;
-         mRRSet.erase(it);
+         mRRMap.erase(it);
+         list->remove();
+         delete list;
          return false;
       }
       else
       {
 #ifdef VERBOSE_DNS_STACK_LOGS
-         StackLog(<< "Cache lookup success for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRSet.size());
+         StackLog(<< "Cache lookup success for: target=" << target << ", type=" << AresDns::dnsRRTypeToString(type) << ", protocol=" << protocol << ", totalCachedEntries=" << mRRMap.size());
 #endif
-         records = (*it)->records(protocol);
-         status = (*it)->status();
-         touch(*it);
+         records = list->records(protocol);
+         status = list->status();
+         touch(list);
+
+         // only positive answers are worth refreshing; negative entries
+         // simply lapse
+         ++list->hits();
+         if (mPrefetchSecs > 0 &&
+             status == 0 &&
+             !records.empty() &&
+             !list->prefetchPending() &&
+             list->hits() >= mPrefetchMinHits &&
+             list->absoluteExpiry() - now <= (uint64_t)mPrefetchSecs)
+         {
+            list->prefetchPending() = true;
+            mPrefetches.push_back(std::make_pair(list->key(), list->rrType()));
+         }
          return true;
       }
    }
@@ -255,14 +308,15 @@ RRCache::touch(RRList* node)
 void 
 RRCache::cleanup()
 {
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); it++)
+   for (RRMap::iterator it = mRRMap.begin(); it != mRRMap.end(); it++)
    {
-      (*it)->remove();
-      delete *it;
+      it->second->remove();
+      delete it->second;
    }
-   mRRSet.clear();
+   mRRMap.clear();
+   mPrefetches.clear();
 #ifdef VERBOSE_DNS_STACK_LOGS
-   StackLog(<< "Cache emptied, totalCachedEntries=" << mRRSet.size());
+   StackLog(<< "Cache emptied, totalCachedEntries=" << mRRMap.size());
 #endif
 }
 
@@ -294,18 +348,18 @@ RRCache::getTTL(const RROverlay& overlay)
 void 
 RRCache::purge()
 {
-   if (mRRSet.size() < mSize) return;
+   if (mRRMap.size() < mSize) return;
    RRList* lst = *(mLruHead->begin());
-   RRSet::iterator it = mRRSet.find(lst);
-   if (it != mRRSet.end()) // safety check incase code forgets to remove from LRU list when removing from mRRset
+   RRMap::iterator it = mRRMap.find(Key(lst->key(), lst->rrType()));
+   if (it != mRRMap.end()) // safety check incase code forgets to remove from LRU list when removing from mRRMap
    {
 #ifdef VERBOSE_DNS_STACK_LOGS
-      StackLog(<< "Cache full purging LRU record, target=" << lst->key() << ", type=" << AresDns::dnsRRTypeToString(lst->rrType()) << ", status=" << lst->status() << ", totalCachedEntries=" << mRRSet.size() << ", maxSize=" << mSize);
+      StackLog(<< "Cache full purging LRU record, target=" << lst->key() << ", type=" << AresDns::dnsRRTypeToString(lst->rrType()) << ", status=" << lst->status() << ", totalCachedEntries=" << mRRMap.size() << ", maxSize=" << mSize);
 #endif
 
+      mRRMap.erase(it);
       lst->remove();
-      delete* it;
-      mRRSet.erase(it);
+      delete lst;
    }
 }
 
@@ -317,27 +371,47 @@ RRCache::logCache()
    WarningLog(<< endl << dnsCacheDump);
 }
 
+static bool
+dumpOrder(const RRList* lhs, const RRList* rhs)
+{
+   if (lhs->rrType() != rhs->rrType())
+   {
+      return lhs->rrType() < rhs->rrType();
+   }
+   return Data(lhs->key()).lowercase() < Data(rhs->key()).lowercase();
+}
+
 void 
 RRCache::getCacheDump(Data& dnsCacheDump)
 {
    uint64_t now = Timer::getTimeSecs();
-   DataStream strm(dnsCacheDump);
-   strm << "DNSCACHE: TotalEntries=" << mRRSet.size();
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   std::vector<RRList*> lists;
+   lists.reserve(mRRMap.size());
+   for (RRMap::iterator it = mRRMap.begin(); it != mRRMap.end(); )
    {
-      if (now >= (*it)->absoluteExpiry())
+      RRList* list = it->second;
+      if (now >= list->absoluteExpiry())
       {
-         (*it)->remove();
-         delete *it;
-         mRRSet.erase(it++);
+         it = mRRMap.erase(it);
+         list->remove();
+         delete list;
       }
       else
       {
-         strm << endl;
-         (*it)->encodeRRList(strm);
+         lists.push_back(list);
          ++it;
       }
    }
+   // the map is unordered; keep the dump sorted by type and name as before
+   std::sort(lists.begin(), lists.end(), dumpOrder);
+
+   DataStream strm(dnsCacheDump);
+   strm << "DNSCACHE: TotalEntries=" << mRRMap.size();
+   for (std::vector<RRList*>::iterator it = lists.begin(); it != lists.end(); ++it)
+   {
+      strm << endl;
+      (*it)->encodeRRList(strm);
+   }
    strm.flush();
 }
 
@@ -2,8 +2,11 @@
 #define RESIP_RRCACHE_HXX
 
 #include <map>
-#include <set>
 #include <memory>
+#include <utility>
+#include <vector>
+
+#include "rutil/HashMap.hxx"
 
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
@@ -18,6 +21,30 @@ namespace resip
 {
 class RROverlay;
 
+// (name, rrType) as the cache is indexed; names compare without regard to
+// case.  A key only points at the name, so the Data it was built from must
+// outlive it.
+class RRCacheKey
+{
+   public:
+      RRCacheKey(const Data& target, int rrType)
+         : mTarget(target.data()), mSize(target.size()), mRRType(rrType) {}
+      bool operator==(const RRCacheKey& rhs) const;
+      size_t hash() const;
+
+   private:
+      const char* mTarget;
+      Data::size_type mSize;
+      int mRRType;
+};
+
+}
+
+HashValue(resip::RRCacheKey);
+
+namespace resip
+{
+
 class RRCache
 {
    public:
@@ -26,11 +53,24 @@ class RRCache
       typedef RRList::Records Result;
       typedef std::vector<RROverlay>::const_iterator Itr;
       typedef std::vector<Data> DataArr;
+      typedef std::vector<std::pair<Data, int> > PrefetchList;
+
+      typedef RRCacheKey Key;
 
       RRCache();
       ~RRCache();
       void setTTL(int ttl) { if (ttl > 0) mUserDefinedTTL = ttl * MIN_TO_SEC; }
       void setSize(int size) { mSize = size; }
+      // Entries that have served at least minHits lookups and are looked up
+      // again within secondsBeforeExpiry of expiring are handed out (once)
+      // by takePrefetches(), so that they can be refreshed before they
+      // lapse.  secondsBeforeExpiry of 0 (the default) disables this.
+      void setPrefetch(int secondsBeforeExpiry, unsigned int minHits);
+      void takePrefetches(PrefetchList& targets);
+      // Called when a lookup of target completes, however it went.  An
+      // answer that refreshed the entry has already re-armed it; this lets
+      // an entry whose refresh timed out or failed be asked for again.
+      void prefetchDone(const Data& target, const int rrType);
       // Update existing cache record, or add a new one
       void updateCache(const Data& target,
                        const int rrType,
@@ -44,6 +84,8 @@ class RRCache
                     RROverlay overlay);
       bool lookup(const Data& target, const int type, const int proto, Result& records, int& status);
       void clearCache();
+      // number of cached record sets, including negative answers
+      size_t size() const { return mRRMap.size(); }
       void logCache();
       void getCacheDump(Data& dnsCacheDump);
 
@@ -52,25 +94,6 @@ class RRCache
       static const int DEFAULT_USER_DEFINED_TTL = 10; // in seconds.
 
       static const int DEFAULT_SIZE = 512;
-      class CompareT
-      {
-         public:
-            bool operator()(const RRList* lhs, const RRList* rhs) const
-            {
-               if (lhs->rrType() < rhs->rrType())
-               {
-                  return true;
-               }
-               else if (lhs->rrType() > rhs->rrType())
-               {
-                  return false;
-               }
-               else
-               {
-                  return (Data(lhs->key())).lowercase() < (Data(rhs->key())).lowercase();
-               }
-            }
-      };
 
       void touch(RRList* node);
       void cleanup();
@@ -81,8 +104,8 @@ class RRCache
       LruListType* mLruHead;                     
       Result Empty;
 
-      typedef std::set<RRList*, CompareT> RRSet;
-      RRSet mRRSet;
+      typedef HashMap<Key, RRList*> RRMap;
+      RRMap mRRMap;
 
       RRFactory<DnsHostRecord> mHostRecordFactory;
       RRFactory<DnsSrvRecord> mSrvRecordFactory;
@@ -95,6 +118,9 @@ class RRCache
       
       int mUserDefinedTTL; // used when the ttl in RR is 0 or less than default(10). in seconds.
       unsigned int mSize;
+      int mPrefetchSecs;
+      unsigned int mPrefetchMinHits;
+      PrefetchList mPrefetches;
 };
 
 }
@@ -39,19 +39,19 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
 
-RRList::RRList() : mRRType(0), mStatus(0), mAbsoluteExpiry(ULONG_MAX) {}
+RRList::RRList() : mRRType(0), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mHits(0), mPrefetchPending(false) {}
 
 RRList::RRList(const Data& key, 
                const int rrtype, 
                int ttl, 
                int status)
-   : mKey(key), mRRType(rrtype), mStatus(status)
+   : mKey(key), mRRType(rrtype), mStatus(status), mHits(0), mPrefetchPending(false)
 {
    mAbsoluteExpiry = ttl + Timer::getTimeSecs();
 }
 
 RRList::RRList(const DnsHostRecord &record, int ttl)
-   : mKey(record.name()), mRRType(T_A), mStatus(0), mAbsoluteExpiry(ULONG_MAX)
+   : mKey(record.name()), mRRType(T_A), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mHits(0), mPrefetchPending(false)
 {
    update(record, ttl);
 }
@@ -64,10 +64,12 @@ void RRList::update(const DnsHostRecord &record, int ttl)
    item.record = new DnsHostRecord(record);
    mRecords.push_back(item);
    mAbsoluteExpiry = Timer::getTimeSecs() + ttl;
+   mHits = 0;
+   mPrefetchPending = false;
 }
       
 RRList::RRList(const Data& key, int rrtype)
-   : mKey(key), mRRType(rrtype), mStatus(0), mAbsoluteExpiry(ULONG_MAX)
+   : mKey(key), mRRType(rrtype), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mHits(0), mPrefetchPending(false)
 {}
 
 RRList::~RRList()
@@ -81,7 +83,7 @@ RRList::RRList(const RRFactoryBase* factory,
                Itr begin,
                Itr end, 
                int ttl)
-   : mKey(key), mRRType(rrType), mStatus(0)
+   : mKey(key), mRRType(rrType), mStatus(0), mHits(0), mPrefetchPending(false)
 {
    update(factory, begin, end, ttl);
 }
@@ -116,6 +118,8 @@ void RRList::update(const RRFactoryBase* factory, Itr begin, Itr end, int ttl)
    }
 
    mAbsoluteExpiry += Timer::getTimeSecs();
+   mHits = 0;
+   mPrefetchPending = false;
 }
 
 RRList::Records RRList::records(const int protocol)
@@ -53,6 +53,10 @@ class RRList : public IntrusiveListElement<RRList*>
       int rrType() const { return mRRType; }
       uint64_t absoluteExpiry() const { return mAbsoluteExpiry; }
       uint64_t& absoluteExpiry() { return mAbsoluteExpiry; }
+      // lookups served since the records were last replaced, and whether a
+      // refresh has already been asked for; both reset by update()
+      unsigned int& hits() { return mHits; }
+      bool& prefetchPending() { return mPrefetchPending; }
       void log();
       EncodeStream& encodeRRList(EncodeStream& strm);
 
@@ -74,6 +78,8 @@ class RRList : public IntrusiveListElement<RRList*>
 
       int mStatus; // dns query status.
       uint64_t mAbsoluteExpiry;
+      unsigned int mHits;
+      bool mPrefetchPending;
 
       RecordItr find(const Data&);
       void clear();
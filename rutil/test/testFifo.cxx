@@ -4,6 +4,7 @@
 #include "rutil/FiniteFifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/ParseBuffer.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Timer.hxx"
 #ifndef WIN32
@@ -78,6 +79,45 @@ class Producer: public ThreadIf
       TimeLimitFifo<Foo>& mFifo;
 };
 
+// tags each message with the producer and a per-producer sequence number,
+// so the consumer can check that nothing is lost or reordered
+class TaggedProducer: public ThreadIf
+{
+  public:
+      TaggedProducer(Fifo<Foo>& f, int id, int count, bool batched = false) :
+         mFifo(f), mId(id), mCount(count), mBatched(batched)
+      {}
+      virtual ~TaggedProducer()
+      {
+         shutdown();
+         join();
+      }
+
+      void thread()
+      {
+         Fifo<Foo>::Messages batch;
+         for (int n = 0; n < mCount; ++n)
+         {
+            if (!mBatched)
+            {
+               mFifo.add(new Foo(Data(mId) + ":" + Data(n)));
+               continue;
+            }
+            batch.push_back(new Foo(Data(mId) + ":" + Data(n)));
+            if (batch.size() == 3 || n + 1 == mCount)
+            {
+               mFifo.addMultiple(batch);
+            }
+         }
+      }
+
+   private:
+      Fifo<Foo>& mFifo;
+      const int mId;
+      const int mCount;
+      const bool mBatched;
+};
+
 Consumer::Consumer(TimeLimitFifo<Foo>& f) :
    mFifo(f)
 {}
@@ -459,6 +499,194 @@ main()
       sleepMS(1000);
    }
 
+   // lock-free mode: many producers, one consumer, ring small enough to
+   // force spills into the overflow list
+   {
+      Fifo<Foo> f;
+      f.setLockFree(64);
+      assert(f.isLockFree());
+      assert(f.empty());
+
+      const int producers = 4;
+      const int perProducer = 20000;
+      TaggedProducer* prods[producers];
+      for (int i = 0; i < producers; ++i)
+      {
+         prods[i] = new TaggedProducer(f, i, perProducer);
+      }
+      for (int i = 0; i < producers; ++i)
+      {
+         prods[i]->run();
+      }
+
+      int next[producers] = { 0 };
+      int received = 0;
+      while (received < producers * perProducer)
+      {
+         Foo* foo = f.getNext(1000);
+         assert(foo);
+         ParseBuffer pb(foo->mVal);
+         int id = pb.integer();
+         pb.skipChar(':');
+         int n = pb.integer();
+         assert(id >= 0 && id < producers);
+         assert(n == next[id]);
+         ++next[id];
+         ++received;
+         delete foo;
+      }
+      assert(f.empty());
+      assert(f.size() == 0);
+
+      for (int i = 0; i < producers; ++i)
+      {
+         delete prods[i];
+      }
+
+      // a parked consumer must be woken by add()
+      TaggedProducer late(f, 0, 1);
+      uint64_t start = Timer::getTimeMs();
+      late.run();
+      Foo* foo = f.getNext(5000);
+      assert(foo);
+      assert(Timer::getTimeMs() - start < 4000);
+      delete foo;
+
+      // nothing there: times out
+      assert(f.getNext(50) == 0);
+
+      // getMultiple drains both the ring and the overflow list
+      for (int n = 0; n < 200; ++n)
+      {
+         f.add(new Foo(Data(n)));
+      }
+      assert(f.size() == 200);
+      Fifo<Foo>::Messages batch;
+      f.getMultiple(batch, 1000);
+      assert(batch.size() == 200);
+      for (int n = 0; n < 200; ++n)
+      {
+         assert(batch[n]->mVal == Data(n));
+         delete batch[n];
+      }
+      assert(f.empty());
+
+      f.add(new Foo("left behind"));
+      f.clear();
+      assert(f.empty());
+   }
+
+   // lock-free mode: the count is taken before an element is published, so
+   // a consumer racing the producers never sees size() run past what is
+   // actually outstanding (an unsigned wrap below zero)
+   {
+      Fifo<Foo> f;
+      f.setLockFree(256);
+
+      const int producers = 4;
+      const int perProducer = 50000;
+      const unsigned int total = producers * perProducer;
+      TaggedProducer* prods[producers];
+      for (int i = 0; i < producers; ++i)
+      {
+         prods[i] = new TaggedProducer(f, i, perProducer, i % 2 == 1);
+      }
+      for (int i = 0; i < producers; ++i)
+      {
+         prods[i]->run();
+      }
+
+      unsigned int received = 0;
+      while (received < total)
+      {
+         Foo* foo = f.getNext(1000);
+         assert(foo);
+         delete foo;
+         ++received;
+         assert(f.size() <= total - received);
+      }
+      assert(f.empty());
+      assert(f.size() == 0);
+
+      for (int i = 0; i < producers; ++i)
+      {
+         delete prods[i];
+      }
+   }
+
+   {
+      TimeLimitFifo<Foo> tlf(1, 100);
+      tlf.setLockFree(16);
+      assert(tlf.add(new Foo("first"), TimeLimitFifo<Foo>::EnforceTimeDepth));
+      sleepMS(2000);
+      assert(tlf.timeDepth() >= 1);
+      assert(!tlf.wouldAccept(TimeLimitFifo<Foo>::EnforceTimeDepth));
+      delete tlf.getNext();
+      assert(tlf.timeDepth() == 0);
+      assert(tlf.wouldAccept(TimeLimitFifo<Foo>::EnforceTimeDepth));
+   }
+
+   cerr << "!! test wait time sampling" << endl;
+   for (int lockFree = 0; lockFree < 2; ++lockFree)
+   {
+      Fifo<Foo> wf;
+      if (lockFree)
+      {
+         wf.setLockFree(16);
+      }
+      wf.enableWaitTimeSampling();
+
+      // the first element added is sampled; the second is not, as the
+      // first's sample is still outstanding
+      wf.add(new Foo("sampled"));
+      sleepMS(50);
+      wf.add(new Foo("not sampled"));
+      delete wf.getNext();
+      LatencyHistogram waits;
+      wf.addWaitTimes(waits);
+      assert(waits.count() == 1);
+      assert(waits.maxMicroSec() >= 40000);
+      delete wf.getNext();
+      waits.zeroOut();
+      wf.addWaitTimes(waits);
+      assert(waits.count() == 1);
+
+      // taken out together: the sample ends with the batch
+      Fifo<Foo>::Messages batch;
+      batch.push_back(new Foo("a"));
+      batch.push_back(new Foo("b"));
+      wf.addMultiple(batch);
+      wf.getMultiple(batch, 10);
+      assert(batch.size() == 2);
+      delete batch[0];
+      delete batch[1];
+      waits.zeroOut();
+      wf.addWaitTimes(waits);
+      assert(waits.count() == 2);
+      assert(waits.percentile(0.5) < 40000);
+
+      wf.zeroOutWaitTimes();
+      waits.zeroOut();
+      wf.addWaitTimes(waits);
+      assert(waits.count() == 0);
+   }
+   {
+      // rejected elements must not throw later samples off
+      TimeLimitFifo<Foo> tlf(0, 1);
+      tlf.enableWaitTimeSampling();
+      assert(tlf.add(new Foo("first"), TimeLimitFifo<Foo>::InternalElement));
+      Foo* rejected = new Foo("rejected");
+      assert(!tlf.add(rejected, TimeLimitFifo<Foo>::InternalElement));
+      delete rejected;
+      delete tlf.getNext();
+      sleepMS(1);
+      assert(tlf.add(new Foo("second"), TimeLimitFifo<Foo>::InternalElement));
+      delete tlf.getNext();
+      LatencyHistogram waits;
+      tlf.addWaitTimes(waits);
+      assert(waits.count() == 2);
+   }
+
    cerr << "All OK" << endl;
    return 0;
 }
@@ -0,0 +1,225 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/LatencyHistogram.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+void
+testBuckets()
+{
+   // every value falls in the bucket whose bounds hold it, and buckets tile
+   // the range with no gaps
+   assert(LatencyHistogram::bucketLowerBound(0) == 0);
+   for (unsigned int b = 1; b < LatencyHistogram::NumBuckets; ++b)
+   {
+      assert(LatencyHistogram::bucketLowerBound(b) == LatencyHistogram::bucketUpperBound(b - 1) + 1);
+   }
+   for (uint64_t v = 0; v < 100000; ++v)
+   {
+      unsigned int b = LatencyHistogram::bucketFor(v);
+      assert(b < LatencyHistogram::NumBuckets);
+      assert(LatencyHistogram::bucketLowerBound(b) <= v);
+      assert(v <= LatencyHistogram::bucketUpperBound(b));
+   }
+   for (unsigned int shift = 17; shift < 64; ++shift)
+   {
+      uint64_t v = (uint64_t)1 << shift;
+      unsigned int b = LatencyHistogram::bucketFor(v - 1);
+      assert(b < LatencyHistogram::NumBuckets);
+      if (v - 1 < LatencyHistogram::MaxMicroSec)
+      {
+         assert(LatencyHistogram::bucketLowerBound(b) <= v - 1);
+         assert(v - 1 <= LatencyHistogram::bucketUpperBound(b));
+         // relative precision
+         uint64_t width = LatencyHistogram::bucketUpperBound(b) - LatencyHistogram::bucketLowerBound(b) + 1;
+         assert(width * LatencyHistogram::SubBuckets <= LatencyHistogram::bucketLowerBound(b));
+      }
+   }
+   assert(LatencyHistogram::bucketFor(LatencyHistogram::MaxMicroSec) == LatencyHistogram::NumBuckets - 1);
+   assert(LatencyHistogram::bucketFor(~(uint64_t)0) == LatencyHistogram::NumBuckets - 1);
+}
+
+void
+testPercentiles()
+{
+   LatencyHistogram h;
+   assert(h.count() == 0);
+   assert(h.percentile(0.5) == 0);
+   assert(h.meanMicroSec() == 0);
+
+   for (uint64_t v = 1; v <= 1000; ++v)
+   {
+      h.record(v * 100);
+   }
+   assert(h.count() == 1000);
+   assert(h.maxMicroSec() == 100000);
+   assert(h.sumMicroSec() == 100 * 1000 * 1001 / 2);
+   assert(h.meanMicroSec() == 50050);
+
+   const double fractions[] = { 0.1, 0.5, 0.9, 0.99 };
+   for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); ++i)
+   {
+      double exact = fractions[i] * 100000;
+      uint64_t p = h.percentile(fractions[i]);
+      assert(p >= exact);
+      assert(p <= exact * 1.125 + 1);
+   }
+   assert(h.percentile(1.0) == 100000);
+   assert(h.percentile(0.0) >= 100);
+
+   Data out;
+   {
+      DataStream ds(out);
+      ds << h;
+   }
+   cerr << out << endl;
+   assert(out.prefix("n=1000 p50="));
+
+   h.zeroOut();
+   assert(h.count() == 0);
+   assert(h.maxMicroSec() == 0);
+   for (unsigned int b = 0; b < LatencyHistogram::NumBuckets; ++b)
+   {
+      assert(h.bucketCount(b) == 0);
+   }
+}
+
+void
+testMerge()
+{
+   LatencyHistogram a;
+   LatencyHistogram b;
+   a.record(10);
+   a.record(2000);
+   b.record(30);
+   b.record(5000000);
+   a.add(b);
+   assert(a.count() == 4);
+   assert(a.maxMicroSec() == 5000000);
+   assert(a.sumMicroSec() == 10 + 2000 + 30 + 5000000);
+   assert(a.bucketCount(LatencyHistogram::bucketFor(30)) == 1);
+   assert(a.percentile(0.25) == 10);
+   assert(a.percentile(1.0) == 5000000);
+
+   LatencyHistogram copy(a);
+   assert(copy.count() == 4);
+   copy = b;
+   assert(copy.count() == 2);
+}
+
+void
+testRecorder()
+{
+   const int threads = 4;
+   const int perThread = 250000;
+   LatencyRecorder recorder;
+   vector<thread> workers;
+   for (int t = 0; t < threads; ++t)
+   {
+      workers.push_back(thread([&recorder, t]()
+      {
+         for (int i = 0; i < perThread; ++i)
+         {
+            recorder.record((uint64_t)(t + 1) * 1000);
+         }
+      }));
+   }
+   for (size_t t = 0; t < workers.size(); ++t)
+   {
+      workers[t].join();
+   }
+
+   LatencyHistogram h;
+   recorder.addTo(h);
+   assert(h.count() == (uint64_t)threads * perThread);
+   assert(h.maxMicroSec() == (uint64_t)threads * 1000);
+   assert(h.sumMicroSec() == (uint64_t)perThread * 1000 * (1 + 2 + 3 + 4));
+   for (int t = 0; t < threads; ++t)
+   {
+      assert(h.bucketCount(LatencyHistogram::bucketFor((uint64_t)(t + 1) * 1000)) == (uint32_t)perThread);
+   }
+
+   // addTo merges
+   recorder.addTo(h);
+   assert(h.count() == 2 * (uint64_t)threads * perThread);
+
+   recorder.zeroOut();
+   LatencyHistogram empty;
+   recorder.addTo(empty);
+   assert(empty.count() == 0);
+   assert(empty.maxMicroSec() == 0);
+}
+
+}
+
+int
+main()
+{
+   testBuckets();
+   testPercentiles();
+   testMerge();
+   testRecorder();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -1,4 +1,10 @@
 
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "rutil/Logger.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/ThreadIf.hxx"
@@ -131,6 +137,85 @@ testThreadLocalLoggers(const char *appname)
    }
 }
 
+class AsyncLogThread : public ThreadIf
+{
+   public:
+      AsyncLogThread(int id, int count) : mId(id), mCount(count) {}
+      void thread()
+      {
+         for (int i = 0; i < mCount; ++i)
+         {
+            InfoLog(<< "async-record " << mId << " " << i);
+         }
+      }
+   private:
+      int mId;
+      int mCount;
+};
+
+// logs from several threads, returns the number of records found in the file
+int
+runAsyncThreads(const char* fileName, int threads, int perThread)
+{
+   std::vector<AsyncLogThread*> logThreads;
+   for (int i = 0; i < threads; ++i)
+   {
+      logThreads.push_back(new AsyncLogThread(i, perThread));
+      logThreads.back()->run();
+   }
+   for (int i = 0; i < threads; ++i)
+   {
+      logThreads[i]->join();
+      delete logThreads[i];
+   }
+   Log::flushAsync();
+
+   int found = 0;
+   std::ifstream in(fileName);
+   std::string line;
+   while (std::getline(in, line))
+   {
+      if (line.find("async-record") != std::string::npos)
+      {
+         ++found;
+      }
+   }
+   return found;
+}
+
+void
+testAsyncLogging(const char* appname)
+{
+   const char* fileName = "testLogger-async.txt";
+
+   remove(fileName);
+   Log::setAsyncBufferSize(1024*1024);
+   Log::setAsyncOverflow(Log::AsyncBlock);
+   Log::initialize("async-file", "INFO", appname, fileName);
+   assert(Log::isAsync());
+   uint64_t dropped = Log::getAsyncDroppedCount();
+   // blocking: nothing may be lost, however small the buffer
+   Log::setAsyncBufferSize(2048);
+   Log::setAsync(true);
+   assert(runAsyncThreads(fileName, 4, 5000) == 4*5000);
+   assert(Log::getAsyncDroppedCount() == dropped);
+
+   // dropping: whatever was not written must have been counted
+   remove(fileName);
+   Log::setAsyncOverflow(Log::AsyncDrop);
+   Log::initialize("async-file", "INFO", appname, fileName);
+   int written = runAsyncThreads(fileName, 4, 5000);
+   assert(written + (Log::getAsyncDroppedCount() - dropped) == 4*5000);
+   cout << "async logging: " << written << " written, "
+        << Log::getAsyncDroppedCount() - dropped << " dropped, "
+        << Log::getAsyncBlockedCount() << " blocked" << endl;
+
+   Log::initialize("cout", "INFO", appname);
+   assert(!Log::isAsync());
+   InfoLog(<< "This should appear-back to Cout, written synchronously");
+   remove(fileName);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -248,6 +333,7 @@ main(int argc, char* argv[])
 
    cout << endl;
    testThreadLocalLoggers(argv[0]);
+   testAsyncLogging(argv[0]);
 
    Log::initialize(Log::Cout, Log::Info, argv[0], 0, 0, "LOG_DAEMON", Log::MessageStructure::Unstructured, "TestDev");
    InfoLog(<<"This should appear-back to Cout");
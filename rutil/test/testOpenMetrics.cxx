@@ -0,0 +1,161 @@
+#include <cassert>
+#include <iostream>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/LatencyHistogram.hxx"
+#include "rutil/OpenMetrics.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+void
+testSeconds()
+{
+   assert(OpenMetricsWriter::microSecToSeconds(0) == "0");
+   assert(OpenMetricsWriter::microSecToSeconds(64) == "0.000064");
+   assert(OpenMetricsWriter::microSecToSeconds(1500000) == "1.5");
+   assert(OpenMetricsWriter::microSecToSeconds(2000000) == "2");
+   assert(OpenMetricsWriter::microSecToSeconds((uint64_t)1 << 28) == "268.435456");
+}
+
+void
+testCounterAndGauge()
+{
+   Data out;
+   {
+      DataStream ds(out);
+      OpenMetricsWriter writer(ds);
+      writer.family("sip_requests_received", OpenMetricsWriter::Counter, "Requests \"received\"\nby method");
+      writer.counter(12, OpenMetricsWriter::Labels("method", "INVITE"), 1700000000);
+      writer.counter(3, OpenMetricsWriter::Labels("method", "a\\b\"c\nd").add("transport", "TCP"));
+      writer.family("fifo_size", OpenMetricsWriter::Gauge, "Fifo size");
+      writer.gauge(7);
+      writer.gauge(0.25, OpenMetricsWriter::Labels("fifo", "x"));
+      writer.gauge(-2);
+      writer.finish();
+   }
+   cerr << out;
+   assert(out ==
+          "# TYPE sip_requests_received counter\n"
+          "# HELP sip_requests_received Requests \\\"received\\\"\\nby method\n"
+          "sip_requests_received_total{method=\"INVITE\"} 12\n"
+          "sip_requests_received_created{method=\"INVITE\"} 1700000000\n"
+          "sip_requests_received_total{method=\"a\\\\b\\\"c\\nd\",transport=\"TCP\"} 3\n"
+          "# TYPE fifo_size gauge\n"
+          "# HELP fifo_size Fifo size\n"
+          "fifo_size 7\n"
+          "fifo_size{fifo=\"x\"} 0.25\n"
+          "fifo_size -2\n"
+          "# EOF\n");
+}
+
+void
+testHistogram()
+{
+   LatencyHistogram h;
+   h.record(10);         // below the first bound
+   h.record(63);         // still below 64us
+   h.record(64);         // below 128us
+   h.record(1500000);    // 1.5s
+   h.record(300000000);  // beyond the last bound
+
+   Data out;
+   {
+      DataStream ds(out);
+      OpenMetricsWriter writer(ds);
+      writer.family("latency_seconds", OpenMetricsWriter::Histogram, "Latency", "seconds");
+      writer.histogram(h, OpenMetricsWriter::Labels("method", "BYE"), 5);
+      writer.finish();
+   }
+   cerr << out;
+   assert(out.prefix("# TYPE latency_seconds histogram\n"
+                     "# UNIT latency_seconds seconds\n"
+                     "# HELP latency_seconds Latency\n"
+                     "latency_seconds_bucket{method=\"BYE\",le=\"0.000064\"} 2\n"
+                     "latency_seconds_bucket{method=\"BYE\",le=\"0.000128\"} 3\n"));
+   assert(out.find("latency_seconds_bucket{method=\"BYE\",le=\"1.048576\"} 3\n") != Data::npos);
+   assert(out.find("latency_seconds_bucket{method=\"BYE\",le=\"2.097152\"} 4\n") != Data::npos);
+   assert(out.find("latency_seconds_bucket{method=\"BYE\",le=\"134.217728\"} 4\n") != Data::npos);
+   assert(out.find("268.435456") == Data::npos);
+   assert(out.find("latency_seconds_bucket{method=\"BYE\",le=\"+Inf\"} 5\n"
+                   "latency_seconds_count{method=\"BYE\"} 5\n"
+                   "latency_seconds_sum{method=\"BYE\"} 301.500137\n"
+                   "latency_seconds_created{method=\"BYE\"} 5\n"
+                   "# EOF\n") != Data::npos);
+
+   // one line per bound, plus +Inf, _count, _sum, _created and the
+   // metadata and EOF lines
+   unsigned int lines = 0;
+   for (Data::size_type i = 0; i < out.size(); ++i)
+   {
+      lines += (out[i] == '\n');
+   }
+   assert(lines == 3 + (OpenMetricsWriter::MaxBucketExponent - OpenMetricsWriter::MinBucketExponent + 1) + 4 + 1);
+}
+
+}
+
+int
+main()
+{
+   testSeconds();
+   testCounterAndGauge();
+   testHistogram();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,325 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rutil/PrefixTree.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+struct Prefix
+{
+      unsigned char key[16];
+      unsigned int length;
+      int id;
+};
+
+bool
+prefixMatches(const Prefix& p, const unsigned char* key)
+{
+   unsigned int bytes = p.length / 8;
+   if (memcmp(p.key, key, bytes) != 0)
+   {
+      return false;
+   }
+   if (p.length % 8 == 0)
+   {
+      return true;
+   }
+   unsigned int mask = (0xff00 >> (p.length % 8)) & 0xff;
+   return (p.key[bytes] & mask) == (key[bytes] & mask);
+}
+
+// the linear scan the tree replaces, as a reference and for comparison
+bool
+linearFind(const vector<Prefix>& prefixes, const unsigned char* key)
+{
+   for (vector<Prefix>::const_iterator i = prefixes.begin(); i != prefixes.end(); ++i)
+   {
+      if (prefixMatches(*i, key))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+struct Collect
+{
+      bool operator()(const int& id)
+      {
+         ids.push_back(id);
+         return false;
+      }
+      vector<int> ids;
+};
+
+struct FindAny
+{
+      bool operator()(const int&) { return true; }
+};
+
+void
+randomKey(unsigned char* key, unsigned int bytes)
+{
+   for (unsigned int i = 0; i < bytes; ++i)
+   {
+      key[i] = (unsigned char)(rand() & 0xff);
+   }
+}
+
+// prefixes clustered under a few roots, so they nest and share paths
+vector<Prefix>
+makePrefixes(unsigned int count, unsigned int keyBits, unsigned int minLength)
+{
+   vector<Prefix> prefixes;
+   unsigned char roots[8][16];
+   for (unsigned int r = 0; r < 8; ++r)
+   {
+      randomKey(roots[r], 16);
+   }
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      Prefix p;
+      memcpy(p.key, roots[rand() % 8], 16);
+      unsigned int fixed = rand() % (keyBits / 2);
+      for (unsigned int b = fixed; b < keyBits; ++b)
+      {
+         if (rand() & 1)
+         {
+            p.key[b / 8] ^= (unsigned char)(0x80 >> (b % 8));
+         }
+      }
+      p.length = minLength + rand() % (keyBits - minLength + 1);
+      p.id = (int)i;
+      prefixes.push_back(p);
+   }
+   return prefixes;
+}
+
+// a key inside a random prefix, or an unrelated one
+void
+makeProbe(const vector<Prefix>& prefixes, unsigned int keyBits, unsigned char* key)
+{
+   randomKey(key, keyBits / 8);
+   if (rand() & 1)
+   {
+      const Prefix& p = prefixes[rand() % prefixes.size()];
+      for (unsigned int b = 0; b < p.length; ++b)
+      {
+         unsigned int mask = 0x80 >> (b % 8);
+         key[b / 8] = (unsigned char)((key[b / 8] & ~mask) | (p.key[b / 8] & mask));
+      }
+   }
+}
+
+void
+checkAgainstLinear(unsigned int count, unsigned int keyBits, unsigned int minLength)
+{
+   vector<Prefix> prefixes = makePrefixes(count, keyBits, minLength);
+   PrefixTree<int> tree;
+   for (vector<Prefix>::const_iterator i = prefixes.begin(); i != prefixes.end(); ++i)
+   {
+      tree.insert(i->key, i->length, i->id);
+   }
+   assert(tree.size() == count);
+
+   for (unsigned int n = 0; n < 20000; ++n)
+   {
+      unsigned char key[16];
+      makeProbe(prefixes, keyBits, key);
+
+      vector<bool> expected(count, false);
+      unsigned int numExpected = 0;
+      for (vector<Prefix>::const_iterator i = prefixes.begin(); i != prefixes.end(); ++i)
+      {
+         if (prefixMatches(*i, key))
+         {
+            expected[i->id] = true;
+            ++numExpected;
+         }
+      }
+
+      Collect collect;
+      assert(!tree.find(key, keyBits, collect));
+      assert(collect.ids.size() == numExpected);
+      for (size_t i = 0; i < collect.ids.size(); ++i)
+      {
+         assert(expected[collect.ids[i]]);
+         // longest prefix first
+         assert(i == 0 || prefixes[collect.ids[i]].length <= prefixes[collect.ids[i - 1]].length);
+      }
+
+      FindAny any;
+      assert(tree.find(key, keyBits, any) == (numExpected > 0));
+   }
+}
+
+void
+benchmark(unsigned int count, unsigned int keyBits, unsigned int minLength)
+{
+   vector<Prefix> prefixes = makePrefixes(count, keyBits, minLength);
+   PrefixTree<int> tree;
+   for (vector<Prefix>::const_iterator i = prefixes.begin(); i != prefixes.end(); ++i)
+   {
+      tree.insert(i->key, i->length, i->id);
+   }
+   const unsigned int numProbes = 1000;
+   vector<unsigned char> probes(numProbes * 16);
+   for (unsigned int n = 0; n < numProbes; ++n)
+   {
+      makeProbe(prefixes, keyBits, &probes[n * 16]);
+   }
+
+   unsigned int treeRounds = 200;
+   unsigned int treeHits = 0;
+   uint64_t start = Timer::getTimeMicroSec();
+   for (unsigned int r = 0; r < treeRounds; ++r)
+   {
+      for (unsigned int n = 0; n < numProbes; ++n)
+      {
+         FindAny any;
+         treeHits += tree.find(&probes[n * 16], keyBits, any);
+      }
+   }
+   uint64_t treeUs = Timer::getTimeMicroSec() - start;
+
+   unsigned int linearHits = 0;
+   start = Timer::getTimeMicroSec();
+   for (unsigned int n = 0; n < numProbes; ++n)
+   {
+      linearHits += linearFind(prefixes, &probes[n * 16]);
+   }
+   uint64_t linearUs = Timer::getTimeMicroSec() - start;
+   assert(treeHits == linearHits * treeRounds);
+
+   cout << count << " IPv" << (keyBits == 32 ? 4 : 6) << " prefixes: tree "
+        << double(treeUs) * 1000 / (treeRounds * numProbes) << "ns/lookup, linear scan "
+        << double(linearUs) * 1000 / numProbes << "ns/lookup" << endl;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   srand(1);
+
+   // empty tree, and the zero length prefix that matches everything
+   {
+      PrefixTree<int> tree;
+      unsigned char key[4] = { 192, 0, 2, 1 };
+      FindAny any;
+      assert(!tree.find(key, 32, any));
+      tree.insert(key, 0, 1);
+      unsigned char other[4] = { 10, 0, 0, 1 };
+      assert(tree.find(other, 32, any));
+   }
+
+   // nested, duplicate and diverging prefixes
+   {
+      PrefixTree<int> tree;
+      unsigned char net10[4] = { 10, 0, 0, 0 };
+      unsigned char net10_1[4] = { 10, 1, 0, 0 };
+      unsigned char net10_1_2[4] = { 10, 1, 2, 0 };
+      unsigned char host[4] = { 10, 1, 2, 3 };
+      tree.insert(net10_1_2, 24, 24);
+      tree.insert(net10, 8, 8);
+      tree.insert(net10_1, 16, 16);
+      tree.insert(net10_1, 16, 160);
+      tree.insert(host, 32, 32);
+      unsigned char net10_128[4] = { 10, 128, 0, 0 };
+      tree.insert(net10_128, 9, 9);
+      assert(tree.size() == 6);
+
+      Collect collect;
+      tree.find(host, 32, collect);
+      assert(collect.ids.size() == 5);
+      assert(collect.ids[0] == 32);
+      assert(collect.ids[1] == 24);
+      assert(collect.ids[2] == 16 && collect.ids[3] == 160);
+      assert(collect.ids[4] == 8);
+
+      unsigned char inNet10_128[4] = { 10, 200, 1, 1 };
+      Collect collect2;
+      tree.find(inNet10_128, 32, collect2);
+      assert(collect2.ids.size() == 2 && collect2.ids[0] == 9 && collect2.ids[1] == 8);
+
+      // bits beyond the prefix length are ignored on insert
+      unsigned char untidy[4] = { 10, 1, 2, 99 };
+      tree.insert(untidy, 24, 240);
+      Collect collect3;
+      tree.find(host, 32, collect3);
+      assert(collect3.ids.size() == 6 && collect3.ids[1] == 24 && collect3.ids[2] == 240);
+
+      unsigned char outside[4] = { 11, 1, 2, 3 };
+      FindAny any;
+      assert(!tree.find(outside, 32, any));
+   }
+
+   checkAgainstLinear(1000, 32, 1);
+   checkAgainstLinear(1000, 128, 1);
+   checkAgainstLinear(50, 32, 20);
+
+   benchmark(10000, 32, 8);
+   benchmark(10000, 128, 32);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
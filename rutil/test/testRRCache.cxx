@@ -0,0 +1,214 @@
+#include <cassert>
+#include <iostream>
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#endif
+
+#include "rutil/BaseException.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/dns/DnsHostRecord.hxx"
+#include "rutil/dns/QueryTypes.hxx"
+#include "rutil/dns/RRCache.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+DnsHostRecord
+makeHost(const Data& name, const char* addr)
+{
+   in_addr a;
+   inet_pton(AF_INET, addr, &a);
+   return DnsHostRecord(name, a);
+}
+
+bool
+found(RRCache& cache, const Data& target, int type = RR_A::getRRType())
+{
+   RRCache::Result records;
+   int status = -1;
+   return cache.lookup(target, type, RRCache::Protocol::Sip, records, status) && status == 0 && records.size() == 1;
+}
+
+void
+testKey()
+{
+   Data a("Example.COM");
+   Data b("example.com");
+   Data c("example.org");
+   assert(RRCache::Key(a, 1) == RRCache::Key(b, 1));
+   assert(RRCache::Key(a, 1).hash() == RRCache::Key(b, 1).hash());
+   assert(!(RRCache::Key(a, 1) == RRCache::Key(b, 33)));
+   assert(!(RRCache::Key(a, 1) == RRCache::Key(c, 1)));
+   assert(!(RRCache::Key(Data("example.co"), 1) == RRCache::Key(b, 1)));
+}
+
+void
+testLookup()
+{
+   RRCache cache;
+   cache.updateCacheFromHostFile(makeHost("Example.COM", "192.0.2.1"));
+
+   // names match regardless of case, types do not mix
+   assert(found(cache, "example.com"));
+   assert(found(cache, "EXAMPLE.com"));
+   assert(!found(cache, "example.com", RR_SRV::getRRType()));
+   assert(!found(cache, "example.org"));
+
+   // updating replaces rather than adds
+   cache.updateCacheFromHostFile(makeHost("example.com", "192.0.2.2"));
+   RRCache::Result records;
+   int status;
+   assert(cache.lookup("example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   assert(dynamic_cast<DnsHostRecord*>(records[0])->host() == "192.0.2.2");
+
+   cache.clearCache();
+   assert(!found(cache, "example.com"));
+}
+
+void
+testLru()
+{
+   RRCache cache;
+   // purge() runs after each insert and trims once size is reached, so
+   // this holds four entries
+   cache.setSize(5);
+   for (int i = 0; i < 4; ++i)
+   {
+      cache.updateCacheFromHostFile(makeHost("host" + Data(i) + ".example.com", "192.0.2.1"));
+   }
+   // make host0 the most recently used, so host1 is the next to go
+   assert(found(cache, "host0.example.com"));
+   cache.updateCacheFromHostFile(makeHost("host4.example.com", "192.0.2.1"));
+
+   assert(found(cache, "host0.example.com"));
+   assert(!found(cache, "host1.example.com"));
+   assert(found(cache, "host4.example.com"));
+
+   Data dump;
+   cache.getCacheDump(dump);
+   assert(dump.prefix("DNSCACHE: TotalEntries=4"));
+   // sorted by name
+   Data::size_type p0 = dump.find("host0");
+   Data::size_type p2 = dump.find("host2");
+   Data::size_type p4 = dump.find("host4");
+   assert(p0 != Data::npos && p0 < p2 && p2 < p4);
+}
+
+void
+testPrefetch()
+{
+   RRCache cache;
+   RRCache::PrefetchList targets;
+
+   // host file entries live for an hour; a two hour window means every
+   // lookup falls inside it
+   cache.updateCacheFromHostFile(makeHost("Busy.example.com", "192.0.2.1"));
+   assert(found(cache, "busy.example.com"));
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.empty()); // disabled by default
+
+   cache.setPrefetch(7200, 3);
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.size() == 1);
+   assert(targets[0].first == "Busy.example.com");
+   assert(targets[0].second == RR_A::getRRType());
+
+   // only asked for once until the entry is refreshed
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.empty());
+
+   // or until the refresh fails
+   cache.prefetchDone("BUSY.example.com", RR_A::getRRType());
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.size() == 1);
+   cache.prefetchDone("unknown.example.com", RR_A::getRRType());
+
+   // the refresh resets the hit count
+   cache.updateCacheFromHostFile(makeHost("busy.example.com", "192.0.2.1"));
+   assert(found(cache, "busy.example.com"));
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.empty());
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.size() == 1);
+
+   // outside the window nothing is asked for
+   cache.setPrefetch(60, 1);
+   cache.updateCacheFromHostFile(makeHost("busy.example.com", "192.0.2.1"));
+   assert(found(cache, "busy.example.com"));
+   cache.takePrefetches(targets);
+   assert(targets.empty());
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   testKey();
+   testLookup();
+   testLru();
+   testPrefetch();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
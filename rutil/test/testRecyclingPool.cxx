@@ -0,0 +1,172 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "rutil/RecyclingPool.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+struct DisabledTag {};
+struct LocalTag {};
+struct CrossThreadTag {};
+
+typedef RecyclingPool<DisabledTag, 64> DisabledPool;
+typedef RecyclingPool<LocalTag, 128> LocalPool;
+typedef RecyclingPool<CrossThreadTag, 256> CrossThreadPool;
+
+void
+testDisabled()
+{
+   assert(DisabledPool::getCacheSize() == 0);
+   void* a = DisabledPool::allocate();
+   memset(a, 0xab, 64);
+   DisabledPool::deallocate(a);
+   DisabledPool::deallocate(0);
+   DisabledPool::Stats stats = DisabledPool::getStats();
+   assert(stats.allocated == 1);
+   assert(stats.recycled == 0);
+   assert(stats.released == 1);
+}
+
+void
+testLocalRecycling()
+{
+   LocalPool::setCacheSize(8);
+   vector<void*> blocks;
+   for (int i = 0; i < 8; ++i)
+   {
+      blocks.push_back(LocalPool::allocate());
+      memset(blocks.back(), i, 128);
+   }
+   set<void*> first(blocks.begin(), blocks.end());
+   assert(first.size() == 8);
+   for (size_t i = 0; i < blocks.size(); ++i)
+   {
+      LocalPool::deallocate(blocks[i]);
+   }
+
+   // the same blocks come back, without touching the system allocator
+   blocks.clear();
+   for (int i = 0; i < 8; ++i)
+   {
+      blocks.push_back(LocalPool::allocate());
+      assert(first.count(blocks.back()) == 1);
+   }
+   LocalPool::Stats stats = LocalPool::getStats();
+   assert(stats.allocated == 8);
+   assert(stats.recycled == 8);
+   assert(stats.released == 0);
+
+   // turning recycling off mid flight is safe
+   LocalPool::setCacheSize(0);
+   for (size_t i = 0; i < blocks.size(); ++i)
+   {
+      LocalPool::deallocate(blocks[i]);
+   }
+   assert(LocalPool::getStats().released == 8);
+}
+
+// One thread allocates, another frees: blocks must find their way back to
+// the allocating thread through the depot, and the depot must stay bounded.
+void
+testCrossThread()
+{
+   const unsigned int cacheSize = 16;
+   CrossThreadPool::setCacheSize(cacheSize);
+
+   for (int round = 0; round < 50; ++round)
+   {
+      vector<void*> blocks;
+      for (int i = 0; i < 100; ++i)
+      {
+         blocks.push_back(CrossThreadPool::allocate());
+         memset(blocks.back(), round, 256);
+      }
+      thread freer([&blocks]()
+      {
+         for (size_t i = 0; i < blocks.size(); ++i)
+         {
+            CrossThreadPool::deallocate(blocks[i]);
+         }
+      });
+      freer.join();
+   }
+
+   CrossThreadPool::Stats stats = CrossThreadPool::getStats();
+   assert(stats.allocated + stats.recycled == 5000);
+   assert(stats.recycled > 0);
+   // whatever is not cached or in the depot was given back
+   assert(stats.allocated - stats.released <= cacheSize + cacheSize * 16);
+   cerr << "cross thread: allocated=" << stats.allocated
+        << " recycled=" << stats.recycled
+        << " released=" << stats.released << endl;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   testDisabled();
+   testLocalRecycling();
+   testCrossThread();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,306 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "rutil/TimingWheel.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+struct Fired
+{
+      Fired(uint64_t& now) : mNow(now) {}
+      void operator()(const int& id)
+      {
+         mIds.push_back(id);
+         mWhen.push_back(mNow);
+      }
+      uint64_t& mNow;
+      vector<int> mIds;
+      vector<uint64_t> mWhen;
+};
+
+// counts live copies, to check that payloads are destroyed
+struct Counted
+{
+      static int sLive;
+      Counted() { ++sLive; }
+      Counted(const Counted&) { ++sLive; }
+      ~Counted() { --sLive; }
+};
+int Counted::sLive = 0;
+
+struct Ignore
+{
+      template <class T> void operator()(const T&) {}
+};
+
+struct AddFromCallback
+{
+      AddFromCallback(TimingWheel<int>& wheel, uint64_t& now) : mWheel(wheel), mNow(now), mCount(0) {}
+      void operator()(const int& id)
+      {
+         ++mCount;
+         if (id == 1)
+         {
+            // already due; must still fire in this same expire() call
+            mWheel.add(2, mNow);
+            // due later
+            mWheel.add(3, mNow + 10);
+         }
+      }
+      TimingWheel<int>& mWheel;
+      uint64_t& mNow;
+      int mCount;
+};
+
+void
+testBasic()
+{
+   uint64_t now = 1000000;
+   TimingWheel<int> wheel(now);
+   Fired fired(now);
+
+   assert(wheel.empty());
+   assert(wheel.nextExpiry() == 0);
+
+   TimingWheel<int>::Handle h1 = wheel.add(1, now + 10);
+   TimingWheel<int>::Handle h2 = wheel.add(2, now + 5);
+   TimingWheel<int>::Handle h3 = wheel.add(3, now + 300);      // level 1
+   TimingWheel<int>::Handle h4 = wheel.add(4, now + 70000);    // level 2
+   TimingWheel<int>::Handle h5 = wheel.add(5, now + 20000000); // level 3
+   assert(wheel.size() == 5);
+   assert(wheel.nextExpiry() == now + 5);
+   assert(h1 != h2 && h1 != TimingWheel<int>::NoHandle);
+
+   now += 4;
+   wheel.expire(now, fired);
+   assert(fired.mIds.empty());
+
+   now += 1;
+   wheel.expire(now, fired);
+   assert(fired.mIds.size() == 1 && fired.mIds[0] == 2);
+   assert(!wheel.isPending(h2));
+   assert(!wheel.cancel(h2));
+
+   assert(wheel.cancel(h1));
+   assert(!wheel.isPending(h1));
+   assert(wheel.size() == 3);
+   assert(wheel.nextExpiry() <= now + 295);
+
+   // jump well past the level 1 timer
+   now += 1000;
+   wheel.expire(now, fired);
+   assert(fired.mIds.size() == 2 && fired.mIds[1] == 3);
+   assert(wheel.isPending(h4));
+
+   now += 70000;
+   wheel.expire(now, fired);
+   assert(fired.mIds.size() == 3 && fired.mIds[2] == 4);
+
+   assert(wheel.isPending(h5));
+   assert(wheel.cancel(h5));
+   assert(wheel.empty());
+   assert(!wheel.isPending(h3));
+}
+
+void
+testPastDueAndCallback()
+{
+   uint64_t now = 5000;
+   TimingWheel<int> wheel(now);
+   Fired fired(now);
+
+   now += 100;
+   wheel.expire(now, fired);
+
+   // expiry in the past fires on the next expire() even if time stood still
+   wheel.add(7, now - 50);
+   assert(wheel.nextExpiry() == now - 50);
+   wheel.expire(now, fired);
+   assert(fired.mIds.size() == 1 && fired.mIds[0] == 7);
+
+   AddFromCallback cb(wheel, now);
+   wheel.add(1, now + 1);
+   now += 1;
+   wheel.expire(now, cb);
+   assert(cb.mCount == 2);
+   assert(wheel.size() == 1);
+   assert(wheel.nextExpiry() == now + 10);
+}
+
+void
+testPayloadLifetime()
+{
+   uint64_t now = 0;
+   {
+      TimingWheel<Counted> wheel(now);
+      TimingWheel<Counted>::Handle handles[100];
+      for (int i = 0; i < 100; ++i)
+      {
+         handles[i] = wheel.add(Counted(), now + i * 1000);
+      }
+      assert(Counted::sLive == 100);
+      for (int i = 0; i < 100; i += 2)
+      {
+         assert(wheel.cancel(handles[i]));
+      }
+      assert(Counted::sLive == 50);
+      Ignore ignore;
+      wheel.expire(now + 10000, ignore);
+      assert(Counted::sLive == 45);
+   }
+   assert(Counted::sLive == 0);
+}
+
+// Compares the wheel against a multimap under random adds, cancels and
+// uneven time steps (including long idle gaps and far-future timers).
+void
+testAgainstReference()
+{
+   srand(1234);
+   uint64_t now = (uint64_t(1) << 32) - 100000; // cross a top level boundary
+   TimingWheel<int> wheel(now);
+   Fired fired(now);
+
+   multimap<uint64_t, int> reference;
+   map<int, TimingWheel<int>::Handle> handles;
+   map<int, uint64_t> whenById;
+   int nextId = 0;
+
+   for (int round = 0; round < 20000; ++round)
+   {
+      int op = rand() % 10;
+      if (op < 6)
+      {
+         uint64_t delta;
+         switch (rand() % 5)
+         {
+            case 0: delta = rand() % 256; break;
+            case 1: delta = rand() % 65536; break;
+            case 2: delta = uint64_t(rand() % 1000) * 1000; break;
+            case 3: delta = uint64_t(rand() % 64) << 27; break;
+            default: delta = rand() % 64000; break;
+         }
+         int id = nextId++;
+         handles[id] = wheel.add(id, now + delta);
+         whenById[id] = now + delta;
+         reference.insert(make_pair(now + delta, id));
+      }
+      else if (op < 8 && !handles.empty())
+      {
+         map<int, TimingWheel<int>::Handle>::iterator it = handles.lower_bound(rand() % nextId);
+         if (it == handles.end())
+         {
+            it = handles.begin();
+         }
+         assert(wheel.cancel(it->second));
+         multimap<uint64_t, int>::iterator r = reference.lower_bound(whenById[it->first]);
+         while (r->second != it->first)
+         {
+            ++r;
+         }
+         reference.erase(r);
+         handles.erase(it);
+      }
+      else
+      {
+         uint64_t step = (rand() % 20 == 0) ? uint64_t(rand() % 200) * 1000 : rand() % 600;
+         now += step;
+         size_t before = fired.mIds.size();
+         wheel.expire(now, fired);
+
+         size_t expected = 0;
+         while (!reference.empty() && reference.begin()->first <= now)
+         {
+            int id = reference.begin()->second;
+            reference.erase(reference.begin());
+            handles.erase(id);
+            ++expected;
+         }
+         assert(fired.mIds.size() - before == expected);
+         for (size_t i = before; i < fired.mIds.size(); ++i)
+         {
+            assert(whenById[fired.mIds[i]] <= now);
+            if (i > before)
+            {
+               assert(whenById[fired.mIds[i - 1]] <= whenById[fired.mIds[i]]);
+            }
+         }
+      }
+
+      assert(wheel.size() == reference.size());
+      if (!reference.empty())
+      {
+         assert(wheel.nextExpiry() <= reference.begin()->first);
+      }
+   }
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   testBasic();
+   testPastDueAndCallback();
+   testPayloadLifetime();
+   testAgainstReference();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2004 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */